@@ -7,9 +7,12 @@
 
 #include "board_init.h"
 #include "cmsis_utils.h"
+#include "dns_resolver.h"
 #include "screen.h"
 #include "sntp_client.h"
+#include "startup.h"
 
+#include "azure_iot_nx_client.h"
 #include "legacy/mqtt.h"
 #include "nx_client.h"
 #include "wwd_networking.h"
@@ -22,28 +25,49 @@
 TX_THREAD azure_thread;
 ULONG azure_thread_stack[AZURE_THREAD_STACK_SIZE / sizeof(ULONG)];
 
+enum
+{
+    STARTUP_STAGE_NETWORK,
+    STARTUP_STAGE_SNTP,
+    STARTUP_STAGE_DNS,
+    STARTUP_STAGE_CLIENT
+};
+
+// The first host the client connects to, resolved while SNTP waits so the connect finds it in the DNS caches
+#ifdef ENABLE_DPS
+#define STARTUP_DNS_HOST_NAME AZURE_IOT_DPS_ENDPOINT
+#else
+#define STARTUP_DNS_HOST_NAME IOT_HUB_HOSTNAME
+#endif
+
 void azure_thread_entry(ULONG parameter);
 void tx_application_define(void* first_unused_memory);
 
-void azure_thread_entry(ULONG parameter)
+static UINT network_stage(VOID* context)
 {
     UINT status;
 
-    printf("Starting Azure thread\r\n\r\n");
-
-    if (platform_init(WIFI_SSID, WIFI_PASSWORD, WIFI_MODE) != NX_SUCCESS)
+    // Initialize the network
+    if ((status = platform_init(WIFI_SSID, WIFI_PASSWORD, WIFI_MODE)))
     {
         printf("Failed to initialize platform.\r\n");
-        return;
+        return status;
     }
     screen_print("WiFi ready", L0);
 
+    return NX_SUCCESS;
+}
+
+static UINT sntp_stage(VOID* context)
+{
+    UINT status;
+
     // Start the SNTP client
     status = sntp_start();
     if (status != NX_SUCCESS)
     {
         printf("Failed to start the SNTP client (0x%02x)\r\n", status);
-        return;
+        return status;
     }
 
     // Wait for an SNTP sync
@@ -51,14 +75,60 @@ void azure_thread_entry(ULONG parameter)
     if (status != NX_SUCCESS)
     {
         printf("Failed to start sync SNTP time (0x%02x)\r\n", status);
-        return;
+        return status;
     }
     screen_print("SNTP inited", L0);
 
+    return NX_SUCCESS;
+}
+
+static UINT dns_stage(VOID* context)
+{
+    UINT status;
+
+    // The connect resolves the host itself if this fails, so startup carries on
+    if ((status = dns_resolver_prefetch(STARTUP_DNS_HOST_NAME, 5 * NX_IP_PERIODIC_RATE)))
+    {
+        printf("Failed to resolve %s ahead of connect (0x%04x)\r\n", STARTUP_DNS_HOST_NAME, status);
+    }
+
+    return NX_SUCCESS;
+}
+
+#ifndef ENABLE_LEGACY_MQTT
+static UINT client_stage(VOID* context)
+{
+    return azure_iot_nx_client_setup(&nx_ip, &nx_pool[0], &nx_dns_client, sntp_time);
+}
+#endif
+
+// The first cloud host is resolved and the client created while SNTP waits for a server to answer
+static STARTUP_STAGE startup_stages[] = {
+    {"network", network_stage, NX_NULL, 0},
+    {"sntp", sntp_stage, NX_NULL, STARTUP_AFTER(STARTUP_STAGE_NETWORK)},
+    {"dns", dns_stage, NX_NULL, STARTUP_AFTER(STARTUP_STAGE_NETWORK)},
+#ifndef ENABLE_LEGACY_MQTT
+    {"client", client_stage, NX_NULL, STARTUP_AFTER(STARTUP_STAGE_NETWORK)},
+#endif
+};
+
+void azure_thread_entry(ULONG parameter)
+{
+    UINT status;
+
+    printf("Starting Azure thread\r\n\r\n");
+
+    // Bring up the network, SNTP and the client, overlapping the stages that don't depend on each other
+    if ((status = startup_run(startup_stages, sizeof(startup_stages) / sizeof(startup_stages[0]))))
+    {
+        printf("Failed to start up (0x%04x)\r\n", status);
+        return;
+    }
+
 #ifdef ENABLE_LEGACY_MQTT
     if ((status = azure_iot_mqtt_entry(&nx_ip, &nx_pool[0], &nx_dns_client, sntp_time_get)))
 #else
-    if ((status = azure_iot_nx_client_entry(&nx_ip, &nx_pool[0], &nx_dns_client, sntp_time)))
+    if ((status = azure_iot_nx_client_entry()))
 #endif
     {
         printf("Failed to run Azure IoT (0x%04x)\r\n", status);
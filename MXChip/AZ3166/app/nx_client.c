@@ -16,33 +16,22 @@
 
 #include "azure_iot_nx_client.h"
 #include "nx_azure_iot_pnp_helpers.h"
+#include "pnp_model.h"
 
 #include "azure_config.h"
 #include "azure_device_x509_cert_config.h"
 #include "azure_pnp_info.h"
 
-#define IOT_MODEL_ID "dtmi:azurertos:devkit:gsgmxchip;2"
-
-// Device telemetry names
-#define TELEMETRY_HUMIDITY          "humidity"
-#define TELEMETRY_TEMPERATURE       "temperature"
-#define TELEMETRY_PRESSURE          "pressure"
-#define TELEMETRY_MAGNETOMETERX     "magnetometerX"
-#define TELEMETRY_MAGNETOMETERY     "magnetometerY"
-#define TELEMETRY_MAGNETOMETERZ     "magnetometerZ"
-#define TELEMETRY_ACCELEROMETERX    "accelerometerX"
-#define TELEMETRY_ACCELEROMETERY    "accelerometerY"
-#define TELEMETRY_ACCELEROMETERZ    "accelerometerZ"
-#define TELEMETRY_GYROSCOPEX        "gyroscopeX"
-#define TELEMETRY_GYROSCOPEY        "gyroscopeY"
-#define TELEMETRY_GYROSCOPEZ        "gyroscopeZ"
-#define TELEMETRY_INTERVAL_PROPERTY "telemetryInterval"
-#define LED_STATE_PROPERTY          "ledState"
-#define SET_LED_STATE_COMMAND       "setLedState"
-#define SET_DISPLAY_TEXT_COMMAND    "setDisplayText"
-
 #define TELEMETRY_INTERVAL_EVENT 1
 
+// Report by exception, a reading is only sent once it moves past its deadband or the heartbeat interval expires
+#define TELEMETRY_HEARTBEAT_SECS (5 * 60)
+
+// IoT Central and IoT Explorer only decode JSON, use TELEMETRY_ENCODING_CBOR to shrink the IMU messages
+#ifndef IMU_TELEMETRY_ENCODING
+#define IMU_TELEMETRY_ENCODING TELEMETRY_ENCODING_JSON
+#endif
+
 typedef enum TELEMETRY_STATE_ENUM
 {
     TELEMETRY_STATE_DEFAULT,
@@ -57,48 +46,22 @@ static TX_EVENT_FLAGS_GROUP azure_iot_flags;
 
 static int32_t telemetry_interval = 10;
 
+static TELEMETRY_DEADBAND humidity_deadband    = TELEMETRY_DEADBAND_INIT(1, 0, TELEMETRY_HEARTBEAT_SECS);
+static TELEMETRY_DEADBAND temperature_deadband = TELEMETRY_DEADBAND_INIT(0.5, 0, TELEMETRY_HEARTBEAT_SECS);
+static TELEMETRY_DEADBAND pressure_deadband    = TELEMETRY_DEADBAND_INIT(0.5, 0, TELEMETRY_HEARTBEAT_SECS);
+
 static UINT append_device_info_properties(NX_AZURE_IOT_JSON_WRITER* json_writer, VOID* context)
 {
-    if (nx_azure_iot_json_writer_append_property_with_string_value(json_writer,
-            (UCHAR*)DEVICE_INFO_MANUFACTURER_PROPERTY_NAME,
-            sizeof(DEVICE_INFO_MANUFACTURER_PROPERTY_NAME) - 1,
-            (UCHAR*)DEVICE_INFO_MANUFACTURER_PROPERTY_VALUE,
-            sizeof(DEVICE_INFO_MANUFACTURER_PROPERTY_VALUE) - 1) ||
-        nx_azure_iot_json_writer_append_property_with_string_value(json_writer,
-            (UCHAR*)DEVICE_INFO_MODEL_PROPERTY_NAME,
-            sizeof(DEVICE_INFO_MODEL_PROPERTY_NAME) - 1,
-            (UCHAR*)DEVICE_INFO_MODEL_PROPERTY_VALUE,
-            sizeof(DEVICE_INFO_MODEL_PROPERTY_VALUE) - 1) ||
-        nx_azure_iot_json_writer_append_property_with_string_value(json_writer,
-            (UCHAR*)DEVICE_INFO_SW_VERSION_PROPERTY_NAME,
-            sizeof(DEVICE_INFO_SW_VERSION_PROPERTY_NAME) - 1,
-            (UCHAR*)DEVICE_INFO_SW_VERSION_PROPERTY_VALUE,
-            sizeof(DEVICE_INFO_SW_VERSION_PROPERTY_VALUE) - 1) ||
-        nx_azure_iot_json_writer_append_property_with_string_value(json_writer,
-            (UCHAR*)DEVICE_INFO_OS_NAME_PROPERTY_NAME,
-            sizeof(DEVICE_INFO_OS_NAME_PROPERTY_NAME) - 1,
-            (UCHAR*)DEVICE_INFO_OS_NAME_PROPERTY_VALUE,
-            sizeof(DEVICE_INFO_OS_NAME_PROPERTY_VALUE) - 1) ||
-        nx_azure_iot_json_writer_append_property_with_string_value(json_writer,
-            (UCHAR*)DEVICE_INFO_PROCESSOR_ARCHITECTURE_PROPERTY_NAME,
-            sizeof(DEVICE_INFO_PROCESSOR_ARCHITECTURE_PROPERTY_NAME) - 1,
-            (UCHAR*)DEVICE_INFO_PROCESSOR_ARCHITECTURE_PROPERTY_VALUE,
-            sizeof(DEVICE_INFO_PROCESSOR_ARCHITECTURE_PROPERTY_VALUE) - 1) ||
-        nx_azure_iot_json_writer_append_property_with_string_value(json_writer,
-            (UCHAR*)DEVICE_INFO_PROCESSOR_MANUFACTURER_PROPERTY_NAME,
-            sizeof(DEVICE_INFO_PROCESSOR_MANUFACTURER_PROPERTY_NAME) - 1,
-            (UCHAR*)DEVICE_INFO_PROCESSOR_MANUFACTURER_PROPERTY_VALUE,
-            sizeof(DEVICE_INFO_PROCESSOR_MANUFACTURER_PROPERTY_VALUE) - 1) ||
-        nx_azure_iot_json_writer_append_property_with_double_value(json_writer,
-            (UCHAR*)DEVICE_INFO_TOTAL_STORAGE_PROPERTY_NAME,
-            sizeof(DEVICE_INFO_TOTAL_STORAGE_PROPERTY_NAME) - 1,
-            DEVICE_INFO_TOTAL_STORAGE_PROPERTY_VALUE,
-            2) ||
-        nx_azure_iot_json_writer_append_property_with_double_value(json_writer,
-            (UCHAR*)DEVICE_INFO_TOTAL_MEMORY_PROPERTY_NAME,
-            sizeof(DEVICE_INFO_TOTAL_MEMORY_PROPERTY_NAME) - 1,
-            DEVICE_INFO_TOTAL_MEMORY_PROPERTY_VALUE,
-            2))
+    if (pnp_device_information_property_manufacturer_append(json_writer, DEVICE_INFO_MANUFACTURER_PROPERTY_VALUE) ||
+        pnp_device_information_property_model_append(json_writer, DEVICE_INFO_MODEL_PROPERTY_VALUE) ||
+        pnp_device_information_property_sw_version_append(json_writer, DEVICE_INFO_SW_VERSION_PROPERTY_VALUE) ||
+        pnp_device_information_property_os_name_append(json_writer, DEVICE_INFO_OS_NAME_PROPERTY_VALUE) ||
+        pnp_device_information_property_processor_architecture_append(
+            json_writer, DEVICE_INFO_PROCESSOR_ARCHITECTURE_PROPERTY_VALUE) ||
+        pnp_device_information_property_processor_manufacturer_append(
+            json_writer, DEVICE_INFO_PROCESSOR_MANUFACTURER_PROPERTY_VALUE) ||
+        pnp_device_information_property_total_storage_append(json_writer, DEVICE_INFO_TOTAL_STORAGE_PROPERTY_VALUE) ||
+        pnp_device_information_property_total_memory_append(json_writer, DEVICE_INFO_TOTAL_MEMORY_PROPERTY_VALUE))
     {
         return NX_NOT_SUCCESSFUL;
     }
@@ -106,20 +69,14 @@ static UINT append_device_info_properties(NX_AZURE_IOT_JSON_WRITER* json_writer,
     return NX_AZURE_IOT_SUCCESS;
 }
 
-static UINT append_device_telemetry(NX_AZURE_IOT_JSON_WRITER* json_writer, VOID* context)
+static UINT append_device_telemetry(TELEMETRY_WRITER* writer, VOID* context)
 {
     lps22hb_t lps22hb_data    = lps22hb_data_read();
     hts221_data_t hts221_data = hts221_data_read();
 
-    if (nx_azure_iot_json_writer_append_property_with_double_value(
-            json_writer, (UCHAR*)TELEMETRY_HUMIDITY, sizeof(TELEMETRY_HUMIDITY) - 1, hts221_data.humidity_perc, 2) ||
-        nx_azure_iot_json_writer_append_property_with_double_value(json_writer,
-            (UCHAR*)TELEMETRY_TEMPERATURE,
-            sizeof(TELEMETRY_TEMPERATURE) - 1,
-            lps22hb_data.temperature_degC,
-            2) ||
-        nx_azure_iot_json_writer_append_property_with_double_value(
-            json_writer, (UCHAR*)TELEMETRY_PRESSURE, sizeof(TELEMETRY_PRESSURE) - 1, lps22hb_data.pressure_hPa, 2))
+    if (pnp_telemetry_humidity_append_filtered(writer, &humidity_deadband, hts221_data.humidity_perc) ||
+        pnp_telemetry_temperature_append_filtered(writer, &temperature_deadband, lps22hb_data.temperature_degC) ||
+        pnp_telemetry_pressure_append_filtered(writer, &pressure_deadband, lps22hb_data.pressure_hPa))
     {
         return NX_NOT_SUCCESSFUL;
     }
@@ -127,25 +84,13 @@ static UINT append_device_telemetry(NX_AZURE_IOT_JSON_WRITER* json_writer, VOID*
     return NX_AZURE_IOT_SUCCESS;
 }
 
-static UINT append_device_telemetry_magnetometer(NX_AZURE_IOT_JSON_WRITER* json_writer, VOID* context)
+static UINT append_device_telemetry_magnetometer(TELEMETRY_WRITER* writer, VOID* context)
 {
     lis2mdl_data_t lis2mdl_data = lis2mdl_data_read();
 
-    if (nx_azure_iot_json_writer_append_property_with_double_value(json_writer,
-            (UCHAR*)TELEMETRY_MAGNETOMETERX,
-            sizeof(TELEMETRY_MAGNETOMETERX) - 1,
-            lis2mdl_data.magnetic_mG[0],
-            2) ||
-        nx_azure_iot_json_writer_append_property_with_double_value(json_writer,
-            (UCHAR*)TELEMETRY_MAGNETOMETERY,
-            sizeof(TELEMETRY_MAGNETOMETERY) - 1,
-            lis2mdl_data.magnetic_mG[1],
-            2) ||
-        nx_azure_iot_json_writer_append_property_with_double_value(json_writer,
-            (UCHAR*)TELEMETRY_MAGNETOMETERZ,
-            sizeof(TELEMETRY_MAGNETOMETERZ) - 1,
-            lis2mdl_data.magnetic_mG[2],
-            2))
+    if (pnp_telemetry_magnetometer_x_append(writer, lis2mdl_data.magnetic_mG[0]) ||
+        pnp_telemetry_magnetometer_y_append(writer, lis2mdl_data.magnetic_mG[1]) ||
+        pnp_telemetry_magnetometer_z_append(writer, lis2mdl_data.magnetic_mG[2]))
     {
         return NX_NOT_SUCCESSFUL;
     }
@@ -153,25 +98,13 @@ static UINT append_device_telemetry_magnetometer(NX_AZURE_IOT_JSON_WRITER* json_
     return NX_AZURE_IOT_SUCCESS;
 }
 
-static UINT append_device_telemetry_accelerometer(NX_AZURE_IOT_JSON_WRITER* json_writer, VOID* context)
+static UINT append_device_telemetry_accelerometer(TELEMETRY_WRITER* writer, VOID* context)
 {
     lsm6dsl_data_t lsm6dsl_data = lsm6dsl_data_read();
 
-    if (nx_azure_iot_json_writer_append_property_with_double_value(json_writer,
-            (UCHAR*)TELEMETRY_ACCELEROMETERX,
-            sizeof(TELEMETRY_ACCELEROMETERX) - 1,
-            lsm6dsl_data.acceleration_mg[0],
-            2) ||
-        nx_azure_iot_json_writer_append_property_with_double_value(json_writer,
-            (UCHAR*)TELEMETRY_ACCELEROMETERY,
-            sizeof(TELEMETRY_ACCELEROMETERY) - 1,
-            lsm6dsl_data.acceleration_mg[1],
-            2) ||
-        nx_azure_iot_json_writer_append_property_with_double_value(json_writer,
-            (UCHAR*)TELEMETRY_ACCELEROMETERZ,
-            sizeof(TELEMETRY_ACCELEROMETERZ) - 1,
-            lsm6dsl_data.acceleration_mg[2],
-            2))
+    if (pnp_telemetry_accelerometer_x_append(writer, lsm6dsl_data.acceleration_mg[0]) ||
+        pnp_telemetry_accelerometer_y_append(writer, lsm6dsl_data.acceleration_mg[1]) ||
+        pnp_telemetry_accelerometer_z_append(writer, lsm6dsl_data.acceleration_mg[2]))
     {
         return NX_NOT_SUCCESSFUL;
     }
@@ -179,25 +112,13 @@ static UINT append_device_telemetry_accelerometer(NX_AZURE_IOT_JSON_WRITER* json
     return NX_AZURE_IOT_SUCCESS;
 }
 
-static UINT append_device_telemetry_gyroscope(NX_AZURE_IOT_JSON_WRITER* json_writer, VOID* context)
+static UINT append_device_telemetry_gyroscope(TELEMETRY_WRITER* writer, VOID* context)
 {
     lsm6dsl_data_t lsm6dsl_data = lsm6dsl_data_read();
 
-    if (nx_azure_iot_json_writer_append_property_with_double_value(json_writer,
-            (UCHAR*)TELEMETRY_GYROSCOPEX,
-            sizeof(TELEMETRY_GYROSCOPEX) - 1,
-            lsm6dsl_data.angular_rate_mdps[0],
-            2) ||
-        nx_azure_iot_json_writer_append_property_with_double_value(json_writer,
-            (UCHAR*)TELEMETRY_GYROSCOPEY,
-            sizeof(TELEMETRY_GYROSCOPEY) - 1,
-            lsm6dsl_data.angular_rate_mdps[1],
-            2) ||
-        nx_azure_iot_json_writer_append_property_with_double_value(json_writer,
-            (UCHAR*)TELEMETRY_GYROSCOPEZ,
-            sizeof(TELEMETRY_GYROSCOPEZ) - 1,
-            lsm6dsl_data.angular_rate_mdps[2],
-            2))
+    if (pnp_telemetry_gyroscope_x_append(writer, lsm6dsl_data.angular_rate_mdps[0]) ||
+        pnp_telemetry_gyroscope_y_append(writer, lsm6dsl_data.angular_rate_mdps[1]) ||
+        pnp_telemetry_gyroscope_z_append(writer, lsm6dsl_data.angular_rate_mdps[2]))
     {
         return NX_NOT_SUCCESSFUL;
     }
@@ -230,23 +151,41 @@ static void direct_method_cb(AZURE_IOT_NX_CONTEXT* nx_context,
     UINT status;
     UINT http_status    = 501;
     CHAR* http_response = "{}";
+    bool led_state;
+    CHAR display_text[64];
+    UINT display_text_length;
 
-    if (strncmp((CHAR*)method, SET_LED_STATE_COMMAND, method_length) == 0)
-    {
-        bool arg = (strncmp((CHAR*)payload, "true", payload_length) == 0);
-        set_led_state(arg);
-
-        azure_iot_nx_client_publish_bool_property(&azure_iot_nx_client, LED_STATE_PROPERTY, arg);
-
-        http_status = 200;
-    }
-
-    else if (strncmp((CHAR*)method, SET_DISPLAY_TEXT_COMMAND, method_length) == 0)
+    switch (pnp_command_lookup(method, method_length))
     {
-        // drop the first and last character to remove the quotes
-        screen_printn((CHAR*)payload + 1, payload_length - 2, L0);
-
-        http_status = 200;
+        case PNP_COMMAND_ID_SET_LED_STATE:
+            if (pnp_command_set_led_state_parse(payload, payload_length, &led_state) == NX_AZURE_IOT_SUCCESS)
+            {
+                set_led_state(led_state);
+                azure_iot_nx_client_publish_bool_property(&azure_iot_nx_client, PNP_PROPERTY_LED_STATE, led_state);
+                http_status = 200;
+            }
+            else
+            {
+                http_status = 400;
+            }
+            break;
+
+        case PNP_COMMAND_ID_SET_DISPLAY_TEXT:
+            if (pnp_command_set_display_text_parse(
+                    payload, payload_length, display_text, sizeof(display_text), &display_text_length) ==
+                NX_AZURE_IOT_SUCCESS)
+            {
+                screen_printn(display_text, display_text_length, L0);
+                http_status = 200;
+            }
+            else
+            {
+                http_status = 400;
+            }
+            break;
+
+        default:
+            break;
     }
 
     if ((status = nx_azure_iot_hub_client_direct_method_message_response(&nx_context->iothub_client,
@@ -273,18 +212,23 @@ static void device_twin_desired_property_cb(UCHAR* component_name,
     UINT status;
     AZURE_IOT_NX_CONTEXT* nx_context = (AZURE_IOT_NX_CONTEXT*)userContextCallback;
 
-    if (strncmp((CHAR*)property_name, TELEMETRY_INTERVAL_PROPERTY, property_name_len) == 0)
+    switch (pnp_property_lookup(component_name, component_name_len, property_name, property_name_len))
     {
-        status = nx_azure_iot_json_reader_token_int32_get(&property_value_reader, &telemetry_interval);
-        if (status == NX_AZURE_IOT_SUCCESS)
-        {
-            // Confirm reception back to hub
-            azure_nx_client_respond_int_writeable_property(
-                nx_context, TELEMETRY_INTERVAL_PROPERTY, telemetry_interval, 200, version);
-
-            // Set a telemetry event so we pick up the change immediately
-            tx_event_flags_set(&azure_iot_flags, TELEMETRY_INTERVAL_EVENT, TX_OR);
-        }
+        case PNP_PROPERTY_ID_TELEMETRY_INTERVAL:
+            status = pnp_property_telemetry_interval_read(&property_value_reader, &telemetry_interval);
+            if (status == NX_AZURE_IOT_SUCCESS)
+            {
+                // Confirm reception back to hub
+                azure_nx_client_respond_int_writeable_property(
+                    nx_context, PNP_PROPERTY_TELEMETRY_INTERVAL, telemetry_interval, 200, version);
+
+                // Set a telemetry event so we pick up the change immediately
+                tx_event_flags_set(&azure_iot_flags, TELEMETRY_INTERVAL_EVENT, TX_OR);
+            }
+            break;
+
+        default:
+            break;
     }
 }
 
@@ -296,18 +240,17 @@ static void device_twin_property_cb(UCHAR* component_name,
     UINT version,
     VOID* userContextCallback)
 {
-    if (strncmp((CHAR*)property_name, TELEMETRY_INTERVAL_PROPERTY, property_name_len) == 0)
+    if (pnp_property_lookup(component_name, component_name_len, property_name, property_name_len) ==
+        PNP_PROPERTY_ID_TELEMETRY_INTERVAL)
     {
-        nx_azure_iot_json_reader_token_int32_get(&property_value_reader, &telemetry_interval);
+        pnp_property_telemetry_interval_read(&property_value_reader, &telemetry_interval);
     }
 }
 
-UINT azure_iot_nx_client_entry(
+UINT azure_iot_nx_client_setup(
     NX_IP* ip_ptr, NX_PACKET_POOL* pool_ptr, NX_DNS* dns_ptr, UINT (*unix_time_callback)(ULONG* unix_time))
 {
     UINT status;
-    ULONG events                    = 0;
-    TELEMETRY_STATE telemetry_state = TELEMETRY_STATE_DEFAULT;
 
     if ((status = tx_event_flags_create(&azure_iot_flags, "Azure IoT flags")))
     {
@@ -316,7 +259,7 @@ UINT azure_iot_nx_client_entry(
     }
 
     status =
-        azure_iot_nx_client_create(&azure_iot_nx_client, ip_ptr, pool_ptr, dns_ptr, unix_time_callback, IOT_MODEL_ID);
+        azure_iot_nx_client_create(&azure_iot_nx_client, ip_ptr, pool_ptr, dns_ptr, unix_time_callback, PNP_MODEL_ID);
     if (status != NX_SUCCESS)
     {
         printf("ERROR: azure_iot_nx_client_create failed (0x%08x)\r\n", status);
@@ -338,6 +281,16 @@ UINT azure_iot_nx_client_entry(
         return status;
     }
 
+    return NX_SUCCESS;
+}
+
+UINT azure_iot_nx_client_entry(VOID)
+{
+    UINT status;
+    REPORTED_PROPERTIES properties;
+    ULONG events                    = 0;
+    TELEMETRY_STATE telemetry_state = TELEMETRY_STATE_DEFAULT;
+
 #ifdef ENABLE_DPS
     status = azure_iot_nx_client_dps_create(&azure_iot_nx_client, IOT_DPS_ID_SCOPE, IOT_DPS_REGISTRATION_ID);
 #else
@@ -367,12 +320,13 @@ UINT azure_iot_nx_client_entry(
         return status;
     }
 
-    // Send out property updates
-    azure_iot_nx_client_publish_int_writeable_property(
-        &azure_iot_nx_client, TELEMETRY_INTERVAL_PROPERTY, telemetry_interval);
-    azure_iot_nx_client_publish_bool_property(&azure_iot_nx_client, LED_STATE_PROPERTY, false);
-    azure_iot_nx_client_publish_properties(
-        &azure_iot_nx_client, DEVICE_INFO_COMPONENT_NAME, append_device_info_properties);
+    // Send out property updates as a single twin patch
+    reported_properties_begin(&properties);
+    reported_properties_append_writeable_ack(&properties, PNP_PROPERTY_TELEMETRY_INTERVAL, telemetry_interval, 200, 1);
+    reported_properties_append_bool(&properties, PNP_PROPERTY_LED_STATE, false);
+    reported_properties_component_set(&properties, PNP_COMPONENT_DEVICE_INFORMATION);
+    reported_properties_append(&properties, append_device_info_properties, NX_NULL);
+    azure_iot_nx_client_reported_properties_send_async(&azure_iot_nx_client, &properties, NX_NULL, NX_NULL);
 
     printf("\r\nStarting Main loop\r\n");
     screen_print("Azure IoT", L0);
@@ -385,19 +339,29 @@ UINT azure_iot_nx_client_entry(
         switch (telemetry_state)
         {
             case TELEMETRY_STATE_DEFAULT:
-                azure_iot_nx_client_publish_telemetry(&azure_iot_nx_client, append_device_telemetry);
+                azure_iot_nx_client_publish_telemetry_async(
+                    &azure_iot_nx_client, TELEMETRY_ENCODING_JSON, append_device_telemetry, NX_NULL, NX_NULL);
                 break;
 
             case TELEMETRY_STATE_MAGNETOMETER:
-                azure_iot_nx_client_publish_telemetry(&azure_iot_nx_client, append_device_telemetry_magnetometer);
+                azure_iot_nx_client_publish_telemetry_async(&azure_iot_nx_client,
+                    IMU_TELEMETRY_ENCODING,
+                    append_device_telemetry_magnetometer,
+                    NX_NULL,
+                    NX_NULL);
                 break;
 
             case TELEMETRY_STATE_ACCELEROMETER:
-                azure_iot_nx_client_publish_telemetry(&azure_iot_nx_client, append_device_telemetry_accelerometer);
+                azure_iot_nx_client_publish_telemetry_async(&azure_iot_nx_client,
+                    IMU_TELEMETRY_ENCODING,
+                    append_device_telemetry_accelerometer,
+                    NX_NULL,
+                    NX_NULL);
                 break;
 
             case TELEMETRY_STATE_GYROSCOPE:
-                azure_iot_nx_client_publish_telemetry(&azure_iot_nx_client, append_device_telemetry_gyroscope);
+                azure_iot_nx_client_publish_telemetry_async(
+                    &azure_iot_nx_client, IMU_TELEMETRY_ENCODING, append_device_telemetry_gyroscope, NX_NULL, NX_NULL);
                 break;
 
             default:
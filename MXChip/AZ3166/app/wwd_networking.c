@@ -8,6 +8,9 @@
 #include "nxd_dhcp_client.h"
 #include "nxd_dns.h"
 
+#include "dhcp_lease.h"
+#include "dns_resolver.h"
+
 #include "stm32f4xx.h"
 
 #include "wiced_sdk.h"
@@ -37,6 +40,9 @@ NX_IP nx_ip;
 NX_DNS nx_dns_client;
 NX_DHCP dhcp_client;
 
+static DHCP_LEASE_STORE dhcp_lease_store;
+static DHCP_LEASE dhcp_lease;
+
 // Print IPv4 address
 static void print_address(CHAR* preable, ULONG address)
 {
@@ -50,30 +56,18 @@ static void print_address(CHAR* preable, ULONG address)
 
 static void dhcp_wait(void)
 {
-    ULONG actual_status;
-    ULONG ip_address;
-    ULONG network_mask;
-    ULONG gateway_address;
-
     printf("Initializing DHCP\r\n");
 
     /* Create the DHCP instance.  */
     nx_dhcp_create(&dhcp_client, &nx_ip, "MXChip_AZ3166");
 
-    /* Start the DHCP Client.  */
-    nx_dhcp_start(&dhcp_client);
-
-    /* Wait until address is solved. */
-    nx_ip_status_check(&nx_ip, NX_IP_ADDRESS_RESOLVED, &actual_status, NX_WAIT_FOREVER);
-
-    /* Get IP address and gateway address. */
-    nx_ip_address_get(&nx_ip, &ip_address, &network_mask);
-    nx_ip_gateway_address_get(&nx_ip, &gateway_address);
+    /* Start the DHCP Client, confirming the stored lease first, and wait until address is solved. */
+    dhcp_lease_acquire(&dhcp_client, &dhcp_lease_store, &dhcp_lease);
 
     /* Output IP address and gateway address. */
-    print_address("IP address", ip_address);
-    print_address("Mask", network_mask);
-    print_address("Gateway", gateway_address);
+    print_address("IP address", dhcp_lease.ip_address);
+    print_address("Mask", dhcp_lease.network_mask);
+    print_address("Gateway", dhcp_lease.gateway_address);
 
     printf("SUCCESS: DHCP initialized\r\n\r\n");
 }
@@ -81,8 +75,7 @@ static void dhcp_wait(void)
 static UINT dns_create()
 {
     UINT status;
-    ULONG dns_server_address[3];
-    UINT dns_server_address_size = 12;
+    UINT i;
 
     printf("Initializing DNS client\r\n");
 
@@ -105,20 +98,31 @@ static UINT dns_create()
     }
 #endif /* NX_DNS_CLIENT_USER_CREATE_PACKET_POOL */
 
-    /* Retrieve DNS server address.  */
-    nx_dhcp_interface_user_option_retrieve(
-        &dhcp_client, 0, NX_DHCP_OPTION_DNS_SVR, (UCHAR*)(dns_server_address), &dns_server_address_size);
-
-    /* Add an IPv4 server address to the Client list. */
-    status = nx_dns_server_add(&nx_dns_client, dns_server_address[0]);
+    status = dns_resolver_create(&nx_dns_client);
     if (status)
     {
         nx_dns_delete(&nx_dns_client);
         return status;
     }
 
-    /* Output DNS Server address.  */
-    print_address("DNS address", dns_server_address[0]);
+    /* Add every IPv4 server address of the lease so that queries can go to all of them at once. */
+    status = NX_DNS_NO_SERVER;
+    for (i = 0; i < DHCP_LEASE_DNS_SERVER_COUNT; i++)
+    {
+        if (dhcp_lease.dns_server_address[i] != 0 &&
+            dns_resolver_server_add(dhcp_lease.dns_server_address[i]) == NX_SUCCESS)
+        {
+            /* Output DNS Server address.  */
+            print_address("DNS address", dhcp_lease.dns_server_address[i]);
+            status = NX_SUCCESS;
+        }
+    }
+
+    if (status)
+    {
+        nx_dns_delete(&nx_dns_client);
+        return status;
+    }
 
     printf("SUCCESS: DNS client initialized\r\n\r\n");
 
@@ -192,6 +196,20 @@ static UINT wifi_network_join(void* pools, CHAR* ssid, CHAR* password, WiFi_Mode
     return NX_SUCCESS;
 }
 
+UINT platform_dhcp_lease_store_set(const FLASH_DRIVER* driver, ULONG first_sector, ULONG sector_count)
+{
+    UINT status;
+
+    if ((status = dhcp_lease_store_open(&dhcp_lease_store, driver, first_sector, sector_count)))
+    {
+        printf("ERROR: failed to open DHCP lease store (0x%08x)\r\n", status);
+        dhcp_lease_store.driver = NX_NULL;
+        return status;
+    }
+
+    return NX_SUCCESS;
+}
+
 int platform_init(CHAR* ssid, CHAR* password, WiFi_Mode mode)
 {
     UINT status;
@@ -8,11 +8,16 @@
 #include "nxd_dns.h"
 
 #include "azure_config.h"
+#include "flash_driver.h"
 
 extern NX_PACKET_POOL nx_pool[2]; /* 0=TX, 1=RX. */
 extern NX_IP nx_ip;
 extern NX_DNS nx_dns_client;
 
+/* Keep the DHCP lease in these sectors of a flash region so the next boot can confirm it instead of running
+   discovery. Call before platform_init. */
+UINT platform_dhcp_lease_store_set(const FLASH_DRIVER* driver, ULONG first_sector, ULONG sector_count);
+
 int platform_init(CHAR* ssid, CHAR* password, WiFi_Mode mode);
 
 #endif // _WWD_NETWORKING_H
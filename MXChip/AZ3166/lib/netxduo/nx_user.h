@@ -20,8 +20,19 @@
 
 #define NXD_MQTT_CLOUD_ENABLE
 
+/* Uncomment to negotiate ECDHE with AES-128-GCM instead of RSA key transport with AES-128-CBC */
+/* #define NX_AZURE_IOT_TLS_PROFILE_ECC */
+
+#ifdef NX_AZURE_IOT_TLS_PROFILE_ECC
+#define NX_SECURE_ENABLE_ECC_CIPHERSUITE
+#define NX_SECURE_ENABLE_AEAD_CIPHER
+#endif
+
 #define NX_SNTP_CLIENT_MIN_SERVER_STRATUM 3
 
+/* Cache answers, by their TTL, for the lookups the Azure IoT middleware makes itself */
+#define NX_DNS_CACHE_ENABLE
+
 extern UINT nx_rand16( void );
 #define NX_RAND                         nx_rand16
 
@@ -92,7 +92,9 @@ static UINT         _nx_driver_hardware_multicast_join(NX_IP_DRIVER *driver_req_
 static UINT         _nx_driver_hardware_multicast_leave(NX_IP_DRIVER *driver_req_ptr);
 static UINT         _nx_driver_hardware_get_status(NX_IP_DRIVER *driver_req_ptr);
 static VOID         _nx_driver_hardware_packet_transmitted(VOID);
-static VOID         _nx_driver_hardware_packet_received(VOID);
+static UINT         _nx_driver_hardware_packet_received(VOID);
+static UINT         _nx_driver_receive_packet_allocate(NX_PACKET **packet_ptr);
+static VOID         _nx_driver_receive_spare_refill(VOID);
 #ifdef NX_ENABLE_INTERFACE_CAPABILITY
 static UINT         _nx_driver_hardware_capability_set(NX_IP_DRIVER *driver_req_ptr);
 #endif /* NX_ENABLE_INTERFACE_CAPABILITY */
@@ -275,6 +277,52 @@ VOID  nx_driver_same54(NX_IP_DRIVER *driver_req_ptr)
 }
 
 
+/**************************************************************************/ 
+/*                                                                        */ 
+/*  FUNCTION                                               RELEASE        */ 
+/*                                                                        */ 
+/*    nx_driver_same54_receive_drop_count_get             SAME54/IAR      */ 
+/*                                                           5.0          */ 
+/*                                                                        */ 
+/*  DESCRIPTION                                                           */ 
+/*                                                                        */ 
+/*    This function returns how many received frames were dropped because */ 
+/*    no packet was left to put back in the receive ring.                 */ 
+/*                                                                        */ 
+/*  INPUT                                                                 */ 
+/*                                                                        */ 
+/*    drop_count                            Destination for dropped frames*/ 
+/*                                                                        */ 
+/*  OUTPUT                                                                */ 
+/*                                                                        */ 
+/*    status                                [NX_SUCCESS|NX_PTR_ERROR]     */
+/*                                                                        */ 
+/*  CALLS                                                                 */ 
+/*                                                                        */ 
+/*    None                                                                */ 
+/*                                                                        */
+/*  CALLED BY                                                             */ 
+/*                                                                        */ 
+/*    Application                                                         */ 
+/*                                                                        */ 
+/**************************************************************************/ 
+UINT  nx_driver_same54_receive_drop_count_get(ULONG *drop_count)
+{
+
+    /* Check for invalid input pointer.  */
+    if (drop_count == NX_NULL)
+    {
+        return(NX_PTR_ERROR);
+    }
+
+    /* Return the counter.  */
+    *drop_count = nx_driver_information.nx_driver_information_receive_drop_count;
+
+    /* Return success.  */
+    return(NX_SUCCESS);
+}
+
+
 /**************************************************************************/ 
 /*                                                                        */ 
 /*  FUNCTION                                               RELEASE        */ 
@@ -1152,8 +1200,22 @@ ULONG       deferred_events;
     if(deferred_events & NX_DRIVER_DEFERRED_PACKET_RECEIVED)
     {
 
-        /* Process received packet(s).  */
-        _nx_driver_hardware_packet_received();
+        /* Process received packet(s), up to the budget.  */
+        if (_nx_driver_hardware_packet_received())
+        {
+
+            /* More frames are waiting, come back for them after NetX had a chance to run.  */
+            TX_DISABLE
+            nx_driver_information.nx_driver_information_deferred_events |= NX_DRIVER_DEFERRED_PACKET_RECEIVED;
+            TX_RESTORE
+            _nx_ip_driver_deferred_processing(nx_driver_information.nx_driver_information_ip_ptr);
+        }
+        else
+        {
+
+            /* The ring is drained, enable the receive interrupt again.  */
+            hri_gmac_set_IMR_RCOMP_bit(MACIF.dev.hw);
+        }
     }
 
     /* Mark request as successful.  */    
@@ -1446,6 +1508,10 @@ struct mac_async_filter filter;
 
     /* Save the size of one rx buffer.  */
     nx_driver_information.nx_driver_information_rx_buffer_size = packet_ptr -> nx_packet_data_end - packet_ptr -> nx_packet_data_start;
+
+    /* Hold back the reserve packets for the receive ring.  */
+    nx_driver_information.nx_driver_information_receive_spare_count = 0;
+    _nx_driver_receive_spare_refill();
         
     /* Clear the number of buffers in use counter.  */
     nx_driver_information.nx_driver_information_multicast_count = 0;
@@ -1955,7 +2021,7 @@ ULONG idx =       nx_driver_information.nx_driver_information_transmit_release_i
 /*  DESCRIPTION                                                           */ 
 /*                                                                        */ 
 /*    This function processes packets received by the ethernet            */ 
-/*    controller.                                                         */ 
+/*    controller, at most NX_DRIVER_RX_BUDGET frames per call.            */ 
 /*                                                                        */ 
 /*  INPUT                                                                 */ 
 /*                                                                        */ 
@@ -1963,12 +2029,14 @@ ULONG idx =       nx_driver_information.nx_driver_information_transmit_release_i
 /*                                                                        */ 
 /*  OUTPUT                                                                */ 
 /*                                                                        */ 
-/*    None                                                                */
+/*    NX_TRUE                               More frames are waiting       */
+/*    NX_FALSE                              The ring is drained           */
 /*                                                                        */ 
 /*  CALLS                                                                 */ 
 /*                                                                        */ 
 /*    _nx_driver_transfer_to_netx           Transfer packet to NetX       */ 
-/*    nx_packet_allocate                    Allocate receive packets      */ 
+/*    _nx_driver_receive_packet_allocate    Allocate receive packets      */ 
+/*    _nx_driver_receive_spare_refill       Refill the reserve packets    */ 
 /*    _nx_packet_release                    Release receive packets       */
 /*                                                                        */
 /*  CALLED BY                                                             */ 
@@ -1982,11 +2050,12 @@ ULONG idx =       nx_driver_information.nx_driver_information_transmit_release_i
 /*  12-07-2015        Yuxin Zhou            Initial Version 5.0           */ 
 /*                                                                        */ 
 /**************************************************************************/ 
-static VOID  _nx_driver_hardware_packet_received(VOID)
+static UINT  _nx_driver_hardware_packet_received(VOID)
 {
 
 NX_PACKET     *packet_ptr;
 ULONG          bd_count = 0;
+UINT           frame_count = 0;
 INT            i;
 ULONG          idx;
 ULONG          temp_idx;
@@ -2048,9 +2117,8 @@ NX_PACKET     *received_packet_ptr = nx_driver_information.nx_driver_information
 
                     temp_idx = (first_idx + i) & (NX_DRIVER_RX_DESCRIPTORS - 1);
 
-                    /* Allocate a new packet from the packet pool.  */
-                    if (nx_packet_allocate(nx_driver_information.nx_driver_information_packet_pool_ptr, &packet_ptr, 
-                                              NX_RECEIVE_PACKET, NX_NO_WAIT) == NX_SUCCESS)
+                    /* Get a new packet from the packet pool or the reserve.  */
+                    if (_nx_driver_receive_packet_allocate(&packet_ptr) == NX_SUCCESS)
                     {
 
                         nx_driver_information.nx_driver_information_dma_rx_descriptors[temp_idx].addr.bm.addrDW = (ULONG)packet_ptr->nx_packet_prepend_ptr >> 2;
@@ -2071,9 +2139,14 @@ NX_PACKET     *received_packet_ptr = nx_driver_information.nx_driver_information
                 {
                     
 #ifndef NX_DISABLE_PACKET_CHAIN
-                    /* At least one packet allocation was failed, release the received packet.  */
-                    nx_packet_release(nx_driver_information.nx_driver_information_receive_packets[temp_idx] -> nx_packet_next);
+                    /* At least one packet allocation was failed, release the part of the frame whose BDs already have
+                       new packets and put the received packets of the others back in the ring.  */
+                    if (nx_driver_information.nx_driver_information_receive_packets[temp_idx] -> nx_packet_next)
+                    {
+                        nx_packet_release(nx_driver_information.nx_driver_information_receive_packets[temp_idx] -> nx_packet_next);
+                    }
 #endif /* NX_DISABLE_PACKET_CHAIN */
+                    nx_driver_information.nx_driver_information_receive_drop_count++;
                     
                     for (; i >= 0; i--)
                     {
@@ -2102,6 +2175,11 @@ NX_PACKET     *received_packet_ptr = nx_driver_information.nx_driver_information
             
             bd_count = 0;
 
+            /* Leave the rest of the frames for the next pass once the budget is used up.  */
+            if (++frame_count >= NX_DRIVER_RX_BUDGET)
+            {
+                break;
+            }
         }
         else
         {
@@ -2123,6 +2201,112 @@ NX_PACKET     *received_packet_ptr = nx_driver_information.nx_driver_information
             bd_count++;
         }
     }
+
+    /* Top up the reserve packets.  */
+    _nx_driver_receive_spare_refill();
+
+    /* Tell the caller whether the budget ran out before the ring was drained.  */
+    return((frame_count >= NX_DRIVER_RX_BUDGET) ? NX_TRUE : NX_FALSE);
+}
+
+
+/**************************************************************************/ 
+/*                                                                        */ 
+/*  FUNCTION                                               RELEASE        */ 
+/*                                                                        */ 
+/*    _nx_driver_receive_packet_allocate                  SAME54/IAR      */ 
+/*                                                           5.0          */ 
+/*                                                                        */ 
+/*  DESCRIPTION                                                           */ 
+/*                                                                        */ 
+/*    This function gets a packet to take the place of a received one in  */ 
+/*    the receive ring, from the packet pool or, when the pool is empty,  */ 
+/*    from the packets held in reserve.                                   */ 
+/*                                                                        */ 
+/*  INPUT                                                                 */ 
+/*                                                                        */ 
+/*    packet_ptr                            Destination for the packet    */ 
+/*                                                                        */ 
+/*  OUTPUT                                                                */ 
+/*                                                                        */ 
+/*    status                                [NX_SUCCESS|NX_NO_PACKET]     */
+/*                                                                        */ 
+/*  CALLS                                                                 */ 
+/*                                                                        */ 
+/*    nx_packet_allocate                    Allocate receive packet       */ 
+/*                                                                        */
+/*  CALLED BY                                                             */ 
+/*                                                                        */ 
+/*    _nx_driver_hardware_packet_received   Driver packet receive function*/ 
+/*                                                                        */ 
+/**************************************************************************/ 
+static UINT  _nx_driver_receive_packet_allocate(NX_PACKET **packet_ptr)
+{
+
+    /* Allocate a new packet from the packet pool.  */
+    if (nx_packet_allocate(nx_driver_information.nx_driver_information_packet_pool_ptr, packet_ptr, 
+                           NX_RECEIVE_PACKET, NX_NO_WAIT) == NX_SUCCESS)
+    {
+        return(NX_SUCCESS);
+    }
+
+    /* The pool is empty, take a packet from the reserve.  */
+    if (nx_driver_information.nx_driver_information_receive_spare_count)
+    {
+        nx_driver_information.nx_driver_information_receive_spare_count--;
+        *packet_ptr = nx_driver_information.nx_driver_information_receive_spare_packets[nx_driver_information.nx_driver_information_receive_spare_count];
+        return(NX_SUCCESS);
+    }
+
+    /* No packet left.  */
+    return(NX_NO_PACKET);
+}
+
+
+/**************************************************************************/ 
+/*                                                                        */ 
+/*  FUNCTION                                               RELEASE        */ 
+/*                                                                        */ 
+/*    _nx_driver_receive_spare_refill                     SAME54/IAR      */ 
+/*                                                           5.0          */ 
+/*                                                                        */ 
+/*  DESCRIPTION                                                           */ 
+/*                                                                        */ 
+/*    This function tops up the packets held in reserve for the receive   */ 
+/*    ring from the packet pool, as far as the pool allows.               */ 
+/*                                                                        */ 
+/*  INPUT                                                                 */ 
+/*                                                                        */ 
+/*    None                                                                */
+/*                                                                        */ 
+/*  OUTPUT                                                                */ 
+/*                                                                        */ 
+/*    None                                                                */
+/*                                                                        */ 
+/*  CALLS                                                                 */ 
+/*                                                                        */ 
+/*    nx_packet_allocate                    Allocate receive packet       */ 
+/*                                                                        */
+/*  CALLED BY                                                             */ 
+/*                                                                        */ 
+/*    _nx_driver_hardware_initialize        Driver hardware initialize    */ 
+/*    _nx_driver_hardware_packet_received   Driver packet receive function*/ 
+/*                                                                        */ 
+/**************************************************************************/ 
+static VOID  _nx_driver_receive_spare_refill(VOID)
+{
+
+NX_PACKET     *packet_ptr;
+
+
+    /* Loop until the reserve is full or the pool is empty.  */
+    while ((nx_driver_information.nx_driver_information_receive_spare_count < NX_DRIVER_RX_SPARE_PACKETS) &&
+           (nx_packet_allocate(nx_driver_information.nx_driver_information_packet_pool_ptr, &packet_ptr, 
+                               NX_RECEIVE_PACKET, NX_NO_WAIT) == NX_SUCCESS))
+    {
+        nx_driver_information.nx_driver_information_receive_spare_packets[nx_driver_information.nx_driver_information_receive_spare_count] = packet_ptr;
+        nx_driver_information.nx_driver_information_receive_spare_count++;
+    }
 }
 
 
@@ -2242,11 +2426,15 @@ ULONG deffered_events;
     {
 #ifdef NX_DRIVER_ENABLE_DEFERRED
 
+        /* The GMAC has no interrupt coalescing, mask the receive interrupt until the deferred processing
+           has drained the ring.  */
+        hri_gmac_clear_IMR_RCOMP_bit(MACIF.dev.hw);
+
         /* Set the receive packet interrupt.  */
         nx_driver_information.nx_driver_information_deferred_events |= NX_DRIVER_DEFERRED_PACKET_RECEIVED;
 #else
         /* Process received packet(s).  */
-        _nx_driver_hardware_packet_received();
+        while (_nx_driver_hardware_packet_received());
 #endif /* NX_DRIVER_ENABLE_DEFERRED */
     }
 
@@ -208,6 +208,16 @@ extern struct mac_async_descriptor MACIF;
 #define NX_DRIVER_RX_DESCRIPTORS   32
 #endif
 
+/* Define the packets held back from the pool to refill the receive ring when the pool runs dry.  */
+#ifndef NX_DRIVER_RX_SPARE_PACKETS
+#define NX_DRIVER_RX_SPARE_PACKETS  4
+#endif
+
+/* Define the number of frames handed to NetX in one deferred processing pass.  */
+#ifndef NX_DRIVER_RX_BUDGET
+#define NX_DRIVER_RX_BUDGET         8
+#endif
+
 /* ETHERNET DMA Rx descriptors Frame Length Shift */
 
 #define ETH_DMARXDESC_FRAME_LENGTHSHIFT           16
@@ -277,6 +287,12 @@ typedef struct NX_DRIVER_INFORMATION_STRUCT
     ULONG               nx_driver_information_rx_buffer_size;
 
     ULONG               nx_driver_information_multicast_count;
+
+    /* Define the packets held in reserve for the receive ring and the frames dropped
+       because no packet was left to replace them.  */
+    NX_PACKET           *nx_driver_information_receive_spare_packets[NX_DRIVER_RX_SPARE_PACKETS];
+    UINT                nx_driver_information_receive_spare_count;
+    ULONG               nx_driver_information_receive_drop_count;
     
 #ifdef NX_DRIVER_INTERNAL_TRANSMIT_QUEUE
 
@@ -303,6 +319,7 @@ typedef struct NX_DRIVER_INFORMATION_STRUCT
 /* Define global driver entry function. */
 
 VOID  nx_driver_same54(NX_IP_DRIVER *driver_req_ptr);
+UINT  nx_driver_same54_receive_drop_count_get(ULONG *drop_count);
 
 /* Define global driver interrupt dispatch function.  */
 
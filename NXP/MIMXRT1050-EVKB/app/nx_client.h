@@ -8,7 +8,11 @@
 #include "nxd_dns.h"
 #include "tx_api.h"
 
-UINT azure_iot_nx_client_entry(
+// Create the client and set its credentials, none of which needs the time to be known
+UINT azure_iot_nx_client_setup(
     NX_IP* ip_ptr, NX_PACKET_POOL* pool_ptr, NX_DNS* dns_ptr, UINT (*unix_time_callback)(ULONG* unix_time));
 
+// Provision, connect and run the main loop once SNTP has synced
+UINT azure_iot_nx_client_entry(VOID);
+
 #endif // _NX_CLIENT_H
\ No newline at end of file
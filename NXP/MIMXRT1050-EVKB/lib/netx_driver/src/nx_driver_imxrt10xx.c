@@ -96,7 +96,9 @@ static UINT         _nx_driver_hardware_multicast_join(NX_IP_DRIVER *driver_req_
 static UINT         _nx_driver_hardware_multicast_leave(NX_IP_DRIVER *driver_req_ptr);
 static UINT         _nx_driver_hardware_get_status(NX_IP_DRIVER *driver_req_ptr);
 static VOID         _nx_driver_hardware_packet_transmitted(VOID);
-static VOID         _nx_driver_hardware_packet_received(VOID);
+static UINT         _nx_driver_hardware_packet_received(VOID);
+static UINT         _nx_driver_receive_packet_allocate(NX_PACKET **packet_ptr);
+static VOID         _nx_driver_receive_spare_refill(VOID);
 #ifdef NX_ENABLE_INTERFACE_CAPABILITY
 static UINT         _nx_driver_hardware_capability_set(NX_IP_DRIVER *driver_req_ptr);
 #endif 
@@ -272,6 +274,103 @@ VOID  nx_driver_imx(NX_IP_DRIVER *driver_req_ptr)
 }
 
 
+/**************************************************************************/ 
+/*                                                                        */ 
+/*  FUNCTION                                               RELEASE        */ 
+/*                                                                        */ 
+/*    nx_driver_imx_transmit_count_get                    PORTABLE C      */ 
+/*                                                           5.0          */ 
+/*                                                                        */ 
+/*  DESCRIPTION                                                           */ 
+/*                                                                        */ 
+/*    This function returns how many frames were sent straight from the   */ 
+/*    NetX packet and how many had to be moved to the transmit buffer     */ 
+/*    alignment first.                                                    */ 
+/*                                                                        */ 
+/*  INPUT                                                                 */ 
+/*                                                                        */ 
+/*    zero_copy_count                       Destination for frames sent   */ 
+/*                                            without a copy              */ 
+/*    copy_count                            Destination for frames moved  */ 
+/*                                            before sending              */ 
+/*                                                                        */ 
+/*  OUTPUT                                                                */ 
+/*                                                                        */ 
+/*    status                                [NX_SUCCESS|NX_PTR_ERROR]     */
+/*                                                                        */ 
+/*  CALLS                                                                 */ 
+/*                                                                        */ 
+/*    None                                                                */ 
+/*                                                                        */
+/*  CALLED BY                                                             */ 
+/*                                                                        */ 
+/*    Application                                                         */ 
+/*                                                                        */ 
+/**************************************************************************/ 
+UINT  nx_driver_imx_transmit_count_get(ULONG *zero_copy_count, ULONG *copy_count)
+{
+
+    /* Check for invalid input pointers.  */
+    if ((zero_copy_count == NX_NULL) || (copy_count == NX_NULL))
+    {
+        return(NX_PTR_ERROR);
+    }
+
+    /* Return the counters.  */
+    *zero_copy_count = nx_driver_information.nx_driver_information_transmit_zero_copy_count;
+    *copy_count = nx_driver_information.nx_driver_information_transmit_copy_count;
+
+    /* Return success.  */
+    return(NX_SUCCESS);
+}
+
+
+/**************************************************************************/ 
+/*                                                                        */ 
+/*  FUNCTION                                               RELEASE        */ 
+/*                                                                        */ 
+/*    nx_driver_imx_receive_drop_count_get                PORTABLE C      */ 
+/*                                                           5.0          */ 
+/*                                                                        */ 
+/*  DESCRIPTION                                                           */ 
+/*                                                                        */ 
+/*    This function returns how many received frames were dropped because */ 
+/*    no packet was left to put back in the receive ring.                 */ 
+/*                                                                        */ 
+/*  INPUT                                                                 */ 
+/*                                                                        */ 
+/*    drop_count                            Destination for dropped frames*/ 
+/*                                                                        */ 
+/*  OUTPUT                                                                */ 
+/*                                                                        */ 
+/*    status                                [NX_SUCCESS|NX_PTR_ERROR]     */
+/*                                                                        */ 
+/*  CALLS                                                                 */ 
+/*                                                                        */ 
+/*    None                                                                */ 
+/*                                                                        */
+/*  CALLED BY                                                             */ 
+/*                                                                        */ 
+/*    Application                                                         */ 
+/*                                                                        */ 
+/**************************************************************************/ 
+UINT  nx_driver_imx_receive_drop_count_get(ULONG *drop_count)
+{
+
+    /* Check for invalid input pointer.  */
+    if (drop_count == NX_NULL)
+    {
+        return(NX_PTR_ERROR);
+    }
+
+    /* Return the counter.  */
+    *drop_count = nx_driver_information.nx_driver_information_receive_drop_count;
+
+    /* Return success.  */
+    return(NX_SUCCESS);
+}
+
+
 /**************************************************************************/ 
 /*                                                                        */ 
 /*  FUNCTION                                               RELEASE        */ 
@@ -1179,8 +1278,24 @@ ULONG       deferred_events;
     if(deferred_events & NX_DRIVER_DEFERRED_PACKET_RECEIVED)
     {
 
-        /* Process received packet(s).  */
-        _nx_driver_hardware_packet_received();
+        /* Process received packet(s), up to the budget.  */
+        if (_nx_driver_hardware_packet_received())
+        {
+
+            /* More frames are waiting, come back for them after NetX had a chance to run.  */
+            TX_DISABLE
+            nx_driver_information.nx_driver_information_deferred_events |= NX_DRIVER_DEFERRED_PACKET_RECEIVED;
+            TX_RESTORE
+            _nx_ip_driver_deferred_processing(nx_driver_information.nx_driver_information_ip_ptr);
+        }
+        else
+        {
+
+            /* The ring is drained, enable the receive interrupt again.  */
+            TX_DISABLE
+            ENET->EIMR |= ENET_EIMR_RXF_MASK;
+            TX_RESTORE
+        }
     }
 
     /* Mark request as successful.  */    
@@ -1926,6 +2041,13 @@ UINT                i;
 #if (NX_DRIVER_TX_DESCRIPTORS & (NX_DRIVER_TX_DESCRIPTORS - 1)) != 0
 #error "Number of Buffer Descriptors must be power of 2"
 #endif    
+
+    /* Make sure packets allocated by packet type leave the frame aligned. NetX places the IP header
+       NX_PHYSICAL_HEADER bytes past the payload start, aligned by NX_PACKET_ALIGNMENT, and the pad and
+       Ethernet header fill that room.  */
+#if ((NX_PHYSICAL_HEADER - NX_DRIVER_ETHERNET_FRAME_SIZE - 2) % NX_DRIVER_TX_BUFFER_ALIGNMENT) != 0
+#error "NX_PHYSICAL_HEADER must leave the Ethernet frame aligned to NX_DRIVER_TX_BUFFER_ALIGNMENT"
+#endif
     
     nx_driver_information.nx_driver_information_dma_tx_descriptors = (enet_tx_bd_struct_t*)(((UINT)nx_driver_information.nx_driver_information_dma_tx_descriptors_area + 15) & (~15));
    
@@ -2001,6 +2123,10 @@ UINT                i;
 
     /* Save the size of one rx buffer.  */
     nx_driver_information.nx_driver_information_rx_buffer_size = packet_ptr -> nx_packet_data_end - packet_ptr -> nx_packet_data_start;
+
+    /* Hold back the reserve packets for the receive ring.  */
+    nx_driver_information.nx_driver_information_receive_spare_count = 0;
+    _nx_driver_receive_spare_refill();
         
     /* Configure the Receive Buffer Size Register.  */
     ENET->MRBR = nx_driver_information.nx_driver_information_rx_buffer_size;
@@ -2059,6 +2185,12 @@ UINT                i;
 static UINT  _nx_driver_hardware_enable(NX_IP_DRIVER *driver_req_ptr)
 {
 
+#if defined(FSL_FEATURE_ENET_HAS_INTERRUPT_COALESCE) && FSL_FEATURE_ENET_HAS_INTERRUPT_COALESCE
+    /* Coalesce receive interrupts, so a burst of frames raises one interrupt rather than one per frame.  */
+    ENET->RXIC = ENET_RXIC_ICFT(NX_DRIVER_RX_COALESCE_FRAMES) | ENET_RXIC_ICTT(NX_DRIVER_RX_COALESCE_TIME) |
+                 ENET_RXIC_ICCS_MASK | ENET_RXIC_ICEN_MASK;
+#endif
+
     /* Enable Ethernet interrupt.  */  
     ENET->EIMR = ENET_EIMR_RXF_MASK | ENET_EIMR_TXF_MASK;
     /* Start Ethernet.  */
@@ -2172,6 +2304,7 @@ NX_PACKET      *pktIdx;
 ULONG          bd_count = 0;
 UCHAR          remainder = 0;    
 UCHAR*         src_addr;
+UINT           copied = NX_FALSE;
 
     /* Pick up the first BD. */
     curIdx = nx_driver_information.nx_driver_information_transmit_current_index;
@@ -2185,7 +2318,9 @@ UCHAR*         src_addr;
     /* Set the buffer size.  */
     nx_driver_information.nx_driver_information_dma_tx_descriptors[curIdx].length = (packet_ptr -> nx_packet_append_ptr - packet_ptr->nx_packet_prepend_ptr + 2);
 
-    remainder = (UCHAR )((ULONG)(packet_ptr->nx_packet_prepend_ptr - 2)& 0x07);
+    /* Packets allocated for the headers they carry are aligned, see _nx_driver_hardware_initialize. One allocated
+       with room for other headers, such as NX_UDP_PACKET for IPv4 with IPv6 enabled, is moved back.  */
+    remainder = (UCHAR )((ULONG)(packet_ptr->nx_packet_prepend_ptr - 2) & (NX_DRIVER_TX_BUFFER_ALIGNMENT - 1));
  
     if(remainder)
     {
@@ -2195,6 +2330,7 @@ UCHAR*         src_addr;
       packet_ptr->nx_packet_prepend_ptr -= remainder;
       
       memmove(packet_ptr->nx_packet_prepend_ptr,src_addr,nx_driver_information.nx_driver_information_dma_tx_descriptors[curIdx].length);
+      copied = NX_TRUE;
     }
     
     /* Find the Buffer, set the Buffer pointer. */
@@ -2246,6 +2382,12 @@ UCHAR*         src_addr;
     
     /* Increment the transmit buffers in use count.  */
     nx_driver_information.nx_driver_information_number_of_transmit_buffers_in_use += bd_count + 1;
+
+    /* Count the frame.  */
+    if (copied)
+        nx_driver_information.nx_driver_information_transmit_copy_count++;
+    else
+        nx_driver_information.nx_driver_information_transmit_zero_copy_count++;
     
     /* Set OWN bit to indicate BDs are ready.  */
     for (; bd_count > 0; bd_count--)
@@ -2647,7 +2789,7 @@ ULONG idx =       nx_driver_information.nx_driver_information_transmit_release_i
 /*  DESCRIPTION                                                           */ 
 /*                                                                        */ 
 /*    This function processes packets received by the ethernet            */ 
-/*    controller.                                                         */ 
+/*    controller, at most NX_DRIVER_RX_BUDGET frames per call.            */ 
 /*                                                                        */ 
 /*  INPUT                                                                 */ 
 /*                                                                        */ 
@@ -2655,12 +2797,14 @@ ULONG idx =       nx_driver_information.nx_driver_information_transmit_release_i
 /*                                                                        */ 
 /*  OUTPUT                                                                */ 
 /*                                                                        */ 
-/*    None                                                                */
+/*    NX_TRUE                               More frames are waiting       */
+/*    NX_FALSE                              The ring is drained           */
 /*                                                                        */ 
 /*  CALLS                                                                 */ 
 /*                                                                        */ 
 /*    _nx_driver_transfer_to_netx           Transfer packet to NetX       */ 
-/*    nx_packet_allocate                    Allocate receive packets      */ 
+/*    _nx_driver_receive_packet_allocate    Allocate receive packets      */ 
+/*    _nx_driver_receive_spare_refill       Refill the reserve packets    */ 
 /*    nx_packet_release                     Release receive packets       */
 /*                                                                        */
 /*  CALLED BY                                                             */ 
@@ -2674,11 +2818,12 @@ ULONG idx =       nx_driver_information.nx_driver_information_transmit_release_i
 /*  02-01-2018     Yuxin Zhou               Initial Version 5.0           */ 
 /*                                                                        */ 
 /**************************************************************************/ 
-static VOID  _nx_driver_hardware_packet_received(VOID)
+static UINT  _nx_driver_hardware_packet_received(VOID)
 {
 
 NX_PACKET     *packet_ptr;
 ULONG          bd_count = 0;
+UINT           frame_count = 0;
 INT            i;
 ULONG          idx;
 ULONG          temp_idx;
@@ -2717,9 +2862,8 @@ NX_PACKET     *received_packet_ptr = nx_driver_information.nx_driver_information
                 
                 temp_idx = (first_idx + i) & (NX_DRIVER_RX_DESCRIPTORS - 1);
                 
-                /* Allocate a new packet from the packet pool.  */
-                if (nx_packet_allocate(nx_driver_information.nx_driver_information_packet_pool_ptr, &packet_ptr, 
-                                          NX_RECEIVE_PACKET, NX_NO_WAIT) == NX_SUCCESS)
+                /* Get a new packet from the packet pool or the reserve.  */
+                if (_nx_driver_receive_packet_allocate(&packet_ptr) == NX_SUCCESS)
                 {
                     
                     /* Adjust the new packet and assign it to the BD.  */
@@ -2739,8 +2883,13 @@ NX_PACKET     *received_packet_ptr = nx_driver_information.nx_driver_information
             if (i >= 0)
             {
                 
-                /* At least one packet allocation was failed, release the received packet.  */
-                nx_packet_release(nx_driver_information.nx_driver_information_receive_packets[temp_idx] -> nx_packet_next);
+                /* At least one packet allocation was failed, release the part of the frame whose BDs already have
+                   new packets and put the received packets of the others back in the ring.  */
+                if (nx_driver_information.nx_driver_information_receive_packets[temp_idx] -> nx_packet_next)
+                {
+                    nx_packet_release(nx_driver_information.nx_driver_information_receive_packets[temp_idx] -> nx_packet_next);
+                }
+                nx_driver_information.nx_driver_information_receive_drop_count++;
                 
                 for (; i >= 0; i--)
                 {
@@ -2768,6 +2917,11 @@ NX_PACKET     *received_packet_ptr = nx_driver_information.nx_driver_information
             
             bd_count = 0;
 
+            /* Leave the rest of the frames for the next pass once the budget is used up.  */
+            if (++frame_count >= NX_DRIVER_RX_BUDGET)
+            {
+                break;
+            }
         }
         else
         {
@@ -2782,6 +2936,9 @@ NX_PACKET     *received_packet_ptr = nx_driver_information.nx_driver_information
         }
     }
     
+    /* Top up the reserve packets.  */
+    _nx_driver_receive_spare_refill();
+    
     /* If Rx DMA is in suspended state, resume it.  */
     if (!ENET->RDAR)  
     {
@@ -2790,6 +2947,108 @@ NX_PACKET     *received_packet_ptr = nx_driver_information.nx_driver_information
         ENET->RDAR = ENET_RDAR_RDAR_MASK;
     }
 
+    /* Tell the caller whether the budget ran out before the ring was drained.  */
+    return((frame_count >= NX_DRIVER_RX_BUDGET) ? NX_TRUE : NX_FALSE);
+}
+
+
+/**************************************************************************/ 
+/*                                                                        */ 
+/*  FUNCTION                                               RELEASE        */ 
+/*                                                                        */ 
+/*    _nx_driver_receive_packet_allocate                  PORTABLE C      */ 
+/*                                                           5.0          */ 
+/*                                                                        */ 
+/*  DESCRIPTION                                                           */ 
+/*                                                                        */ 
+/*    This function gets a packet to take the place of a received one in  */ 
+/*    the receive ring, from the packet pool or, when the pool is empty,  */ 
+/*    from the packets held in reserve.                                   */ 
+/*                                                                        */ 
+/*  INPUT                                                                 */ 
+/*                                                                        */ 
+/*    packet_ptr                            Destination for the packet    */ 
+/*                                                                        */ 
+/*  OUTPUT                                                                */ 
+/*                                                                        */ 
+/*    status                                [NX_SUCCESS|NX_NO_PACKET]     */
+/*                                                                        */ 
+/*  CALLS                                                                 */ 
+/*                                                                        */ 
+/*    nx_packet_allocate                    Allocate receive packet       */ 
+/*                                                                        */
+/*  CALLED BY                                                             */ 
+/*                                                                        */ 
+/*    _nx_driver_hardware_packet_received   Driver packet receive function*/ 
+/*                                                                        */ 
+/**************************************************************************/ 
+static UINT  _nx_driver_receive_packet_allocate(NX_PACKET **packet_ptr)
+{
+
+    /* Allocate a new packet from the packet pool.  */
+    if (nx_packet_allocate(nx_driver_information.nx_driver_information_packet_pool_ptr, packet_ptr, 
+                           NX_RECEIVE_PACKET, NX_NO_WAIT) == NX_SUCCESS)
+    {
+        return(NX_SUCCESS);
+    }
+
+    /* The pool is empty, take a packet from the reserve.  */
+    if (nx_driver_information.nx_driver_information_receive_spare_count)
+    {
+        nx_driver_information.nx_driver_information_receive_spare_count--;
+        *packet_ptr = nx_driver_information.nx_driver_information_receive_spare_packets[nx_driver_information.nx_driver_information_receive_spare_count];
+        return(NX_SUCCESS);
+    }
+
+    /* No packet left.  */
+    return(NX_NO_PACKET);
+}
+
+
+/**************************************************************************/ 
+/*                                                                        */ 
+/*  FUNCTION                                               RELEASE        */ 
+/*                                                                        */ 
+/*    _nx_driver_receive_spare_refill                     PORTABLE C      */ 
+/*                                                           5.0          */ 
+/*                                                                        */ 
+/*  DESCRIPTION                                                           */ 
+/*                                                                        */ 
+/*    This function tops up the packets held in reserve for the receive   */ 
+/*    ring from the packet pool, as far as the pool allows.               */ 
+/*                                                                        */ 
+/*  INPUT                                                                 */ 
+/*                                                                        */ 
+/*    None                                                                */
+/*                                                                        */ 
+/*  OUTPUT                                                                */ 
+/*                                                                        */ 
+/*    None                                                                */
+/*                                                                        */ 
+/*  CALLS                                                                 */ 
+/*                                                                        */ 
+/*    nx_packet_allocate                    Allocate receive packet       */ 
+/*                                                                        */
+/*  CALLED BY                                                             */ 
+/*                                                                        */ 
+/*    _nx_driver_hardware_initialize        Driver hardware initialize    */ 
+/*    _nx_driver_hardware_packet_received   Driver packet receive function*/ 
+/*                                                                        */ 
+/**************************************************************************/ 
+static VOID  _nx_driver_receive_spare_refill(VOID)
+{
+
+NX_PACKET     *packet_ptr;
+
+
+    /* Loop until the reserve is full or the pool is empty.  */
+    while ((nx_driver_information.nx_driver_information_receive_spare_count < NX_DRIVER_RX_SPARE_PACKETS) &&
+           (nx_packet_allocate(nx_driver_information.nx_driver_information_packet_pool_ptr, &packet_ptr, 
+                               NX_RECEIVE_PACKET, NX_NO_WAIT) == NX_SUCCESS))
+    {
+        nx_driver_information.nx_driver_information_receive_spare_packets[nx_driver_information.nx_driver_information_receive_spare_count] = packet_ptr;
+        nx_driver_information.nx_driver_information_receive_spare_count++;
+    }
 }
 
 /**************************************************************************/ 
@@ -2967,19 +3226,22 @@ ULONG idx;
 VOID  nx_driver_imx_ethernet_isr(VOID)
 {
 UINT status;
-  status = ENET->EIR;
+  status = ENET->EIR & ENET->EIMR;
 	
   if(status & ENET_EIR_RXF_MASK )
   {
     /* Receive packet interrupt.  */
 #ifdef NX_DRIVER_ENABLE_DEFERRED
 
+    /* Mask the receive interrupt until the deferred processing has drained the ring.  */
+    ENET->EIMR &= ~ENET_EIMR_RXF_MASK;
+
     /* Set the receive packet interrupt.  */
     nx_driver_information.nx_driver_information_deferred_events |= NX_DRIVER_DEFERRED_PACKET_RECEIVED;
 #else
 
     /* Process received packet(s).  */
-    _nx_driver_hardware_packet_received();
+    while (_nx_driver_hardware_packet_received());
 #endif
 
 
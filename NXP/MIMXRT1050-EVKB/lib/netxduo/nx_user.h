@@ -18,10 +18,28 @@
 
 #define NXD_MQTT_CLOUD_ENABLE
 
+/* Uncomment to negotiate ECDHE with AES-128-GCM instead of RSA key transport with AES-128-CBC */
+/* #define NX_AZURE_IOT_TLS_PROFILE_ECC */
+
+#ifdef NX_AZURE_IOT_TLS_PROFILE_ECC
+#define NX_SECURE_ENABLE_ECC_CIPHERSUITE
+#define NX_SECURE_ENABLE_AEAD_CIPHER
+#endif
+
 #define NX_ENABLE_IP_PACKET_FILTER
 
 #define NX_SNTP_CLIENT_MIN_SERVER_STRATUM 3
 
+/* DNS and DHCP take their packets from the application's services pool */
+#define NX_DHCP_CLIENT_USER_CREATE_PACKET_POOL
+
+/* Cache answers, by their TTL, for the lookups the Azure IoT middleware makes itself */
+#define NX_DNS_CACHE_ENABLE
+
+/* The Ethernet driver keeps its 16 receive descriptors and 4 reserve packets filled from the stack packet pool,
+   size the pool so that NetX still has packets left for a TLS record in flight */
+#define THREADX_STACK_PACKET_COUNT 40
+
 #define NX_PACKET_ALIGNMENT 32
 #define NX_DISABLE_ICMPV4_RX_CHECKSUM
 #define NX_DISABLE_ICMPV4_TX_CHECKSUM  
@@ -142,9 +142,31 @@ extern   "C" {
 #endif
 
 #ifndef NX_DRIVER_RX_DESCRIPTORS
-#define NX_DRIVER_RX_DESCRIPTORS   8
+#define NX_DRIVER_RX_DESCRIPTORS   16
 #endif
 
+/* Define the packets held back from the pool to refill the receive ring when the pool runs dry.  */
+#ifndef NX_DRIVER_RX_SPARE_PACKETS
+#define NX_DRIVER_RX_SPARE_PACKETS  4
+#endif
+
+/* Define the number of frames handed to NetX in one deferred processing pass.  */
+#ifndef NX_DRIVER_RX_BUDGET
+#define NX_DRIVER_RX_BUDGET         8
+#endif
+
+/* Define the receive interrupt coalescing: frames, and time in units of 64 ENET clocks.  */
+#ifndef NX_DRIVER_RX_COALESCE_FRAMES
+#define NX_DRIVER_RX_COALESCE_FRAMES    4
+#endif
+
+#ifndef NX_DRIVER_RX_COALESCE_TIME
+#define NX_DRIVER_RX_COALESCE_TIME      256
+#endif
+
+/* Define the alignment of the first transmit buffer of a frame, including the 2 byte pad the ENET strips.  */
+#define NX_DRIVER_TX_BUFFER_ALIGNMENT   8
+
 
 /****** DRIVER SPECIFIC ****** End of part/vendor specific constant area!  */
 
@@ -201,6 +223,17 @@ typedef struct NX_DRIVER_INFORMATION_STRUCT
 
     UINT                nx_driver_information_link_speed;
     UINT                nx_driver_information_link_duplex;
+
+    /* Define the frames sent straight from the packet and the frames moved back to the
+       buffer alignment first.  */
+    ULONG               nx_driver_information_transmit_zero_copy_count;
+    ULONG               nx_driver_information_transmit_copy_count;
+
+    /* Define the packets held in reserve for the receive ring and the frames dropped
+       because no packet was left to replace them.  */
+    NX_PACKET           *nx_driver_information_receive_spare_packets[NX_DRIVER_RX_SPARE_PACKETS];
+    UINT                nx_driver_information_receive_spare_count;
+    ULONG               nx_driver_information_receive_drop_count;
        
         
 #ifdef NX_DIRVER_INTERNAL_TRANSMIT_QUEUE
@@ -230,6 +263,11 @@ typedef struct NX_DRIVER_INFORMATION_STRUCT
 
 VOID  nx_driver_imx(NX_IP_DRIVER *driver_req_ptr);
 
+/* Define the transmit counters, frames sent without a copy and frames that had to be moved.  */
+
+UINT  nx_driver_imx_transmit_count_get(ULONG *zero_copy_count, ULONG *copy_count);
+UINT  nx_driver_imx_receive_drop_count_get(ULONG *drop_count);
+
 /* Define global driver interrupt dispatch function.  */
 
 
@@ -18,10 +18,43 @@
 
 #define NXD_MQTT_CLOUD_ENABLE
 
+/* Uncomment to negotiate ECDHE with AES-128-GCM instead of RSA key transport with AES-128-CBC */
+/* #define NX_AZURE_IOT_TLS_PROFILE_ECC */
+
+#ifdef NX_AZURE_IOT_TLS_PROFILE_ECC
+#define NX_SECURE_ENABLE_ECC_CIPHERSUITE
+#define NX_SECURE_ENABLE_AEAD_CIPHER
+#endif
+
 #define NX_ENABLE_IP_PACKET_FILTER
 
 #define NX_SNTP_CLIENT_MIN_SERVER_STRATUM 3
 
+/* DNS and DHCP take their packets from the application's services pool */
+#define NX_DHCP_CLIENT_USER_CREATE_PACKET_POOL
+
+/* Cache answers, by their TTL, for the lookups the Azure IoT middleware makes itself */
+#define NX_DNS_CACHE_ENABLE
+
+/* The Ethernet driver keeps its 16 receive descriptors and 4 reserve packets filled from the stack packet pool,
+   size the pool so that NetX still has packets left for a TLS record in flight */
+#define THREADX_STACK_PACKET_COUNT 40
+
+/* Replay telemetry that could not be delivered once the hub is back, see azure_iot_nx_client_store_forward_flash_set */
+#define AZURE_IOT_STORE_FORWARD_ENABLE
+
+/* The emulated flash holds the DPS cache and the DHCP lease, a sector each */
+#define FLASH_EMULATOR_SECTOR_COUNT 2
+#define FLASH_SECTOR_DPS_CACHE      0
+#define FLASH_SECTOR_DHCP_LEASE     1
+
+/* Keep the emulated flash over a warm reset, the linker leaves .noinit alone */
+#if defined(__ICCARM__)
+#define FLASH_EMULATOR_STORAGE_ATTRIBUTE __no_init
+#elif defined(__GNUC__)
+#define FLASH_EMULATOR_STORAGE_ATTRIBUTE __attribute__((section(".noinit")))
+#endif
+
 #define NX_PACKET_ALIGNMENT 32
 #define NX_DISABLE_ICMPV4_RX_CHECKSUM
 #define NX_DISABLE_ICMPV4_TX_CHECKSUM  
@@ -59,8 +59,23 @@
 
 #define NX_SNTP_CLIENT_MIN_SERVER_STRATUM 3
 
+/* DNS and DHCP take their packets from the application's services pool */
+#define NX_DNS_CLIENT_USER_CREATE_PACKET_POOL
+#define NX_DHCP_CLIENT_USER_CREATE_PACKET_POOL
+
+/* Cache answers, by their TTL, for the lookups the Azure IoT middleware makes itself */
+#define NX_DNS_CACHE_ENABLE
+
 #define NXD_MQTT_CLOUD_ENABLE
 
+/* Uncomment to negotiate ECDHE with AES-128-GCM instead of RSA key transport with AES-128-CBC */
+/* #define NX_AZURE_IOT_TLS_PROFILE_ECC */
+
+#ifdef NX_AZURE_IOT_TLS_PROFILE_ECC
+#define NX_SECURE_ENABLE_ECC_CIPHERSUITE
+#define NX_SECURE_ENABLE_AEAD_CIPHER
+#endif
+
 /* Define various build options for the NetX Duo port.  The application should either make changes
    here by commenting or un-commenting the conditional compilation defined OR supply the defines
    though the compiler's equivalent of the -D option.  */
@@ -12,6 +12,7 @@
 
 #include "azure_iot_nx_client.h"
 #include "nx_azure_iot_pnp_helpers.h"
+#include "pnp_model.h"
 
 #include "azure_config.h"
 #include "azure_device_x509_cert_config.h"
@@ -21,27 +22,19 @@
 
 #include "rx65n_cloud_kit_sensors.h"
 
-#define IOT_MODEL_ID "dtmi:azurertos:devkit:gsgrx65ncloud;1"
-
-// Device telemetry names
-#define TELEMETRY_HUMIDITY          "humidity"
-#define TELEMETRY_TEMPERATURE       "temperature"
-#define TELEMETRY_PRESSURE          "pressure"
-#define TELEMETRY_GAS_RESISTANCE    "gasResistance"
-#define TELEMETRY_ACCELEROMETERX    "accelerometerX"
-#define TELEMETRY_ACCELEROMETERY    "accelerometerY"
-#define TELEMETRY_ACCELEROMETERZ    "accelerometerZ"
-#define TELEMETRY_GYROSCOPEX        "gyroscopeX"
-#define TELEMETRY_GYROSCOPEY        "gyroscopeY"
-#define TELEMETRY_GYROSCOPEZ        "gyroscopeZ"
-#define TELEMETRY_LIGHT             "illuminance"
-#define TELEMETRY_INTERVAL_PROPERTY "telemetryInterval"
-#define LED_STATE_PROPERTY          "ledState"
-#define SET_LED_STATE_COMMAND       "setLedState"
+// Sent alongside the model telemetry but not part of the published interface
+#define TELEMETRY_GAS_RESISTANCE "gasResistance"
 
 #define TELEMETRY_INTERVAL_EVENT 1
 #define DEVICE_TWIN_RECEIVED     2
 
+// Report by exception, a reading is only sent once it moves past its deadband or the heartbeat interval expires
+#define TELEMETRY_HEARTBEAT_SECS (5 * 60)
+
+// Motion samples are only useful as a series, send them in batches rather than one message per reading
+#define TELEMETRY_BATCH_SAMPLES    6
+#define TELEMETRY_BATCH_DELAY_SECS (5 * 60)
+
 typedef enum TELEMETRY_STATE_ENUM
 {
     TELEMETRY_STATE_DEFAULT,
@@ -61,48 +54,25 @@ static TX_EVENT_FLAGS_GROUP azure_iot_flags;
 
 static int32_t telemetry_interval = 10;
 
+static TELEMETRY_DEADBAND humidity_deadband    = TELEMETRY_DEADBAND_INIT(1, 0, TELEMETRY_HEARTBEAT_SECS);
+static TELEMETRY_DEADBAND temperature_deadband = TELEMETRY_DEADBAND_INIT(0.5, 0, TELEMETRY_HEARTBEAT_SECS);
+static TELEMETRY_DEADBAND pressure_deadband    = TELEMETRY_DEADBAND_INIT(0, 0.05, TELEMETRY_HEARTBEAT_SECS);
+
+// Gas resistance drifts with the heater, only a relative change is meaningful
+static TELEMETRY_DEADBAND gas_resistance_deadband = TELEMETRY_DEADBAND_INIT(0, 10, TELEMETRY_HEARTBEAT_SECS);
+
 static UINT append_device_info_properties(NX_AZURE_IOT_JSON_WRITER* json_writer, VOID* context)
 {
-    if (nx_azure_iot_json_writer_append_property_with_string_value(json_writer,
-            (UCHAR*)DEVICE_INFO_MANUFACTURER_PROPERTY_NAME,
-            sizeof(DEVICE_INFO_MANUFACTURER_PROPERTY_NAME) - 1,
-            (UCHAR*)DEVICE_INFO_MANUFACTURER_PROPERTY_VALUE,
-            sizeof(DEVICE_INFO_MANUFACTURER_PROPERTY_VALUE) - 1) ||
-        nx_azure_iot_json_writer_append_property_with_string_value(json_writer,
-            (UCHAR*)DEVICE_INFO_MODEL_PROPERTY_NAME,
-            sizeof(DEVICE_INFO_MODEL_PROPERTY_NAME) - 1,
-            (UCHAR*)DEVICE_INFO_MODEL_PROPERTY_VALUE,
-            sizeof(DEVICE_INFO_MODEL_PROPERTY_VALUE) - 1) ||
-        nx_azure_iot_json_writer_append_property_with_string_value(json_writer,
-            (UCHAR*)DEVICE_INFO_SW_VERSION_PROPERTY_NAME,
-            sizeof(DEVICE_INFO_SW_VERSION_PROPERTY_NAME) - 1,
-            (UCHAR*)DEVICE_INFO_SW_VERSION_PROPERTY_VALUE,
-            sizeof(DEVICE_INFO_SW_VERSION_PROPERTY_VALUE) - 1) ||
-        nx_azure_iot_json_writer_append_property_with_string_value(json_writer,
-            (UCHAR*)DEVICE_INFO_OS_NAME_PROPERTY_NAME,
-            sizeof(DEVICE_INFO_OS_NAME_PROPERTY_NAME) - 1,
-            (UCHAR*)DEVICE_INFO_OS_NAME_PROPERTY_VALUE,
-            sizeof(DEVICE_INFO_OS_NAME_PROPERTY_VALUE) - 1) ||
-        nx_azure_iot_json_writer_append_property_with_string_value(json_writer,
-            (UCHAR*)DEVICE_INFO_PROCESSOR_ARCHITECTURE_PROPERTY_NAME,
-            sizeof(DEVICE_INFO_PROCESSOR_ARCHITECTURE_PROPERTY_NAME) - 1,
-            (UCHAR*)DEVICE_INFO_PROCESSOR_ARCHITECTURE_PROPERTY_VALUE,
-            sizeof(DEVICE_INFO_PROCESSOR_ARCHITECTURE_PROPERTY_VALUE) - 1) ||
-        nx_azure_iot_json_writer_append_property_with_string_value(json_writer,
-            (UCHAR*)DEVICE_INFO_PROCESSOR_MANUFACTURER_PROPERTY_NAME,
-            sizeof(DEVICE_INFO_PROCESSOR_MANUFACTURER_PROPERTY_NAME) - 1,
-            (UCHAR*)DEVICE_INFO_PROCESSOR_MANUFACTURER_PROPERTY_VALUE,
-            sizeof(DEVICE_INFO_PROCESSOR_MANUFACTURER_PROPERTY_VALUE) - 1) ||
-        nx_azure_iot_json_writer_append_property_with_double_value(json_writer,
-            (UCHAR*)DEVICE_INFO_TOTAL_STORAGE_PROPERTY_NAME,
-            sizeof(DEVICE_INFO_TOTAL_STORAGE_PROPERTY_NAME) - 1,
-            DEVICE_INFO_TOTAL_STORAGE_PROPERTY_VALUE,
-            2) ||
-        nx_azure_iot_json_writer_append_property_with_double_value(json_writer,
-            (UCHAR*)DEVICE_INFO_TOTAL_MEMORY_PROPERTY_NAME,
-            sizeof(DEVICE_INFO_TOTAL_MEMORY_PROPERTY_NAME) - 1,
-            DEVICE_INFO_TOTAL_MEMORY_PROPERTY_VALUE,
-            2))
+    if (pnp_device_information_property_manufacturer_append(json_writer, DEVICE_INFO_MANUFACTURER_PROPERTY_VALUE) ||
+        pnp_device_information_property_model_append(json_writer, DEVICE_INFO_MODEL_PROPERTY_VALUE) ||
+        pnp_device_information_property_sw_version_append(json_writer, DEVICE_INFO_SW_VERSION_PROPERTY_VALUE) ||
+        pnp_device_information_property_os_name_append(json_writer, DEVICE_INFO_OS_NAME_PROPERTY_VALUE) ||
+        pnp_device_information_property_processor_architecture_append(
+            json_writer, DEVICE_INFO_PROCESSOR_ARCHITECTURE_PROPERTY_VALUE) ||
+        pnp_device_information_property_processor_manufacturer_append(
+            json_writer, DEVICE_INFO_PROCESSOR_MANUFACTURER_PROPERTY_VALUE) ||
+        pnp_device_information_property_total_storage_append(json_writer, DEVICE_INFO_TOTAL_STORAGE_PROPERTY_VALUE) ||
+        pnp_device_information_property_total_memory_append(json_writer, DEVICE_INFO_TOTAL_MEMORY_PROPERTY_VALUE))
     {
         return NX_NOT_SUCCESSFUL;
     }
@@ -110,25 +80,24 @@ static UINT append_device_info_properties(NX_AZURE_IOT_JSON_WRITER* json_writer,
     return NX_AZURE_IOT_SUCCESS;
 }
 
-static UINT append_device_telemetry(NX_AZURE_IOT_JSON_WRITER* json_writer, VOID* context)
+static UINT append_device_telemetry(TELEMETRY_WRITER* writer, VOID* context)
 {
     struct bme68x_data data;
     read_bme680(&data);
 
-    if (nx_azure_iot_json_writer_append_property_with_double_value(
-            json_writer, (UCHAR*)TELEMETRY_HUMIDITY, sizeof(TELEMETRY_HUMIDITY) - 1, data.humidity, 2) ||
-
-        nx_azure_iot_json_writer_append_property_with_double_value(
-            json_writer, (UCHAR*)TELEMETRY_TEMPERATURE, sizeof(TELEMETRY_TEMPERATURE) - 1, data.temperature, 2) ||
-
-        nx_azure_iot_json_writer_append_property_with_double_value(
-            json_writer, (UCHAR*)TELEMETRY_PRESSURE, sizeof(TELEMETRY_PRESSURE) - 1, data.pressure, 2) ||
+    if (pnp_telemetry_humidity_append_filtered(writer, &humidity_deadband, data.humidity) ||
+        pnp_telemetry_temperature_append_filtered(writer, &temperature_deadband, data.temperature) ||
+        pnp_telemetry_pressure_append_filtered(writer, &pressure_deadband, data.pressure))
+    {
+        return NX_NOT_SUCCESSFUL;
+    }
 
-        nx_azure_iot_json_writer_append_property_with_double_value(json_writer,
+    if (telemetry_writer_deadband_check(writer, &gas_resistance_deadband, data.gas_resistance) &&
+        telemetry_writer_append_property_with_double_value(writer,
             (UCHAR*)TELEMETRY_GAS_RESISTANCE,
             sizeof(TELEMETRY_GAS_RESISTANCE) - 1,
             data.gas_resistance,
-            2))
+            PNP_DOUBLE_PRECISION))
     {
         return NX_NOT_SUCCESSFUL;
     }
@@ -136,19 +105,14 @@ static UINT append_device_telemetry(NX_AZURE_IOT_JSON_WRITER* json_writer, VOID*
     return NX_AZURE_IOT_SUCCESS;
 }
 
-static UINT append_device_accelerometer(NX_AZURE_IOT_JSON_WRITER* json_writer, VOID* context)
+static UINT append_device_accelerometer(TELEMETRY_WRITER* writer, VOID* context)
 {
     struct bmi160_sensor_data data;
     read_bmi160_accel(&data);
 
-    if (nx_azure_iot_json_writer_append_property_with_int32_value(
-            json_writer, (UCHAR*)TELEMETRY_ACCELEROMETERX, sizeof(TELEMETRY_ACCELEROMETERX) - 1, data.x) ||
-
-        nx_azure_iot_json_writer_append_property_with_int32_value(
-            json_writer, (UCHAR*)TELEMETRY_ACCELEROMETERY, sizeof(TELEMETRY_ACCELEROMETERY) - 1, data.y) ||
-
-        nx_azure_iot_json_writer_append_property_with_int32_value(
-            json_writer, (UCHAR*)TELEMETRY_ACCELEROMETERZ, sizeof(TELEMETRY_ACCELEROMETERZ) - 1, data.z))
+    if (pnp_telemetry_accelerometer_x_append(writer, data.x) ||
+        pnp_telemetry_accelerometer_y_append(writer, data.y) ||
+        pnp_telemetry_accelerometer_z_append(writer, data.z))
     {
         return NX_NOT_SUCCESSFUL;
     }
@@ -156,19 +120,14 @@ static UINT append_device_accelerometer(NX_AZURE_IOT_JSON_WRITER* json_writer, V
     return NX_AZURE_IOT_SUCCESS;
 }
 
-static UINT append_device_gyroscope(NX_AZURE_IOT_JSON_WRITER* json_writer, VOID* context)
+static UINT append_device_gyroscope(TELEMETRY_WRITER* writer, VOID* context)
 {
     struct bmi160_sensor_data data;
     read_bmi160_gyro(&data);
 
-    if (nx_azure_iot_json_writer_append_property_with_int32_value(
-            json_writer, (UCHAR*)TELEMETRY_GYROSCOPEX, sizeof(TELEMETRY_GYROSCOPEX) - 1, data.x) ||
-
-        nx_azure_iot_json_writer_append_property_with_int32_value(
-            json_writer, (UCHAR*)TELEMETRY_GYROSCOPEY, sizeof(TELEMETRY_GYROSCOPEY) - 1, data.y) ||
-
-        nx_azure_iot_json_writer_append_property_with_int32_value(
-            json_writer, (UCHAR*)TELEMETRY_GYROSCOPEZ, sizeof(TELEMETRY_GYROSCOPEZ) - 1, data.z))
+    if (pnp_telemetry_gyroscope_x_append(writer, data.x) ||
+        pnp_telemetry_gyroscope_y_append(writer, data.y) ||
+        pnp_telemetry_gyroscope_z_append(writer, data.z))
     {
         return NX_NOT_SUCCESSFUL;
     }
@@ -176,14 +135,13 @@ static UINT append_device_gyroscope(NX_AZURE_IOT_JSON_WRITER* json_writer, VOID*
     return NX_AZURE_IOT_SUCCESS;
 }
 
-static UINT append_device_light(NX_AZURE_IOT_JSON_WRITER* json_writer, VOID* context)
+static UINT append_device_light(TELEMETRY_WRITER* writer, VOID* context)
 {
     double als;
 
     read_isl29035(&als);
 
-    if (nx_azure_iot_json_writer_append_property_with_double_value(
-            json_writer, (UCHAR*)TELEMETRY_LIGHT, sizeof(TELEMETRY_LIGHT) - 1, als, 2))
+    if (pnp_telemetry_illuminance_append(writer, als))
     {
         return NX_NOT_SUCCESSFUL;
     }
@@ -218,15 +176,25 @@ static void direct_method_cb(AZURE_IOT_NX_CONTEXT* nx_context,
     UINT status;
     UINT http_status    = 501;
     CHAR* http_response = "{}";
+    bool led_state;
 
-    if (strncmp((CHAR*)method, SET_LED_STATE_COMMAND, method_length) == 0)
+    switch (pnp_command_lookup(method, method_length))
     {
-        bool arg = (strncmp((CHAR*)payload, "true", payload_length) == 0);
-        set_led_state(arg);
-
-        azure_iot_nx_client_publish_bool_property(&azure_iot_nx_client, LED_STATE_PROPERTY, arg);
-
-        http_status = 200;
+        case PNP_COMMAND_ID_SET_LED_STATE:
+            if (pnp_command_set_led_state_parse(payload, payload_length, &led_state) == NX_AZURE_IOT_SUCCESS)
+            {
+                set_led_state(led_state);
+                azure_iot_nx_client_publish_bool_property(&azure_iot_nx_client, PNP_PROPERTY_LED_STATE, led_state);
+                http_status = 200;
+            }
+            else
+            {
+                http_status = 400;
+            }
+            break;
+
+        default:
+            break;
     }
 
     if ((status = nx_azure_iot_hub_client_direct_method_message_response(&nx_context->iothub_client,
@@ -253,18 +221,23 @@ static void device_twin_desired_property_cb(UCHAR* component_name,
     UINT status;
     AZURE_IOT_NX_CONTEXT* nx_context = (AZURE_IOT_NX_CONTEXT*)userContextCallback;
 
-    if (strncmp((CHAR*)property_name, TELEMETRY_INTERVAL_PROPERTY, property_name_len) == 0)
+    switch (pnp_property_lookup(component_name, component_name_len, property_name, property_name_len))
     {
-        status = nx_azure_iot_json_reader_token_int32_get(&property_value_reader, &telemetry_interval);
-        if (status == NX_AZURE_IOT_SUCCESS)
-        {
-            // Confirm reception back to hub
-            azure_nx_client_respond_int_writeable_property(
-                nx_context, TELEMETRY_INTERVAL_PROPERTY, telemetry_interval, 200, version);
-
-            // Set a telemetry event so we pick up the change immediately
-            tx_event_flags_set(&azure_iot_flags, TELEMETRY_INTERVAL_EVENT, TX_OR);
-        }
+        case PNP_PROPERTY_ID_TELEMETRY_INTERVAL:
+            status = pnp_property_telemetry_interval_read(&property_value_reader, &telemetry_interval);
+            if (status == NX_AZURE_IOT_SUCCESS)
+            {
+                // Confirm reception back to hub
+                azure_nx_client_respond_int_writeable_property(
+                    nx_context, PNP_PROPERTY_TELEMETRY_INTERVAL, telemetry_interval, 200, version);
+
+                // Set a telemetry event so we pick up the change immediately
+                tx_event_flags_set(&azure_iot_flags, TELEMETRY_INTERVAL_EVENT, TX_OR);
+            }
+            break;
+
+        default:
+            break;
     }
 }
 
@@ -276,18 +249,17 @@ static void device_twin_property_cb(UCHAR* component_name,
     UINT version,
     VOID* userContextCallback)
 {
-    if (strncmp((CHAR*)property_name, TELEMETRY_INTERVAL_PROPERTY, property_name_len) == 0)
+    if (pnp_property_lookup(component_name, component_name_len, property_name, property_name_len) ==
+        PNP_PROPERTY_ID_TELEMETRY_INTERVAL)
     {
-        nx_azure_iot_json_reader_token_int32_get(&property_value_reader, &telemetry_interval);
+        pnp_property_telemetry_interval_read(&property_value_reader, &telemetry_interval);
     }
 }
 
-UINT azure_iot_nx_client_entry(
+UINT azure_iot_nx_client_setup(
     NX_IP* ip_ptr, NX_PACKET_POOL* pool_ptr, NX_DNS* dns_ptr, UINT (*unix_time_callback)(ULONG* unix_time))
 {
     UINT status;
-    ULONG events                    = 0;
-    TELEMETRY_STATE telemetry_state = TELEMETRY_STATE_DEFAULT;
 
     if ((status = tx_event_flags_create(&azure_iot_flags, "Azure IoT flags")))
     {
@@ -296,7 +268,7 @@ UINT azure_iot_nx_client_entry(
     }
 
     status =
-        azure_iot_nx_client_create(&azure_iot_nx_client, ip_ptr, pool_ptr, dns_ptr, unix_time_callback, IOT_MODEL_ID);
+        azure_iot_nx_client_create(&azure_iot_nx_client, ip_ptr, pool_ptr, dns_ptr, unix_time_callback, PNP_MODEL_ID);
     if (status != NX_SUCCESS)
     {
         printf("ERROR: azure_iot_nx_client_create failed (0x%08x)\r\n", status);
@@ -318,6 +290,16 @@ UINT azure_iot_nx_client_entry(
         return status;
     }
 
+    return NX_SUCCESS;
+}
+
+UINT azure_iot_nx_client_entry(VOID)
+{
+    UINT status;
+    REPORTED_PROPERTIES properties;
+    ULONG events                    = 0;
+    TELEMETRY_STATE telemetry_state = TELEMETRY_STATE_DEFAULT;
+
 #ifdef ENABLE_DPS
     status = azure_iot_nx_client_dps_create(&azure_iot_nx_client, IOT_DPS_ID_SCOPE, IOT_DPS_REGISTRATION_ID);
 #else
@@ -347,12 +329,15 @@ UINT azure_iot_nx_client_entry(
         return status;
     }
 
-    // Send out property updates
-    azure_iot_nx_client_publish_int_writeable_property(
-        &azure_iot_nx_client, TELEMETRY_INTERVAL_PROPERTY, telemetry_interval);
-    azure_iot_nx_client_publish_bool_property(&azure_iot_nx_client, LED_STATE_PROPERTY, false);
-    azure_iot_nx_client_publish_properties(
-        &azure_iot_nx_client, DEVICE_INFO_COMPONENT_NAME, append_device_info_properties);
+    // Send out property updates as a single twin patch
+    reported_properties_begin(&properties);
+    reported_properties_append_writeable_ack(&properties, PNP_PROPERTY_TELEMETRY_INTERVAL, telemetry_interval, 200, 1);
+    reported_properties_append_bool(&properties, PNP_PROPERTY_LED_STATE, false);
+    reported_properties_component_set(&properties, PNP_COMPONENT_DEVICE_INFORMATION);
+    reported_properties_append(&properties, append_device_info_properties, NX_NULL);
+    azure_iot_nx_client_reported_properties_send_async(&azure_iot_nx_client, &properties, NX_NULL, NX_NULL);
+
+    azure_iot_nx_client_telemetry_batch_set(&azure_iot_nx_client, TELEMETRY_BATCH_SAMPLES, TELEMETRY_BATCH_DELAY_SECS);
 
     printf("\r\nStarting Main loop\r\n");
     while (true)
@@ -363,19 +348,21 @@ UINT azure_iot_nx_client_entry(
         switch (telemetry_state)
         {
             case TELEMETRY_STATE_DEFAULT:
-                azure_iot_nx_client_publish_telemetry(&azure_iot_nx_client, append_device_telemetry);
+                azure_iot_nx_client_publish_telemetry_async(
+                    &azure_iot_nx_client, TELEMETRY_ENCODING_JSON, append_device_telemetry, NX_NULL, NX_NULL);
                 break;
 
             case TELEMETRY_STATE_ACCELEROMETER:
-                azure_iot_nx_client_publish_telemetry(&azure_iot_nx_client, append_device_accelerometer);
+                azure_iot_nx_client_publish_telemetry_batched(&azure_iot_nx_client, append_device_accelerometer);
                 break;
 
             case TELEMETRY_STATE_GYROSCOPE:
-                azure_iot_nx_client_publish_telemetry(&azure_iot_nx_client, append_device_gyroscope);
+                azure_iot_nx_client_publish_telemetry_batched(&azure_iot_nx_client, append_device_gyroscope);
                 break;
 
             case TELEMETRY_STATE_LIGHT:
-                azure_iot_nx_client_publish_telemetry(&azure_iot_nx_client, append_device_light);
+                azure_iot_nx_client_publish_telemetry_async(
+                    &azure_iot_nx_client, TELEMETRY_ENCODING_JSON, append_device_light, NX_NULL, NX_NULL);
                 break;
 
             default:
@@ -8,16 +8,23 @@
 #include "nx_wifi.h"
 #include "nxd_dns.h"
 
+#include "dns_resolver.h"
+
 #include <r_wifi_sx_ulpgn_if.h>
 
-#define THREADX_PACKET_COUNT 60
 #define THREADX_PACKET_SIZE  1536
-#define THREADX_POOL_SIZE    ((THREADX_PACKET_SIZE + sizeof(NX_PACKET)) * THREADX_PACKET_COUNT)
 
-static UCHAR threadx_ip_pool[THREADX_POOL_SIZE];
+// The WiFi module runs DHCP itself, the services pool only carries DNS and SNTP
+#define THREADX_STACK_PACKET_COUNT    24
+#define THREADX_CLOUD_PACKET_COUNT    20
+#define THREADX_SERVICES_PACKET_COUNT 6
+
+static UCHAR threadx_stack_pool[PACKET_POOL_MEMORY_SIZE(THREADX_PACKET_SIZE, THREADX_STACK_PACKET_COUNT)];
+static UCHAR threadx_cloud_pool[PACKET_POOL_MEMORY_SIZE(THREADX_PACKET_SIZE, THREADX_CLOUD_PACKET_COUNT)];
+static UCHAR threadx_services_pool[PACKET_POOL_MEMORY_SIZE(
+    PACKET_POOL_SERVICES_PAYLOAD_SIZE, THREADX_SERVICES_PACKET_COUNT)];
 
 NX_IP nx_ip;
-NX_PACKET_POOL nx_pool;
 NX_DNS nx_dns_client;
 
 // Print IPv4 address
@@ -112,7 +119,7 @@ static UINT dns_create()
 
     // Use the packet pool here
 #ifdef NX_DNS_CLIENT_USER_CREATE_PACKET_POOL
-    status = nx_dns_packet_pool_set(&nx_dns_client, nx_ip.nx_ip_default_packet_pool);
+    status = nx_dns_packet_pool_set(&nx_dns_client, packet_pool_get(PACKET_POOL_SERVICES));
     if (status != NX_SUCCESS)
     {
         printf("ERROR: Failed to create DNS packet pool (%0x02)\r\n", status);
@@ -121,6 +128,13 @@ static UINT dns_create()
     }
 #endif
 
+    status = dns_resolver_create(&nx_dns_client);
+    if (status != NX_SUCCESS)
+    {
+        nx_dns_delete(&nx_dns_client);
+        return status;
+    }
+
     if (R_WIFI_SX_ULPGN_GetDnsServerAddress(&dns_address_1) != WIFI_SUCCESS)
     {
         printf("ERROR: Failed to fetch Wifi DNS\r\n");
@@ -132,7 +146,7 @@ static UINT dns_create()
     print_address("DNS address", dns_address_1);
 
     // Add an IPv4 server address to the Client list.
-    status = nx_dns_server_add(&nx_dns_client,
+    status = dns_resolver_server_add(
         IP_ADDRESS(
             dns_address_1 >> 24 & 0xFF, dns_address_1 >> 16 & 0xFF, dns_address_1 >> 8 & 0xFF, dns_address_1 & 0xFF));
     if (status != NX_SUCCESS)
@@ -160,30 +174,36 @@ int rx_network_init(CHAR* ssid, CHAR* password, WiFi_Mode mode)
     // Initialize the NetX system
     nx_system_initialize();
 
-    // Create a packet pool
-    status =
-        nx_packet_pool_create(&nx_pool, "NetX Packet Pool", THREADX_PACKET_SIZE, threadx_ip_pool, THREADX_POOL_SIZE);
-    if (status != NX_SUCCESS)
+    // Create the packet pools
+    if ((status = packet_pool_create(
+             PACKET_POOL_STACK, THREADX_PACKET_SIZE, threadx_stack_pool, sizeof(threadx_stack_pool))) ||
+        (status = packet_pool_create(
+             PACKET_POOL_CLOUD, THREADX_PACKET_SIZE, threadx_cloud_pool, sizeof(threadx_cloud_pool))) ||
+        (status = packet_pool_create(PACKET_POOL_SERVICES,
+             PACKET_POOL_SERVICES_PAYLOAD_SIZE,
+             threadx_services_pool,
+             sizeof(threadx_services_pool))))
     {
+        packet_pools_delete();
         printf("ERROR: Packet pool create fail.\r\n");
         return status;
     }
 
     // Create an IP instance
-    status = nx_ip_create(&nx_ip, "NetX IP Instance 0", 0, 0, &nx_pool, NULL, NULL, 0, 0);
+    status = nx_ip_create(&nx_ip, "NetX IP Instance 0", 0, 0, packet_pool_get(PACKET_POOL_STACK), NULL, NULL, 0, 0);
     if (status != NX_SUCCESS)
     {
-        nx_packet_pool_delete(&nx_pool);
+        packet_pools_delete();
         printf("ERROR: IP create fail.\r\n");
         return status;
     }
 
     // Initialize NetX WiFi
-    status = nx_wifi_initialize(&nx_ip, &nx_pool);
+    status = nx_wifi_initialize(&nx_ip, packet_pool_get(PACKET_POOL_STACK));
     if (status != NX_SUCCESS)
     {
         nx_ip_delete(&nx_ip);
-        nx_packet_pool_delete(&nx_pool);
+        packet_pools_delete();
         printf("ERROR: WiFi initialize fail.\r\n");
         return status;
     }
@@ -196,7 +216,7 @@ int rx_network_init(CHAR* ssid, CHAR* password, WiFi_Mode mode)
     if (status != NX_SUCCESS)
     {
         nx_ip_delete(&nx_ip);
-        nx_packet_pool_delete(&nx_pool);
+        packet_pools_delete();
         printf("ERROR: DNS create fail.\r\n");
         return status;
     }
@@ -7,11 +7,12 @@
 #include "nx_api.h"
 #include "nxd_dns.h"
 
+#include "packet_pools.h"
+
 #include "azure_config.h"
 
-extern NX_IP          nx_ip;
-extern NX_PACKET_POOL nx_pool;
-extern NX_DNS         nx_dns_client;
+extern NX_IP  nx_ip;
+extern NX_DNS nx_dns_client;
 
 int rx_network_init(CHAR* ssid, CHAR* password, WiFi_Mode mode);
 
@@ -78,6 +78,12 @@ static NX_IP                        *nx_wifi_ip;
 #define NX_WIFI_PACKET_RESERVED     1
 #endif /* NX_WIFI_PACKET_RESERVED  */
 
+/* Define the room for received data in a packet. Data is read straight into the packet payload,
+   at most WIFI_PAYLOAD_SIZE at a time, and whatever does not fit stays in the module for the next read.  */
+#define NX_WIFI_PACKET_ROOM(packet_ptr) \
+    (((ULONG)((packet_ptr) -> nx_packet_data_end - (packet_ptr) -> nx_packet_prepend_ptr) < WIFI_PAYLOAD_SIZE) ? \
+     (ULONG)((packet_ptr) -> nx_packet_data_end - (packet_ptr) -> nx_packet_prepend_ptr) : WIFI_PAYLOAD_SIZE)
+
 /* Define the WIFI socket structure.  */
 typedef struct NX_WIFI_SOCKET_STRUCT
 {
@@ -121,9 +127,6 @@ static NX_WIFI_SOCKET               nx_wifi_socket[NX_WIFI_SOCKET_COUNTER];
 /* Define the SOCKET ID.  */
 static CHAR                         nx_wifi_socket_counter;
 
-/* Define the buffer to receive data from wifi.  */
-static CHAR                         nx_wifi_buffer[WIFI_PAYLOAD_SIZE];
-
 #ifdef NX_ENABLE_IP_PACKET_FILTER
 
 /* Define the wifi IP address.  */
@@ -303,29 +306,28 @@ wifi_ip_configuration_t ip_cfg;
                 do
                 {
 
-                    /* Make sure there is enough space to store the data before receiving data from WIFI.  */
-                    if ((nx_wifi_pool -> nx_packet_pool_available * nx_wifi_pool -> nx_packet_pool_payload_size) <
-                        (WIFI_PAYLOAD_SIZE + (NX_WIFI_PACKET_RESERVED * nx_wifi_pool -> nx_packet_pool_payload_size)))
-                        break;
-
-                    /* Receive the data in WIFI_READ_TIMEOUT ms.  */
-                    size = R_WIFI_SX_ULPGN_ReceiveSocket(nx_wifi_socket[i].socket_id,
-                            (uint8_t *)nx_wifi_buffer, WIFI_PAYLOAD_SIZE, WIFI_READ_TIMEOUT);
-                    /* Check status.  */
-                    if ((size <= 0))
+                    /* Make sure a packet is left for the applications before receiving data from WIFI.  */
+                    if (nx_wifi_pool -> nx_packet_pool_available <= NX_WIFI_PACKET_RESERVED)
                         break;
 
                     /* Allocate one packet to store the data.  */
                     if (nx_packet_allocate(nx_wifi_pool, &packet_ptr,  NX_RECEIVE_PACKET, NX_NO_WAIT))
                         break;
 
-                    /* Set the data.  */
-                    if (nx_packet_data_append(packet_ptr, nx_wifi_buffer, size, nx_wifi_pool, NX_NO_WAIT))
+                    /* Receive the data in WIFI_READ_TIMEOUT ms straight into the packet.  */
+                    size = R_WIFI_SX_ULPGN_ReceiveSocket(nx_wifi_socket[i].socket_id,
+                            packet_ptr -> nx_packet_prepend_ptr, (int32_t)NX_WIFI_PACKET_ROOM(packet_ptr), WIFI_READ_TIMEOUT);
+                    /* Check status.  */
+                    if ((size <= 0))
                     {
                         nx_packet_release(packet_ptr);
                         break;
                     }
 
+                    /* Set the data.  */
+                    packet_ptr -> nx_packet_append_ptr = packet_ptr -> nx_packet_prepend_ptr + size;
+                    packet_ptr -> nx_packet_length = (ULONG)size;
+
                     /* Check to see if the deferred processing queue is empty.  */
                     if (nx_wifi_socket[i].nx_wifi_received_packet_head)
                     {
@@ -690,7 +692,7 @@ ULONG   total_millisecond;
 ULONG   wait_millisecond;
 UINT    start_time;
 ULONG   millisecond;
-USHORT  size;
+int32_t size;
 UINT    received_packet = NX_FALSE;
 #ifdef NX_ENABLE_IP_PACKET_FILTER
 NX_TCP_SOCKET *tcp_socket;
@@ -748,6 +750,15 @@ NX_UDP_SOCKET *udp_socket;
     else
     {
 
+        /* Allocate one packet up front so the data lands straight in its payload.  */
+        if (nx_packet_allocate(nx_wifi_pool, packet_ptr,  NX_RECEIVE_PACKET, NX_NO_WAIT))
+        {
+
+            /* Release the IP internal mutex before processing the IP event.  */
+            tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+            return(NX_NOT_SUCCESSFUL);
+        }
+
         /* Get the start time.  */
         start_time = tx_time_get();
 
@@ -767,7 +778,7 @@ NX_UDP_SOCKET *udp_socket;
 
             /* Receive the data within a specified time.  */
             size = R_WIFI_SX_ULPGN_ReceiveSocket(nx_wifi_socket[entry_index].socket_id,
-                    (uint8_t *)nx_wifi_buffer, WIFI_PAYLOAD_SIZE, WIFI_READ_TIMEOUT);
+                    (*packet_ptr) -> nx_packet_prepend_ptr, (int32_t)NX_WIFI_PACKET_ROOM(*packet_ptr), WIFI_READ_TIMEOUT);
 
             /* Check status.  */
             if ((size <= 0))
@@ -795,11 +806,19 @@ NX_UDP_SOCKET *udp_socket;
         if (received_packet != NX_TRUE)
         {
 
+            /* Release the packet.  */
+            nx_packet_release(*packet_ptr);
+            *packet_ptr = NX_NULL;
+
             /* Release the IP internal mutex before processing the IP event.  */
             tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
             return(NX_NO_PACKET);
         }
 
+        /* Set the data.  */
+        (*packet_ptr) -> nx_packet_append_ptr = (*packet_ptr) -> nx_packet_prepend_ptr + size;
+        (*packet_ptr) -> nx_packet_length = (ULONG)size;
+
 #ifdef NX_ENABLE_IP_PACKET_FILTER
 
         /* Check the socket type.  */
@@ -831,27 +850,6 @@ NX_UDP_SOCKET *udp_socket;
         }
 #endif /* NX_ENABLE_IP_PACKET_FILTER  */
 
-        /* Allocate one packet to store the data.  */
-        if (nx_packet_allocate(nx_wifi_pool, packet_ptr,  NX_RECEIVE_PACKET, NX_NO_WAIT))
-        {
-
-            /* Release the IP internal mutex before processing the IP event.  */
-            tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
-            return(NX_NOT_SUCCESSFUL);
-        }
-
-        /* Set the data.  */
-        if (nx_packet_data_append(*packet_ptr, nx_wifi_buffer, size, nx_wifi_pool, NX_NO_WAIT))
-        {
-
-            /* Release the packet.  */
-            nx_packet_release(*packet_ptr);
-
-            /* Release the IP internal mutex before processing the IP event.  */
-            tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
-            return(NX_NOT_SUCCESSFUL);
-        }
-
         /* Release the IP internal mutex before processing the IP event.  */
         tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
         return(NX_SUCCESS);
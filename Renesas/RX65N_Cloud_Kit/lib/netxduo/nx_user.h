@@ -58,12 +58,27 @@
 #define NX_ENABLE_IP_PACKET_FILTER
 
 #define NX_SNTP_CLIENT_MIN_SERVER_STRATUM 3
+
+/* Cache answers, by their TTL, for the lookups the Azure IoT middleware makes itself */
+#define NX_DNS_CACHE_ENABLE
+
 #define NX_SNTP_CLIENT_MESSAGE_CHECK_DISABLE
 
 #define NXD_MQTT_CLOUD_ENABLE
 
+/* Uncomment to negotiate ECDHE with AES-128-GCM instead of RSA key transport with AES-128-CBC */
+/* #define NX_AZURE_IOT_TLS_PROFILE_ECC */
+
+#ifdef NX_AZURE_IOT_TLS_PROFILE_ECC
+#define NX_SECURE_ENABLE_ECC_CIPHERSUITE
+#define NX_SECURE_ENABLE_AEAD_CIPHER
+#endif
+
 #define NX_AZURE_IOT_PROVISIONING_CLIENT_CONNECT_WAIT_OPTION (40 * NX_IP_PERIODIC_RATE)
 
+/* Batch the motion sensor samples into one message each, see azure_iot_nx_client_publish_telemetry_batched */
+#define AZURE_IOT_TELEMETRY_BATCH_ENABLE
+
 /* NetX */
 #define NX_DNS_CLIENT_USER_CREATE_PACKET_POOL
 #define NX_DNS_CLIENT_CLEAR_QUEUE
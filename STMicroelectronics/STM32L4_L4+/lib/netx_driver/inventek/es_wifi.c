@@ -823,24 +823,26 @@ static ES_WIFI_Status_t AT_RequestSendData(ES_WIFIObject_t *Obj, uint8_t* cmd, u
 
 
 /**
-  * @brief  Parses Received data.
+  * @brief  Parses Received data where it was read, without copying it out.
   * @param  Obj: pointer to module handle
   * @param  cmd:command formatted string
-  * @param  pdata: payload
+  * @param  pbuf: buffer the response is read into
+  * @param  Buflen : most bytes to read into pbuf, 0 for no limit. One byte past them must stay writable.
+  * @param  pdata : (OUT) start of the payload in pbuf.
   * @param  Reqlen : requested Data length.
   * @param  ReadData : pointer to received data length.
   * @retval Operation Status.
   */
-static ES_WIFI_Status_t AT_RequestReceiveData(ES_WIFIObject_t *Obj, uint8_t* cmd, char *pdata, uint16_t Reqlen, uint16_t *ReadData)
+static ES_WIFI_Status_t AT_RequestReceiveDataInPlace(ES_WIFIObject_t *Obj, uint8_t* cmd, uint8_t *pbuf, uint16_t Buflen, uint8_t **pdata, uint16_t Reqlen, uint16_t *ReadData)
 {
   int len;
   int i = 0;
-  uint8_t *p=Obj->CmdData;
+  uint8_t *p=pbuf;
 
   LOCK_WIFI();
   if(Obj->fops.IO_Send(cmd, strlen((char*)cmd), Obj->Timeout) > 0)
   {
-    len = Obj->fops.IO_Receive(p, 0 , Obj->Timeout);
+    len = Obj->fops.IO_Receive(p, Buflen, Obj->Timeout);
     if (len == ES_WIFI_ERROR_STUFFING_FOREVER )
     {
       UNLOCK_WIFI();
@@ -881,7 +883,7 @@ static ES_WIFI_Status_t AT_RequestReceiveData(ES_WIFIObject_t *Obj, uint8_t* cmd
        {
          *ReadData = Reqlen;
        }
-       memcpy(pdata, p, *ReadData);
+       *pdata = p;
        UNLOCK_WIFI();
        return ES_WIFI_STATUS_OK;
      }
@@ -902,6 +904,28 @@ static ES_WIFI_Status_t AT_RequestReceiveData(ES_WIFIObject_t *Obj, uint8_t* cmd
   return ES_WIFI_STATUS_IO_ERROR;
 }
 
+/**
+  * @brief  Parses Received data.
+  * @param  Obj: pointer to module handle
+  * @param  cmd:command formatted string
+  * @param  pdata: payload
+  * @param  Reqlen : requested Data length.
+  * @param  ReadData : pointer to received data length.
+  * @retval Operation Status.
+  */
+static ES_WIFI_Status_t AT_RequestReceiveData(ES_WIFIObject_t *Obj, uint8_t* cmd, char *pdata, uint16_t Reqlen, uint16_t *ReadData)
+{
+  uint8_t *p;
+  ES_WIFI_Status_t ret;
+
+  ret = AT_RequestReceiveDataInPlace(Obj, cmd, Obj->CmdData, 0, &p, Reqlen, ReadData);
+  if (ret == ES_WIFI_STATUS_OK)
+  {
+    memcpy(pdata, p, *ReadData);
+  }
+  return ret;
+}
+
 
 /**
   * @brief  Initialize WIFI module.
@@ -2126,70 +2150,153 @@ ES_WIFI_Status_t ES_WIFI_StopServerMultiConn(ES_WIFIObject_t *Obj, ES_WIFI_Conn_
   return ret;
 }
 /**
-  * @brief  Send an amount data over WIFI.
+  * @brief  Selects the socket and write timeout of the next S3 send.
   * @param  Obj: pointer to module handle
   * @param  Socket: number of the socket
-  * @param  pdata: pointer to data
-  * @param  len : length of the data to be sent
+  * @param  Timeout : send timeout in mS, 0 for the non blocking default
   * @retval Operation Status.
   */
-ES_WIFI_Status_t ES_WIFI_SendData(ES_WIFIObject_t *Obj, uint8_t Socket, uint8_t *pdata, uint16_t Reqlen , uint16_t *SentLen , uint32_t Timeout)
+static ES_WIFI_Status_t AT_PrepareSend(ES_WIFIObject_t *Obj, uint8_t Socket, uint32_t Timeout)
 {
-  uint32_t wkgTimeOut;
-
-  ES_WIFI_Status_t ret = ES_WIFI_STATUS_ERROR;
+  ES_WIFI_Status_t ret;
 
   if (Timeout == 0)
   {
-    wkgTimeOut = NET_DEFAULT_NOBLOCKING_WRITE_TIMEOUT;
+    Timeout = NET_DEFAULT_NOBLOCKING_WRITE_TIMEOUT;
+  }
+
+  sprintf((char*)Obj->CmdData,"P0=%d\r", Socket);
+  ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
+  if(ret != ES_WIFI_STATUS_OK)
+  {
+    DEBUG("P0 command failed\r\n");
+    return ret;
+  }
+
+  sprintf((char*)Obj->CmdData,"S2=%lu\r",Timeout);
+  ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
+  if(ret != ES_WIFI_STATUS_OK)
+  {
+    DEBUG("S2 command failed\r\n");
+  }
+  return ret;
+}
+
+/**
+  * @brief  Sends a payload on the socket selected by AT_PrepareSend.
+  * @param  Obj: pointer to module handle
+  * @param  pdata: pointer to data, may be in CmdData past ES_WIFI_GATHER_OFFSET
+  * @param  Reqlen : length of the data, at most ES_WIFI_PAYLOAD_SIZE
+  * @retval Operation Status.
+  */
+static ES_WIFI_Status_t AT_SendPayload(ES_WIFIObject_t *Obj, uint8_t *pdata, uint16_t Reqlen)
+{
+  ES_WIFI_Status_t ret;
+
+  sprintf((char *)Obj->CmdData,"S3=%04d\r",Reqlen);
+  ret = AT_RequestSendData(Obj, Obj->CmdData, pdata, Reqlen, Obj->CmdData);
+
+  if(ret == ES_WIFI_STATUS_OK)
+  {
+    if(strstr((char *)Obj->CmdData,"-1\r\n"))
+    {
+      DEBUG("Send Data detect error %s\r\n", (char *)Obj->CmdData);
+      ret = ES_WIFI_STATUS_ERROR;
+    }
   }
   else
   {
-    wkgTimeOut = Timeout;
+    DEBUG("Send Data command failed\r\n");
   }
+  return ret;
+}
+
+/**
+  * @brief  Send an amount data over WIFI.
+  * @param  Obj: pointer to module handle
+  * @param  Socket: number of the socket
+  * @param  pdata: pointer to data
+  * @param  len : length of the data to be sent
+  * @retval Operation Status.
+  */
+ES_WIFI_Status_t ES_WIFI_SendData(ES_WIFIObject_t *Obj, uint8_t Socket, uint8_t *pdata, uint16_t Reqlen , uint16_t *SentLen , uint32_t Timeout)
+{
+  ES_WIFI_Status_t ret;
 
   LOCK_WIFI();
   if(Reqlen >= ES_WIFI_PAYLOAD_SIZE ) Reqlen= ES_WIFI_PAYLOAD_SIZE;
 
   *SentLen = Reqlen;
-  sprintf((char*)Obj->CmdData,"P0=%d\r", Socket);
-  ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
+  ret = AT_PrepareSend(Obj, Socket, Timeout);
   if(ret == ES_WIFI_STATUS_OK)
   {
-    sprintf((char*)Obj->CmdData,"S2=%lu\r",wkgTimeOut);
-    ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
+    ret = AT_SendPayload(Obj, pdata, Reqlen);
+  }
 
-    if(ret == ES_WIFI_STATUS_OK)
-    {
-      sprintf((char *)Obj->CmdData,"S3=%04d\r",Reqlen);
-      ret = AT_RequestSendData(Obj, Obj->CmdData, pdata, Reqlen, Obj->CmdData);
+  if (ret == ES_WIFI_STATUS_ERROR)
+  {
+    *SentLen = 0;
+  }
+  UNLOCK_WIFI();
+  return ret;
+}
 
-      if(ret == ES_WIFI_STATUS_OK)
-      {
-        if(strstr((char *)Obj->CmdData,"-1\r\n"))
-        {
-          DEBUG("Send Data detect error %s\r\n", (char *)Obj->CmdData);
-          ret = ES_WIFI_STATUS_ERROR;
-        }
-      }
-      else
-      {
-        DEBUG("Send Data command failed\r\n");
-      }
+/**
+  * @brief  Send scattered data over WIFI in one module transaction. Segments are
+  *         sent in order and the total is cut at ES_WIFI_PAYLOAD_SIZE. More than
+  *         one segment is gathered into CmdData behind the S3 command.
+  * @param  Obj: pointer to module handle
+  * @param  Socket: number of the socket
+  * @param  Segments: data to send
+  * @param  Count : number of segments
+  * @param  SentLen : (OUT) length actually sent
+  * @param  Timeout : send timeout in mS
+  * @retval Operation Status.
+  */
+ES_WIFI_Status_t ES_WIFI_SendDataGather(ES_WIFIObject_t *Obj, uint8_t Socket, const ES_WIFI_Segment_t *Segments, uint8_t Count, uint16_t *SentLen, uint32_t Timeout)
+{
+  ES_WIFI_Status_t ret;
+  uint16_t Reqlen = 0;
+  uint16_t len;
+  uint8_t *pdata;
+  uint8_t i;
+
+  *SentLen = 0;
+
+  if (Count == 0)
+  {
+    return ES_WIFI_STATUS_ERROR;
+  }
+
+  LOCK_WIFI();
+
+  ret = AT_PrepareSend(Obj, Socket, Timeout);
+  if(ret == ES_WIFI_STATUS_OK)
+  {
+    if ((Count == 1) || (Segments[0].len >= ES_WIFI_PAYLOAD_SIZE))
+    {
+      /* nothing to gather, send the data where it is */
+      pdata = Segments[0].pdata;
+      Reqlen = MIN(Segments[0].len, ES_WIFI_PAYLOAD_SIZE);
     }
     else
     {
-      DEBUG("S2 command failed\r\n");
+      /* P0 and S2 are done with CmdData, only the S3 command goes in front */
+      pdata = Obj->CmdData + ES_WIFI_GATHER_OFFSET;
+      for (i = 0; (i < Count) && (Reqlen < ES_WIFI_PAYLOAD_SIZE); i++)
+      {
+        len = MIN(Segments[i].len, ES_WIFI_PAYLOAD_SIZE - Reqlen);
+        memcpy(pdata + Reqlen, Segments[i].pdata, len);
+        Reqlen += len;
+      }
     }
-  }
-  else
-  {
-   DEBUG("P0 command failed\r\n");
+
+    ret = AT_SendPayload(Obj, pdata, Reqlen);
   }
 
-  if (ret == ES_WIFI_STATUS_ERROR)
+  if (ret == ES_WIFI_STATUS_OK)
   {
-    *SentLen = 0;
+    *SentLen = Reqlen;
   }
   UNLOCK_WIFI();
   return ret;
@@ -2286,69 +2393,129 @@ ES_WIFI_Status_t  ES_WIFI_SendDataTo(ES_WIFIObject_t *Obj, uint8_t Socket, uint8
 
 int issue15=0;
 /**
-  * @brief  Receive an amount data over WIFI.
+  * @brief  Sets the socket, length and timeout of the next R0 read.
   * @param  Obj: pointer to module handle
   * @param  Socket: number of the socket
-  * @param  pdata: pointer to data
-  * @param  len : pointer to the length of the data to be received
+  * @param  Reqlen : most data to return
+  * @param  Timeout : receive timeout in mS, 0 for the non blocking default
   * @retval Operation Status.
   */
-ES_WIFI_Status_t ES_WIFI_ReceiveData(ES_WIFIObject_t *Obj, uint8_t Socket, uint8_t *pdata, uint16_t Reqlen, uint16_t *Receivedlen, uint32_t Timeout)
+static ES_WIFI_Status_t AT_PrepareReceive(ES_WIFIObject_t *Obj, uint8_t Socket, uint16_t Reqlen, uint32_t Timeout)
 {
-  uint32_t wkgTimeOut;
-
-  ES_WIFI_Status_t ret = ES_WIFI_STATUS_ERROR;
+  ES_WIFI_Status_t ret;
 
   if (Timeout == 0)
   {
-    wkgTimeOut = NET_DEFAULT_NOBLOCKING_READ_TIMEOUT;
+    Timeout = NET_DEFAULT_NOBLOCKING_READ_TIMEOUT;
   }
-  else
+
+  sprintf((char*)Obj->CmdData,"P0=%d\r", Socket);
+  ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
+  if(ret != ES_WIFI_STATUS_OK)
   {
-    wkgTimeOut = Timeout;
+    DEBUG("setting socket for read failed\r\n");
+    issue15++;
+    return ret;
+  }
+
+  sprintf((char*)Obj->CmdData,"R1=%d\r", Reqlen);
+  ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
+  if(ret != ES_WIFI_STATUS_OK)
+  {
+    DEBUG("setting requested len failed\r\n");
+    return ret;
   }
 
+  sprintf((char*)Obj->CmdData,"R2=%lu\r", Timeout);
+  ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
+  if(ret != ES_WIFI_STATUS_OK)
+  {
+    DEBUG("setting timeout failed\r\n");
+  }
+  return ret;
+}
+
+/**
+  * @brief  Receive an amount data over WIFI.
+  * @param  Obj: pointer to module handle
+  * @param  Socket: number of the socket
+  * @param  pdata: pointer to data
+  * @param  len : pointer to the length of the data to be received
+  * @retval Operation Status.
+  */
+ES_WIFI_Status_t ES_WIFI_ReceiveData(ES_WIFIObject_t *Obj, uint8_t Socket, uint8_t *pdata, uint16_t Reqlen, uint16_t *Receivedlen, uint32_t Timeout)
+{
+  ES_WIFI_Status_t ret = ES_WIFI_STATUS_ERROR;
+
   LOCK_WIFI();
 
   if(Reqlen <= ES_WIFI_PAYLOAD_SIZE )
   {
-    sprintf((char*)Obj->CmdData,"P0=%d\r", Socket);
-    ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
-
+    ret = AT_PrepareReceive(Obj, Socket, Reqlen, Timeout);
     if(ret == ES_WIFI_STATUS_OK)
     {
-      sprintf((char*)Obj->CmdData,"R1=%d\r", Reqlen);
-      ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
-      if(ret == ES_WIFI_STATUS_OK)
-      {
-        sprintf((char*)Obj->CmdData,"R2=%lu\r", wkgTimeOut);
-        ret = AT_ExecuteCommand(Obj, Obj->CmdData, Obj->CmdData);
-        if(ret == ES_WIFI_STATUS_OK)
-        {
-          sprintf((char*)Obj->CmdData,"R0\r");
-          ret = AT_RequestReceiveData(Obj, Obj->CmdData, (char *)pdata, Reqlen, Receivedlen);
-          if (ret != ES_WIFI_STATUS_OK)
-          {
-            DEBUG("AT_RequestReceiveData  failed\r\n");
-          }
-        }
-        else
-        {
-         DEBUG("setting timeout failed\r\n");
-        }
-      }
-      else
+      sprintf((char*)Obj->CmdData,"R0\r");
+      ret = AT_RequestReceiveData(Obj, Obj->CmdData, (char *)pdata, Reqlen, Receivedlen);
+      if (ret != ES_WIFI_STATUS_OK)
       {
-        DEBUG("setting requested len failed\r\n");
-        *Receivedlen = 0;
+        DEBUG("AT_RequestReceiveData  failed\r\n");
       }
     }
     else
     {
-      DEBUG("setting socket for read failed\r\n");
-      issue15++;
+      *Receivedlen = 0;
+    }
+  }
+  UNLOCK_WIFI();
+  return ret;
+}
+
+/**
+  * @brief  Receive data over WIFI straight into the caller's buffer. The whole module
+  *         response is read into pbuf and the data is left in place, which saves the
+  *         copy out of CmdData.
+  * @param  Obj: pointer to module handle
+  * @param  Socket: number of the socket
+  * @param  pbuf: buffer the response is read into
+  * @param  Buflen : size of pbuf, up to ES_WIFI_RECEIVE_OVERHEAD of it holds the framing
+  * @param  pdata : (OUT) start of the data in pbuf
+  * @param  Receivedlen : (OUT) length of the data received
+  * @param  Timeout : receive timeout in mS
+  * @retval Operation Status.
+  */
+ES_WIFI_Status_t ES_WIFI_ReceiveDataInPlace(ES_WIFIObject_t *Obj, uint8_t Socket, uint8_t *pbuf, uint16_t Buflen, uint8_t **pdata, uint16_t *Receivedlen, uint32_t Timeout)
+{
+  ES_WIFI_Status_t ret;
+  uint16_t Reqlen;
+
+  *Receivedlen = 0;
+
+  if (Buflen <= ES_WIFI_RECEIVE_OVERHEAD)
+  {
+    return ES_WIFI_STATUS_ERROR;
+  }
+
+  /* ask for no more than fits in pbuf along with the framing */
+  Reqlen = Buflen - ES_WIFI_RECEIVE_OVERHEAD;
+  if (Reqlen > ES_WIFI_PAYLOAD_SIZE)
+  {
+    Reqlen = ES_WIFI_PAYLOAD_SIZE;
+  }
+
+  LOCK_WIFI();
+
+  ret = AT_PrepareReceive(Obj, Socket, Reqlen, Timeout);
+  if(ret == ES_WIFI_STATUS_OK)
+  {
+    /* SPI reads whole 16-bit words, keep a byte spare for the terminator the parser adds */
+    sprintf((char*)Obj->CmdData,"R0\r");
+    ret = AT_RequestReceiveDataInPlace(Obj, Obj->CmdData, pbuf, (Buflen - 1) & ~1, pdata, Reqlen, Receivedlen);
+    if (ret != ES_WIFI_STATUS_OK)
+    {
+      DEBUG("AT_RequestReceiveDataInPlace failed\r\n");
     }
   }
+
   UNLOCK_WIFI();
   return ret;
 }
@@ -59,6 +59,10 @@
 
 /* Exported Constants --------------------------------------------------------*/
 #define ES_WIFI_PAYLOAD_SIZE     1200
+/* Room a receive response takes around the data: "\r\n", "\r\nOK\r\n> " and padding */
+#define ES_WIFI_RECEIVE_OVERHEAD 32
+/* Where gathered send data starts in CmdData, past the "S3=nnnn\r" command */
+#define ES_WIFI_GATHER_OFFSET    16
 /* Exported macro-------------------------------------------------------------*/
 #define MIN(a, b)  ((a) < (b) ? (a) : (b))
 
@@ -87,6 +91,12 @@ typedef enum {
   ES_WIFI_STATUS_MODULE_CRASH   = 6
 } ES_WIFI_Status_t;
 
+/* One piece of the data of a gathered send */
+typedef struct {
+  uint8_t  *pdata;
+  uint16_t len;
+} ES_WIFI_Segment_t;
+
 #define ES_WIFI_ERROR_SPI_FAILED                    -1
 #define ES_WIFI_ERROR_WAITING_DRDY_RISING           -2
 #define ES_WIFI_ERROR_WAITING_DRDY_FALLING          -3
@@ -317,8 +327,10 @@ ES_WIFI_Status_t  ES_WIFI_StopServerSingleConn(ES_WIFIObject_t *Obj, int socket)
 ES_WIFI_Status_t  ES_WIFI_StartServerMultiConn(ES_WIFIObject_t *Obj, ES_WIFI_Conn_t *conn);
 ES_WIFI_Status_t  ES_WIFI_StopServerMultiConn(ES_WIFIObject_t *Obj,ES_WIFI_Conn_t *conn);
 ES_WIFI_Status_t  ES_WIFI_SendData(ES_WIFIObject_t *Obj, uint8_t Socket, uint8_t *pdata, uint16_t Reqlen , uint16_t *SentLen, uint32_t Timeout);
+ES_WIFI_Status_t  ES_WIFI_SendDataGather(ES_WIFIObject_t *Obj, uint8_t Socket, const ES_WIFI_Segment_t *Segments, uint8_t Count, uint16_t *SentLen, uint32_t Timeout);
 ES_WIFI_Status_t  ES_WIFI_SendDataTo(ES_WIFIObject_t *Obj, uint8_t Socket, uint8_t *pdata, uint16_t Reqlen , uint16_t *SentLen, uint32_t Timeout, uint8_t *IPaddr, uint16_t Port);
 ES_WIFI_Status_t  ES_WIFI_ReceiveData(ES_WIFIObject_t *Obj, uint8_t Socket, uint8_t *pdata, uint16_t Reqlen, uint16_t *Receivedlen, uint32_t Timeout);
+ES_WIFI_Status_t  ES_WIFI_ReceiveDataInPlace(ES_WIFIObject_t *Obj, uint8_t Socket, uint8_t *pbuf, uint16_t Buflen, uint8_t **pdata, uint16_t *Receivedlen, uint32_t Timeout);
 ES_WIFI_Status_t  ES_WIFI_ReceiveDataFrom(ES_WIFIObject_t *Obj, uint8_t Socket, uint8_t *pdata, uint16_t Reqlen, uint16_t *Receivedlen, uint32_t Timeout, uint8_t *IPaddr, uint16_t *pPort);
 ES_WIFI_Status_t  ES_WIFI_ActivateAP(ES_WIFIObject_t *Obj, ES_WIFI_APConfig_t *ApConfig);
 ES_WIFI_APState_t ES_WIFI_WaitAPStateChange(ES_WIFIObject_t *Obj);
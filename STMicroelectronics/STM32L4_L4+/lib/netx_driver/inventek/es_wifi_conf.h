@@ -26,6 +26,11 @@
 
 //#define WIFI_USE_CMSIS_OS
 
+/* Block on ThreadX semaphores, given by the data ready and SPI interrupts, instead of spinning on the flags */
+#ifndef WIFI_USE_CMSIS_OS
+#define WIFI_USE_THREADX
+#endif
+
 #ifdef WIFI_USE_CMSIS_OS
 #include "cmsis_os.h"
 
@@ -38,6 +43,18 @@ extern osMutexId es_wifi_mutex;
 #define SEM_SIGNAL(a)           osSemaphoreRelease(a)
 #define SEM_WAIT(a,timeout)     osSemaphoreWait(a,timeout)
 #define SPI_INTERFACE_PRIO              configMAX_SYSCALL_INTERRUPT_PRIORITY
+#elif defined(WIFI_USE_THREADX)
+#include "tx_api.h"
+
+#define WIFI_MS_TO_TICKS(ms)    ((((ULONG)(ms)) * TX_TIMER_TICKS_PER_SECOND + 999) / 1000)
+
+#define LOCK_WIFI()
+#define UNLOCK_WIFI()
+#define LOCK_SPI()
+#define UNLOCK_SPI()
+#define SEM_SIGNAL(a)           tx_semaphore_ceiling_put(&(a), 1)
+#define SEM_WAIT(a,timeout)     ((tx_semaphore_get(&(a), WIFI_MS_TO_TICKS(timeout)) == TX_SUCCESS) ? 0 : -1)
+#define SPI_INTERFACE_PRIO              0
 #else
 
 #define LOCK_WIFI()
@@ -52,6 +52,11 @@ osSemaphoreDef(spi_tx_sem);
 static    osSemaphoreId cmddata_rdy_rising_sem;
 osSemaphoreDef(cmddata_rdy_rising_sem);
 
+#elif defined(WIFI_USE_THREADX)
+static    TX_SEMAPHORE spi_rx_sem;
+static    TX_SEMAPHORE spi_tx_sem;
+static    TX_SEMAPHORE cmddata_rdy_rising_sem;
+
 #endif
 
 
@@ -188,6 +193,11 @@ int8_t SPI_WIFI_Init(uint16_t mode)
     SEM_WAIT(spi_rx_sem, 1);
     SEM_WAIT(spi_tx_sem, 1);
 
+#elif defined(WIFI_USE_THREADX)
+    cmddata_rdy_rising_event=0;
+    tx_semaphore_create(&spi_rx_sem, "ES-WiFi SPI Rx", 0);
+    tx_semaphore_create(&spi_tx_sem, "ES-WiFi SPI Tx", 0);
+    tx_semaphore_create(&cmddata_rdy_rising_sem, "ES-WiFi Data Ready", 0);
 #endif
     /* first call used for calibration */
     SPI_WIFI_DelayUs(10);
@@ -248,6 +258,10 @@ int8_t SPI_WIFI_DeInit(void)
   osSemaphoreDelete(spi_tx_sem);
   osSemaphoreDelete(spi_rx_sem);
   osSemaphoreDelete(cmddata_rdy_rising_sem);
+#elif defined(WIFI_USE_THREADX)
+  tx_semaphore_delete(&spi_tx_sem);
+  tx_semaphore_delete(&spi_rx_sem);
+  tx_semaphore_delete(&cmddata_rdy_rising_sem);
 #endif
   return 0;
 }
@@ -398,6 +412,11 @@ int16_t SPI_WIFI_SendData( uint8_t *pdata,  uint16_t len, uint32_t timeout)
     return ES_WIFI_ERROR_SPI_FAILED;
   }
     
+#ifdef WIFI_USE_THREADX
+  /* drop an edge that arrived after an earlier wait timed out */
+  while (tx_semaphore_get(&cmddata_rdy_rising_sem, TX_NO_WAIT) == TX_SUCCESS);
+#endif
+
   /* arm to detect rising event */
   cmddata_rdy_rising_event=1;
   LOCK_SPI();
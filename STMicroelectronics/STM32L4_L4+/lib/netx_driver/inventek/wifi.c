@@ -440,6 +440,25 @@ WIFI_Status_t WIFI_SendData(uint8_t socket, uint8_t *pdata, uint16_t Reqlen, uin
   return ret;
 }
 
+/**
+  * @brief  Send scattered data on a socket in one module transaction
+  * @param  Segments : data to be sent, in order
+  * @param  Count : number of segments
+  * @param  SentDatalen : (OUT) length actually sent, at most ES_WIFI_PAYLOAD_SIZE
+  * @param  Timeout : Socket write timeout (ms)
+  * @retval Operation status
+  */
+WIFI_Status_t WIFI_SendDataGather(uint8_t socket, const WIFI_Segment_t *Segments, uint8_t Count, uint16_t *SentDatalen, uint32_t Timeout)
+{
+  WIFI_Status_t ret = WIFI_STATUS_ERROR;
+
+  if(ES_WIFI_SendDataGather(&EsWifiObj, socket, Segments, Count, SentDatalen, Timeout) == ES_WIFI_STATUS_OK)
+  {
+    ret = WIFI_STATUS_OK;
+  }
+  return ret;
+}
+
 /**
   * @brief  Send Data on a socket
   * @param  pdata : pointer to data to be sent
@@ -481,6 +500,26 @@ WIFI_Status_t WIFI_ReceiveData(uint8_t socket, uint8_t *pdata, uint16_t Reqlen,
   return ret;
 }
 
+/**
+  * @brief  Receive Data from a socket straight into a buffer, the data is left where it was read
+  * @param  pbuf : buffer the module response is read into
+  * @param  Buflen : size of pbuf, the data gets up to ES_WIFI_RECEIVE_OVERHEAD less
+  * @param  pdata : (OUT) start of the data in pbuf
+  * @param  RcvDatalen : (OUT) length of the data actually received
+  * @param  Timeout : Socket read timeout (ms)
+  * @retval Operation status
+  */
+WIFI_Status_t WIFI_ReceiveDataInPlace(uint8_t socket, uint8_t *pbuf, uint16_t Buflen, uint8_t **pdata, uint16_t *RcvDatalen, uint32_t Timeout)
+{
+  WIFI_Status_t ret = WIFI_STATUS_ERROR;
+
+  if(ES_WIFI_ReceiveDataInPlace(&EsWifiObj, socket, pbuf, Buflen, pdata, RcvDatalen, Timeout) == ES_WIFI_STATUS_OK)
+  {
+    ret = WIFI_STATUS_OK;
+  }
+  return ret;
+}
+
 /**
   * @brief  Receive Data from a socket
   * @param  pdata : pointer to Rx buffer
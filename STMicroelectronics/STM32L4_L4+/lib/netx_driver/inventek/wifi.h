@@ -115,6 +115,8 @@ typedef struct {
   uint8_t          Gateway_Addr[4];
 } WIFI_Conn_t;
 
+typedef ES_WIFI_Segment_t WIFI_Segment_t;
+
 /* Exported macro ------------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */
 WIFI_Status_t       WIFI_Init(void);
@@ -148,8 +150,10 @@ WIFI_Status_t       WIFI_CloseServerConnection(int socket);
 WIFI_Status_t       WIFI_StopServer(uint32_t socket);
 
 WIFI_Status_t       WIFI_SendData(uint8_t socket, uint8_t *pdata, uint16_t Reqlen, uint16_t *SentDatalen, uint32_t Timeout);
+WIFI_Status_t       WIFI_SendDataGather(uint8_t socket, const WIFI_Segment_t *Segments, uint8_t Count, uint16_t *SentDatalen, uint32_t Timeout);
 WIFI_Status_t       WIFI_SendDataTo(uint8_t socket, uint8_t *pdata, uint16_t Reqlen, uint16_t *SentDatalen, uint32_t Timeout, uint8_t *ipaddr, uint16_t port);
 WIFI_Status_t       WIFI_ReceiveData(uint8_t socket, uint8_t *pdata, uint16_t Reqlen, uint16_t *RcvDatalen, uint32_t Timeout);
+WIFI_Status_t       WIFI_ReceiveDataInPlace(uint8_t socket, uint8_t *pbuf, uint16_t Buflen, uint8_t **pdata, uint16_t *RcvDatalen, uint32_t Timeout);
 WIFI_Status_t       WIFI_ReceiveDataFrom(uint8_t socket, uint8_t *pdata, uint16_t Reqlen, uint16_t *RcvDatalen, uint32_t Timeout, uint8_t *ipaddr, uint16_t *port);
 WIFI_Status_t       WIFI_StartClient(void);
 WIFI_Status_t       WIFI_StopClient(void);
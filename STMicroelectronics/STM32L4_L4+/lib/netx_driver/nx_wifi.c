@@ -35,6 +35,12 @@
 #define WIFI_THREAD_PERIOD          100
 #endif /* WIFI_THREAD_PERIOD  */
 
+/* Define the poll period used while data is flowing. The period doubles on every quiet round
+   until it is back at WIFI_THREAD_PERIOD.  */
+#ifndef WIFI_THREAD_PERIOD_MIN
+#define WIFI_THREAD_PERIOD_MIN      1
+#endif /* WIFI_THREAD_PERIOD_MIN  */
+
 /* Define the default thread priority, stack size, etc. The user can override this 
    via -D command line option or via project settings.  */
 
@@ -51,6 +57,8 @@ static UCHAR                        nx_wifi_thread_stack[NX_WIFI_STACK_SIZE];
 
 /* Define the prototypes for X-WARE.  */
 static TX_THREAD                    nx_wifi_thread;
+static TX_SEMAPHORE                 nx_wifi_poll_semaphore;
+static TX_MUTEX                     nx_wifi_module_mutex;
 static NX_PACKET_POOL               *nx_wifi_pool;
 static NX_IP                        *nx_wifi_ip;
 
@@ -63,6 +71,22 @@ static NX_IP                        *nx_wifi_ip;
 #define NX_WIFI_PACKET_RESERVED     1
 #endif /* NX_WIFI_PACKET_RESERVED  */
 
+/* Define the room for a module response in a packet. The whole response is read into the packet
+   payload and the data is used where it lands, up to ES_WIFI_RECEIVE_OVERHEAD goes to the framing.  */
+#define NX_WIFI_PACKET_ROOM(packet_ptr) \
+    ((USHORT)((packet_ptr) -> nx_packet_data_end - (packet_ptr) -> nx_packet_data_start))
+
+/* Define the most packets gathered into one module send. The module takes up to ES_WIFI_PAYLOAD_SIZE
+   per send, small packets of a chain or of back to back sends share it.  */
+#ifndef NX_WIFI_SEND_SEGMENTS
+#define NX_WIFI_SEND_SEGMENTS       8
+#endif /* NX_WIFI_SEND_SEGMENTS  */
+
+/* Define how long a corked socket holds back a partial send, in ticks.  */
+#ifndef NX_WIFI_CORK_TIMEOUT
+#define NX_WIFI_CORK_TIMEOUT        ((NX_IP_PERIODIC_RATE + 19) / 20)
+#endif /* NX_WIFI_CORK_TIMEOUT  */
+
 /* Define the WIFI socket structure.  */
 typedef struct NX_WIFI_SOCKET_STRUCT
 {
@@ -79,13 +103,21 @@ typedef struct NX_WIFI_SOCKET_STRUCT
     /* Define the connected flag.  */
     CHAR        nx_wifi_socket_connected;
 
-    /* Reserved.  */
-    CHAR        reserved;
+    /* Define the corked flag, only full transfers are sent.  */
+    CHAR        nx_wifi_socket_corked;
     
     /* Define the deferred packet processing queue.  */
     NX_PACKET   *nx_wifi_received_packet_head,
                 *nx_wifi_received_packet_tail;
 
+    /* Define the queue of packets waiting to be sent, the bytes queued, the bytes of the head
+       packet already sent and when the oldest data was queued.  */
+    NX_PACKET   *nx_wifi_send_packet_head,
+                *nx_wifi_send_packet_tail;
+    ULONG       nx_wifi_send_length;
+    ULONG       nx_wifi_send_offset;
+    ULONG       nx_wifi_send_time;
+
 #ifdef NX_ENABLE_IP_PACKET_FILTER
 
     /* Define the UDP connected IP and port.  */
@@ -102,12 +134,13 @@ typedef struct NX_WIFI_SOCKET_STRUCT
 /* Define the TCP socket and UDP socket.  */
 static NX_WIFI_SOCKET               nx_wifi_socket[NX_WIFI_SOCKET_COUNTER];
 
+/* Define the per socket mutex. A socket holds it across its module transactions so the IP mutex
+   can be released while the SPI transfer runs. Kept apart from the entries which get cleared.  */
+static TX_MUTEX                     nx_wifi_socket_mutex[NX_WIFI_SOCKET_COUNTER];
+
 /* Define the SOCKET ID.  */
 static CHAR                         nx_wifi_socket_counter;
 
-/* Define the buffer to receive data from wifi.  */
-static CHAR                         nx_wifi_buffer[ES_WIFI_PAYLOAD_SIZE];
-
 #ifdef NX_ENABLE_IP_PACKET_FILTER
 
 /* Define the wifi IP address.  */
@@ -126,6 +159,24 @@ static UINT  nx_wifi_ip_packet_filter(ULONG source_ip, ULONG destination_ip,
 /* Define the wifi thread.  */
 static void    nx_wifi_thread_entry(ULONG thread_input);
 
+/* Wake the wifi thread to poll now. The module does not signal inbound socket data, but replies
+   usually follow a send or a new connection.  */
+#define NX_WIFI_POLL_REQUEST()      tx_semaphore_ceiling_put(&nx_wifi_poll_semaphore, 1)
+
+/* Serialize module transactions. The module runs one command at a time, each socket takes it
+   per transaction so concurrent sockets interleave. Taken after the socket mutex, the IP mutex
+   is never held while waiting for it.  */
+#define NX_WIFI_MODULE_GET()        tx_mutex_get(&nx_wifi_module_mutex, TX_WAIT_FOREVER)
+#define NX_WIFI_MODULE_PUT()        tx_mutex_put(&nx_wifi_module_mutex)
+
+/* Define the socket lookup.  */
+static UINT  nx_wifi_socket_lock(VOID *socket_ptr, UCHAR *entry_index);
+
+/* Define the send queue.  */
+static VOID  nx_wifi_socket_send_queue(UCHAR entry_index, NX_PACKET *packet_ptr);
+static VOID  nx_wifi_socket_send_drop(UCHAR entry_index, NX_PACKET *keep_packet);
+static UINT  nx_wifi_socket_send_flush(UCHAR entry_index, UINT full_only);
+
 /**************************************************************************/ 
 /*                                                                        */ 
 /*  FUNCTION                                               RELEASE        */ 
@@ -170,6 +221,7 @@ UINT nx_wifi_initialize(NX_IP *ip_ptr, NX_PACKET_POOL *packet_pool)
 {
 
 UINT    status;
+UINT    i;
 
     
     /* Set the IP.  */
@@ -184,6 +236,18 @@ UINT    status;
     /* Initialize the socket id.  */
     nx_wifi_socket_counter = 0;
 
+    /* Create the semaphore that wakes the wifi thread.  */
+    status = tx_semaphore_create(&nx_wifi_poll_semaphore, "Wifi Poll Semaphore", 0);
+
+    /* Check for semaphore create errors.  */
+    if (status)
+        return(status);
+
+    /* Create the module and socket mutexes.  */
+    tx_mutex_create(&nx_wifi_module_mutex, "Wifi Module Mutex", TX_INHERIT);
+    for (i = 0; i < NX_WIFI_SOCKET_COUNTER; i++)
+        tx_mutex_create(&nx_wifi_socket_mutex[i], "Wifi Socket Mutex", TX_INHERIT);
+
     /* Create the wifi thread.  */
     status = tx_thread_create(&nx_wifi_thread, "Wifi Thread", nx_wifi_thread_entry, 0,  
                               nx_wifi_thread_stack, NX_WIFI_STACK_SIZE, 
@@ -191,7 +255,13 @@ UINT    status;
      
     /* Check for thread create errors.  */
     if (status)
+    {
+        for (i = 0; i < NX_WIFI_SOCKET_COUNTER; i++)
+            tx_mutex_delete(&nx_wifi_socket_mutex[i]);
+        tx_mutex_delete(&nx_wifi_module_mutex);
+        tx_semaphore_delete(&nx_wifi_poll_semaphore);
         return(status);
+    }
     
     return(NX_SUCCESS);
 }
@@ -241,9 +311,12 @@ void nx_wifi_thread_entry(ULONG thread_input)
 {
 
 UINT            i;
-UINT            socket_counter;
 USHORT          size;
+UCHAR           *data_ptr;
 UINT            status; 
+UINT            received;
+UINT            corked;
+ULONG           poll_period = WIFI_THREAD_PERIOD;
 NX_PACKET       *packet_ptr;
 NX_TCP_SOCKET   *tcp_socket;
 NX_UDP_SOCKET   *udp_socket;
@@ -253,7 +326,10 @@ uint8_t         ip_address[4];
 
 
 #ifdef NX_ENABLE_IP_PACKET_FILTER
-    if (WIFI_GetIP_Address(ip_address) == WIFI_STATUS_OK)
+    NX_WIFI_MODULE_GET();
+    status = WIFI_GetIP_Address(ip_address);
+    NX_WIFI_MODULE_PUT();
+    if (status == WIFI_STATUS_OK)
     {
         nx_wifi_ip_address = IP_ADDRESS(ip_address[0], ip_address[1], ip_address[2], ip_address[3]);
     }
@@ -262,135 +338,171 @@ uint8_t         ip_address[4];
     while(1)
     {
       
-        /* Obtain the IP internal mutex before processing the IP event.  */
-        tx_mutex_get(&(nx_wifi_ip -> nx_ip_protection), TX_WAIT_FOREVER);
-        
-        socket_counter = 0;
-        
-        /* Check if have socket.  */
-        if (nx_wifi_socket_counter != 0)
+        received = NX_FALSE;
+        corked = NX_FALSE;
+
+        /* Loop to receive the data from every socket.  */
+        for (i = 0; i < NX_WIFI_SOCKET_COUNTER; i++)
         {
-          
-            /* Loop to receive the data from */
-            for (i = 0; (i < NX_WIFI_SOCKET_COUNTER) && (socket_counter < nx_wifi_socket_counter); i++)
+
+            /* Obtain the IP internal mutex to look at the socket entry.  */
+            tx_mutex_get(&(nx_wifi_ip -> nx_ip_protection), TX_WAIT_FOREVER);
+
+            /* Check if the socket is valid and connected, and skip it while another thread is using it.  */
+            if ((nx_wifi_socket[i].nx_wifi_socket_valid == 0) || (nx_wifi_socket[i].nx_wifi_socket_connected == 0) ||
+                (tx_mutex_get(&nx_wifi_socket_mutex[i], TX_NO_WAIT) != TX_SUCCESS))
+            {
+                tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+                continue;
+            }
+
+            /* Release the IP internal mutex while talking to the module.  */
+            tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+
+            /* Loop to receive the data from wifi for current socket.  */
+            do
             {
-              
-                /* Check if the socket is valid and connected.  */
-                if ((nx_wifi_socket[i].nx_wifi_socket_valid == 0) || (nx_wifi_socket[i].nx_wifi_socket_connected == 0))
-                    continue;                                           
-                
-                /* Update the socket counter.  */
-                socket_counter++;
                 
-                /* Loop to receive the data from wifi for current socket.  */
-                status = WIFI_STATUS_OK;
-                do
+                /* Make sure a packet is left for the applications before receiving data from WIFI.  */
+                if (nx_wifi_pool -> nx_packet_pool_available <= NX_WIFI_PACKET_RESERVED)
+                    break;
+
+                /* Allocate one packet to receive the data into.  */
+                if (nx_packet_allocate(nx_wifi_pool, &packet_ptr,  NX_RECEIVE_PACKET, NX_NO_WAIT))
+                    break;
+
+                /* Receive the data in WIFI_READ_TIMEOUT ms straight into the packet.  */
+                NX_WIFI_MODULE_GET();
+                status = WIFI_ReceiveDataInPlace(i, packet_ptr -> nx_packet_data_start, NX_WIFI_PACKET_ROOM(packet_ptr),
+                                                 &data_ptr, &size, WIFI_READ_TIMEOUT);
+                NX_WIFI_MODULE_PUT();
+
+                /* Check status.  */
+                if ((status != WIFI_STATUS_OK) || (size == 0))
                 {
-                    
-                    /* Make sure there is enought space to store the data before receiving data from WIFI.  */
-                    if ((nx_wifi_pool -> nx_packet_pool_available * nx_wifi_pool -> nx_packet_pool_payload_size) < 
-                        (ES_WIFI_PAYLOAD_SIZE + (NX_WIFI_PACKET_RESERVED * nx_wifi_pool -> nx_packet_pool_payload_size)))
-                        break;
-                      
-                    /* Receive the data in WIFI_READ_TIMEOUT ms.  */
-                    status = WIFI_ReceiveData(i, (uint8_t*)nx_wifi_buffer, ES_WIFI_PAYLOAD_SIZE, &size, WIFI_READ_TIMEOUT);
-                    
-                    /* Check status.  */
-                    if ((status != WIFI_STATUS_OK) || (size == 0))
-                        break;
-                    
-                    /* Allocate one packet to store the data.  */
-                    if (nx_packet_allocate(nx_wifi_pool, &packet_ptr,  NX_RECEIVE_PACKET, NX_NO_WAIT))
-                        break;
-                      
-                    /* Set the data.  */
-                    if (nx_packet_data_append(packet_ptr, nx_wifi_buffer, size, nx_wifi_pool, NX_NO_WAIT))
-                    {
-                        nx_packet_release(packet_ptr);
-                        break;
-                    }
-          
-                    /* Check to see if the deferred processing queue is empty.  */
-                    if (nx_wifi_socket[i].nx_wifi_received_packet_head)
-                    {
+                    nx_packet_release(packet_ptr);
+                    break;
+                }
 
-                        /* Not empty, just place the packet at the end of the queue.  */
-                        (nx_wifi_socket[i].nx_wifi_received_packet_tail) -> nx_packet_queue_next =  packet_ptr;
-                        packet_ptr -> nx_packet_queue_next =  NX_NULL;
-                        nx_wifi_socket[i].nx_wifi_received_packet_tail =  packet_ptr;
+                /* Data is flowing, keep polling at the short period.  */
+                received = NX_TRUE;
 
-                    }
-                    else
-                    {
+                /* Set the data where it landed.  */
+                packet_ptr -> nx_packet_prepend_ptr = data_ptr;
+                packet_ptr -> nx_packet_append_ptr = data_ptr + size;
+                packet_ptr -> nx_packet_length = size;
 
-                        /* Empty deferred receive processing queue.  Just setup the head pointers and
-                           set the event flags to ensure the IP helper thread looks at the deferred processing
-                           queue.  */
-                        nx_wifi_socket[i].nx_wifi_received_packet_head =  packet_ptr;
-                        nx_wifi_socket[i].nx_wifi_received_packet_tail =  packet_ptr;
-                        packet_ptr -> nx_packet_queue_next =             NX_NULL;
-                          
-                        /* Check the socket type.  */
-                        if (nx_wifi_socket[i].nx_wifi_socket_type == NX_WIFI_TCP_SOCKET)
-                        {
-                            
-                            /* Get the tcp socket.  */
-                            tcp_socket = (NX_TCP_SOCKET *)nx_wifi_socket[i].nx_wifi_socket_ptr;
+                /* Obtain the IP internal mutex to queue the packet.  */
+                tx_mutex_get(&(nx_wifi_ip -> nx_ip_protection), TX_WAIT_FOREVER);
+      
+                /* Check to see if the deferred processing queue is empty.  */
+                if (nx_wifi_socket[i].nx_wifi_received_packet_head)
+                {
+
+                    /* Not empty, just place the packet at the end of the queue.  */
+                    (nx_wifi_socket[i].nx_wifi_received_packet_tail) -> nx_packet_queue_next =  packet_ptr;
+                    packet_ptr -> nx_packet_queue_next =  NX_NULL;
+                    nx_wifi_socket[i].nx_wifi_received_packet_tail =  packet_ptr;
+
+                }
+                else
+                {
+
+                    /* Empty deferred receive processing queue.  Just setup the head pointers and
+                       set the event flags to ensure the IP helper thread looks at the deferred processing
+                       queue.  */
+                    nx_wifi_socket[i].nx_wifi_received_packet_head =  packet_ptr;
+                    nx_wifi_socket[i].nx_wifi_received_packet_tail =  packet_ptr;
+                    packet_ptr -> nx_packet_queue_next =             NX_NULL;
+                      
+                    /* Check the socket type.  */
+                    if (nx_wifi_socket[i].nx_wifi_socket_type == NX_WIFI_TCP_SOCKET)
+                    {
+                        
+                        /* Get the tcp socket.  */
+                        tcp_socket = (NX_TCP_SOCKET *)nx_wifi_socket[i].nx_wifi_socket_ptr;
 
 #ifdef NX_ENABLE_IP_PACKET_FILTER
-                            nx_wifi_ip_packet_filter(tcp_socket -> nx_tcp_socket_connect_ip.nxd_ip_address.v4,
-                                                     nx_wifi_ip_address,
-                                                     tcp_socket -> nx_tcp_socket_connect_port,
-                                                     tcp_socket -> nx_tcp_socket_port,
-                                                     NX_IP_TCP, size, NX_IP_PACKET_IN);
+                        nx_wifi_ip_packet_filter(tcp_socket -> nx_tcp_socket_connect_ip.nxd_ip_address.v4,
+                                                 nx_wifi_ip_address,
+                                                 tcp_socket -> nx_tcp_socket_connect_port,
+                                                 tcp_socket -> nx_tcp_socket_port,
+                                                 NX_IP_TCP, size, NX_IP_PACKET_IN);
 #endif /* NX_ENABLE_IP_PACKET_FILTER */
 
-                            /* Determine if there is a socket receive notification function specified.  */
-                            if (tcp_socket -> nx_tcp_receive_callback)
-                            {
+                        /* Determine if there is a socket receive notification function specified.  */
+                        if (tcp_socket -> nx_tcp_receive_callback)
+                        {
 
-                                /* Yes, notification is requested.  Call the application's receive notification
-                                   function for this socket.  */
-                                (tcp_socket -> nx_tcp_receive_callback)(tcp_socket);
-                            }
+                            /* Yes, notification is requested.  Call the application's receive notification
+                               function for this socket.  */
+                            (tcp_socket -> nx_tcp_receive_callback)(tcp_socket);
                         }
-                        else
-                        {
+                    }
+                    else
+                    {
 
-                            /* Get the udp socket.  */
-                            udp_socket = (NX_UDP_SOCKET *)nx_wifi_socket[i].nx_wifi_socket_ptr;
+                        /* Get the udp socket.  */
+                        udp_socket = (NX_UDP_SOCKET *)nx_wifi_socket[i].nx_wifi_socket_ptr;
 
 #ifdef NX_ENABLE_IP_PACKET_FILTER
 
-                            /* Process packet filter.  */
-                            nx_wifi_ip_packet_filter(nx_wifi_socket[i].nx_wifi_udp_socket_connect_ip,
-                                                     nx_wifi_ip_address,
-                                                     nx_wifi_socket[i].nx_wifi_udp_socket_connect_port,
-                                                     udp_socket -> nx_udp_socket_port,
-                                                     NX_IP_UDP, size, NX_IP_PACKET_IN);
+                        /* Process packet filter.  */
+                        nx_wifi_ip_packet_filter(nx_wifi_socket[i].nx_wifi_udp_socket_connect_ip,
+                                                 nx_wifi_ip_address,
+                                                 nx_wifi_socket[i].nx_wifi_udp_socket_connect_port,
+                                                 udp_socket -> nx_udp_socket_port,
+                                                 NX_IP_UDP, size, NX_IP_PACKET_IN);
 #endif /* NX_ENABLE_IP_PACKET_FILTER */
 
-                            /* Determine if there is a socket receive notification function specified.  */
-                            if (udp_socket -> nx_udp_receive_callback)
-                            {
+                        /* Determine if there is a socket receive notification function specified.  */
+                        if (udp_socket -> nx_udp_receive_callback)
+                        {
 
-                                /* Yes, notification is requested.  Call the application's receive notification
-                                   function for this socket.  */
-                                (udp_socket -> nx_udp_receive_callback)(udp_socket);
-                            }                     
-                        }
+                            /* Yes, notification is requested.  Call the application's receive notification
+                               function for this socket.  */
+                            (udp_socket -> nx_udp_receive_callback)(udp_socket);
+                        }                     
                     }
-        
-                    /* Queue the packet.  */
-                }while (status == WIFI_STATUS_OK);  
+                }
+
+                /* Release the IP internal mutex.  */
+                tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+    
+            }while (status == WIFI_STATUS_OK);  
+
+            /* Send the data a corked socket held back for NX_WIFI_CORK_TIMEOUT.  */
+            if (nx_wifi_socket[i].nx_wifi_send_packet_head)
+            {
+                if ((tx_time_get() - nx_wifi_socket[i].nx_wifi_send_time) >= NX_WIFI_CORK_TIMEOUT)
+                {
+                    if (nx_wifi_socket_send_flush(i, NX_FALSE))
+                        nx_wifi_socket_send_drop(i, NX_NULL);
+
+                    /* Poll soon for the reply.  */
+                    received = NX_TRUE;
+                }
+                else
+                    corked = NX_TRUE;
             }
+
+            /* Let other threads use this socket.  */
+            tx_mutex_put(&nx_wifi_socket_mutex[i]);
         }
         
-        /* Release the IP internal mutex before processing the IP event.  */
-        tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
-        
-        /* Sleep some ticks to next loop.  */
-        tx_thread_sleep(WIFI_THREAD_PERIOD);
+        /* Poll again soon while data is arriving, back off while the sockets are quiet.  */
+        if (received)
+            poll_period = WIFI_THREAD_PERIOD_MIN;
+        else if (poll_period < WIFI_THREAD_PERIOD)
+            poll_period = ((poll_period << 1) < WIFI_THREAD_PERIOD) ? (poll_period << 1) : WIFI_THREAD_PERIOD;
+
+        /* Come back in time to send what the corked sockets hold back.  */
+        if (corked && (poll_period > NX_WIFI_CORK_TIMEOUT))
+            poll_period = NX_WIFI_CORK_TIMEOUT;
+
+        /* Wait for the next poll, or for a send or connect to ask for one right away.  */
+        if (tx_semaphore_get(&nx_wifi_poll_semaphore, poll_period) == TX_SUCCESS)
+            poll_period = WIFI_THREAD_PERIOD_MIN;
     }
 }
 
@@ -615,6 +727,9 @@ NX_PACKET *current_packet;
         /* Release the current packet.  */
         nx_packet_release(current_packet);
     }
+
+    /* Release any packets waiting to be sent.  */
+    nx_wifi_socket_send_drop(entry_index, NX_NULL);
     
     /* Reset the entry.  */
     memset(&nx_wifi_socket[entry_index], 0, sizeof(NX_WIFI_SOCKET));    
@@ -626,22 +741,20 @@ NX_PACKET *current_packet;
 /*                                                                        */ 
 /*  FUNCTION                                               RELEASE        */ 
 /*                                                                        */ 
-/*    nx_wifi_socket_receive                              PORTABLE C      */
+/*    nx_wifi_socket_lock                                 PORTABLE C      */
 /*                                                           6.1          */
-/*  AUTHOR                                                                */
-/*                                                                        */
-/*    Yuxin Zhou, Microsoft Corporation                                   */
 /*                                                                        */
 /*  DESCRIPTION                                                           */ 
 /*                                                                        */
-/*    This function receives packet for wifi socket                       */
+/*    This function finds the entry of the socket and takes its mutex.    */
+/*    On success it returns with both the socket mutex and the IP         */
+/*    internal mutex held. The socket mutex is never waited on with the   */
+/*    IP internal mutex held, so the entry is checked again afterwards.   */
 /*                                                                        */ 
 /*  INPUT                                                                 */ 
 /*                                                                        */
 /*    socket_ptr                            Socket pointer                */
-/*    packet_ptr                            Pointer to received packet    */
-/*    wait_option                           Suspension option             */
-/*    socket_type                           Socket type                   */
+/*    entry_index                           Destination to entry          */
 /*                                                                        */ 
 /*  OUTPUT                                                                */ 
 /*                                                                        */ 
@@ -649,196 +762,113 @@ NX_PACKET *current_packet;
 /*                                                                        */ 
 /*  CALLS                                                                 */ 
 /*                                                                        */ 
-/*    None                                                                */ 
+/*    nx_wifi_socket_entry_find             Find the socket entry         */
+/*    tx_mutex_get                          Obtain protection mutex       */
+/*    tx_mutex_put                          Release protection mutex      */
 /*                                                                        */ 
 /*  CALLED BY                                                             */ 
 /*                                                                        */ 
-/*    Application Code                                                    */ 
-/*                                                                        */ 
-/*  RELEASE HISTORY                                                       */ 
+/*    NetX Wifi socket services                                           */ 
 /*                                                                        */ 
-/*    DATE              NAME                      DESCRIPTION             */
-/*                                                                        */
-/*  05-19-2020     Yuxin Zhou               Initial Version 6.0           */
-/*  09-30-2020     Yuxin Zhou               Modified comment(s), and      */
-/*                                            optimized internal code,    */
-/*                                            resulting in version 6.1    */
-/*                                                                        */
 /**************************************************************************/
-static UINT  nx_wifi_socket_receive(VOID *socket_ptr, NX_PACKET **packet_ptr, ULONG wait_option, UINT socket_type)
+static UINT  nx_wifi_socket_lock(VOID *socket_ptr, UCHAR *entry_index)
 {
 
-UINT    status;
-UCHAR   entry_index;
-ULONG   total_millisecond;
-ULONG   wait_millisecond;
-UINT    start_time;
-ULONG   millisecond;
-USHORT  size;
-UINT    received_packet = NX_FALSE;
-#ifdef NX_ENABLE_IP_PACKET_FILTER
-NX_TCP_SOCKET *tcp_socket;
-NX_UDP_SOCKET *udp_socket;
-#endif /* NX_ENABLE_IP_PACKET_FILTER */
+UCHAR   index;
 
-    /* Obtain the IP internal mutex before processing the IP event.  */
-    tx_mutex_get(&(nx_wifi_ip -> nx_ip_protection), TX_WAIT_FOREVER);     
+
+    /* Obtain the IP internal mutex to look up the entry.  */
+    tx_mutex_get(&(nx_wifi_ip -> nx_ip_protection), TX_WAIT_FOREVER);
     
-    /* Find an avaiable entry.  */
-    if (nx_wifi_socket_entry_find((void *)socket_ptr, &entry_index, 1))
+    /* Find the entry.  */
+    if (nx_wifi_socket_entry_find(socket_ptr, &index, 1))
     {
       
-        /* Release the IP internal mutex before processing the IP event.  */
+        /* Release the IP internal mutex.  */
         tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
         return(NX_NOT_SUCCESSFUL);
     }
 
-    /* Check if the socket is connected.  */
-    if (nx_wifi_socket[entry_index].nx_wifi_socket_connected == 0)
+    /* Release the IP internal mutex while another thread may be using the socket.  */
+    tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+
+    /* Take the socket.  */
+    tx_mutex_get(&nx_wifi_socket_mutex[index], TX_WAIT_FOREVER);
+    
+    /* Obtain the IP internal mutex again.  */
+    tx_mutex_get(&(nx_wifi_ip -> nx_ip_protection), TX_WAIT_FOREVER);
+
+    /* The socket may have been closed while waiting.  */
+    if ((nx_wifi_socket[index].nx_wifi_socket_valid == 0) ||
+        (nx_wifi_socket[index].nx_wifi_socket_ptr != socket_ptr))
     {
       
-        /* Release the IP internal mutex before processing the IP event.  */
+        /* Release the IP internal mutex and the socket.  */
         tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+        tx_mutex_put(&nx_wifi_socket_mutex[index]);
         return(NX_NOT_SUCCESSFUL);
-    } 
+    }
     
-    /* Convert the tick to millisecond.  */
-    nx_wifi_tick_convert_ms(wait_option, &total_millisecond); 
-          
-    /* Receive the packet from queue.  */
-    if (nx_wifi_socket[entry_index].nx_wifi_received_packet_head)
-    {
-                
-        /* Remove the first packet and process it!  */
-          
-        /* Pickup the first packet.  */
-        *packet_ptr =  nx_wifi_socket[entry_index].nx_wifi_received_packet_head;
-
-        /* Move the head pointer to the next packet.  */
-        nx_wifi_socket[entry_index].nx_wifi_received_packet_head =  (*packet_ptr) -> nx_packet_queue_next;
+    *entry_index = index;
+    return(NX_SUCCESS);
+}
 
-        /* Check for end of deferred processing queue.  */
-        if (nx_wifi_socket[entry_index].nx_wifi_received_packet_head == NX_NULL)
-        {
 
-            /* Yes, the queue is empty.  Set the tail pointer to NULL.  */
-            nx_wifi_socket[entry_index].nx_wifi_received_packet_tail =  NX_NULL;
-        }
-        
-        /* Release the IP internal mutex before processing the IP event.  */
-        tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
-        return(NX_SUCCESS);
-    }
-    else
-    {
-        
-        /* Get the start time.  */
-        start_time = tx_time_get();
-        
-        /* Loop to receive a packet.  */
-        while(total_millisecond)
-        {
-            
-            /* Check if exceed the max value of ES_WIFI_TIMEOUT.  */
-            if (total_millisecond > ES_WIFI_TIMEOUT)
-                wait_millisecond = ES_WIFI_TIMEOUT;
-            else
-                wait_millisecond = total_millisecond;
-            
-            /* Check if exceed the max value of ES_WIFI_TRANSPORT_TIMEOUT.  */
-            if (wait_millisecond > ES_WIFI_TRANSPORT_TIMEOUT)
-                wait_millisecond = ES_WIFI_TRANSPORT_TIMEOUT;
-        
-            /* Receive the data within a specified time.  */ 
-            status = WIFI_ReceiveData(entry_index, (uint8_t*)nx_wifi_buffer, ES_WIFI_PAYLOAD_SIZE, &size, wait_millisecond);
-                                
-            /* Check status.  */
-            if ((status != WIFI_STATUS_OK) || (size == 0))
-            {
-                
-                /* Convert the tick to millisecond.  */
-                nx_wifi_tick_convert_ms((tx_time_get() - start_time), &millisecond); 
-                
-                /* Update the remaining millisecond.  */
-                if (millisecond >= total_millisecond)
-                    total_millisecond = 0;
-                else
-                    total_millisecond -=millisecond;
-                
-                continue;
-            }
-            else
-            {
-                received_packet = NX_TRUE;
-                break;
-            }
-        }    
-        
-        /* Check if receive a packet.  */
-        if (received_packet != NX_TRUE)
-        {
-            
-            /* Release the IP internal mutex before processing the IP event.  */
-            tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
-            return(NX_NO_PACKET);
-        }
+/**************************************************************************/ 
+/*                                                                        */ 
+/*  FUNCTION                                               RELEASE        */ 
+/*                                                                        */ 
+/*    nx_wifi_socket_send_queue                           PORTABLE C      */
+/*                                                           6.1          */
+/*                                                                        */
+/*  DESCRIPTION                                                           */ 
+/*                                                                        */
+/*    This function queues a packet behind the data of the socket that    */
+/*    is still waiting to be sent. The caller holds the socket mutex.     */
+/*                                                                        */ 
+/*  INPUT                                                                 */ 
+/*                                                                        */
+/*    entry_index                           Entry of the socket           */
+/*    packet_ptr                            Packet to send                */
+/*                                                                        */ 
+/*  OUTPUT                                                                */ 
+/*                                                                        */ 
+/*    None                                                                */
+/*                                                                        */ 
+/*  CALLS                                                                 */ 
+/*                                                                        */ 
+/*    tx_time_get                           Get the system time           */
+/*                                                                        */ 
+/*  CALLED BY                                                             */ 
+/*                                                                        */ 
+/*    NetX Wifi socket services                                           */ 
+/*                                                                        */ 
+/**************************************************************************/
+static VOID  nx_wifi_socket_send_queue(UCHAR entry_index, NX_PACKET *packet_ptr)
+{
 
-#ifdef NX_ENABLE_IP_PACKET_FILTER
+NX_WIFI_SOCKET  *wifi_socket = &nx_wifi_socket[entry_index];
 
-        /* Check the socket type.  */
-        if (nx_wifi_socket[entry_index].nx_wifi_socket_type == NX_WIFI_TCP_SOCKET)
-        {
 
-            /* Get the tcp socket.  */
-            tcp_socket = (NX_TCP_SOCKET *)nx_wifi_socket[entry_index].nx_wifi_socket_ptr;
+    packet_ptr -> nx_packet_queue_next = NX_NULL;
 
-            /* Process packet filter.  */
-            nx_wifi_ip_packet_filter(tcp_socket -> nx_tcp_socket_connect_ip.nxd_ip_address.v4,
-                                     nx_wifi_ip_address,
-                                     tcp_socket -> nx_tcp_socket_connect_port,
-                                     tcp_socket -> nx_tcp_socket_port,
-                                     NX_IP_TCP, size, NX_IP_PACKET_IN);
-        }
-        else
-        {
+    /* Check if the queue is empty.  */
+    if (wifi_socket -> nx_wifi_send_packet_tail)
+    {
 
-            /* Get the udp socket.  */
-            udp_socket = (NX_UDP_SOCKET *)nx_wifi_socket[entry_index].nx_wifi_socket_ptr;
+        /* Not empty, just place the packet at the end of the queue.  */
+        (wifi_socket -> nx_wifi_send_packet_tail) -> nx_packet_queue_next = packet_ptr;
+    }
+    else
+    {
 
-            /* Process packet filter.  */
-            nx_wifi_ip_packet_filter(nx_wifi_socket[entry_index].nx_wifi_udp_socket_connect_ip,
-                                     nx_wifi_ip_address,
-                                     nx_wifi_socket[entry_index].nx_wifi_udp_socket_connect_port,
-                                     udp_socket -> nx_udp_socket_port,
-                                     NX_IP_UDP, size, NX_IP_PACKET_IN);
-        }
-#endif /* NX_ENABLE_IP_PACKET_FILTER  */
-        
-        /* Allocate one packet to store the data.  */
-        if (nx_packet_allocate(nx_wifi_pool, packet_ptr,  NX_RECEIVE_PACKET, NX_NO_WAIT))
-        {
-            
-            /* Release the IP internal mutex before processing the IP event.  */
-            tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
-            return(NX_NOT_SUCCESSFUL);
-        }
-                      
-        /* Set the data.  */
-        if (nx_packet_data_append(*packet_ptr, nx_wifi_buffer, size, nx_wifi_pool, NX_NO_WAIT))
-        {          
-            
-            /* Release the packet.  */
-            nx_packet_release(*packet_ptr);
-            
-            /* Release the IP internal mutex before processing the IP event.  */
-            tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
-            return(NX_NOT_SUCCESSFUL);
-        }
-        
-        /* Release the IP internal mutex before processing the IP event.  */
-        tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
-        return(NX_SUCCESS);
+        /* Empty, the cork timeout starts now.  */
+        wifi_socket -> nx_wifi_send_packet_head = packet_ptr;
+        wifi_socket -> nx_wifi_send_time = tx_time_get();
     }
+
+    wifi_socket -> nx_wifi_send_packet_tail = packet_ptr;
+    wifi_socket -> nx_wifi_send_length += packet_ptr -> nx_packet_length;
 }
 
 
@@ -846,47 +876,509 @@ NX_UDP_SOCKET *udp_socket;
 /*                                                                        */ 
 /*  FUNCTION                                               RELEASE        */ 
 /*                                                                        */ 
-/*    nx_wifi_tcp_client_socket_connect                   PORTABLE C      */
+/*    nx_wifi_socket_send_drop                            PORTABLE C      */
 /*                                                           6.1          */
-/*  AUTHOR                                                                */
-/*                                                                        */
-/*    Yuxin Zhou, Microsoft Corporation                                   */
 /*                                                                        */
 /*  DESCRIPTION                                                           */ 
 /*                                                                        */
-/*    This function sends wifi connection command                         */
+/*    This function releases the packets waiting to be sent after a send  */
+/*    failed. The packet the caller still owns is taken off the queue but */
+/*    not released. The caller holds the socket mutex.                    */
 /*                                                                        */ 
 /*  INPUT                                                                 */ 
 /*                                                                        */
-/*    socket_ptr                            Socket pointer                */
-/*    packet_ptr                            Pointer to received packet    */
-/*    wait_option                           Suspension option             */
-/*    socket_type                           Socket type                   */
+/*    entry_index                           Entry of the socket           */
+/*    keep_packet                           Packet to keep, or NX_NULL    */
 /*                                                                        */ 
 /*  OUTPUT                                                                */ 
 /*                                                                        */ 
-/*    status                                Completion status             */
+/*    None                                                                */
 /*                                                                        */ 
 /*  CALLS                                                                 */ 
 /*                                                                        */ 
-/*    None                                                                */ 
+/*    nx_packet_release                     Release packet                */
 /*                                                                        */ 
 /*  CALLED BY                                                             */ 
 /*                                                                        */ 
-/*    Application Code                                                    */ 
-/*                                                                        */ 
-/*  RELEASE HISTORY                                                       */ 
+/*    NetX Wifi socket services                                           */ 
 /*                                                                        */ 
-/*    DATE              NAME                      DESCRIPTION             */
-/*                                                                        */
-/*  05-19-2020     Yuxin Zhou               Initial Version 6.0           */
-/*  09-30-2020     Yuxin Zhou               Modified comment(s),          */
-/*                                            resulting in version 6.1    */
-/*                                                                        */
 /**************************************************************************/
-UINT  nx_wifi_tcp_client_socket_connect(NX_TCP_SOCKET *socket_ptr,
-                                        NXD_ADDRESS *server_ip,
-                                        UINT server_port,
+static VOID  nx_wifi_socket_send_drop(UCHAR entry_index, NX_PACKET *keep_packet)
+{
+
+NX_WIFI_SOCKET  *wifi_socket = &nx_wifi_socket[entry_index];
+NX_PACKET       *next_packet;
+NX_PACKET       *current_packet;
+
+
+    /* Setup next packet to queue head.  */
+    next_packet = wifi_socket -> nx_wifi_send_packet_head;
+
+    /* Release the packets queued up.  */
+    while (next_packet)
+    {
+
+        /* Setup the current packet pointer.  */
+        current_packet =  next_packet;
+
+        /* Move to the next packet.  */
+        next_packet =  next_packet -> nx_packet_queue_next;
+
+        /* Release the current packet unless the caller keeps it.  */
+        if (current_packet != keep_packet)
+            nx_packet_release(current_packet);
+    }
+
+    /* Reset the queue.  */
+    wifi_socket -> nx_wifi_send_packet_head = NX_NULL;
+    wifi_socket -> nx_wifi_send_packet_tail = NX_NULL;
+    wifi_socket -> nx_wifi_send_length = 0;
+    wifi_socket -> nx_wifi_send_offset = 0;
+}
+
+
+/**************************************************************************/ 
+/*                                                                        */ 
+/*  FUNCTION                                               RELEASE        */ 
+/*                                                                        */ 
+/*    nx_wifi_socket_send_flush                           PORTABLE C      */
+/*                                                           6.1          */
+/*                                                                        */
+/*  DESCRIPTION                                                           */ 
+/*                                                                        */
+/*    This function sends the data queued on the socket. The packets and  */
+/*    their chains are gathered into transfers of up to                   */
+/*    ES_WIFI_PAYLOAD_SIZE bytes, each one module transaction. With       */
+/*    full_only set only full transfers go out and the rest stays queued. */
+/*    Packets are released once all of their data is sent. The caller     */
+/*    holds the socket mutex and not the IP internal mutex.               */
+/*                                                                        */ 
+/*  INPUT                                                                 */ 
+/*                                                                        */
+/*    entry_index                           Entry of the socket           */
+/*    full_only                             Send full transfers only      */
+/*                                                                        */ 
+/*  OUTPUT                                                                */ 
+/*                                                                        */ 
+/*    status                                Completion status             */
+/*                                                                        */ 
+/*  CALLS                                                                 */ 
+/*                                                                        */ 
+/*    WIFI_SendDataGather                   Send one transfer             */
+/*    nx_packet_release                     Release packet                */
+/*                                                                        */ 
+/*  CALLED BY                                                             */ 
+/*                                                                        */ 
+/*    NetX Wifi socket services                                           */ 
+/*                                                                        */ 
+/**************************************************************************/
+static UINT  nx_wifi_socket_send_flush(UCHAR entry_index, UINT full_only)
+{
+
+NX_WIFI_SOCKET  *wifi_socket = &nx_wifi_socket[entry_index];
+WIFI_Segment_t  segments[NX_WIFI_SEND_SEGMENTS];
+NX_PACKET       *packet_ptr;
+NX_PACKET       *current_packet;
+ULONG           skip;
+ULONG           packet_size;
+USHORT          length;
+USHORT          send_data_length;
+UINT            count;
+UINT            status;
+#ifdef NX_ENABLE_IP_PACKET_FILTER
+NX_TCP_SOCKET   *tcp_socket;
+NX_UDP_SOCKET   *udp_socket;
+#endif /* NX_ENABLE_IP_PACKET_FILTER */
+
+
+    /* Loop to send the queued data.  */
+    while ((wifi_socket -> nx_wifi_send_packet_head) &&
+           ((full_only == NX_FALSE) || (wifi_socket -> nx_wifi_send_length >= ES_WIFI_PAYLOAD_SIZE)))
+    {
+
+        /* Gather the next transfer, starting past the data of the head packet already sent.  */
+        packet_ptr = wifi_socket -> nx_wifi_send_packet_head;
+        current_packet = packet_ptr;
+        skip = wifi_socket -> nx_wifi_send_offset;
+        length = 0;
+        count = 0;
+        while (packet_ptr && (length < ES_WIFI_PAYLOAD_SIZE) && (count < NX_WIFI_SEND_SEGMENTS))
+        {
+
+            /* Calculate current packet size. */
+            packet_size = (ULONG)(current_packet -> nx_packet_append_ptr - current_packet -> nx_packet_prepend_ptr);
+
+            /* Skip what was sent, take as much of the rest as fits.  */
+            if (skip >= packet_size)
+                skip -= packet_size;
+            else
+            {
+                packet_size -= skip;
+                if (packet_size > (ULONG)(ES_WIFI_PAYLOAD_SIZE - length))
+                    packet_size = (ULONG)(ES_WIFI_PAYLOAD_SIZE - length);
+
+                segments[count].pdata = current_packet -> nx_packet_prepend_ptr + skip;
+                segments[count].len = (USHORT)packet_size;
+                length = (USHORT)(length + packet_size);
+                count++;
+                skip = 0;
+            }
+
+#ifndef NX_DISABLE_PACKET_CHAIN
+            /* We have crossed the packet boundary.  Move to the next packet
+               structure.  */
+            current_packet =  current_packet -> nx_packet_next;
+#else
+
+            /* End the chain.  */
+            current_packet = NX_NULL;
+#endif /* NX_DISABLE_PACKET_CHAIN */
+
+            /* Move on to the next queued packet at the end of the chain.  */
+            if (current_packet == NX_NULL)
+            {
+                packet_ptr = packet_ptr -> nx_packet_queue_next;
+                current_packet = packet_ptr;
+            }
+        }
+
+        /* Check if there is any data left, empty packets are just released.  */
+        if (count == 0)
+        {
+            nx_wifi_socket_send_drop(entry_index, NX_NULL);
+            break;
+        }
+
+        /* Send data.  */
+        NX_WIFI_MODULE_GET();
+        status = WIFI_SendDataGather(entry_index, segments, (uint8_t)count, &send_data_length, WIFI_WRITE_TIMEOUT);
+        NX_WIFI_MODULE_PUT();
+
+        /* Check status.  */
+        if ((status != WIFI_STATUS_OK) || (send_data_length != length))
+            return(NX_NOT_SUCCESSFUL);
+
+#ifdef NX_ENABLE_IP_PACKET_FILTER
+
+        /* Process packet filter.  */
+        tx_mutex_get(&(nx_wifi_ip -> nx_ip_protection), TX_WAIT_FOREVER);
+        if (wifi_socket -> nx_wifi_socket_type == NX_WIFI_TCP_SOCKET)
+        {
+            tcp_socket = (NX_TCP_SOCKET *)wifi_socket -> nx_wifi_socket_ptr;
+            nx_wifi_ip_packet_filter(nx_wifi_ip_address,
+                                     tcp_socket -> nx_tcp_socket_connect_ip.nxd_ip_address.v4,
+                                     tcp_socket -> nx_tcp_socket_port,
+                                     tcp_socket -> nx_tcp_socket_connect_port,
+                                     NX_IP_TCP, length, NX_IP_PACKET_OUT);
+        }
+        else
+        {
+            udp_socket = (NX_UDP_SOCKET *)wifi_socket -> nx_wifi_socket_ptr;
+            nx_wifi_ip_packet_filter(nx_wifi_ip_address,
+                                     wifi_socket -> nx_wifi_udp_socket_connect_ip,
+                                     udp_socket -> nx_udp_socket_port,
+                                     wifi_socket -> nx_wifi_udp_socket_connect_port,
+                                     NX_IP_UDP, length, NX_IP_PACKET_OUT);
+        }
+        tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+#endif /* NX_ENABLE_IP_PACKET_FILTER */
+
+        /* Release the packets that went out in full.  */
+        wifi_socket -> nx_wifi_send_length -= length;
+        wifi_socket -> nx_wifi_send_offset += length;
+        while ((wifi_socket -> nx_wifi_send_packet_head) &&
+               (wifi_socket -> nx_wifi_send_offset >= (wifi_socket -> nx_wifi_send_packet_head) -> nx_packet_length))
+        {
+            packet_ptr = wifi_socket -> nx_wifi_send_packet_head;
+            wifi_socket -> nx_wifi_send_offset -= packet_ptr -> nx_packet_length;
+            wifi_socket -> nx_wifi_send_packet_head = packet_ptr -> nx_packet_queue_next;
+            nx_packet_release(packet_ptr);
+        }
+
+        /* Check for the end of the queue.  */
+        if (wifi_socket -> nx_wifi_send_packet_head == NX_NULL)
+            wifi_socket -> nx_wifi_send_packet_tail = NX_NULL;
+    }
+
+    return(NX_SUCCESS);
+}
+
+
+/**************************************************************************/ 
+/*                                                                        */ 
+/*  FUNCTION                                               RELEASE        */ 
+/*                                                                        */ 
+/*    nx_wifi_socket_receive                              PORTABLE C      */
+/*                                                           6.1          */
+/*  AUTHOR                                                                */
+/*                                                                        */
+/*    Yuxin Zhou, Microsoft Corporation                                   */
+/*                                                                        */
+/*  DESCRIPTION                                                           */ 
+/*                                                                        */
+/*    This function receives packet for wifi socket                       */
+/*                                                                        */ 
+/*  INPUT                                                                 */ 
+/*                                                                        */
+/*    socket_ptr                            Socket pointer                */
+/*    packet_ptr                            Pointer to received packet    */
+/*    wait_option                           Suspension option             */
+/*    socket_type                           Socket type                   */
+/*                                                                        */ 
+/*  OUTPUT                                                                */ 
+/*                                                                        */ 
+/*    status                                Completion status             */
+/*                                                                        */ 
+/*  CALLS                                                                 */ 
+/*                                                                        */ 
+/*    None                                                                */ 
+/*                                                                        */ 
+/*  CALLED BY                                                             */ 
+/*                                                                        */ 
+/*    Application Code                                                    */ 
+/*                                                                        */ 
+/*  RELEASE HISTORY                                                       */ 
+/*                                                                        */ 
+/*    DATE              NAME                      DESCRIPTION             */
+/*                                                                        */
+/*  05-19-2020     Yuxin Zhou               Initial Version 6.0           */
+/*  09-30-2020     Yuxin Zhou               Modified comment(s), and      */
+/*                                            optimized internal code,    */
+/*                                            resulting in version 6.1    */
+/*                                                                        */
+/**************************************************************************/
+static UINT  nx_wifi_socket_receive(VOID *socket_ptr, NX_PACKET **packet_ptr, ULONG wait_option, UINT socket_type)
+{
+
+UINT    status = WIFI_STATUS_OK;
+UCHAR   entry_index;
+ULONG   total_millisecond;
+ULONG   wait_millisecond;
+ULONG   start_time;
+ULONG   millisecond;
+USHORT  size;
+UCHAR   *data_ptr;
+UINT    received_packet = NX_FALSE;
+#ifdef NX_ENABLE_IP_PACKET_FILTER
+NX_TCP_SOCKET *tcp_socket;
+NX_UDP_SOCKET *udp_socket;
+#endif /* NX_ENABLE_IP_PACKET_FILTER */
+
+    /* Find the entry and take the socket, this returns with the IP internal mutex held.  */
+    if (nx_wifi_socket_lock(socket_ptr, &entry_index))
+        return(NX_NOT_SUCCESSFUL);
+
+    /* Check if the socket is connected.  */
+    if (nx_wifi_socket[entry_index].nx_wifi_socket_connected == 0)
+    {
+      
+        /* Release the IP internal mutex and the socket.  */
+        tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+        tx_mutex_put(&nx_wifi_socket_mutex[entry_index]);
+        return(NX_NOT_SUCCESSFUL);
+    } 
+    
+    /* Convert the tick to millisecond.  */
+    nx_wifi_tick_convert_ms(wait_option, &total_millisecond); 
+          
+    /* Receive the packet from queue.  */
+    if (nx_wifi_socket[entry_index].nx_wifi_received_packet_head)
+    {
+                
+        /* Remove the first packet and process it!  */
+          
+        /* Pickup the first packet.  */
+        *packet_ptr =  nx_wifi_socket[entry_index].nx_wifi_received_packet_head;
+
+        /* Move the head pointer to the next packet.  */
+        nx_wifi_socket[entry_index].nx_wifi_received_packet_head =  (*packet_ptr) -> nx_packet_queue_next;
+
+        /* Check for end of deferred processing queue.  */
+        if (nx_wifi_socket[entry_index].nx_wifi_received_packet_head == NX_NULL)
+        {
+
+            /* Yes, the queue is empty.  Set the tail pointer to NULL.  */
+            nx_wifi_socket[entry_index].nx_wifi_received_packet_tail =  NX_NULL;
+        }
+        
+        /* Release the IP internal mutex and the socket.  */
+        tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+        tx_mutex_put(&nx_wifi_socket_mutex[entry_index]);
+        return(NX_SUCCESS);
+    }
+
+    /* Release the IP internal mutex while waiting on the module, other sockets carry on.  */
+    tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+
+    /* Check if there is time to wait.  */
+    if (total_millisecond == 0)
+    {
+
+        /* Release the socket.  */
+        tx_mutex_put(&nx_wifi_socket_mutex[entry_index]);
+        return(NX_NO_PACKET);
+    }
+
+    /* Send the data a corked socket holds back, the reply may be waiting on it.  */
+    if (nx_wifi_socket[entry_index].nx_wifi_send_packet_head)
+    {
+        if (nx_wifi_socket_send_flush(entry_index, NX_FALSE))
+            nx_wifi_socket_send_drop(entry_index, NX_NULL);
+    }
+
+    /* Allocate the packet up front, the data is read straight into it.  */
+    if (nx_packet_allocate(nx_wifi_pool, packet_ptr,  NX_RECEIVE_PACKET, NX_NO_WAIT))
+    {
+
+        /* Release the socket.  */
+        tx_mutex_put(&nx_wifi_socket_mutex[entry_index]);
+        return(NX_NOT_SUCCESSFUL);
+    }
+        
+    /* Get the start time.  */
+    start_time = tx_time_get();
+    
+    /* Loop to receive a packet.  */
+    while(total_millisecond)
+    {
+        
+        /* Wait in slices of WIFI_READ_TIMEOUT and give the module up in between, so a long wait on
+           this socket does not hold off sends and receives on the others.  */
+        if (total_millisecond > WIFI_READ_TIMEOUT)
+            wait_millisecond = WIFI_READ_TIMEOUT;
+        else
+            wait_millisecond = total_millisecond;
+    
+        /* Receive the data within a specified time straight into the packet.  */ 
+        NX_WIFI_MODULE_GET();
+        status = WIFI_ReceiveDataInPlace(entry_index, (*packet_ptr) -> nx_packet_data_start, NX_WIFI_PACKET_ROOM(*packet_ptr),
+                                         &data_ptr, &size, wait_millisecond);
+        NX_WIFI_MODULE_PUT();
+                            
+        /* Check if receive a packet.  */
+        if ((status == WIFI_STATUS_OK) && (size != 0))
+        {
+            received_packet = NX_TRUE;
+            break;
+        }
+            
+        /* Convert the tick to millisecond.  */
+        nx_wifi_tick_convert_ms((tx_time_get() - start_time), &millisecond); 
+
+        /* Update the remaining millisecond.  */
+        start_time = tx_time_get();
+        if (millisecond >= total_millisecond)
+            total_millisecond = 0;
+        else
+            total_millisecond -=millisecond;
+    }    
+    
+    /* Check if receive a packet.  */
+    if (received_packet != NX_TRUE)
+    {
+
+        /* Release the packet.  */
+        nx_packet_release(*packet_ptr);
+        *packet_ptr = NX_NULL;
+        
+        /* Release the socket.  */
+        tx_mutex_put(&nx_wifi_socket_mutex[entry_index]);
+        return(NX_NO_PACKET);
+    }
+
+    /* Set the data where it landed.  */
+    (*packet_ptr) -> nx_packet_prepend_ptr = data_ptr;
+    (*packet_ptr) -> nx_packet_append_ptr = data_ptr + size;
+    (*packet_ptr) -> nx_packet_length = size;
+
+#ifdef NX_ENABLE_IP_PACKET_FILTER
+
+    /* Obtain the IP internal mutex for the packet filter.  */
+    tx_mutex_get(&(nx_wifi_ip -> nx_ip_protection), TX_WAIT_FOREVER);
+
+    /* Check the socket type.  */
+    if (nx_wifi_socket[entry_index].nx_wifi_socket_type == NX_WIFI_TCP_SOCKET)
+    {
+
+        /* Get the tcp socket.  */
+        tcp_socket = (NX_TCP_SOCKET *)nx_wifi_socket[entry_index].nx_wifi_socket_ptr;
+
+        /* Process packet filter.  */
+        nx_wifi_ip_packet_filter(tcp_socket -> nx_tcp_socket_connect_ip.nxd_ip_address.v4,
+                                 nx_wifi_ip_address,
+                                 tcp_socket -> nx_tcp_socket_connect_port,
+                                 tcp_socket -> nx_tcp_socket_port,
+                                 NX_IP_TCP, size, NX_IP_PACKET_IN);
+    }
+    else
+    {
+
+        /* Get the udp socket.  */
+        udp_socket = (NX_UDP_SOCKET *)nx_wifi_socket[entry_index].nx_wifi_socket_ptr;
+
+        /* Process packet filter.  */
+        nx_wifi_ip_packet_filter(nx_wifi_socket[entry_index].nx_wifi_udp_socket_connect_ip,
+                                 nx_wifi_ip_address,
+                                 nx_wifi_socket[entry_index].nx_wifi_udp_socket_connect_port,
+                                 udp_socket -> nx_udp_socket_port,
+                                 NX_IP_UDP, size, NX_IP_PACKET_IN);
+    }
+
+    /* Release the IP internal mutex.  */
+    tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+#endif /* NX_ENABLE_IP_PACKET_FILTER  */
+    
+    /* Release the socket.  */
+    tx_mutex_put(&nx_wifi_socket_mutex[entry_index]);
+    return(NX_SUCCESS);
+}
+
+
+/**************************************************************************/ 
+/*                                                                        */ 
+/*  FUNCTION                                               RELEASE        */ 
+/*                                                                        */ 
+/*    nx_wifi_tcp_client_socket_connect                   PORTABLE C      */
+/*                                                           6.1          */
+/*  AUTHOR                                                                */
+/*                                                                        */
+/*    Yuxin Zhou, Microsoft Corporation                                   */
+/*                                                                        */
+/*  DESCRIPTION                                                           */ 
+/*                                                                        */
+/*    This function sends wifi connection command                         */
+/*                                                                        */ 
+/*  INPUT                                                                 */ 
+/*                                                                        */
+/*    socket_ptr                            Socket pointer                */
+/*    packet_ptr                            Pointer to received packet    */
+/*    wait_option                           Suspension option             */
+/*    socket_type                           Socket type                   */
+/*                                                                        */ 
+/*  OUTPUT                                                                */ 
+/*                                                                        */ 
+/*    status                                Completion status             */
+/*                                                                        */ 
+/*  CALLS                                                                 */ 
+/*                                                                        */ 
+/*    None                                                                */ 
+/*                                                                        */ 
+/*  CALLED BY                                                             */ 
+/*                                                                        */ 
+/*    Application Code                                                    */ 
+/*                                                                        */ 
+/*  RELEASE HISTORY                                                       */ 
+/*                                                                        */ 
+/*    DATE              NAME                      DESCRIPTION             */
+/*                                                                        */
+/*  05-19-2020     Yuxin Zhou               Initial Version 6.0           */
+/*  09-30-2020     Yuxin Zhou               Modified comment(s),          */
+/*                                            resulting in version 6.1    */
+/*                                                                        */
+/**************************************************************************/
+UINT  nx_wifi_tcp_client_socket_connect(NX_TCP_SOCKET *socket_ptr,
+                                        NXD_ADDRESS *server_ip,
+                                        UINT server_port,
                                         ULONG wait_option)
 {
   
@@ -912,15 +1404,26 @@ UCHAR   entry_index;
     nx_wifi_socket[entry_index].nx_wifi_socket_type = NX_WIFI_TCP_SOCKET; 
     nx_wifi_socket[entry_index].nx_wifi_socket_connected = 0;
     nx_wifi_socket_counter++;
+
+    /* Release the IP internal mutex while the module connects.  */
+    tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+
+    /* Take the socket. A thread that looked up the socket this entry used to hold may still have it briefly.  */
+    tx_mutex_get(&nx_wifi_socket_mutex[entry_index], TX_WAIT_FOREVER);
     
     /* Swap the address.  */
     NX_CHANGE_ULONG_ENDIAN(server_ip -> nxd_ip_address.v4);
   
     /* Wifi connect.  */
+    NX_WIFI_MODULE_GET();
     status= WIFI_OpenClientConnection(entry_index , WIFI_TCP_PROTOCOL, "", (unsigned char* )(&(server_ip -> nxd_ip_address.v4)), server_port, socket_ptr -> nx_tcp_socket_port) ;
+    NX_WIFI_MODULE_PUT();
     
     /* Swap the address.  */
     NX_CHANGE_ULONG_ENDIAN(server_ip -> nxd_ip_address.v4);
+
+    /* Obtain the IP internal mutex to update the entry.  */
+    tx_mutex_get(&(nx_wifi_ip -> nx_ip_protection), TX_WAIT_FOREVER);
     
     if(status == WIFI_STATUS_OK)
     {     
@@ -934,8 +1437,12 @@ UCHAR   entry_index;
         socket_ptr -> nx_tcp_socket_connect_port = server_port;
         socket_ptr -> nx_tcp_socket_state =  NX_TCP_ESTABLISHED;  
         
-        /* Release the IP internal mutex before processing the IP event.  */
+        /* Release the IP internal mutex and the socket.  */
         tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+        tx_mutex_put(&nx_wifi_socket_mutex[entry_index]);
+
+        /* The server may speak first, poll the new connection now.  */
+        NX_WIFI_POLL_REQUEST();
         return(NX_SUCCESS); 
     }
     else
@@ -944,8 +1451,9 @@ UCHAR   entry_index;
         /* Reset the entry.  */
         nx_wifi_socket_reset(entry_index);
         
-        /* Release the IP internal mutex before processing the IP event.  */
+        /* Release the IP internal mutex and the socket.  */
         tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+        tx_mutex_put(&nx_wifi_socket_mutex[entry_index]);
         return(NX_NOT_SUCCESSFUL);
     }
 }
@@ -997,29 +1505,34 @@ UINT  nx_wifi_tcp_socket_disconnect(NX_TCP_SOCKET *socket_ptr, ULONG wait_option
 UCHAR   entry_index;
 
 
-    /* Obtain the IP internal mutex before processing the IP event.  */
-    tx_mutex_get(&(nx_wifi_ip -> nx_ip_protection), TX_WAIT_FOREVER);
-    
-    /* Check if the entry already exist.  */
-    if (nx_wifi_socket_entry_find((void *)socket_ptr, &entry_index, 1))
-    {
-      
-        /* Release the IP internal mutex before processing the IP event.  */
-        tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+    /* Find the entry and take the socket, this returns with the IP internal mutex held.  */
+    if (nx_wifi_socket_lock((void *)socket_ptr, &entry_index))
         return(NX_NOT_SUCCESSFUL);
-    }
     
     /* Check if the socket is connected.  */
     if (nx_wifi_socket[entry_index].nx_wifi_socket_connected == 0)
     {
       
-        /* Release the IP internal mutex before processing the IP event.  */
+        /* Release the IP internal mutex and the socket.  */
         tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+        tx_mutex_put(&nx_wifi_socket_mutex[entry_index]);
         return(NX_NOT_SUCCESSFUL);
     }
+
+    /* Release the IP internal mutex while the module closes the connection.  */
+    tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
     
+    /* Send the data a corked socket holds back, the entry reset drops whatever is left.  */
+    if (nx_wifi_socket[entry_index].nx_wifi_send_packet_head)
+        nx_wifi_socket_send_flush(entry_index, NX_FALSE);
+
     /* Close connection.  */
+    NX_WIFI_MODULE_GET();
     WIFI_CloseClientConnection(entry_index);
+    NX_WIFI_MODULE_PUT();
+
+    /* Obtain the IP internal mutex to reset the entry.  */
+    tx_mutex_get(&(nx_wifi_ip -> nx_ip_protection), TX_WAIT_FOREVER);
 
     /* Reset the entry.  */   
     socket_ptr -> nx_tcp_socket_state = NX_TCP_CLOSED;  
@@ -1027,8 +1540,9 @@ UCHAR   entry_index;
     /* Reset the entry.  */
     nx_wifi_socket_reset(entry_index);
         
-    /* Release the IP internal mutex before processing the IP event.  */
+    /* Release the IP internal mutex and the socket.  */
     tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+    tx_mutex_put(&nx_wifi_socket_mutex[entry_index]);
     
     /* Return success.  */
     return(NX_SUCCESS);
@@ -1081,82 +1595,188 @@ UINT  nx_wifi_tcp_socket_send(NX_TCP_SOCKET *socket_ptr, NX_PACKET *packet_ptr,
   
 UINT        status ;
 UCHAR       entry_index;
-USHORT      send_data_length;
-ULONG       packet_size;
-NX_PACKET   *current_packet;
+ULONG       queued_length;
 
     
-    /* Obtain the IP internal mutex before processing the IP event.  */
-    tx_mutex_get(&(nx_wifi_ip -> nx_ip_protection), TX_WAIT_FOREVER);
-        
-    /* Find an avaiable entry.  */
-    if (nx_wifi_socket_entry_find((void *)socket_ptr, &entry_index, 1))
-    {
-      
-        /* Release the IP internal mutex before processing the IP event.  */
-        tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+    /* Find the entry and take the socket, this returns with the IP internal mutex held.  */
+    if (nx_wifi_socket_lock((void *)socket_ptr, &entry_index))
         return(NX_NOT_SUCCESSFUL);
-    }
     
     /* Check if the socket is connected.  */
     if (nx_wifi_socket[entry_index].nx_wifi_socket_connected == 0)
     {
       
-        /* Release the IP internal mutex before processing the IP event.  */
+        /* Release the IP internal mutex and the socket.  */
         tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+        tx_mutex_put(&nx_wifi_socket_mutex[entry_index]);
         return(NX_NOT_SUCCESSFUL);
     }
+
+    /* Release the IP internal mutex while sending, other sockets carry on.  */
+    tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
     
-    /* Initialize the current packet to the input packet pointer.  */
-    current_packet =  packet_ptr;
-    
-    /* Loop to send the packet.  */
-    while(current_packet)
-    {
-      
-        /* Calculate current packet size. */
-        packet_size = (ULONG)(current_packet -> nx_packet_append_ptr - current_packet -> nx_packet_prepend_ptr);
-      
-        /* Send data.  */
-        status = WIFI_SendData(entry_index, current_packet -> nx_packet_prepend_ptr, packet_size, &send_data_length, WIFI_WRITE_TIMEOUT); 
+    /* Queue the packet behind the data still waiting, so the chain and any corked data
+       go out together in full transfers.  */
+    nx_wifi_socket_send_queue(entry_index, packet_ptr);
+    queued_length = nx_wifi_socket[entry_index].nx_wifi_send_length;
+
+    /* A corked socket sends full transfers only, the rest waits for more data, a flush
+       or NX_WIFI_CORK_TIMEOUT.  */
+    status = nx_wifi_socket_send_flush(entry_index, (UINT)nx_wifi_socket[entry_index].nx_wifi_socket_corked);
         
-        /* Check status.  */
-        if ((status != WIFI_STATUS_OK) || (send_data_length != packet_size))
-        {
+    /* Check status.  */
+    if (status)
+    {
+
+        /* Drop the data queued earlier, the caller keeps this packet.  */
+        nx_wifi_socket_send_drop(entry_index, packet_ptr);
           
-            /* Release the IP internal mutex before processing the IP event.  */
-            tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
-            return (NX_NOT_SUCCESSFUL);
-        }
+        /* Release the socket.  */
+        tx_mutex_put(&nx_wifi_socket_mutex[entry_index]);
+        return (NX_NOT_SUCCESSFUL);
+    }
 
-#ifdef NX_ENABLE_IP_PACKET_FILTER
+    /* Check if anything went out.  */
+    if (nx_wifi_socket[entry_index].nx_wifi_send_length < queued_length)
+    {
+    
+        /* Poll for the reply.  */
+        NX_WIFI_POLL_REQUEST();
+    }
+    
+    /* Release the socket.  */
+    tx_mutex_put(&nx_wifi_socket_mutex[entry_index]);
+    
+    return (NX_SUCCESS);      
+}
 
-        /* Process packet filter.  */
-        nx_wifi_ip_packet_filter(nx_wifi_ip_address,
-                                 socket_ptr -> nx_tcp_socket_connect_ip.nxd_ip_address.v4,
-                                 socket_ptr -> nx_tcp_socket_port,
-                                 socket_ptr -> nx_tcp_socket_connect_port,
-                                 NX_IP_TCP, packet_size, NX_IP_PACKET_OUT);
-#endif /* NX_ENABLE_IP_PACKET_FILTER */
 
-#ifndef NX_DISABLE_PACKET_CHAIN
-        /* We have crossed the packet boundary.  Move to the next packet
-           structure.  */
-        current_packet =  current_packet -> nx_packet_next;
-#else
+/**************************************************************************/ 
+/*                                                                        */ 
+/*  FUNCTION                                               RELEASE        */ 
+/*                                                                        */ 
+/*    nx_wifi_tcp_socket_cork                             PORTABLE C      */
+/*                                                           6.1          */
+/*                                                                        */
+/*  DESCRIPTION                                                           */ 
+/*                                                                        */
+/*    This function corks or uncorks a connected TCP socket. A corked     */
+/*    socket holds back sends until a full ES_WIFI_PAYLOAD_SIZE transfer  */
+/*    is queued, so back to back small sends share module transactions.   */
+/*    Held data goes out on uncork, on nx_wifi_tcp_socket_flush, before   */
+/*    a receive waits on the module and after NX_WIFI_CORK_TIMEOUT ticks. */
+/*                                                                        */ 
+/*  INPUT                                                                 */ 
+/*                                                                        */
+/*    socket_ptr                            Pointer to TCP socket         */
+/*    cork                                  NX_TRUE to cork               */
+/*                                                                        */ 
+/*  OUTPUT                                                                */ 
+/*                                                                        */ 
+/*    status                                Completion status             */
+/*                                                                        */ 
+/*  CALLS                                                                 */ 
+/*                                                                        */ 
+/*    nx_wifi_socket_send_flush             Send the queued data          */
+/*                                                                        */ 
+/*  CALLED BY                                                             */ 
+/*                                                                        */ 
+/*    Application Code                                                    */ 
+/*                                                                        */ 
+/**************************************************************************/
+UINT  nx_wifi_tcp_socket_cork(NX_TCP_SOCKET *socket_ptr, UINT cork)
+{
 
-        /* End the loop.  */
-        current_packet = NX_NULL;
-#endif /* NX_DISABLE_PACKET_CHAIN */
+UINT        status = NX_SUCCESS;
+UCHAR       entry_index;
+
+
+    /* Find the entry and take the socket, this returns with the IP internal mutex held.  */
+    if (nx_wifi_socket_lock((void *)socket_ptr, &entry_index))
+        return(NX_NOT_SUCCESSFUL);
+
+    /* Set the cork flag.  */
+    nx_wifi_socket[entry_index].nx_wifi_socket_corked = (cork) ? 1 : 0;
+
+    /* Release the IP internal mutex.  */
+    tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+
+    /* Send what was held back.  */
+    if ((cork == NX_FALSE) && (nx_wifi_socket[entry_index].nx_wifi_send_packet_head))
+    {
+        status = nx_wifi_socket_send_flush(entry_index, NX_FALSE);
+        if (status)
+            nx_wifi_socket_send_drop(entry_index, NX_NULL);
+
+        /* Poll for the reply.  */
+        NX_WIFI_POLL_REQUEST();
     }
-     
-    /* Release the packet.  */
-    nx_packet_release(packet_ptr);
-    
-    /* Release the IP internal mutex before processing the IP event.  */
+
+    /* Release the socket.  */
+    tx_mutex_put(&nx_wifi_socket_mutex[entry_index]);
+
+    return(status);
+}
+
+
+/**************************************************************************/ 
+/*                                                                        */ 
+/*  FUNCTION                                               RELEASE        */ 
+/*                                                                        */ 
+/*    nx_wifi_tcp_socket_flush                            PORTABLE C      */
+/*                                                           6.1          */
+/*                                                                        */
+/*  DESCRIPTION                                                           */ 
+/*                                                                        */
+/*    This function sends the data a corked TCP socket holds back, the    */
+/*    socket stays corked.                                                */
+/*                                                                        */ 
+/*  INPUT                                                                 */ 
+/*                                                                        */
+/*    socket_ptr                            Pointer to TCP socket         */
+/*                                                                        */ 
+/*  OUTPUT                                                                */ 
+/*                                                                        */ 
+/*    status                                Completion status             */
+/*                                                                        */ 
+/*  CALLS                                                                 */ 
+/*                                                                        */ 
+/*    nx_wifi_socket_send_flush             Send the queued data          */
+/*                                                                        */ 
+/*  CALLED BY                                                             */ 
+/*                                                                        */ 
+/*    Application Code                                                    */ 
+/*                                                                        */ 
+/**************************************************************************/
+UINT  nx_wifi_tcp_socket_flush(NX_TCP_SOCKET *socket_ptr)
+{
+
+UINT        status = NX_SUCCESS;
+UCHAR       entry_index;
+
+
+    /* Find the entry and take the socket, this returns with the IP internal mutex held.  */
+    if (nx_wifi_socket_lock((void *)socket_ptr, &entry_index))
+        return(NX_NOT_SUCCESSFUL);
+
+    /* Release the IP internal mutex.  */
     tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
-    
-    return (NX_SUCCESS);      
+
+    /* Send what was held back.  */
+    if (nx_wifi_socket[entry_index].nx_wifi_send_packet_head)
+    {
+        status = nx_wifi_socket_send_flush(entry_index, NX_FALSE);
+        if (status)
+            nx_wifi_socket_send_drop(entry_index, NX_NULL);
+
+        /* Poll for the reply.  */
+        NX_WIFI_POLL_REQUEST();
+    }
+
+    /* Release the socket.  */
+    tx_mutex_put(&nx_wifi_socket_mutex[entry_index]);
+
+    return(status);
 }
 
 /**************************************************************************/ 
@@ -1322,35 +1942,37 @@ UINT  nx_wifi_udp_socket_unbind(NX_UDP_SOCKET *socket_ptr)
 
 UCHAR   entry_index;
 
-    /* Obtain the IP internal mutex before processing the IP event.  */
-    tx_mutex_get(&(nx_wifi_ip -> nx_ip_protection), TX_WAIT_FOREVER);
-        
-    /* Check if the entry already exist.  */
-    if (nx_wifi_socket_entry_find((void *)socket_ptr, &entry_index, 1))
-    {
-      
-        /* Release the IP internal mutex before processing the IP event.  */
-        tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+    /* Find the entry and take the socket, this returns with the IP internal mutex held.  */
+    if (nx_wifi_socket_lock((void *)socket_ptr, &entry_index))
         return(NX_NOT_SUCCESSFUL);
-    }
     
     /* Check if the socket is connected.  */
     if (nx_wifi_socket[entry_index].nx_wifi_socket_connected == 0)
     {
       
-        /* Release the IP internal mutex before processing the IP event.  */
+        /* Release the IP internal mutex and the socket.  */
         tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+        tx_mutex_put(&nx_wifi_socket_mutex[entry_index]);
         return(NX_NOT_SUCCESSFUL);
     }
+
+    /* Release the IP internal mutex while the module closes the connection.  */
+    tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
     
     /* Close connection.  */
+    NX_WIFI_MODULE_GET();
     WIFI_CloseClientConnection(entry_index);
+    NX_WIFI_MODULE_PUT();
+
+    /* Obtain the IP internal mutex to reset the entry.  */
+    tx_mutex_get(&(nx_wifi_ip -> nx_ip_protection), TX_WAIT_FOREVER);
 
     /* Reset the entry.  */
     nx_wifi_socket_reset(entry_index);
         
-    /* Release the IP internal mutex before processing the IP event.  */
+    /* Release the IP internal mutex and the socket.  */
     tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+    tx_mutex_put(&nx_wifi_socket_mutex[entry_index]);
     
     /* Return success.  */
     return(NX_SUCCESS);
@@ -1402,35 +2024,32 @@ UINT  nx_wifi_udp_socket_send(NX_UDP_SOCKET *socket_ptr, NX_PACKET *packet_ptr,
 
 UINT        status ;
 UCHAR       entry_index;
-USHORT      send_data_length;
-ULONG       packet_size;
-NX_PACKET   *current_packet;
 
-    /* Obtain the IP internal mutex before processing the IP event.  */
-    tx_mutex_get(&(nx_wifi_ip -> nx_ip_protection), TX_WAIT_FOREVER);
-    
-    /* Find an avaiable entry.  */
-    if (nx_wifi_socket_entry_find((void *)socket_ptr, &entry_index, 1))
-    {
-      
-        /* Release the IP internal mutex before processing the IP event.  */
-        tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+    /* Find the entry and take the socket, this returns with the IP internal mutex held.  */
+    if (nx_wifi_socket_lock((void *)socket_ptr, &entry_index))
         return(NX_NOT_SUCCESSFUL);
-    }
     
     /* Check if already open the connection.  */
     if (nx_wifi_socket[entry_index].nx_wifi_socket_connected == 0)
     {        
+
+        /* Release the IP internal mutex while the module opens the connection.  */
+        tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
         
         /* Swap the address.  */
         NX_CHANGE_ULONG_ENDIAN(ip_address -> nxd_ip_address.v4);
 
         /* Open connection.  */
+        NX_WIFI_MODULE_GET();
         status= WIFI_OpenClientConnection(entry_index , WIFI_UDP_PROTOCOL, "", (unsigned char* )(&(ip_address -> nxd_ip_address.v4)), port, socket_ptr -> nx_udp_socket_port) ;
+        NX_WIFI_MODULE_PUT();
 
         /* Swap the address.  */
         NX_CHANGE_ULONG_ENDIAN(ip_address -> nxd_ip_address.v4);
 
+        /* Obtain the IP internal mutex to update the entry.  */
+        tx_mutex_get(&(nx_wifi_ip -> nx_ip_protection), TX_WAIT_FOREVER);
+
         /* Check status.  */
         if(status)
         {
@@ -1438,8 +2057,9 @@ NX_PACKET   *current_packet;
             /* Reset the entry.  */
             nx_wifi_socket_reset(entry_index);
         
-            /* Release the IP internal mutex before processing the IP event.  */
+            /* Release the IP internal mutex and the socket.  */
             tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+            tx_mutex_put(&nx_wifi_socket_mutex[entry_index]);
             return(NX_NOT_SUCCESSFUL);
         }
 
@@ -1453,57 +2073,33 @@ NX_PACKET   *current_packet;
         nx_wifi_socket[entry_index].nx_wifi_udp_socket_connect_port = port;
 #endif /* NX_ENABLE_IP_PACKET_FILTER */
     }
-        
-    /* Initialize the current packet to the input packet pointer.  */
-    current_packet =  packet_ptr;
-    
-    /* Loop to send the packet.  */
-    while(current_packet)
-    {
-      
-        /* Calculate current packet size. */
-        packet_size = (ULONG)(current_packet -> nx_packet_append_ptr - current_packet -> nx_packet_prepend_ptr);
-      
-        /* Loop to send data.  */
-        status = WIFI_SendData(entry_index, (uint8_t *)current_packet-> nx_packet_prepend_ptr, packet_size, &send_data_length, WIFI_WRITE_TIMEOUT); 
 
-        /* Check status.  */
-        if ((status != WIFI_STATUS_OK) || (send_data_length != packet_size))
-        {
-          
-            /* Release the IP internal mutex before processing the IP event.  */
-            tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
-            return(NX_NOT_SUCCESSFUL);
-        }
+    /* Release the IP internal mutex while sending, other sockets carry on.  */
+    tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
 
-#ifdef NX_ENABLE_IP_PACKET_FILTER
+    /* Queue the packet and send it, the fragments of a chain share module transfers.  */
+    nx_wifi_socket_send_queue(entry_index, packet_ptr);
+    status = nx_wifi_socket_send_flush(entry_index, NX_FALSE);
 
-        /* Process packet filter.  */
-        nx_wifi_ip_packet_filter(nx_wifi_ip_address,
-                                 nx_wifi_socket[entry_index].nx_wifi_udp_socket_connect_ip,
-                                 socket_ptr -> nx_udp_socket_port,
-                                 nx_wifi_socket[entry_index].nx_wifi_udp_socket_connect_port,
-                                 NX_IP_UDP, packet_size, NX_IP_PACKET_OUT);
-#endif /* NX_ENABLE_IP_PACKET_FILTER */
-
-#ifndef NX_DISABLE_PACKET_CHAIN
-        /* We have crossed the packet boundary.  Move to the next packet
-           structure.  */
-        current_packet =  current_packet -> nx_packet_next;
-#else
+    /* Check status.  */
+    if (status)
+    {
 
-        /* End the loop.  */
-        current_packet = NX_NULL;
-#endif /* NX_DISABLE_PACKET_CHAIN */
+        /* Drop the queue, the caller keeps this packet.  */
+        nx_wifi_socket_send_drop(entry_index, packet_ptr);
+          
+        /* Release the socket.  */
+        tx_mutex_put(&nx_wifi_socket_mutex[entry_index]);
+        return(NX_NOT_SUCCESSFUL);
     }
-        
-    /* Release the packet.  */
-    nx_packet_release(packet_ptr);
     
-    /* Release the IP internal mutex before processing the IP event.  */
-    tx_mutex_put(&(nx_wifi_ip -> nx_ip_protection));
+    /* Release the socket.  */
+    tx_mutex_put(&nx_wifi_socket_mutex[entry_index]);
+
+    /* Poll for the reply.  */
+    NX_WIFI_POLL_REQUEST();
     return(NX_SUCCESS);
-} 
+}
 
 
 /**************************************************************************/ 
@@ -38,6 +38,8 @@ UINT  nx_wifi_tcp_client_socket_connect(NX_TCP_SOCKET *socket_ptr,
 UINT  nx_wifi_tcp_socket_disconnect(NX_TCP_SOCKET *socket_ptr, ULONG wait_option);
 UINT  nx_wifi_tcp_socket_send(NX_TCP_SOCKET *socket_ptr, NX_PACKET *packet_ptr, ULONG wait_option);
 UINT  nx_wifi_tcp_socket_receive(NX_TCP_SOCKET *socket_ptr, NX_PACKET **packet_ptr, ULONG wait_option);
+UINT  nx_wifi_tcp_socket_cork(NX_TCP_SOCKET *socket_ptr, UINT cork);
+UINT  nx_wifi_tcp_socket_flush(NX_TCP_SOCKET *socket_ptr);
 UINT  nx_wifi_udp_socket_bind(NX_UDP_SOCKET *socket_ptr, UINT  port, ULONG wait_option);
 UINT  nx_wifi_udp_socket_unbind(NX_UDP_SOCKET *socket_ptr);
 UINT  nx_wifi_udp_socket_send(NX_UDP_SOCKET *socket_ptr, NX_PACKET *packet_ptr, 
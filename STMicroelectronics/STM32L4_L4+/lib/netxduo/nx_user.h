@@ -21,6 +21,10 @@
 
 /* SNTP */
 #define NX_SNTP_CLIENT_MIN_SERVER_STRATUM 3
+
+/* Cache answers, by their TTL, for the lookups the Azure IoT middleware makes itself */
+#define NX_DNS_CACHE_ENABLE
+
 #define NX_SNTP_CLIENT_MESSAGE_CHECK_DISABLE
 
 /* Azure IoT Security Module */
@@ -30,6 +34,14 @@
 #define NXD_MQTT_CLOUD_ENABLE
 #define NX_ENABLE_EXTENDED_NOTIFY_SUPPORT
 
+/* Uncomment to negotiate ECDHE with AES-128-GCM instead of RSA key transport with AES-128-CBC */
+/* #define NX_AZURE_IOT_TLS_PROFILE_ECC */
+
+#ifdef NX_AZURE_IOT_TLS_PROFILE_ECC
+#define NX_SECURE_ENABLE_ECC_CIPHERSUITE
+#define NX_SECURE_ENABLE_AEAD_CIPHER
+#endif
+
 /* Override wait option as the L475/L4S5 doesn't support 0 wait time */
 #define NX_AZURE_IOT_PROVISIONING_CLIENT_CONNECT_WAIT_OPTION (40 * NX_IP_PERIODIC_RATE)
 
@@ -30,6 +30,78 @@ function(set_target_linker TARGET LINKER_SCRIPT)
     endif()
 endfunction()
 
+# Generate pnp_model.c/pnp_model.h for TARGET from a DTDL model, component interfaces are found next to the model.
+# Without Python 3 the copy checked in under generated/ next to the model is used instead.
+function(dtdl_codegen TARGET MODEL_FILE)
+    find_package(Python3 COMPONENTS Interpreter)
+
+    get_filename_component(MODEL_DIR ${MODEL_FILE} DIRECTORY)
+
+    if(NOT Python3_Interpreter_FOUND)
+        get_filename_component(MODEL_NAME ${MODEL_FILE} NAME_WE)
+        set(GENERATED_DIR ${MODEL_DIR}/generated/${MODEL_NAME})
+
+        if(NOT EXISTS ${GENERATED_DIR}/pnp_model.c)
+            message(FATAL_ERROR "Python 3 is needed to generate the device model bindings for ${MODEL_FILE}")
+        endif()
+
+        message(STATUS "Python 3 not found, using the device model bindings in ${GENERATED_DIR}")
+        target_sources(${TARGET} PRIVATE ${GENERATED_DIR}/pnp_model.c)
+        target_include_directories(${TARGET} PRIVATE ${GENERATED_DIR})
+        return()
+    endif()
+    file(GLOB MODEL_INTERFACES ${MODEL_DIR}/*.json)
+
+    set(CODEGEN_SCRIPT ${GSG_BASE_DIR}/tools/dtdl_codegen.py)
+    set(OUTPUT_DIR ${CMAKE_CURRENT_BINARY_DIR}/${TARGET}_pnp_model)
+
+    add_custom_command(
+        OUTPUT ${OUTPUT_DIR}/pnp_model.c ${OUTPUT_DIR}/pnp_model.h
+        COMMAND ${Python3_EXECUTABLE} ${CODEGEN_SCRIPT} --model ${MODEL_FILE} --output ${OUTPUT_DIR}
+        DEPENDS ${CODEGEN_SCRIPT} ${MODEL_INTERFACES}
+        COMMENT "Generating device model bindings from ${MODEL_FILE}"
+        VERBATIM)
+
+    add_custom_target(${TARGET}_dtdl_codegen
+        DEPENDS ${OUTPUT_DIR}/pnp_model.c ${OUTPUT_DIR}/pnp_model.h)
+    add_dependencies(${TARGET} ${TARGET}_dtdl_codegen)
+
+    target_sources(${TARGET} PRIVATE ${OUTPUT_DIR}/pnp_model.c)
+    target_include_directories(${TARGET} PRIVATE ${OUTPUT_DIR})
+endfunction()
+
+# Build TARGET from SOURCES to run on the host, against ThreadX and NetX Duo built with their Linux ports and the
+# nx_user.h next to the calling CMakeLists.txt. Other NetX Duo options are set before the call. Unless it is a
+# BENCHMARK the target is registered with CTest and run with ARGS.
+macro(host_test TARGET)
+    cmake_parse_arguments(HOST_TEST "BENCHMARK" "" "SOURCES;ARGS" ${ARGN})
+
+    set(THREADX_ARCH "linux")
+    set(THREADX_TOOLCHAIN "gnu")
+
+    # The ThreadX Linux port is 32 bit, and the drivers under test keep addresses in 32 bits too
+    add_compile_options(-m32)
+    add_link_options(-m32)
+
+    set(NX_USER_FILE "${CMAKE_CURRENT_SOURCE_DIR}/nx_user.h" CACHE STRING "Enable NX user configuration")
+    set(NXD_ENABLE_FILE_SERVERS OFF CACHE BOOL "Disable fileX dependency by netxduo")
+
+    add_subdirectory(${GSG_BASE_DIR}/core/lib/threadx threadx)
+    add_subdirectory(${GSG_BASE_DIR}/core/lib/netxduo netxduo)
+
+    add_executable(${TARGET} ${HOST_TEST_SOURCES})
+
+    target_link_libraries(${TARGET}
+        azrtos::threadx
+        azrtos::netxduo
+    )
+
+    if(NOT HOST_TEST_BENCHMARK)
+        enable_testing()
+        add_test(NAME ${TARGET} COMMAND ${TARGET} ${HOST_TEST_ARGS})
+    endif()
+endmacro()
+
 macro(print_all_variables)
     message(STATUS "print_all_variables------------------------------------------{")
     get_cmake_property(_variableNames VARIABLES)
@@ -0,0 +1,96 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+// Generated from gsg-2.json by tools/dtdl_codegen.py, do not edit
+
+#ifndef _PNP_MODEL_H
+#define _PNP_MODEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nx_api.h"
+#include "nx_azure_iot_json_reader.h"
+#include "nx_azure_iot_json_writer.h"
+
+#include "telemetry_deadband.h"
+#include "telemetry_writer.h"
+
+#ifndef PNP_DOUBLE_PRECISION
+#define PNP_DOUBLE_PRECISION 2
+#endif
+
+#define PNP_MODEL_ID "dtmi:azurertos:devkit:gsg;2"
+
+#define PNP_COMPONENT_DEVICE_INFORMATION "deviceInformation"
+
+// Telemetry names
+#define PNP_TELEMETRY_TEMPERATURE "temperature"
+
+// Property names
+#define PNP_PROPERTY_TELEMETRY_INTERVAL                        "telemetryInterval"
+#define PNP_PROPERTY_LED_STATE                                 "ledState"
+#define PNP_DEVICE_INFORMATION_PROPERTY_MANUFACTURER           "manufacturer"
+#define PNP_DEVICE_INFORMATION_PROPERTY_MODEL                  "model"
+#define PNP_DEVICE_INFORMATION_PROPERTY_SW_VERSION             "swVersion"
+#define PNP_DEVICE_INFORMATION_PROPERTY_OS_NAME                "osName"
+#define PNP_DEVICE_INFORMATION_PROPERTY_PROCESSOR_ARCHITECTURE "processorArchitecture"
+#define PNP_DEVICE_INFORMATION_PROPERTY_PROCESSOR_MANUFACTURER "processorManufacturer"
+#define PNP_DEVICE_INFORMATION_PROPERTY_TOTAL_STORAGE          "totalStorage"
+#define PNP_DEVICE_INFORMATION_PROPERTY_TOTAL_MEMORY           "totalMemory"
+
+// Command names
+#define PNP_COMMAND_SET_LED_STATE "setLedState"
+
+typedef enum PNP_PROPERTY_ID_ENUM
+{
+    PNP_PROPERTY_ID_TELEMETRY_INTERVAL,
+    PNP_PROPERTY_ID_LED_STATE,
+    PNP_PROPERTY_ID_DEVICE_INFORMATION_MANUFACTURER,
+    PNP_PROPERTY_ID_DEVICE_INFORMATION_MODEL,
+    PNP_PROPERTY_ID_DEVICE_INFORMATION_SW_VERSION,
+    PNP_PROPERTY_ID_DEVICE_INFORMATION_OS_NAME,
+    PNP_PROPERTY_ID_DEVICE_INFORMATION_PROCESSOR_ARCHITECTURE,
+    PNP_PROPERTY_ID_DEVICE_INFORMATION_PROCESSOR_MANUFACTURER,
+    PNP_PROPERTY_ID_DEVICE_INFORMATION_TOTAL_STORAGE,
+    PNP_PROPERTY_ID_DEVICE_INFORMATION_TOTAL_MEMORY,
+    PNP_PROPERTY_ID_UNKNOWN
+} PNP_PROPERTY_ID;
+
+typedef enum PNP_COMMAND_ID_ENUM
+{
+    PNP_COMMAND_ID_SET_LED_STATE,
+    PNP_COMMAND_ID_UNKNOWN
+} PNP_COMMAND_ID;
+
+// Constant time routing of incoming names, component is NX_NULL or empty for the root interface
+PNP_PROPERTY_ID pnp_property_lookup(const UCHAR* component, UINT component_length, const UCHAR* name, UINT name_length);
+PNP_COMMAND_ID pnp_command_lookup(const UCHAR* method_name, UINT method_name_length);
+
+// Telemetry serializers
+UINT pnp_telemetry_temperature_append(TELEMETRY_WRITER* writer, double value);
+
+// Report by exception, write the value only when the deadband lets it through
+UINT pnp_telemetry_temperature_append_filtered(TELEMETRY_WRITER* writer, TELEMETRY_DEADBAND* deadband, double value);
+
+// Property serializers
+UINT pnp_property_telemetry_interval_append(NX_AZURE_IOT_JSON_WRITER* json_writer, int32_t value);
+UINT pnp_property_led_state_append(NX_AZURE_IOT_JSON_WRITER* json_writer, bool value);
+UINT pnp_device_information_property_manufacturer_append(NX_AZURE_IOT_JSON_WRITER* json_writer, const CHAR* value);
+UINT pnp_device_information_property_model_append(NX_AZURE_IOT_JSON_WRITER* json_writer, const CHAR* value);
+UINT pnp_device_information_property_sw_version_append(NX_AZURE_IOT_JSON_WRITER* json_writer, const CHAR* value);
+UINT pnp_device_information_property_os_name_append(NX_AZURE_IOT_JSON_WRITER* json_writer, const CHAR* value);
+UINT pnp_device_information_property_processor_architecture_append(
+    NX_AZURE_IOT_JSON_WRITER* json_writer, const CHAR* value);
+UINT pnp_device_information_property_processor_manufacturer_append(
+    NX_AZURE_IOT_JSON_WRITER* json_writer, const CHAR* value);
+UINT pnp_device_information_property_total_storage_append(NX_AZURE_IOT_JSON_WRITER* json_writer, double value);
+UINT pnp_device_information_property_total_memory_append(NX_AZURE_IOT_JSON_WRITER* json_writer, double value);
+
+// Writable property deserializers, json_reader must be positioned on the value
+UINT pnp_property_telemetry_interval_read(NX_AZURE_IOT_JSON_READER* json_reader, int32_t* value);
+
+// Command request deserializers
+UINT pnp_command_set_led_state_parse(const UCHAR* payload, UINT payload_length, bool* state);
+
+#endif // _PNP_MODEL_H
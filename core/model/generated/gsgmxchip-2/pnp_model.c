@@ -0,0 +1,470 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+// Generated from gsgmxchip-2.json by tools/dtdl_codegen.py, do not edit
+
+#include "pnp_model.h"
+
+#include <string.h>
+
+#define PNP_SLOT_EMPTY 0xFF
+#define PNP_FNV_PRIME  16777619u
+
+#define PNP_PROPERTY_HASH_SEED 0x00000011u
+#define PNP_PROPERTY_HASH_MASK 0x1Fu
+#define PNP_COMMAND_HASH_SEED  0x00000001u
+#define PNP_COMMAND_HASH_MASK  0x3u
+
+typedef struct PNP_PROPERTY_KEY_STRUCT
+{
+    const CHAR* component;
+    UINT component_length;
+    const CHAR* name;
+    UINT name_length;
+} PNP_PROPERTY_KEY;
+
+typedef struct PNP_COMMAND_KEY_STRUCT
+{
+    const CHAR* method_name;
+    UINT method_name_length;
+} PNP_COMMAND_KEY;
+
+// Indexed by PNP_PROPERTY_ID
+static const PNP_PROPERTY_KEY pnp_property_keys[] = {
+    {NX_NULL, 0, "telemetryInterval", 17},
+    {NX_NULL, 0, "ledState", 8},
+    {"deviceInformation", 17, "manufacturer", 12},
+    {"deviceInformation", 17, "model", 5},
+    {"deviceInformation", 17, "swVersion", 9},
+    {"deviceInformation", 17, "osName", 6},
+    {"deviceInformation", 17, "processorArchitecture", 21},
+    {"deviceInformation", 17, "processorManufacturer", 21},
+    {"deviceInformation", 17, "totalStorage", 12},
+    {"deviceInformation", 17, "totalMemory", 11},
+};
+
+// Indexed by PNP_COMMAND_ID
+static const PNP_COMMAND_KEY pnp_command_keys[] = {
+    {"setLedState", 11},
+    {"setDisplayText", 14},
+};
+
+static const UCHAR pnp_property_slots[] = {
+    0xFF, 0x07, 0xFF, 0x08, 0xFF, 0xFF, 0x05, 0xFF, 0x03, 0xFF, 0x01, 0x02, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x09, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0x04, 0xFF, 0x06, 0xFF, 0xFF, 0xFF,
+};
+
+static const UCHAR pnp_command_slots[] = {
+    0xFF, 0x00, 0xFF, 0x01,
+};
+
+// 32 bit FNV-1a, the generator picks the seeds so every name lands in its own slot
+static uint32_t pnp_hash(uint32_t hash, const UCHAR* data, UINT length)
+{
+    while (length--)
+    {
+        hash = (hash ^ *data++) * PNP_FNV_PRIME;
+    }
+
+    return hash;
+}
+
+// Multiplication only carries upwards, fold the high bits in so the seed reaches the slot index
+static UINT pnp_slot(uint32_t hash, uint32_t mask)
+{
+    return (hash ^ (hash >> 16)) & mask;
+}
+
+PNP_PROPERTY_ID pnp_property_lookup(const UCHAR* component, UINT component_length, const UCHAR* name, UINT name_length)
+{
+    const PNP_PROPERTY_KEY* key;
+    uint32_t hash = PNP_PROPERTY_HASH_SEED;
+    UCHAR slot;
+
+    if (component == NX_NULL)
+    {
+        component_length = 0;
+    }
+
+    if (component_length > 0)
+    {
+        hash = pnp_hash(hash, component, component_length);
+        hash = pnp_hash(hash, (const UCHAR*)"/", 1);
+    }
+
+    hash = pnp_hash(hash, name, name_length);
+    slot = pnp_property_slots[pnp_slot(hash, PNP_PROPERTY_HASH_MASK)];
+    if (slot == PNP_SLOT_EMPTY)
+    {
+        return PNP_PROPERTY_ID_UNKNOWN;
+    }
+
+    key = &pnp_property_keys[slot];
+    if (key->component_length != component_length || key->name_length != name_length ||
+        memcmp(key->component, component, component_length) != 0 ||
+        memcmp(key->name, name, name_length) != 0)
+    {
+        return PNP_PROPERTY_ID_UNKNOWN;
+    }
+
+    return (PNP_PROPERTY_ID)slot;
+}
+
+PNP_COMMAND_ID pnp_command_lookup(const UCHAR* method_name, UINT method_name_length)
+{
+    const PNP_COMMAND_KEY* key;
+    uint32_t hash = pnp_hash(PNP_COMMAND_HASH_SEED, method_name, method_name_length);
+    UCHAR slot    = pnp_command_slots[pnp_slot(hash, PNP_COMMAND_HASH_MASK)];
+
+    if (slot == PNP_SLOT_EMPTY)
+    {
+        return PNP_COMMAND_ID_UNKNOWN;
+    }
+
+    key = &pnp_command_keys[slot];
+    if (key->method_name_length != method_name_length ||
+        memcmp(key->method_name, method_name, method_name_length) != 0)
+    {
+        return PNP_COMMAND_ID_UNKNOWN;
+    }
+
+    return (PNP_COMMAND_ID)slot;
+}
+
+UINT pnp_telemetry_temperature_append(TELEMETRY_WRITER* writer, double value)
+{
+    return telemetry_writer_append_property_with_double_value(
+        writer, (UCHAR*)PNP_TELEMETRY_TEMPERATURE, sizeof(PNP_TELEMETRY_TEMPERATURE) - 1, value, PNP_DOUBLE_PRECISION);
+}
+
+UINT pnp_telemetry_humidity_append(TELEMETRY_WRITER* writer, double value)
+{
+    return telemetry_writer_append_property_with_double_value(
+        writer, (UCHAR*)PNP_TELEMETRY_HUMIDITY, sizeof(PNP_TELEMETRY_HUMIDITY) - 1, value, PNP_DOUBLE_PRECISION);
+}
+
+UINT pnp_telemetry_pressure_append(TELEMETRY_WRITER* writer, double value)
+{
+    return telemetry_writer_append_property_with_double_value(
+        writer, (UCHAR*)PNP_TELEMETRY_PRESSURE, sizeof(PNP_TELEMETRY_PRESSURE) - 1, value, PNP_DOUBLE_PRECISION);
+}
+
+UINT pnp_telemetry_magnetometer_x_append(TELEMETRY_WRITER* writer, double value)
+{
+    return telemetry_writer_append_property_with_double_value(writer,
+        (UCHAR*)PNP_TELEMETRY_MAGNETOMETER_X,
+        sizeof(PNP_TELEMETRY_MAGNETOMETER_X) - 1,
+        value,
+        PNP_DOUBLE_PRECISION);
+}
+
+UINT pnp_telemetry_magnetometer_y_append(TELEMETRY_WRITER* writer, double value)
+{
+    return telemetry_writer_append_property_with_double_value(writer,
+        (UCHAR*)PNP_TELEMETRY_MAGNETOMETER_Y,
+        sizeof(PNP_TELEMETRY_MAGNETOMETER_Y) - 1,
+        value,
+        PNP_DOUBLE_PRECISION);
+}
+
+UINT pnp_telemetry_magnetometer_z_append(TELEMETRY_WRITER* writer, double value)
+{
+    return telemetry_writer_append_property_with_double_value(writer,
+        (UCHAR*)PNP_TELEMETRY_MAGNETOMETER_Z,
+        sizeof(PNP_TELEMETRY_MAGNETOMETER_Z) - 1,
+        value,
+        PNP_DOUBLE_PRECISION);
+}
+
+UINT pnp_telemetry_accelerometer_x_append(TELEMETRY_WRITER* writer, double value)
+{
+    return telemetry_writer_append_property_with_double_value(writer,
+        (UCHAR*)PNP_TELEMETRY_ACCELEROMETER_X,
+        sizeof(PNP_TELEMETRY_ACCELEROMETER_X) - 1,
+        value,
+        PNP_DOUBLE_PRECISION);
+}
+
+UINT pnp_telemetry_accelerometer_y_append(TELEMETRY_WRITER* writer, double value)
+{
+    return telemetry_writer_append_property_with_double_value(writer,
+        (UCHAR*)PNP_TELEMETRY_ACCELEROMETER_Y,
+        sizeof(PNP_TELEMETRY_ACCELEROMETER_Y) - 1,
+        value,
+        PNP_DOUBLE_PRECISION);
+}
+
+UINT pnp_telemetry_accelerometer_z_append(TELEMETRY_WRITER* writer, double value)
+{
+    return telemetry_writer_append_property_with_double_value(writer,
+        (UCHAR*)PNP_TELEMETRY_ACCELEROMETER_Z,
+        sizeof(PNP_TELEMETRY_ACCELEROMETER_Z) - 1,
+        value,
+        PNP_DOUBLE_PRECISION);
+}
+
+UINT pnp_telemetry_gyroscope_x_append(TELEMETRY_WRITER* writer, double value)
+{
+    return telemetry_writer_append_property_with_double_value(
+        writer, (UCHAR*)PNP_TELEMETRY_GYROSCOPE_X, sizeof(PNP_TELEMETRY_GYROSCOPE_X) - 1, value, PNP_DOUBLE_PRECISION);
+}
+
+UINT pnp_telemetry_gyroscope_y_append(TELEMETRY_WRITER* writer, double value)
+{
+    return telemetry_writer_append_property_with_double_value(
+        writer, (UCHAR*)PNP_TELEMETRY_GYROSCOPE_Y, sizeof(PNP_TELEMETRY_GYROSCOPE_Y) - 1, value, PNP_DOUBLE_PRECISION);
+}
+
+UINT pnp_telemetry_gyroscope_z_append(TELEMETRY_WRITER* writer, double value)
+{
+    return telemetry_writer_append_property_with_double_value(
+        writer, (UCHAR*)PNP_TELEMETRY_GYROSCOPE_Z, sizeof(PNP_TELEMETRY_GYROSCOPE_Z) - 1, value, PNP_DOUBLE_PRECISION);
+}
+
+UINT pnp_telemetry_temperature_append_filtered(TELEMETRY_WRITER* writer, TELEMETRY_DEADBAND* deadband, double value)
+{
+    if (!telemetry_writer_deadband_check(writer, deadband, value))
+    {
+        return NX_AZURE_IOT_SUCCESS;
+    }
+
+    return pnp_telemetry_temperature_append(writer, value);
+}
+
+UINT pnp_telemetry_humidity_append_filtered(TELEMETRY_WRITER* writer, TELEMETRY_DEADBAND* deadband, double value)
+{
+    if (!telemetry_writer_deadband_check(writer, deadband, value))
+    {
+        return NX_AZURE_IOT_SUCCESS;
+    }
+
+    return pnp_telemetry_humidity_append(writer, value);
+}
+
+UINT pnp_telemetry_pressure_append_filtered(TELEMETRY_WRITER* writer, TELEMETRY_DEADBAND* deadband, double value)
+{
+    if (!telemetry_writer_deadband_check(writer, deadband, value))
+    {
+        return NX_AZURE_IOT_SUCCESS;
+    }
+
+    return pnp_telemetry_pressure_append(writer, value);
+}
+
+UINT pnp_telemetry_magnetometer_x_append_filtered(TELEMETRY_WRITER* writer, TELEMETRY_DEADBAND* deadband, double value)
+{
+    if (!telemetry_writer_deadband_check(writer, deadband, value))
+    {
+        return NX_AZURE_IOT_SUCCESS;
+    }
+
+    return pnp_telemetry_magnetometer_x_append(writer, value);
+}
+
+UINT pnp_telemetry_magnetometer_y_append_filtered(TELEMETRY_WRITER* writer, TELEMETRY_DEADBAND* deadband, double value)
+{
+    if (!telemetry_writer_deadband_check(writer, deadband, value))
+    {
+        return NX_AZURE_IOT_SUCCESS;
+    }
+
+    return pnp_telemetry_magnetometer_y_append(writer, value);
+}
+
+UINT pnp_telemetry_magnetometer_z_append_filtered(TELEMETRY_WRITER* writer, TELEMETRY_DEADBAND* deadband, double value)
+{
+    if (!telemetry_writer_deadband_check(writer, deadband, value))
+    {
+        return NX_AZURE_IOT_SUCCESS;
+    }
+
+    return pnp_telemetry_magnetometer_z_append(writer, value);
+}
+
+UINT pnp_telemetry_accelerometer_x_append_filtered(TELEMETRY_WRITER* writer, TELEMETRY_DEADBAND* deadband, double value)
+{
+    if (!telemetry_writer_deadband_check(writer, deadband, value))
+    {
+        return NX_AZURE_IOT_SUCCESS;
+    }
+
+    return pnp_telemetry_accelerometer_x_append(writer, value);
+}
+
+UINT pnp_telemetry_accelerometer_y_append_filtered(TELEMETRY_WRITER* writer, TELEMETRY_DEADBAND* deadband, double value)
+{
+    if (!telemetry_writer_deadband_check(writer, deadband, value))
+    {
+        return NX_AZURE_IOT_SUCCESS;
+    }
+
+    return pnp_telemetry_accelerometer_y_append(writer, value);
+}
+
+UINT pnp_telemetry_accelerometer_z_append_filtered(TELEMETRY_WRITER* writer, TELEMETRY_DEADBAND* deadband, double value)
+{
+    if (!telemetry_writer_deadband_check(writer, deadband, value))
+    {
+        return NX_AZURE_IOT_SUCCESS;
+    }
+
+    return pnp_telemetry_accelerometer_z_append(writer, value);
+}
+
+UINT pnp_telemetry_gyroscope_x_append_filtered(TELEMETRY_WRITER* writer, TELEMETRY_DEADBAND* deadband, double value)
+{
+    if (!telemetry_writer_deadband_check(writer, deadband, value))
+    {
+        return NX_AZURE_IOT_SUCCESS;
+    }
+
+    return pnp_telemetry_gyroscope_x_append(writer, value);
+}
+
+UINT pnp_telemetry_gyroscope_y_append_filtered(TELEMETRY_WRITER* writer, TELEMETRY_DEADBAND* deadband, double value)
+{
+    if (!telemetry_writer_deadband_check(writer, deadband, value))
+    {
+        return NX_AZURE_IOT_SUCCESS;
+    }
+
+    return pnp_telemetry_gyroscope_y_append(writer, value);
+}
+
+UINT pnp_telemetry_gyroscope_z_append_filtered(TELEMETRY_WRITER* writer, TELEMETRY_DEADBAND* deadband, double value)
+{
+    if (!telemetry_writer_deadband_check(writer, deadband, value))
+    {
+        return NX_AZURE_IOT_SUCCESS;
+    }
+
+    return pnp_telemetry_gyroscope_z_append(writer, value);
+}
+
+UINT pnp_property_telemetry_interval_append(NX_AZURE_IOT_JSON_WRITER* json_writer, int32_t value)
+{
+    return nx_azure_iot_json_writer_append_property_with_int32_value(
+        json_writer, (UCHAR*)PNP_PROPERTY_TELEMETRY_INTERVAL, sizeof(PNP_PROPERTY_TELEMETRY_INTERVAL) - 1, value);
+}
+
+UINT pnp_property_led_state_append(NX_AZURE_IOT_JSON_WRITER* json_writer, bool value)
+{
+    return nx_azure_iot_json_writer_append_property_with_bool_value(
+        json_writer, (UCHAR*)PNP_PROPERTY_LED_STATE, sizeof(PNP_PROPERTY_LED_STATE) - 1, value);
+}
+
+UINT pnp_device_information_property_manufacturer_append(NX_AZURE_IOT_JSON_WRITER* json_writer, const CHAR* value)
+{
+    return nx_azure_iot_json_writer_append_property_with_string_value(json_writer,
+        (UCHAR*)PNP_DEVICE_INFORMATION_PROPERTY_MANUFACTURER,
+        sizeof(PNP_DEVICE_INFORMATION_PROPERTY_MANUFACTURER) - 1,
+        (const UCHAR*)value,
+        strlen(value));
+}
+
+UINT pnp_device_information_property_model_append(NX_AZURE_IOT_JSON_WRITER* json_writer, const CHAR* value)
+{
+    return nx_azure_iot_json_writer_append_property_with_string_value(json_writer,
+        (UCHAR*)PNP_DEVICE_INFORMATION_PROPERTY_MODEL,
+        sizeof(PNP_DEVICE_INFORMATION_PROPERTY_MODEL) - 1,
+        (const UCHAR*)value,
+        strlen(value));
+}
+
+UINT pnp_device_information_property_sw_version_append(NX_AZURE_IOT_JSON_WRITER* json_writer, const CHAR* value)
+{
+    return nx_azure_iot_json_writer_append_property_with_string_value(json_writer,
+        (UCHAR*)PNP_DEVICE_INFORMATION_PROPERTY_SW_VERSION,
+        sizeof(PNP_DEVICE_INFORMATION_PROPERTY_SW_VERSION) - 1,
+        (const UCHAR*)value,
+        strlen(value));
+}
+
+UINT pnp_device_information_property_os_name_append(NX_AZURE_IOT_JSON_WRITER* json_writer, const CHAR* value)
+{
+    return nx_azure_iot_json_writer_append_property_with_string_value(json_writer,
+        (UCHAR*)PNP_DEVICE_INFORMATION_PROPERTY_OS_NAME,
+        sizeof(PNP_DEVICE_INFORMATION_PROPERTY_OS_NAME) - 1,
+        (const UCHAR*)value,
+        strlen(value));
+}
+
+UINT pnp_device_information_property_processor_architecture_append(
+    NX_AZURE_IOT_JSON_WRITER* json_writer, const CHAR* value)
+{
+    return nx_azure_iot_json_writer_append_property_with_string_value(json_writer,
+        (UCHAR*)PNP_DEVICE_INFORMATION_PROPERTY_PROCESSOR_ARCHITECTURE,
+        sizeof(PNP_DEVICE_INFORMATION_PROPERTY_PROCESSOR_ARCHITECTURE) - 1,
+        (const UCHAR*)value,
+        strlen(value));
+}
+
+UINT pnp_device_information_property_processor_manufacturer_append(
+    NX_AZURE_IOT_JSON_WRITER* json_writer, const CHAR* value)
+{
+    return nx_azure_iot_json_writer_append_property_with_string_value(json_writer,
+        (UCHAR*)PNP_DEVICE_INFORMATION_PROPERTY_PROCESSOR_MANUFACTURER,
+        sizeof(PNP_DEVICE_INFORMATION_PROPERTY_PROCESSOR_MANUFACTURER) - 1,
+        (const UCHAR*)value,
+        strlen(value));
+}
+
+UINT pnp_device_information_property_total_storage_append(NX_AZURE_IOT_JSON_WRITER* json_writer, double value)
+{
+    return nx_azure_iot_json_writer_append_property_with_double_value(json_writer,
+        (UCHAR*)PNP_DEVICE_INFORMATION_PROPERTY_TOTAL_STORAGE,
+        sizeof(PNP_DEVICE_INFORMATION_PROPERTY_TOTAL_STORAGE) - 1,
+        value,
+        PNP_DOUBLE_PRECISION);
+}
+
+UINT pnp_device_information_property_total_memory_append(NX_AZURE_IOT_JSON_WRITER* json_writer, double value)
+{
+    return nx_azure_iot_json_writer_append_property_with_double_value(json_writer,
+        (UCHAR*)PNP_DEVICE_INFORMATION_PROPERTY_TOTAL_MEMORY,
+        sizeof(PNP_DEVICE_INFORMATION_PROPERTY_TOTAL_MEMORY) - 1,
+        value,
+        PNP_DOUBLE_PRECISION);
+}
+
+UINT pnp_property_telemetry_interval_read(NX_AZURE_IOT_JSON_READER* json_reader, int32_t* value)
+{
+    return nx_azure_iot_json_reader_token_int32_get(json_reader, value);
+}
+
+UINT pnp_command_set_led_state_parse(const UCHAR* payload, UINT payload_length, bool* state)
+{
+    NX_AZURE_IOT_JSON_READER reader;
+    NX_AZURE_IOT_JSON_READER* json_reader = &reader;
+    UINT bool_value;
+    UINT status;
+
+    if ((status = nx_azure_iot_json_reader_with_buffer_init(json_reader, payload, payload_length)) ||
+        (status = nx_azure_iot_json_reader_next_token(json_reader)))
+    {
+        return status;
+    }
+
+    if ((status = nx_azure_iot_json_reader_token_bool_get(json_reader, &bool_value)) == NX_AZURE_IOT_SUCCESS)
+    {
+        *state = bool_value;
+    }
+
+    return status;
+}
+
+UINT pnp_command_set_display_text_parse(
+    const UCHAR* payload, UINT payload_length, CHAR* text, UINT text_size, UINT* text_length)
+{
+    NX_AZURE_IOT_JSON_READER reader;
+    NX_AZURE_IOT_JSON_READER* json_reader = &reader;
+    UINT status;
+
+    if ((status = nx_azure_iot_json_reader_with_buffer_init(json_reader, payload, payload_length)) ||
+        (status = nx_azure_iot_json_reader_next_token(json_reader)))
+    {
+        return status;
+    }
+
+    return nx_azure_iot_json_reader_token_string_get(json_reader, (UCHAR*)text, text_size, text_length);
+}
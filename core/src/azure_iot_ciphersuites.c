@@ -19,6 +19,12 @@
 #error "X509 must be enabled."
 #endif /* NX_SECURE_DISABLE_X509 */
 
+#ifdef NX_AZURE_IOT_TLS_PROFILE_ECC
+#if !defined(NX_SECURE_ENABLE_ECC_CIPHERSUITE) || !defined(NX_SECURE_ENABLE_AEAD_CIPHER)
+#error "The ECC profile needs NX_SECURE_ENABLE_ECC_CIPHERSUITE and NX_SECURE_ENABLE_AEAD_CIPHER."
+#endif
+#endif /* NX_AZURE_IOT_TLS_PROFILE_ECC */
+
 /* Define supported crypto method. */
 extern NX_CRYPTO_METHOD crypto_method_hmac;
 extern NX_CRYPTO_METHOD crypto_method_hmac_sha256;
@@ -27,7 +33,7 @@ extern NX_CRYPTO_METHOD crypto_method_sha256;
 extern NX_CRYPTO_METHOD crypto_method_aes_cbc_128;
 extern NX_CRYPTO_METHOD crypto_method_rsa;
 
-const NX_CRYPTO_METHOD *_nx_azure_iot_tls_supported_crypto[] =
+const NX_CRYPTO_METHOD *_nx_azure_iot_tls_rsa_crypto[] =
 {
     &crypto_method_hmac,
     &crypto_method_hmac_sha256,
@@ -37,23 +43,78 @@ const NX_CRYPTO_METHOD *_nx_azure_iot_tls_supported_crypto[] =
     &crypto_method_rsa,
 };
 
-const UINT _nx_azure_iot_tls_supported_crypto_size = sizeof(_nx_azure_iot_tls_supported_crypto) / sizeof(NX_CRYPTO_METHOD*);
+const UINT _nx_azure_iot_tls_rsa_crypto_size = sizeof(_nx_azure_iot_tls_rsa_crypto) / sizeof(NX_CRYPTO_METHOD*);
 
 
 /* Define supported TLS ciphersuites. */
 extern const NX_CRYPTO_CIPHERSUITE nx_crypto_tls_rsa_with_aes_128_cbc_sha256;
 extern const NX_CRYPTO_CIPHERSUITE nx_crypto_x509_rsa_sha_256;
 
-const NX_CRYPTO_CIPHERSUITE *_nx_azure_iot_tls_ciphersuite_map[] =
+const NX_CRYPTO_CIPHERSUITE *_nx_azure_iot_tls_rsa_ciphersuite_map[] =
+{
+
+    /* TLS ciphersuites. */
+    &nx_crypto_tls_rsa_with_aes_128_cbc_sha256,
+
+    /* X.509 ciphersuites. */
+    &nx_crypto_x509_rsa_sha_256,
+};
+
+const UINT _nx_azure_iot_tls_rsa_ciphersuite_map_size = sizeof(_nx_azure_iot_tls_rsa_ciphersuite_map) / sizeof(NX_CRYPTO_CIPHERSUITE*);
+
+#if defined(NX_SECURE_ENABLE_ECC_CIPHERSUITE) && defined(NX_SECURE_ENABLE_AEAD_CIPHER)
+
+/* ECDHE key agreement and AES-GCM records, RSA stays for the certificate chains the hub and DPS present. */
+extern NX_CRYPTO_METHOD crypto_method_aes_128_gcm_16;
+extern NX_CRYPTO_METHOD crypto_method_ecdhe;
+extern NX_CRYPTO_METHOD crypto_method_ecdsa;
+
+const NX_CRYPTO_METHOD *_nx_azure_iot_tls_ecc_crypto[] =
+{
+    &crypto_method_hmac,
+    &crypto_method_hmac_sha256,
+    &crypto_method_tls_prf_sha256,
+    &crypto_method_sha256,
+    &crypto_method_aes_128_gcm_16,
+    &crypto_method_aes_cbc_128,
+    &crypto_method_ecdhe,
+    &crypto_method_ecdsa,
+    &crypto_method_rsa,
+};
+
+const UINT _nx_azure_iot_tls_ecc_crypto_size = sizeof(_nx_azure_iot_tls_ecc_crypto) / sizeof(NX_CRYPTO_METHOD*);
+
+extern const NX_CRYPTO_CIPHERSUITE nx_crypto_tls_ecdhe_ecdsa_with_aes_128_gcm_sha256;
+extern const NX_CRYPTO_CIPHERSUITE nx_crypto_tls_ecdhe_rsa_with_aes_128_gcm_sha256;
+extern const NX_CRYPTO_CIPHERSUITE nx_crypto_x509_ecdsa_sha_256;
+
+/* In order of preference, the RSA key transport suite is only there for a server that offers nothing better. */
+const NX_CRYPTO_CIPHERSUITE *_nx_azure_iot_tls_ecc_ciphersuite_map[] =
 {
 
     /* TLS ciphersuites. */
+    &nx_crypto_tls_ecdhe_ecdsa_with_aes_128_gcm_sha256,
+    &nx_crypto_tls_ecdhe_rsa_with_aes_128_gcm_sha256,
     &nx_crypto_tls_rsa_with_aes_128_cbc_sha256,
 
     /* X.509 ciphersuites. */
+    &nx_crypto_x509_ecdsa_sha_256,
     &nx_crypto_x509_rsa_sha_256,
 };
 
-const UINT _nx_azure_iot_tls_ciphersuite_map_size = sizeof(_nx_azure_iot_tls_ciphersuite_map) / sizeof(NX_CRYPTO_CIPHERSUITE*);
+const UINT _nx_azure_iot_tls_ecc_ciphersuite_map_size = sizeof(_nx_azure_iot_tls_ecc_ciphersuite_map) / sizeof(NX_CRYPTO_CIPHERSUITE*);
 
+#endif /* NX_SECURE_ENABLE_ECC_CIPHERSUITE && NX_SECURE_ENABLE_AEAD_CIPHER */
 
+/* The profile the clients are built with. */
+#ifdef NX_AZURE_IOT_TLS_PROFILE_ECC
+const NX_CRYPTO_METHOD **const _nx_azure_iot_tls_supported_crypto = _nx_azure_iot_tls_ecc_crypto;
+const UINT _nx_azure_iot_tls_supported_crypto_size = sizeof(_nx_azure_iot_tls_ecc_crypto) / sizeof(NX_CRYPTO_METHOD*);
+const NX_CRYPTO_CIPHERSUITE **const _nx_azure_iot_tls_ciphersuite_map = _nx_azure_iot_tls_ecc_ciphersuite_map;
+const UINT _nx_azure_iot_tls_ciphersuite_map_size = sizeof(_nx_azure_iot_tls_ecc_ciphersuite_map) / sizeof(NX_CRYPTO_CIPHERSUITE*);
+#else
+const NX_CRYPTO_METHOD **const _nx_azure_iot_tls_supported_crypto = _nx_azure_iot_tls_rsa_crypto;
+const UINT _nx_azure_iot_tls_supported_crypto_size = sizeof(_nx_azure_iot_tls_rsa_crypto) / sizeof(NX_CRYPTO_METHOD*);
+const NX_CRYPTO_CIPHERSUITE **const _nx_azure_iot_tls_ciphersuite_map = _nx_azure_iot_tls_rsa_ciphersuite_map;
+const UINT _nx_azure_iot_tls_ciphersuite_map_size = sizeof(_nx_azure_iot_tls_rsa_ciphersuite_map) / sizeof(NX_CRYPTO_CIPHERSUITE*);
+#endif /* NX_AZURE_IOT_TLS_PROFILE_ECC */
@@ -16,11 +16,35 @@
 
 /* Users can use these ciphersuites as sample, and also can build their own ciphersuite
    referring to nx_secure/nx_crypto_generic_ciphersuites.c.  */
-extern const NX_CRYPTO_METHOD *_nx_azure_iot_tls_supported_crypto[];
+
+/* Ciphersuite profile the clients negotiate with. By default this is RSA key transport with AES-128-CBC and
+   HMAC-SHA256. Defining NX_AZURE_IOT_TLS_PROFILE_ECC in nx_user.h switches to ECDHE-ECDSA/ECDHE-RSA with
+   AES-128-GCM, which also needs NX_SECURE_ENABLE_ECC_CIPHERSUITE and NX_SECURE_ENABLE_AEAD_CIPHER.  */
+extern const NX_CRYPTO_METHOD **const _nx_azure_iot_tls_supported_crypto;
 extern const UINT _nx_azure_iot_tls_supported_crypto_size;
-extern const NX_CRYPTO_CIPHERSUITE *_nx_azure_iot_tls_ciphersuite_map[];
+extern const NX_CRYPTO_CIPHERSUITE **const _nx_azure_iot_tls_ciphersuite_map;
 extern const UINT _nx_azure_iot_tls_ciphersuite_map_size;
 
+/* Each profile on its own.  */
+extern const NX_CRYPTO_METHOD *_nx_azure_iot_tls_rsa_crypto[];
+extern const UINT _nx_azure_iot_tls_rsa_crypto_size;
+extern const NX_CRYPTO_CIPHERSUITE *_nx_azure_iot_tls_rsa_ciphersuite_map[];
+extern const UINT _nx_azure_iot_tls_rsa_ciphersuite_map_size;
+
+#if defined(NX_SECURE_ENABLE_ECC_CIPHERSUITE) && defined(NX_SECURE_ENABLE_AEAD_CIPHER)
+extern const NX_CRYPTO_METHOD *_nx_azure_iot_tls_ecc_crypto[];
+extern const UINT _nx_azure_iot_tls_ecc_crypto_size;
+extern const NX_CRYPTO_CIPHERSUITE *_nx_azure_iot_tls_ecc_ciphersuite_map[];
+extern const UINT _nx_azure_iot_tls_ecc_ciphersuite_map_size;
+#endif /* NX_SECURE_ENABLE_ECC_CIPHERSUITE && NX_SECURE_ENABLE_AEAD_CIPHER */
+
+#ifdef NX_SECURE_ENABLE_ECC_CIPHERSUITE
+/* Curves offered for ECDHE and accepted in ECDSA certificates, from nx_crypto_generic_ciphersuites.c.  */
+extern const USHORT nx_crypto_ecc_supported_groups[];
+extern const NX_CRYPTO_METHOD *nx_crypto_ecc_curves[];
+extern const UINT nx_crypto_ecc_supported_groups_size;
+#endif /* NX_SECURE_ENABLE_ECC_CIPHERSUITE */
+
 /* Define the metadata size for _nx_azure_iot_tls_ciphers.  */
 #ifndef NX_AZURE_IOT_TLS_METADATA_BUFFER_SIZE
 #define NX_AZURE_IOT_TLS_METADATA_BUFFER_SIZE                     (9 * 1024)
@@ -9,6 +9,7 @@
 #include "azure_iot_dps_mqtt.h"
 
 #include "azure_iot_mqtt/sas_token.h"
+#include "dns_resolver.h"
 
 #include "json_utils.h"
 
@@ -272,11 +273,10 @@ UINT azure_iot_dps_register(AZURE_IOT_MQTT* azure_iot_mqtt, UINT wait)
     }
 
     // Resolve the MQTT server IP address
-    status = nxd_dns_host_by_name_get(azure_iot_mqtt->nx_dns,
-        (UCHAR*)AZURE_IOT_DPS_ENDPOINT,
-        &server_ip,
-        5 * NX_IP_PERIODIC_RATE,
-        NX_IP_VERSION_V4);
+    server_ip.nxd_ip_version = NX_IP_VERSION_V4;
+
+    status = dns_resolver_host_by_name_get(
+        AZURE_IOT_DPS_ENDPOINT, &server_ip.nxd_ip_address.v4, 5 * NX_IP_PERIODIC_RATE);
     if (status != NX_SUCCESS)
     {
         printf("Error: Unable to resolve DNS for DPS MQTT Server %s (0x%04x)\r\n",
@@ -289,6 +289,8 @@ UINT azure_iot_dps_register(AZURE_IOT_MQTT* azure_iot_mqtt, UINT wait)
     // Stash the hostname so we can verify the cert at connect
     azure_iot_x509_hostname = AZURE_IOT_DPS_ENDPOINT;
 
+    tls_handshake_stats_start(&azure_iot_mqtt->tls_stats);
+
     status = nxd_mqtt_client_secure_connect(&azure_iot_mqtt->nxd_mqtt_client,
         &server_ip,
         NXD_MQTT_TLS_PORT,
@@ -296,6 +298,7 @@ UINT azure_iot_dps_register(AZURE_IOT_MQTT* azure_iot_mqtt, UINT wait)
         MQTT_KEEP_ALIVE,
         NX_TRUE,
         MQTT_TIMEOUT);
+    tls_handshake_stats_update(&azure_iot_mqtt->tls_stats, status);
     if (status != NXD_MQTT_SUCCESS)
     {
         printf("Error: Could not connect to DPS MQTT server (0x%04x)\r\n", status);
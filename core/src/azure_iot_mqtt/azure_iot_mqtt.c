@@ -14,6 +14,8 @@
 #include "azure_iot_cert.h"
 #include "azure_iot_mqtt/azure_iot_dps_mqtt.h"
 #include "azure_iot_mqtt/sas_token.h"
+#include "dns_resolver.h"
+#include "startup.h"
 
 #define USERNAME                "%s/%s/?api-version=2020-09-30&model-id=%s"
 #define PUBLISH_TELEMETRY_TOPIC "devices/%s/messages/events/"
@@ -124,6 +126,17 @@ UINT tls_setup(NXD_MQTT_CLIENT* client,
         return status;
     }
 
+#ifdef NX_SECURE_ENABLE_ECC_CIPHERSUITE
+    // Curves for ECDHE key agreement and ECDSA certificates
+    status = nx_secure_tls_ecc_initialize(
+        tls_session, nx_crypto_ecc_supported_groups, nx_crypto_ecc_supported_groups_size, nx_crypto_ecc_curves);
+    if (status != NX_SUCCESS)
+    {
+        printf("Failed to initialize TLS ECC curves (0x%04x)\r\n", status);
+        return status;
+    }
+#endif
+
     status = nx_secure_tls_remote_certificate_allocate(tls_session,	
         &azure_iot_mqtt->mqtt_remote_certificate,	
         azure_iot_mqtt->mqtt_remote_cert_buffer,	
@@ -484,6 +497,7 @@ UINT azure_iot_mqtt_publish_bool_property(AZURE_IOT_MQTT* azure_iot_mqtt, CHAR*
 
 UINT azure_iot_mqtt_publish_float_telemetry(AZURE_IOT_MQTT* azure_iot_mqtt, CHAR* label, float value)
 {
+    UINT status;
     CHAR mqtt_publish_topic[100];
 
     printf("Sending telemetry with float value\r\n");
@@ -493,7 +507,14 @@ UINT azure_iot_mqtt_publish_float_telemetry(AZURE_IOT_MQTT* azure_iot_mqtt, CHAR
         PUBLISH_TELEMETRY_TOPIC,
         azure_iot_mqtt->nxd_mqtt_client.nxd_mqtt_client_id);
 
-    return mqtt_publish_float(azure_iot_mqtt, mqtt_publish_topic, label, value);
+    if ((status = mqtt_publish_float(azure_iot_mqtt, mqtt_publish_topic, label, value)))
+    {
+        return status;
+    }
+
+    startup_telemetry_sent();
+
+    return NX_SUCCESS;
 }
 
 UINT azure_iot_mqtt_publish_int_writeable_property(AZURE_IOT_MQTT* azure_iot_mqtt, CHAR* label, int value)
@@ -722,11 +743,10 @@ UINT azure_iot_mqtt_connect(AZURE_IOT_MQTT* azure_iot_mqtt)
     }
 
     // Resolve the MQTT server IP address
-    status = nxd_dns_host_by_name_get(azure_iot_mqtt->nx_dns,
-        (UCHAR*)azure_iot_mqtt->mqtt_hub_hostname,
-        &server_ip,
-        NX_IP_PERIODIC_RATE,
-        NX_IP_VERSION_V4);
+    server_ip.nxd_ip_version = NX_IP_VERSION_V4;
+
+    status = dns_resolver_host_by_name_get(
+        azure_iot_mqtt->mqtt_hub_hostname, &server_ip.nxd_ip_address.v4, NX_IP_PERIODIC_RATE);
     if (status != NX_SUCCESS)
     {
         printf("Unable to resolve DNS for MQTT Server %s (0x%02x)\r\n", azure_iot_mqtt->mqtt_hub_hostname, status);
@@ -737,6 +757,8 @@ UINT azure_iot_mqtt_connect(AZURE_IOT_MQTT* azure_iot_mqtt)
     // Stash the hostname in a global variable so we can verify the cert at connect
     azure_iot_x509_hostname = azure_iot_mqtt->mqtt_hub_hostname;
 
+    tls_handshake_stats_start(&azure_iot_mqtt->tls_stats);
+
     status = nxd_mqtt_client_secure_connect(&azure_iot_mqtt->nxd_mqtt_client,
         &server_ip,
         NXD_MQTT_TLS_PORT,
@@ -744,6 +766,7 @@ UINT azure_iot_mqtt_connect(AZURE_IOT_MQTT* azure_iot_mqtt)
         MQTT_KEEP_ALIVE,
         NX_TRUE,
         MQTT_TIMEOUT);
+    tls_handshake_stats_update(&azure_iot_mqtt->tls_stats, status);
     if (status != NXD_MQTT_SUCCESS)
     {
         printf("Could not connect to MQTT server (0x%02x)\r\n", status);
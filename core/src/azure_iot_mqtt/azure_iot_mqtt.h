@@ -13,6 +13,7 @@
 #include "nxd_mqtt_client.h"
 
 #include "azure_iot_ciphersuites.h"
+#include "tls_handshake_stats.h"
 
 #define AZURE_IOT_MQTT_HOSTNAME_SIZE           100
 #define AZURE_IOT_MQTT_DEVICE_ID_SIZE          64
@@ -80,6 +81,9 @@ struct AZURE_IOT_MQTT_STRUCT
     NX_SECURE_X509_CERT mqtt_remote_certificate;	
     UCHAR mqtt_remote_cert_buffer[AZURE_IOT_MQTT_CERT_BUFFER_SIZE];
 
+    // Handshakes with the hub and DPS
+    TLS_HANDSHAKE_STATS tls_stats;
+
     func_ptr_direct_method cb_ptr_mqtt_invoke_direct_method;
     func_ptr_c2d_message cb_ptr_mqtt_c2d_message;
     func_ptr_device_twin_desired_prop cb_ptr_mqtt_device_twin_desired_prop_callback;
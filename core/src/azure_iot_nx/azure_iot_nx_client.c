@@ -3,65 +3,156 @@
 
 #include "azure_iot_nx_client.h"
 
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "azure_iot_cert.h"
 #include "azure_iot_ciphersuites.h"
+#include "dns_resolver.h"
+#include "packet_pools.h"
 #include "nx_azure_iot_pnp_helpers.h"
+#include "startup.h"
 
 #define NX_AZURE_IOT_THREAD_PRIORITY 4
 #define THREAD_PRIORITY              16
 
 // Incoming events from the middleware
-#define ALL_EVENTS                         0xFF
+#define ALL_EVENTS                         0xFFFFFFFF
 #define DIRECT_METHOD_EVENT                0x01
 #define DEVICE_TWIN_GET_EVENT              0x02
 #define DEVICE_TWIN_DESIRED_PROPERTY_EVENT 0x04
 #define DEVICE_TWIN_COMPLETE_EVENT         0x08
+#define TELEMETRY_QUEUE_EVENT              0x10
+#define TELEMETRY_BATCH_EVENT              0x20
+#define TELEMETRY_REPLAY_EVENT             0x40
+#define CONNECTION_LOST_EVENT              0x80
+#define RECONNECT_EVENT                    0x100
+#define REPORTED_PROPERTIES_EVENT          0x200
 
-#define AZURE_IOT_DPS_ENDPOINT "global.azure-devices-provisioning.net"
+// Everything except the twin completion, which is consumed by azure_iot_nx_client_device_twin_request_and_wait
+#define CLIENT_THREAD_EVENTS (ALL_EVENTS & ~DEVICE_TWIN_COMPLETE_EVENT)
 
 #define MODULE_ID   ""
 #define DPS_PAYLOAD "{\"modelId\":\"%s\"}"
 
 #define DPS_PAYLOAD_SIZE    200
 #define PUBLISH_BUFFER_SIZE 512
+#define MQTT_PACKET_ID_SIZE 2
 
 #define MAX_EXPONENTIAL_BACKOFF_JITTER_PERCENT 60
 #define MAX_EXPONENTIAL_BACKOFF_IN_SEC         (10 * 60)
 #define INITIAL_EXPONENTIAL_BACKOFF_IN_SEC     3
 
 // Connection timeouts in threadx ticks
-#define HUB_CONNECT_TIMEOUT_TICKS  (10 * TX_TIMER_TICKS_PER_SECOND)
-#define DPS_REGISTER_TIMEOUT_TICKS (3 * TX_TIMER_TICKS_PER_SECOND)
+#define HUB_CONNECT_TIMEOUT_TICKS     (10 * TX_TIMER_TICKS_PER_SECOND)
+#define DPS_REGISTER_TIMEOUT_TICKS    (3 * TX_TIMER_TICKS_PER_SECOND)
+#define TELEMETRY_SEND_TIMEOUT_TICKS  (5 * TX_TIMER_TICKS_PER_SECOND)
+#define PROPERTIES_SEND_TIMEOUT_TICKS (5 * TX_TIMER_TICKS_PER_SECOND)
+#define TELEMETRY_REPLAY_PERIOD_TICKS TX_TIMER_TICKS_PER_SECOND
+#define PROPERTIES_RETRY_TICKS        (2 * TX_TIMER_TICKS_PER_SECOND)
+
+// A patch the hub keeps refusing is failed back to its caller rather than holding up the ones behind it
+#define PROPERTIES_SEND_ATTEMPTS 5
+
+#define TELEMETRY_NO_SEQUENCE 0xFFFFFFFF
+
+static const CHAR telemetry_sequence_property[]         = "seq";
+static const CHAR telemetry_content_type_property[]     = "$.ct";
+static const CHAR telemetry_content_encoding_property[] = "$.ce";
+
+static UINT dps_register(AZURE_IOT_NX_CONTEXT* context);
 
 static VOID connection_status_callback(NX_AZURE_IOT_HUB_CLIENT* hub_client_ptr, UINT status)
 {
+    // The hub client is the first member of the client union
+    AZURE_IOT_NX_CONTEXT* nx_context =
+        (AZURE_IOT_NX_CONTEXT*)((UCHAR*)hub_client_ptr - offsetof(AZURE_IOT_NX_CONTEXT, client));
+
     if (status == NX_SUCCESS)
     {
         printf("Connected to IoT Hub\r\n");
+        nx_context->connected = NX_TRUE;
+#ifdef AZURE_IOT_STORE_FORWARD_ENABLE
+        tx_event_flags_set(&nx_context->events, TELEMETRY_REPLAY_EVENT, TX_OR);
+#endif
     }
     else
     {
         printf("Connection failure from IoT Hub (0x%08x)\r\n", status);
+        nx_context->connected = NX_FALSE;
+        tx_event_flags_set(&nx_context->events, CONNECTION_LOST_EVENT, TX_OR);
+    }
+}
+
+// Stamp the arrival of the first unserviced notification of a kind, called from the middleware thread
+static VOID dispatch_signal(ULONG* pending_time)
+{
+    if (*pending_time == 0)
+    {
+        *pending_time = tx_time_get();
+    }
+}
+
+static VOID dispatch_record(AZURE_IOT_NX_EVENT_STATS* stats, ULONG* pending_time)
+{
+    ULONG latency;
+
+    if (*pending_time == 0)
+    {
+        return;
+    }
+
+    latency       = tx_time_get() - *pending_time;
+    *pending_time = 0;
+
+    stats->count++;
+    stats->latency_last = latency;
+    stats->latency_total += latency;
+    if (latency > stats->latency_max)
+    {
+        stats->latency_max = latency;
     }
 }
 
+static VOID reconnect_timer_expired(ULONG parameter)
+{
+    AZURE_IOT_NX_CONTEXT* nx_context = (AZURE_IOT_NX_CONTEXT*)parameter;
+    tx_event_flags_set(&nx_context->events, RECONNECT_EVENT, TX_OR);
+}
+
+static VOID properties_retry_timer_expired(ULONG parameter)
+{
+    AZURE_IOT_NX_CONTEXT* nx_context = (AZURE_IOT_NX_CONTEXT*)parameter;
+    tx_event_flags_set(&nx_context->events, REPORTED_PROPERTIES_EVENT, TX_OR);
+}
+
+#ifdef AZURE_IOT_STORE_FORWARD_ENABLE
+static VOID replay_timer_expired(ULONG parameter)
+{
+    AZURE_IOT_NX_CONTEXT* nx_context = (AZURE_IOT_NX_CONTEXT*)parameter;
+    tx_event_flags_set(&nx_context->events, TELEMETRY_REPLAY_EVENT, TX_OR);
+}
+#endif
+
 static VOID message_receive_direct_method(NX_AZURE_IOT_HUB_CLIENT* hub_client_ptr, VOID* context)
 {
     AZURE_IOT_NX_CONTEXT* nx_context = (AZURE_IOT_NX_CONTEXT*)context;
+    dispatch_signal(&nx_context->direct_method_time);
     tx_event_flags_set(&nx_context->events, DIRECT_METHOD_EVENT, TX_OR);
 }
 
 static VOID message_receive_callback_twin(NX_AZURE_IOT_HUB_CLIENT* hub_client_ptr, VOID* context)
 {
     AZURE_IOT_NX_CONTEXT* nx_context = (AZURE_IOT_NX_CONTEXT*)context;
+    dispatch_signal(&nx_context->twin_get_time);
     tx_event_flags_set(&nx_context->events, DEVICE_TWIN_GET_EVENT, TX_OR);
 }
 
 static VOID message_receive_callback_desire_property(NX_AZURE_IOT_HUB_CLIENT* hub_client_ptr, VOID* context)
 {
     AZURE_IOT_NX_CONTEXT* nx_context = (AZURE_IOT_NX_CONTEXT*)context;
+    dispatch_signal(&nx_context->desired_property_time);
     tx_event_flags_set(&nx_context->events, DEVICE_TWIN_DESIRED_PROPERTY_EVENT, TX_OR);
 }
 
@@ -100,6 +191,8 @@ static VOID process_direct_method(AZURE_IOT_NX_CONTEXT* nx_context)
         nx_packet_release(packet);
     }
 
+    dispatch_record(&nx_context->dispatch_stats.direct_method, &nx_context->direct_method_time);
+
     // If we failed for anything other than no packet, then report error
     if (status != NX_AZURE_IOT_NO_PACKET)
     {
@@ -108,6 +201,18 @@ static VOID process_direct_method(AZURE_IOT_NX_CONTEXT* nx_context)
     }
 }
 
+// Serve any commands that arrived while bulk work was in progress
+static VOID process_direct_method_pending(AZURE_IOT_NX_CONTEXT* nx_context)
+{
+    ULONG app_events;
+
+    if (tx_event_flags_get(&nx_context->events, DIRECT_METHOD_EVENT, TX_OR_CLEAR, &app_events, TX_NO_WAIT) ==
+        TX_SUCCESS)
+    {
+        process_direct_method(nx_context);
+    }
+}
+
 static VOID process_device_twin_get(AZURE_IOT_NX_CONTEXT* nx_context)
 {
     UINT status;
@@ -115,8 +220,9 @@ static VOID process_device_twin_get(AZURE_IOT_NX_CONTEXT* nx_context)
     NX_AZURE_IOT_JSON_READER json_reader;
     UCHAR buffer[PUBLISH_BUFFER_SIZE];
 
+    // Only dispatched once the middleware has the response, so there is nothing to wait for
     if ((status = nx_azure_iot_hub_client_device_twin_properties_receive(
-             &nx_context->iothub_client, &packet_ptr, NX_WAIT_FOREVER)))
+             &nx_context->iothub_client, &packet_ptr, NX_NO_WAIT)))
     {
         printf("Error: receive device twin property failed (0x%08x)\r\n", status);
         return;
@@ -156,6 +262,8 @@ static VOID process_device_twin_get(AZURE_IOT_NX_CONTEXT* nx_context)
     // Deinit the reader, the reader owns the NX_PACKET at this point, so will release it
     nx_azure_iot_json_reader_deinit(&json_reader);
 
+    dispatch_record(&nx_context->dispatch_stats.twin_get, &nx_context->twin_get_time);
+
     // Send event to notify device twin received
     tx_event_flags_set(&nx_context->events, DEVICE_TWIN_COMPLETE_EVENT, TX_OR);
 }
@@ -204,6 +312,10 @@ static VOID process_device_twin_desired_property(AZURE_IOT_NX_CONTEXT* nx_contex
 
         // Deinit the reader, the reader owns the NX_PACKET at this point, so will release it
         nx_azure_iot_json_reader_deinit(&json_reader);
+
+        dispatch_record(&nx_context->dispatch_stats.desired_property, &nx_context->desired_property_time);
+
+        process_direct_method_pending(nx_context);
     }
 
     // If we failed for anything other than no packet, then report error
@@ -214,254 +326,984 @@ static VOID process_device_twin_desired_property(AZURE_IOT_NX_CONTEXT* nx_contex
     }
 }
 
-static VOID event_thread(ULONG parameter)
+static UINT telemetry_property_add(
+    NX_PACKET* packet_ptr, const CHAR* name, UINT name_length, const CHAR* value, UINT wait_option)
 {
-    ULONG app_events;
-
-    AZURE_IOT_NX_CONTEXT* context = (AZURE_IOT_NX_CONTEXT*)parameter;
-
-    while (true)
-    {
-        tx_event_flags_get(&context->events, ALL_EVENTS, TX_OR_CLEAR, &app_events, NX_IP_PERIODIC_RATE);
-
-        if (app_events & DIRECT_METHOD_EVENT)
-        {
-            process_direct_method(context);
-        }
-
-        if (app_events & DEVICE_TWIN_GET_EVENT)
-        {
-            process_device_twin_get(context);
-        }
-
-        if (app_events & DEVICE_TWIN_DESIRED_PROPERTY_EVENT)
-        {
-            process_device_twin_desired_property(context);
-        }
-
-        app_events = 0;
-    }
+    return nx_azure_iot_hub_client_telemetry_property_add(
+        packet_ptr, (UCHAR*)name, (USHORT)name_length, (UCHAR*)value, (USHORT)strlen(value), wait_option);
 }
 
-static UINT azure_iot_nx_client_hub_create_internal(AZURE_IOT_NX_CONTEXT* context)
+// Telemetry is serialized straight into the packet that goes on the wire, laid out as topic, MQTT packet id and then
+// payload. The payload is appended by the caller between telemetry_packet_create and telemetry_packet_publish.
+static UINT telemetry_packet_create(AZURE_IOT_NX_CONTEXT* nx_context,
+    TELEMETRY_ENCODING encoding,
+    ULONG sequence,
+    NX_PACKET** packet_pptr,
+    UINT* topic_length,
+    UCHAR* packet_id,
+    UINT wait_option)
 {
     UINT status;
+    CHAR sequence_str[11];
+    INT sequence_length;
 
-    printf("Initializing Azure IoT Hub client\r\n");
-    printf("\tHub hostname: %s\r\n", context->azure_iot_hub_hostname);
-    printf("\tDevice id: %s\r\n", context->azure_iot_device_id);
-    printf("\tModel id: %s\r\n", context->azure_iot_model_id);
-
-    // Initialize IoT Hub client.
-    if ((status = nx_azure_iot_hub_client_initialize(&context->iothub_client,
-             &context->nx_azure_iot,
-             (UCHAR*)context->azure_iot_hub_hostname,
-             strlen(context->azure_iot_hub_hostname),
-             (UCHAR*)context->azure_iot_device_id,
-             strlen(context->azure_iot_device_id),
-             (UCHAR*)MODULE_ID,
-             strlen(MODULE_ID),
-             _nx_azure_iot_tls_supported_crypto,
-             _nx_azure_iot_tls_supported_crypto_size,
-             _nx_azure_iot_tls_ciphersuite_map,
-             _nx_azure_iot_tls_ciphersuite_map_size,
-             (UCHAR*)context->nx_azure_iot_tls_metadata_buffer,
-             sizeof(context->nx_azure_iot_tls_metadata_buffer),
-             &context->root_ca_cert)))
+    if ((status = nx_azure_iot_pnp_helper_telemetry_message_create(
+             &nx_context->iothub_client, NX_NULL, 0, packet_pptr, wait_option)))
     {
-        printf("ERROR: on nx_azure_iot_hub_client_initialize (0x%08x)\r\n", status);
+        printf("Telemetry message create failed!: error code = 0x%08x\r\n", status);
         return status;
     }
 
-    // Set credentials
-    if (context->azure_iot_auth_mode == AZURE_IOT_AUTH_MODE_SAS)
-    {
-        // Symmetric (SAS) Key
-        if ((status = nx_azure_iot_hub_client_symmetric_key_set(&context->iothub_client,
-                 (UCHAR*)context->azure_iot_device_sas_key,
-                 context->azure_iot_device_sas_key_len)))
-        {
-            printf("ERROR: failed on nx_azure_iot_hub_client_symmetric_key_set (0x%08x)\r\n", status);
-        }
+    // Tag the payload format so the backend can decode it without guessing, messages can mix encodings
+    if ((status = telemetry_property_add(*packet_pptr,
+             telemetry_content_type_property,
+             sizeof(telemetry_content_type_property) - 1,
+             telemetry_encoding_content_type(encoding),
+             wait_option)) ||
+        (status = telemetry_property_add(*packet_pptr,
+             telemetry_content_encoding_property,
+             sizeof(telemetry_content_encoding_property) - 1,
+             telemetry_encoding_content_encoding(encoding),
+             wait_option)))
+    {
+        printf("Telemetry content type property add failed (0x%08x)\r\n", status);
+        nx_azure_iot_hub_client_telemetry_message_delete(*packet_pptr);
+        return status;
     }
-    else if (context->azure_iot_auth_mode == AZURE_IOT_AUTH_MODE_CERT)
+
+    // Replayed messages carry their sequence number so the backend can order and de-duplicate them
+    if (sequence != TELEMETRY_NO_SEQUENCE)
     {
-        // X509 Certificate
-        if ((status = nx_azure_iot_hub_client_device_cert_set(&context->iothub_client, &context->device_certificate)))
+        sequence_length = snprintf(sequence_str, sizeof(sequence_str), "%lu", sequence);
+
+        if ((status = nx_azure_iot_hub_client_telemetry_property_add(*packet_pptr,
+                 (UCHAR*)telemetry_sequence_property,
+                 (USHORT)(sizeof(telemetry_sequence_property) - 1),
+                 (UCHAR*)sequence_str,
+                 (USHORT)sequence_length,
+                 wait_option)))
         {
-            printf("ERROR: failed on nx_azure_iot_hub_client_device_cert_set!: error code = 0x%08x\r\n", status);
+            printf("Telemetry sequence property add failed (0x%08x)\r\n", status);
+            nx_azure_iot_hub_client_telemetry_message_delete(*packet_pptr);
+            return status;
         }
     }
 
-    // Set Model id
-    if ((status = nx_azure_iot_hub_client_model_id_set(
-             &context->iothub_client, (UCHAR*)context->azure_iot_model_id, strlen(context->azure_iot_model_id))))
-    {
-        printf("ERROR: nx_azure_iot_hub_client_model_id_set (0x%08x)\r\n", status);
-    }
+    *topic_length = (*packet_pptr)->nx_packet_length;
 
-    // Set connection status callback
-    else if ((status = nx_azure_iot_hub_client_connection_status_callback_set(
-                  &context->iothub_client, connection_status_callback)))
+    if ((status = nx_azure_iot_mqtt_packet_id_get(
+             &nx_context->iothub_client.nx_azure_iot_hub_client_resource.resource_mqtt, packet_id, wait_option)))
     {
-        printf("ERROR: failed on connection_status_callback (0x%08x)\r\n", status);
+        printf("Telemetry packet id get failed (0x%08x)\r\n", status);
+        nx_azure_iot_hub_client_telemetry_message_delete(*packet_pptr);
+        return status;
     }
 
-    // Enable direct methods
-    else if ((status = nx_azure_iot_hub_client_direct_method_enable(&context->iothub_client)))
+    if ((status = nx_packet_data_append(
+             *packet_pptr, packet_id, MQTT_PACKET_ID_SIZE, (*packet_pptr)->nx_packet_pool_owner, wait_option)))
     {
-        printf("ERROR: direct method receive enable failed (0x%08x)\r\n", status);
+        printf("Telemetry packet id append failed (0x%08x)\r\n", status);
+        nx_azure_iot_hub_client_telemetry_message_delete(*packet_pptr);
+        return status;
     }
 
-    // Enable device twin
-    else if ((status = nx_azure_iot_hub_client_device_twin_enable(&context->iothub_client)))
-    {
-        printf("ERROR: device twin enabled failed (0x%08x)\r\n", status);
-    }
+    return NX_SUCCESS;
+}
 
-    // Set device twin callback
-    else if ((status = nx_azure_iot_hub_client_receive_callback_set(&context->iothub_client,
-                  NX_AZURE_IOT_HUB_DEVICE_TWIN_PROPERTIES,
-                  message_receive_callback_twin,
-                  (VOID*)context)))
+static UINT telemetry_packet_publish(
+    AZURE_IOT_NX_CONTEXT* nx_context, NX_PACKET* packet_ptr, UINT topic_length, UCHAR* packet_id, UINT wait_option)
+{
+    UINT status;
+
+    if ((status = nx_azure_iot_publish_mqtt_packet(
+             &nx_context->iothub_client.nx_azure_iot_hub_client_resource.resource_mqtt,
+             packet_ptr,
+             topic_length,
+             packet_id,
+             NX_AZURE_IOT_MQTT_QOS_1,
+             wait_option)))
     {
-        printf("ERROR: device twin callback set (0x%08x)\r\n", status);
+        printf("Telemetry message send failed (0x%08x)\r\n", status);
+        nx_azure_iot_hub_client_telemetry_message_delete(packet_ptr);
+        return status;
     }
 
-    // Set direct method callback
-    else if ((status = nx_azure_iot_hub_client_receive_callback_set(&context->iothub_client,
-                  NX_AZURE_IOT_HUB_DIRECT_METHOD,
-                  message_receive_direct_method,
-                  (VOID*)context)))
+    startup_telemetry_sent();
+
+    return NX_SUCCESS;
+}
+
+#ifdef AZURE_IOT_STORE_FORWARD_ENABLE
+// Replayed records come out of the store as a flat buffer and are copied into the packet
+static UINT telemetry_send(
+    AZURE_IOT_NX_CONTEXT* nx_context, UCHAR* payload, UINT payload_length, ULONG sequence, UINT wait_option)
+{
+    UINT status;
+    NX_PACKET* packet_ptr;
+    UINT topic_length;
+    UCHAR packet_id[MQTT_PACKET_ID_SIZE];
+    TELEMETRY_ENCODING encoding = telemetry_payload_encoding(payload, payload_length);
+
+    if ((status = telemetry_packet_create(
+             nx_context, encoding, sequence, &packet_ptr, &topic_length, packet_id, wait_option)))
     {
-        printf("ERROR: device method callback set (0x%08x)\r\n", status);
+        return status;
     }
 
-    // Set the writeable property callback
-    else if ((status = nx_azure_iot_hub_client_receive_callback_set(&context->iothub_client,
-                  NX_AZURE_IOT_HUB_DEVICE_TWIN_DESIRED_PROPERTIES,
-                  message_receive_callback_desire_property,
-                  (VOID*)context)))
+    if ((status = nx_packet_data_append(
+             packet_ptr, payload, payload_length, packet_ptr->nx_packet_pool_owner, wait_option)))
     {
-        printf("ERROR: device twin desired property callback set (0x%08x)\r\n", status);
+        printf("Telemetry payload append failed (0x%08x)\r\n", status);
+        nx_azure_iot_hub_client_telemetry_message_delete(packet_ptr);
+        return status;
     }
 
-    if (status != NX_AZURE_IOT_SUCCESS)
+    if ((status = telemetry_packet_publish(nx_context, packet_ptr, topic_length, packet_id, wait_option)))
     {
-        nx_azure_iot_hub_client_deinitialize(&context->iothub_client);
+        return status;
     }
 
-    return status;
-}
-
-UINT azure_iot_nx_client_register_direct_method(AZURE_IOT_NX_CONTEXT* context, func_ptr_direct_method callback)
-{
-    if (context == NULL || context->direct_method_cb != NULL)
+    if (encoding == TELEMETRY_ENCODING_JSON)
     {
-        return NX_PTR_ERROR;
+        printf("Telemetry message sent: %.*s.\r\n", payload_length, payload);
     }
-
-    context->direct_method_cb = callback;
-    return NX_SUCCESS;
-}
-
-UINT azure_iot_nx_client_register_device_twin_desired_prop(
-    AZURE_IOT_NX_CONTEXT* context, func_ptr_device_twin_desired_prop callback)
-{
-    if (context == NULL || context->device_twin_desired_prop_cb != NULL)
+    else
     {
-        return NX_PTR_ERROR;
+        printf("Telemetry message sent (%d bytes CBOR)\r\n", payload_length);
     }
 
-    context->device_twin_desired_prop_cb = callback;
     return NX_SUCCESS;
 }
+#endif
 
-UINT azure_iot_nx_client_register_device_twin_prop(AZURE_IOT_NX_CONTEXT* context, func_ptr_device_twin_prop callback)
+// Queued telemetry was serialized into a packet chain when it was pushed, it is linked in behind the topic rather than
+// copied. The connection owns the whole chain once it is published, whether or not the send succeeds.
+static UINT telemetry_queued_send(AZURE_IOT_NX_CONTEXT* nx_context, TELEMETRY_QUEUE_ENTRY* entry, UINT wait_option)
 {
-    if (context == NULL || context->device_twin_get_cb != NULL)
+    UINT status;
+    NX_PACKET* packet_ptr;
+    NX_PACKET* last_ptr;
+    UINT topic_length;
+    UCHAR packet_id[MQTT_PACKET_ID_SIZE];
+    ULONG payload_length = entry->payload->nx_packet_length;
+
+    if ((status = telemetry_packet_create(
+             nx_context, entry->encoding, TELEMETRY_NO_SEQUENCE, &packet_ptr, &topic_length, packet_id, wait_option)))
     {
-        return NX_PTR_ERROR;
+        return status;
     }
 
-    context->device_twin_get_cb = callback;
-    return NX_SUCCESS;
-}
+    last_ptr = packet_ptr->nx_packet_last ? packet_ptr->nx_packet_last : packet_ptr;
 
-UINT azure_iot_nx_client_sas_set(AZURE_IOT_NX_CONTEXT* context, CHAR* device_sas_key)
-{
-    if (device_sas_key[0] == 0)
+    last_ptr->nx_packet_next = entry->payload;
+    packet_ptr->nx_packet_last = entry->payload->nx_packet_last ? entry->payload->nx_packet_last : entry->payload;
+    packet_ptr->nx_packet_length += payload_length;
+    entry->payload = NX_NULL;
+
+    if ((status = telemetry_packet_publish(nx_context, packet_ptr, topic_length, packet_id, wait_option)))
     {
-        printf("ERROR: azure_iot_nx_client_sas_set device_sas_key is null\r\n");
-        return NX_PTR_ERROR;
+        return status;
     }
 
-    context->azure_iot_auth_mode          = AZURE_IOT_AUTH_MODE_SAS;
-    context->azure_iot_device_sas_key     = device_sas_key;
-    context->azure_iot_device_sas_key_len = strlen(device_sas_key);
+    printf("Telemetry message sent (%lu bytes %s)\r\n",
+        payload_length,
+        entry->encoding == TELEMETRY_ENCODING_CBOR ? "CBOR" : "JSON");
 
     return NX_SUCCESS;
 }
 
-UINT azure_iot_nx_client_cert_set(AZURE_IOT_NX_CONTEXT* context,
-    UCHAR* device_x509_cert,
-    UINT device_x509_cert_len,
-    UCHAR* device_x509_key,
-    UINT device_x509_key_len)
+static VOID process_telemetry_queue(AZURE_IOT_NX_CONTEXT* nx_context)
 {
     UINT status;
+    TELEMETRY_QUEUE_ENTRY* entry = &nx_context->telemetry_in_flight;
+#ifdef AZURE_IOT_STORE_FORWARD_ENABLE
+    ULONG stored_length;
+#endif
+
+    // Bounded wait so a stalled link fails the message rather than wedging the client thread
+    while (telemetry_queue_pop(&nx_context->telemetry_queue, entry) == NX_SUCCESS)
+    {
+        status = NX_NOT_CONNECTED;
+
+#ifdef AZURE_IOT_STORE_FORWARD_ENABLE
+        // Sending gives the packet away, so take the copy that may have to be stored first. A message too big for the
+        // replay buffer is only ever sent live.
+        if (nx_packet_data_extract_offset(entry->payload,
+                0,
+                nx_context->store_forward_buffer,
+                sizeof(nx_context->store_forward_buffer),
+                &stored_length) ||
+            stored_length < entry->payload->nx_packet_length)
+        {
+            stored_length = 0;
+        }
+#endif
 
-    if (device_x509_cert[0] == 0 || device_x509_cert_len == 0 || device_x509_key[0] == 0 || device_x509_key_len == 0)
-    {
-        printf("ERROR: azure_iot_nx_client_cert_set cert/key is null\r\n");
-        return NX_PTR_ERROR;
-    }
+        if (nx_context->connected)
+        {
+            status = telemetry_queued_send(nx_context, entry, TELEMETRY_SEND_TIMEOUT_TICKS);
+        }
 
-    context->azure_iot_auth_mode = AZURE_IOT_AUTH_MODE_CERT;
+#ifdef AZURE_IOT_STORE_FORWARD_ENABLE
+        // Keep undelivered telemetry for replay rather than losing it
+        if (status != NX_SUCCESS && stored_length > 0 &&
+            store_forward_append(&nx_context->store_forward, nx_context->store_forward_buffer, stored_length) ==
+                NX_SUCCESS)
+        {
+            status = NX_IN_PROGRESS;
+        }
+#endif
 
-    // Create the device certificate
-    if ((status = nx_secure_x509_certificate_initialize(&context->device_certificate,
-             (UCHAR*)device_x509_cert,
-             (USHORT)device_x509_cert_len,
-             NX_NULL,
-             0,
-             (UCHAR*)device_x509_key,
-             (USHORT)device_x509_key_len,
-             NX_SECURE_X509_KEY_TYPE_RSA_PKCS1_DER)))
-    {
-        printf("Error: Failed on device nx_secure_x509_certificate_initialize!: error code = 0x%08x\r\n", status);
-    }
+        telemetry_queue_complete(&nx_context->telemetry_queue, entry, status);
 
-    return NX_SUCCESS;
+        process_direct_method_pending(nx_context);
+    }
 }
 
-UINT azure_iot_nx_client_create(AZURE_IOT_NX_CONTEXT* context,
-    NX_IP* nx_ip,
-    NX_PACKET_POOL* nx_pool,
-    NX_DNS* nx_dns,
-    UINT (*unix_time_callback)(ULONG* unix_time),
-    CHAR* iot_model_id)
+#ifdef AZURE_IOT_STORE_FORWARD_ENABLE
+static VOID process_telemetry_replay(AZURE_IOT_NX_CONTEXT* nx_context)
 {
     UINT status;
+    ULONG sequence;
+    UINT length;
+
+    // Live telemetry has already gone out, the backlog gets whatever the replay rate allows
+    while (nx_context->connected && store_forward_backlog_get(&nx_context->store_forward) > 0 &&
+           store_forward_replay_acquire(&nx_context->store_forward))
+    {
+        if ((status = store_forward_peek(&nx_context->store_forward,
+                 nx_context->store_forward_buffer,
+                 sizeof(nx_context->store_forward_buffer),
+                 &length,
+                 &sequence)))
+        {
+            printf("ERROR: failed to read stored telemetry (0x%08x)\r\n", status);
+            break;
+        }
 
-    if (iot_model_id[0] == 0)
-    {
-        printf("ERROR: UINT azure_iot_nx_client_create_new empty device_id or model_id\r\n");
-        return NX_PTR_ERROR;
-    }
-
-    // Initialise the context
-    memset(context, 0, sizeof(AZURE_IOT_NX_CONTEXT));
+        status = telemetry_send(
+            nx_context, nx_context->store_forward_buffer, length, sequence, TELEMETRY_SEND_TIMEOUT_TICKS);
 
-    // Stash parameters
-    context->azure_iot_model_id = iot_model_id;
+        store_forward_replay_complete(&nx_context->store_forward, sequence, length, status);
 
-    if ((status = tx_event_flags_create(&context->events, "nx_client")))
+        if (status != NX_SUCCESS)
+        {
+            break;
+        }
+
+        process_direct_method_pending(nx_context);
+    }
+
+    // Come back for the rest once the rate limiter has refilled
+    if (nx_context->connected && store_forward_backlog_get(&nx_context->store_forward) > 0)
+    {
+        tx_timer_activate(&nx_context->replay_timer);
+    }
+    else
+    {
+        tx_timer_deactivate(&nx_context->replay_timer);
+    }
+}
+#endif
+
+static VOID process_reported_properties(AZURE_IOT_NX_CONTEXT* nx_context)
+{
+    REPORTED_PROPERTIES_REQUEST* request;
+    UINT request_id;
+    UINT response_status;
+    ULONG version;
+    UINT status;
+
+    // The middleware waits for the hub response inside the send, so patches go out one at a time. Anything left over
+    // goes out on the retry timer or after the next reconnect.
+    while (nx_context->connected &&
+           (request = reported_properties_queue_peek(&nx_context->reported_properties_queue)) != NX_NULL)
+    {
+        // Checked at send time so acknowledgements that arrived while this patch was queued count
+        if (reported_properties_queue_unchanged(
+                &nx_context->reported_properties_queue, request->items, request->item_count))
+        {
+            printf("Device twin properties unchanged, not sent: %.*s\r\n", request->length, request->document);
+
+            if (request->complete_cb)
+            {
+                request->complete_cb(NX_SUCCESS, 0, REPORTED_PROPERTIES_STATUS_UNCHANGED, 0, request->complete_context);
+            }
+
+            reported_properties_queue_remove(&nx_context->reported_properties_queue);
+            nx_context->reported_properties_attempts = 0;
+            continue;
+        }
+
+        if ((status = nx_azure_iot_hub_client_device_twin_reported_properties_send(&nx_context->iothub_client,
+                 request->document,
+                 request->length,
+                 &request_id,
+                 &response_status,
+                 &version,
+                 PROPERTIES_SEND_TIMEOUT_TICKS)))
+        {
+            printf("ERROR: device twin reported properties failed (0x%08x)\r\n", status);
+
+            // Keep the patch at the head and back off, doubling the wait on each attempt
+            if (++nx_context->reported_properties_attempts < PROPERTIES_SEND_ATTEMPTS)
+            {
+                tx_timer_deactivate(&nx_context->properties_retry_timer);
+                tx_timer_change(&nx_context->properties_retry_timer,
+                    PROPERTIES_RETRY_TICKS << (nx_context->reported_properties_attempts - 1),
+                    0);
+                tx_timer_activate(&nx_context->properties_retry_timer);
+                return;
+            }
+
+            printf("ERROR: device twin reported properties dropped after %d attempts\r\n", PROPERTIES_SEND_ATTEMPTS);
+            request_id      = 0;
+            response_status = 0;
+            version         = 0;
+        }
+        else if ((response_status < 200) || (response_status >= 300))
+        {
+            printf("ERROR: device twin report properties failed (%d)\r\n", response_status);
+            status = NX_NOT_SUCCESSFUL;
+        }
+        else
+        {
+            printf("Device twin properties sent: %.*s\r\n", request->length, request->document);
+            reported_properties_queue_acknowledge(
+                &nx_context->reported_properties_queue, request->items, request->item_count);
+        }
+
+        if (request->complete_cb)
+        {
+            request->complete_cb(status, request_id, response_status, version, request->complete_context);
+        }
+
+        reported_properties_queue_remove(&nx_context->reported_properties_queue);
+        nx_context->reported_properties_attempts = 0;
+
+        process_direct_method_pending(nx_context);
+    }
+}
+
+static ULONG reconnect_backoff_ticks(AZURE_IOT_NX_CONTEXT* nx_context)
+{
+    UINT jitter_percent = rand() % (MAX_EXPONENTIAL_BACKOFF_JITTER_PERCENT + 1);
+    ULONG backoff_secs  = MAX_EXPONENTIAL_BACKOFF_IN_SEC;
+
+    // Doubles from the initial delay until it reaches the cap, then jitter spreads out a fleet coming back together
+    if (nx_context->reconnect_attempts < 16)
+    {
+        backoff_secs = INITIAL_EXPONENTIAL_BACKOFF_IN_SEC << nx_context->reconnect_attempts;
+    }
+
+    if (backoff_secs >= MAX_EXPONENTIAL_BACKOFF_IN_SEC)
+    {
+        backoff_secs = MAX_EXPONENTIAL_BACKOFF_IN_SEC;
+    }
+    else
+    {
+        nx_context->reconnect_attempts++;
+    }
+
+    return (backoff_secs * (100 + jitter_percent) / 100) * TX_TIMER_TICKS_PER_SECOND;
+}
+
+static VOID reconnect_schedule(AZURE_IOT_NX_CONTEXT* nx_context)
+{
+    UINT active;
+    ULONG backoff;
+    ULONG seed;
+    CHAR* id;
+
+    // Already waiting on the timer
+    if (tx_timer_info_get(&nx_context->reconnect_timer, NX_NULL, &active, NX_NULL, NX_NULL, NX_NULL) == TX_SUCCESS &&
+        active == TX_TRUE)
+    {
+        return;
+    }
+
+    // Mix in the device identity so a fleet that lost the hub together does not draw the same jitter
+    if (nx_context->reconnect_attempts == 0)
+    {
+        seed = tx_time_get();
+        for (id = nx_context->azure_iot_device_id; *id != 0; id++)
+        {
+            seed = seed * 31 + *id;
+        }
+        srand(seed);
+    }
+
+    backoff = reconnect_backoff_ticks(nx_context);
+
+    printf("Reconnecting to IoT Hub in %lu seconds\r\n", backoff / TX_TIMER_TICKS_PER_SECOND);
+
+    tx_timer_change(&nx_context->reconnect_timer, backoff, 0);
+    tx_timer_activate(&nx_context->reconnect_timer);
+}
+
+// The middleware runs the TCP connect, TLS handshake and MQTT CONNECT as one call, they are timed together
+static UINT hub_client_connect(AZURE_IOT_NX_CONTEXT* nx_context)
+{
+    ULONG hub_address;
+    UINT status;
+
+    // The middleware looks the hub up through the DNS client, which asks one server at a time. Racing the servers
+    // here first leaves the fastest one at the head of that list, the middleware's own lookup is not raced.
+    if ((status = dns_resolver_host_by_name_get(
+             nx_context->azure_iot_hub_hostname, &hub_address, 5 * NX_IP_PERIODIC_RATE)))
+    {
+        printf("Failed to resolve %s ahead of connect (0x%08x)\r\n", nx_context->azure_iot_hub_hostname, status);
+    }
+
+    tls_handshake_stats_start(&nx_context->tls_stats);
+
+    status = nx_azure_iot_hub_client_connect(&nx_context->iothub_client, NX_TRUE, HUB_CONNECT_TIMEOUT_TICKS);
+
+    tls_handshake_stats_update(&nx_context->tls_stats, status);
+
+    return status;
+}
+
+static UINT reconnect(AZURE_IOT_NX_CONTEXT* nx_context)
+{
+    UINT status;
+
+    // Tear down whatever is left of the previous session before starting a new one
+    if (!nx_context->provisioning_required)
+    {
+        nx_azure_iot_hub_client_disconnect(&nx_context->iothub_client);
+
+        status = hub_client_connect(nx_context);
+
+        // Hub no longer recognises this device, it may have been moved to another hub so go back through DPS
+        if ((status == NXD_MQTT_ERROR_BAD_USERNAME_PASSWORD || status == NXD_MQTT_ERROR_NOT_AUTHORIZED) &&
+            nx_context->dps_id_scope != NX_NULL)
+        {
+            printf("IoT Hub rejected the device identity (0x%08x), re-provisioning\r\n", status);
+            nx_azure_iot_hub_client_deinitialize(&nx_context->iothub_client);
+            dps_cache_invalidate(&nx_context->dps_cache);
+            nx_context->provisioning_required = NX_TRUE;
+        }
+        else if (status)
+        {
+            printf("Failed on nx_azure_iot_hub_client_connect (0x%08x)\r\n", status);
+            return status;
+        }
+    }
+
+    if (nx_context->provisioning_required)
+    {
+        if ((status = dps_register(nx_context)))
+        {
+            return status;
+        }
+
+        nx_context->provisioning_required = NX_FALSE;
+
+        // The device may now have a fresh twin on another hub
+        reported_properties_queue_acknowledged_clear(&nx_context->reported_properties_queue);
+
+        if ((status = hub_client_connect(nx_context)))
+        {
+            printf("Failed on nx_azure_iot_hub_client_connect (0x%08x)\r\n", status);
+            return status;
+        }
+    }
+
+    nx_context->connected          = NX_TRUE;
+    nx_context->reconnect_attempts = 0;
+
+    // A clean session drops the subscriptions, restore them
+    if ((status = nx_azure_iot_hub_client_direct_method_enable(&nx_context->iothub_client)))
+    {
+        printf("ERROR: direct method receive enable failed (0x%08x)\r\n", status);
+    }
+
+    if ((status = nx_azure_iot_hub_client_device_twin_enable(&nx_context->iothub_client)))
+    {
+        printf("ERROR: device twin enabled failed (0x%08x)\r\n", status);
+    }
+
+    // Desired properties may have changed while we were away
+    if ((status = nx_azure_iot_hub_client_device_twin_properties_request(
+             &nx_context->iothub_client, HUB_CONNECT_TIMEOUT_TICKS)))
+    {
+        printf("ERROR: failed to request device twin (0x%08x)\r\n", status);
+    }
+
+    // Attempts lost to the dropped connection do not count against the pending patch
+    nx_context->reported_properties_attempts = 0;
+    tx_event_flags_set(&nx_context->events, REPORTED_PROPERTIES_EVENT, TX_OR);
+#ifdef AZURE_IOT_STORE_FORWARD_ENABLE
+    tx_event_flags_set(&nx_context->events, TELEMETRY_REPLAY_EVENT, TX_OR);
+#endif
+
+    return NX_SUCCESS;
+}
+
+static VOID process_reconnect(AZURE_IOT_NX_CONTEXT* nx_context)
+{
+    if (nx_context->connected)
+    {
+        return;
+    }
+
+    if (reconnect(nx_context))
+    {
+        reconnect_schedule(nx_context);
+    }
+}
+
+static VOID event_thread(ULONG parameter)
+{
+    ULONG app_events;
+
+    AZURE_IOT_NX_CONTEXT* context = (AZURE_IOT_NX_CONTEXT*)parameter;
+
+    // Every source of work raises an event, timed work has its own timer, so there is nothing to poll for
+    while (true)
+    {
+        tx_event_flags_get(&context->events, CLIENT_THREAD_EVENTS, TX_OR_CLEAR, &app_events, TX_WAIT_FOREVER);
+
+        // Commands are latency sensitive, serve them ahead of twin and telemetry traffic
+        if (app_events & DIRECT_METHOD_EVENT)
+        {
+            process_direct_method(context);
+        }
+
+        if ((app_events & CONNECTION_LOST_EVENT) && !context->connected)
+        {
+            reconnect_schedule(context);
+        }
+
+        if (app_events & RECONNECT_EVENT)
+        {
+            process_reconnect(context);
+        }
+
+        if (app_events & DEVICE_TWIN_DESIRED_PROPERTY_EVENT)
+        {
+            process_direct_method_pending(context);
+            process_device_twin_desired_property(context);
+        }
+
+        if (app_events & DEVICE_TWIN_GET_EVENT)
+        {
+            process_direct_method_pending(context);
+            process_device_twin_get(context);
+        }
+
+        if (app_events & REPORTED_PROPERTIES_EVENT)
+        {
+            process_direct_method_pending(context);
+            process_reported_properties(context);
+        }
+
+#ifdef AZURE_IOT_TELEMETRY_BATCH_ENABLE
+        if (app_events & TELEMETRY_BATCH_EVENT)
+        {
+            // Batch latency budget expired, ship whatever has accumulated
+            if (telemetry_batch_flush(&context->telemetry_batch) == NX_SUCCESS)
+            {
+                app_events |= TELEMETRY_QUEUE_EVENT;
+            }
+        }
+#endif
+
+        if (app_events & TELEMETRY_QUEUE_EVENT)
+        {
+            process_telemetry_queue(context);
+        }
+
+#ifdef AZURE_IOT_STORE_FORWARD_ENABLE
+        // The backlog follows every drain of the live queue
+        if (app_events & (TELEMETRY_QUEUE_EVENT | TELEMETRY_REPLAY_EVENT))
+        {
+            process_telemetry_replay(context);
+        }
+#endif
+    }
+}
+
+static UINT azure_iot_nx_client_hub_create_internal(AZURE_IOT_NX_CONTEXT* context)
+{
+    UINT status;
+
+    printf("Initializing Azure IoT Hub client\r\n");
+    printf("\tHub hostname: %s\r\n", context->azure_iot_hub_hostname);
+    printf("\tDevice id: %s\r\n", context->azure_iot_device_id);
+    printf("\tModel id: %s\r\n", context->azure_iot_model_id);
+
+    // Initialize IoT Hub client.
+    if ((status = nx_azure_iot_hub_client_initialize(&context->iothub_client,
+             &context->nx_azure_iot,
+             (UCHAR*)context->azure_iot_hub_hostname,
+             strlen(context->azure_iot_hub_hostname),
+             (UCHAR*)context->azure_iot_device_id,
+             strlen(context->azure_iot_device_id),
+             (UCHAR*)MODULE_ID,
+             strlen(MODULE_ID),
+             _nx_azure_iot_tls_supported_crypto,
+             _nx_azure_iot_tls_supported_crypto_size,
+             _nx_azure_iot_tls_ciphersuite_map,
+             _nx_azure_iot_tls_ciphersuite_map_size,
+             (UCHAR*)context->nx_azure_iot_tls_metadata_buffer,
+             sizeof(context->nx_azure_iot_tls_metadata_buffer),
+             &context->root_ca_cert)))
+    {
+        printf("ERROR: on nx_azure_iot_hub_client_initialize (0x%08x)\r\n", status);
+        return status;
+    }
+
+    // Set credentials
+    if (context->azure_iot_auth_mode == AZURE_IOT_AUTH_MODE_SAS)
+    {
+        // Symmetric (SAS) Key
+        if ((status = nx_azure_iot_hub_client_symmetric_key_set(&context->iothub_client,
+                 (UCHAR*)context->azure_iot_device_sas_key,
+                 context->azure_iot_device_sas_key_len)))
+        {
+            printf("ERROR: failed on nx_azure_iot_hub_client_symmetric_key_set (0x%08x)\r\n", status);
+        }
+    }
+    else if (context->azure_iot_auth_mode == AZURE_IOT_AUTH_MODE_CERT)
+    {
+        // X509 Certificate
+        if ((status = nx_azure_iot_hub_client_device_cert_set(&context->iothub_client, &context->device_certificate)))
+        {
+            printf("ERROR: failed on nx_azure_iot_hub_client_device_cert_set!: error code = 0x%08x\r\n", status);
+        }
+    }
+
+    // Set Model id
+    if ((status = nx_azure_iot_hub_client_model_id_set(
+             &context->iothub_client, (UCHAR*)context->azure_iot_model_id, strlen(context->azure_iot_model_id))))
+    {
+        printf("ERROR: nx_azure_iot_hub_client_model_id_set (0x%08x)\r\n", status);
+    }
+
+    // Set connection status callback
+    else if ((status = nx_azure_iot_hub_client_connection_status_callback_set(
+                  &context->iothub_client, connection_status_callback)))
+    {
+        printf("ERROR: failed on connection_status_callback (0x%08x)\r\n", status);
+    }
+
+    // Enable direct methods
+    else if ((status = nx_azure_iot_hub_client_direct_method_enable(&context->iothub_client)))
+    {
+        printf("ERROR: direct method receive enable failed (0x%08x)\r\n", status);
+    }
+
+    // Enable device twin
+    else if ((status = nx_azure_iot_hub_client_device_twin_enable(&context->iothub_client)))
+    {
+        printf("ERROR: device twin enabled failed (0x%08x)\r\n", status);
+    }
+
+    // Set device twin callback
+    else if ((status = nx_azure_iot_hub_client_receive_callback_set(&context->iothub_client,
+                  NX_AZURE_IOT_HUB_DEVICE_TWIN_PROPERTIES,
+                  message_receive_callback_twin,
+                  (VOID*)context)))
+    {
+        printf("ERROR: device twin callback set (0x%08x)\r\n", status);
+    }
+
+    // Set direct method callback
+    else if ((status = nx_azure_iot_hub_client_receive_callback_set(&context->iothub_client,
+                  NX_AZURE_IOT_HUB_DIRECT_METHOD,
+                  message_receive_direct_method,
+                  (VOID*)context)))
+    {
+        printf("ERROR: device method callback set (0x%08x)\r\n", status);
+    }
+
+    // Set the writeable property callback
+    else if ((status = nx_azure_iot_hub_client_receive_callback_set(&context->iothub_client,
+                  NX_AZURE_IOT_HUB_DEVICE_TWIN_DESIRED_PROPERTIES,
+                  message_receive_callback_desire_property,
+                  (VOID*)context)))
+    {
+        printf("ERROR: device twin desired property callback set (0x%08x)\r\n", status);
+    }
+
+    if (status != NX_AZURE_IOT_SUCCESS)
+    {
+        nx_azure_iot_hub_client_deinitialize(&context->iothub_client);
+    }
+
+    return status;
+}
+
+UINT azure_iot_nx_client_register_direct_method(AZURE_IOT_NX_CONTEXT* context, func_ptr_direct_method callback)
+{
+    if (context == NULL || context->direct_method_cb != NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    context->direct_method_cb = callback;
+    return NX_SUCCESS;
+}
+
+UINT azure_iot_nx_client_register_device_twin_desired_prop(
+    AZURE_IOT_NX_CONTEXT* context, func_ptr_device_twin_desired_prop callback)
+{
+    if (context == NULL || context->device_twin_desired_prop_cb != NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    context->device_twin_desired_prop_cb = callback;
+    return NX_SUCCESS;
+}
+
+UINT azure_iot_nx_client_register_device_twin_prop(AZURE_IOT_NX_CONTEXT* context, func_ptr_device_twin_prop callback)
+{
+    if (context == NULL || context->device_twin_get_cb != NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    context->device_twin_get_cb = callback;
+    return NX_SUCCESS;
+}
+
+UINT azure_iot_nx_client_sas_set(AZURE_IOT_NX_CONTEXT* context, CHAR* device_sas_key)
+{
+    if (device_sas_key[0] == 0)
+    {
+        printf("ERROR: azure_iot_nx_client_sas_set device_sas_key is null\r\n");
+        return NX_PTR_ERROR;
+    }
+
+    context->azure_iot_auth_mode          = AZURE_IOT_AUTH_MODE_SAS;
+    context->azure_iot_device_sas_key     = device_sas_key;
+    context->azure_iot_device_sas_key_len = strlen(device_sas_key);
+
+    return NX_SUCCESS;
+}
+
+// PKCS#1 RSAPrivateKey and SEC1 ECPrivateKey DER both open with a SEQUENCE holding an INTEGER version, 0 for RSA and 1
+// for EC
+static UINT device_key_type(const UCHAR* key, UINT key_len)
+{
+    UINT offset = 2;
+
+    if (key_len > 2 && key[0] == 0x30 && (key[1] & 0x80))
+    {
+        // Long form length
+        offset += key[1] & 0x7F;
+    }
+
+    if (key_len >= offset + 3 && key[0] == 0x30 && key[offset] == 0x02 && key[offset + 1] == 0x01 &&
+        key[offset + 2] == 0x01)
+    {
+        return NX_SECURE_X509_KEY_TYPE_EC_DER;
+    }
+
+    return NX_SECURE_X509_KEY_TYPE_RSA_PKCS1_DER;
+}
+
+UINT azure_iot_nx_client_cert_set(AZURE_IOT_NX_CONTEXT* context,
+    UCHAR* device_x509_cert,
+    UINT device_x509_cert_len,
+    UCHAR* device_x509_key,
+    UINT device_x509_key_len)
+{
+    UINT key_type;
+    UINT status;
+
+    if (device_x509_cert[0] == 0 || device_x509_cert_len == 0 || device_x509_key[0] == 0 || device_x509_key_len == 0)
+    {
+        printf("ERROR: azure_iot_nx_client_cert_set cert/key is null\r\n");
+        return NX_PTR_ERROR;
+    }
+
+    key_type = device_key_type(device_x509_key, device_x509_key_len);
+
+#ifndef NX_AZURE_IOT_TLS_PROFILE_ECC
+    if (key_type == NX_SECURE_X509_KEY_TYPE_EC_DER)
+    {
+        printf("ERROR: ECC device certificates need NX_AZURE_IOT_TLS_PROFILE_ECC\r\n");
+        return NX_NOT_SUPPORTED;
+    }
+#endif
+
+    context->azure_iot_auth_mode = AZURE_IOT_AUTH_MODE_CERT;
+
+    // Create the device certificate
+    if ((status = nx_secure_x509_certificate_initialize(&context->device_certificate,
+             (UCHAR*)device_x509_cert,
+             (USHORT)device_x509_cert_len,
+             NX_NULL,
+             0,
+             (UCHAR*)device_x509_key,
+             (USHORT)device_x509_key_len,
+             key_type)))
+    {
+        printf("Error: Failed on device nx_secure_x509_certificate_initialize!: error code = 0x%08x\r\n", status);
+    }
+
+    return NX_SUCCESS;
+}
+
+// Delete what azure_iot_nx_client_create made before the Azure IoT handler, newest first
+static VOID client_resources_delete(AZURE_IOT_NX_CONTEXT* context)
+{
+#ifdef AZURE_IOT_STORE_FORWARD_ENABLE
+    tx_timer_deactivate(&context->replay_timer);
+    tx_timer_delete(&context->replay_timer);
+    store_forward_delete(&context->store_forward);
+#endif
+#ifdef AZURE_IOT_TELEMETRY_BATCH_ENABLE
+    telemetry_batch_delete(&context->telemetry_batch);
+#endif
+    tx_timer_deactivate(&context->properties_retry_timer);
+    tx_timer_delete(&context->properties_retry_timer);
+    reported_properties_queue_delete(&context->reported_properties_queue);
+    tx_timer_deactivate(&context->reconnect_timer);
+    tx_timer_delete(&context->reconnect_timer);
+    telemetry_queue_delete(&context->telemetry_queue);
+    tx_event_flags_delete(&context->events);
+}
+
+UINT azure_iot_nx_client_create(AZURE_IOT_NX_CONTEXT* context,
+    NX_IP* nx_ip,
+    NX_PACKET_POOL* nx_pool,
+    NX_DNS* nx_dns,
+    UINT (*unix_time_callback)(ULONG* unix_time),
+    CHAR* iot_model_id)
+{
+    NX_PACKET_POOL* telemetry_pool;
+    UINT status;
+
+    if (iot_model_id[0] == 0)
+    {
+        printf("ERROR: UINT azure_iot_nx_client_create_new empty device_id or model_id\r\n");
+        return NX_PTR_ERROR;
+    }
+
+    // Initialise the context
+    memset(context, 0, sizeof(AZURE_IOT_NX_CONTEXT));
+
+    // Stash parameters
+    context->azure_iot_model_id = iot_model_id;
+    context->unix_time_get      = unix_time_callback;
+    context->nx_pool            = nx_pool;
+
+    if ((status = tx_event_flags_create(&context->events, "nx_client")))
     {
         printf("ERROR: failed on create nx_client event flags (0x%08x)\r\n", status);
         return status;
     }
 
+    // Queued messages are built in the small size class of the cloud pool where the board has one, a message is
+    // mostly far smaller than a TLS record
+    telemetry_pool = packet_pool_get(PACKET_POOL_CLOUD_SMALL);
+    if (telemetry_pool == NX_NULL)
+    {
+        telemetry_pool = nx_pool;
+    }
+
+    if ((status = telemetry_queue_create(&context->telemetry_queue, telemetry_pool, TELEMETRY_QUEUE_DROP_OLDEST)))
+    {
+        printf("ERROR: failed on create telemetry queue (0x%08x)\r\n", status);
+        tx_event_flags_delete(&context->events);
+        return status;
+    }
+
+    if ((status = tx_timer_create(&context->reconnect_timer,
+             "nx_client reconnect",
+             reconnect_timer_expired,
+             (ULONG)context,
+             INITIAL_EXPONENTIAL_BACKOFF_IN_SEC * TX_TIMER_TICKS_PER_SECOND,
+             0,
+             TX_NO_ACTIVATE)))
+    {
+        printf("ERROR: failed on create reconnect timer (0x%08x)\r\n", status);
+        telemetry_queue_delete(&context->telemetry_queue);
+        tx_event_flags_delete(&context->events);
+        return status;
+    }
+
+    if ((status = reported_properties_queue_create(&context->reported_properties_queue)))
+    {
+        printf("ERROR: failed on create reported properties queue (0x%08x)\r\n", status);
+        tx_timer_delete(&context->reconnect_timer);
+        telemetry_queue_delete(&context->telemetry_queue);
+        tx_event_flags_delete(&context->events);
+        return status;
+    }
+
+    if ((status = tx_timer_create(&context->properties_retry_timer,
+             "reported properties retry",
+             properties_retry_timer_expired,
+             (ULONG)context,
+             PROPERTIES_RETRY_TICKS,
+             0,
+             TX_NO_ACTIVATE)))
+    {
+        printf("ERROR: failed on create reported properties retry timer (0x%08x)\r\n", status);
+        reported_properties_queue_delete(&context->reported_properties_queue);
+        tx_timer_delete(&context->reconnect_timer);
+        telemetry_queue_delete(&context->telemetry_queue);
+        tx_event_flags_delete(&context->events);
+        return status;
+    }
+
+#ifdef AZURE_IOT_TELEMETRY_BATCH_ENABLE
+    if ((status = telemetry_batch_create(
+             &context->telemetry_batch, &context->telemetry_queue, &context->events, TELEMETRY_BATCH_EVENT)))
+    {
+        printf("ERROR: failed on create telemetry batch (0x%08x)\r\n", status);
+        tx_timer_delete(&context->properties_retry_timer);
+        reported_properties_queue_delete(&context->reported_properties_queue);
+        tx_timer_delete(&context->reconnect_timer);
+        telemetry_queue_delete(&context->telemetry_queue);
+        tx_event_flags_delete(&context->events);
+        return status;
+    }
+#endif
+
+#ifdef AZURE_IOT_STORE_FORWARD_ENABLE
+    if ((status = store_forward_create(&context->store_forward)))
+    {
+        printf("ERROR: failed on create store forward (0x%08x)\r\n", status);
+#ifdef AZURE_IOT_TELEMETRY_BATCH_ENABLE
+        telemetry_batch_delete(&context->telemetry_batch);
+#endif
+        tx_timer_delete(&context->properties_retry_timer);
+        reported_properties_queue_delete(&context->reported_properties_queue);
+        tx_timer_delete(&context->reconnect_timer);
+        telemetry_queue_delete(&context->telemetry_queue);
+        tx_event_flags_delete(&context->events);
+        return status;
+    }
+
+    if ((status = tx_timer_create(&context->replay_timer,
+             "telemetry replay",
+             replay_timer_expired,
+             (ULONG)context,
+             TELEMETRY_REPLAY_PERIOD_TICKS,
+             TELEMETRY_REPLAY_PERIOD_TICKS,
+             TX_NO_ACTIVATE)))
+    {
+        printf("ERROR: failed on create telemetry replay timer (0x%08x)\r\n", status);
+        store_forward_delete(&context->store_forward);
+#ifdef AZURE_IOT_TELEMETRY_BATCH_ENABLE
+        telemetry_batch_delete(&context->telemetry_batch);
+#endif
+        tx_timer_delete(&context->properties_retry_timer);
+        reported_properties_queue_delete(&context->reported_properties_queue);
+        tx_timer_delete(&context->reconnect_timer);
+        telemetry_queue_delete(&context->telemetry_queue);
+        tx_event_flags_delete(&context->events);
+        return status;
+    }
+#endif
+
     // Create Azure IoT handler
     if ((status = nx_azure_iot_create(&context->nx_azure_iot,
              (UCHAR*)"Azure IoT",
@@ -474,6 +1316,7 @@ UINT azure_iot_nx_client_create(AZURE_IOT_NX_CONTEXT* context,
              unix_time_callback)))
     {
         printf("ERROR: failed on nx_azure_iot_create (0x%08x)\r\n", status);
+        client_resources_delete(context);
         return status;
     }
 
@@ -489,6 +1332,7 @@ UINT azure_iot_nx_client_create(AZURE_IOT_NX_CONTEXT* context,
     {
         printf("Failed to initialize ROOT CA certificate!: error code = 0x%08x\r\n", status);
         nx_azure_iot_delete(&context->nx_azure_iot);
+        client_resources_delete(context);
         return status;
     }
 
@@ -517,7 +1361,7 @@ UINT azure_iot_nx_client_hub_create(AZURE_IOT_NX_CONTEXT* context, CHAR* iot_hub
     return azure_iot_nx_client_hub_create_internal(context);
 }
 
-UINT azure_iot_nx_client_dps_create(AZURE_IOT_NX_CONTEXT* context, CHAR* dps_id_scope, CHAR* dps_registration_id)
+static UINT dps_register(AZURE_IOT_NX_CONTEXT* context)
 {
     UINT status;
     CHAR payload[DPS_PAYLOAD_SIZE];
@@ -526,21 +1370,8 @@ UINT azure_iot_nx_client_dps_create(AZURE_IOT_NX_CONTEXT* context, CHAR* dps_id_
 
     printf("Initializing Azure IoT DPS client\r\n");
     printf("\tDPS endpoint: %s\r\n", AZURE_IOT_DPS_ENDPOINT);
-    printf("\tDPS ID scope: %s\r\n", dps_id_scope);
-    printf("\tRegistration ID: %s\r\n", dps_registration_id);
-
-    if (context == NULL)
-    {
-        printf("ERROR: context is NULL\r\n");
-        return NX_PTR_ERROR;
-    }
-
-    // Return error if empty credentials
-    if (dps_id_scope[0] == 0 || dps_registration_id[0] == 0)
-    {
-        printf("ERROR: azure_iot_nx_client_dps_create incorrect parameters\r\n");
-        return NX_PTR_ERROR;
-    }
+    printf("\tDPS ID scope: %s\r\n", context->dps_id_scope);
+    printf("\tRegistration ID: %s\r\n", context->dps_registration_id);
 
     if (snprintf(payload, sizeof(payload), DPS_PAYLOAD, context->azure_iot_model_id) > DPS_PAYLOAD_SIZE - 1)
     {
@@ -553,10 +1384,10 @@ UINT azure_iot_nx_client_dps_create(AZURE_IOT_NX_CONTEXT* context, CHAR* dps_id_
              &context->nx_azure_iot,
              (UCHAR*)AZURE_IOT_DPS_ENDPOINT,
              strlen(AZURE_IOT_DPS_ENDPOINT),
-             (UCHAR*)dps_id_scope,
-             strlen(dps_id_scope),
-             (UCHAR*)dps_registration_id,
-             strlen(dps_registration_id),
+             (UCHAR*)context->dps_id_scope,
+             strlen(context->dps_id_scope),
+             (UCHAR*)context->dps_registration_id,
+             strlen(context->dps_registration_id),
              _nx_azure_iot_tls_supported_crypto,
              _nx_azure_iot_tls_supported_crypto_size,
              _nx_azure_iot_tls_ciphersuite_map,
@@ -602,8 +1433,8 @@ UINT azure_iot_nx_client_dps_create(AZURE_IOT_NX_CONTEXT* context, CHAR* dps_id_
     {
         while (true)
         {
-            if ((status = nx_azure_iot_provisioning_client_register(&context->dps_client, DPS_REGISTER_TIMEOUT_TICKS) ==
-                          NX_AZURE_IOT_PENDING))
+            status = nx_azure_iot_provisioning_client_register(&context->dps_client, DPS_REGISTER_TIMEOUT_TICKS);
+            if (status == NX_AZURE_IOT_PENDING)
             {
                 printf("\tPending DPS connection, retrying\r\n");
                 continue;
@@ -637,18 +1468,128 @@ UINT azure_iot_nx_client_dps_create(AZURE_IOT_NX_CONTEXT* context, CHAR* dps_id_
         return status;
     }
 
-
     // Null terminate returned values
     context->azure_iot_hub_hostname[iot_hub_hostname_len] = 0;
     context->azure_iot_device_id[iot_device_id_len]       = 0;
 
     printf("SUCCESS: Azure IoT DPS client initialized\r\n\r\n");
 
+    context->identity_cached = NX_FALSE;
+
+    if (context->dps_cache.driver != NX_NULL &&
+        (status = dps_cache_save(&context->dps_cache,
+             context->dps_id_scope,
+             context->dps_registration_id,
+             context->azure_iot_hub_hostname,
+             context->azure_iot_device_id)))
+    {
+        // Not fatal, the next boot provisions again
+        printf("ERROR: failed to cache DPS assignment (0x%08x)\r\n", status);
+    }
+
     return azure_iot_nx_client_hub_create_internal(context);
 }
 
+UINT azure_iot_nx_client_dps_create(AZURE_IOT_NX_CONTEXT* context, CHAR* dps_id_scope, CHAR* dps_registration_id)
+{
+    if (context == NULL)
+    {
+        printf("ERROR: context is NULL\r\n");
+        return NX_PTR_ERROR;
+    }
+
+    // Return error if empty credentials
+    if (dps_id_scope[0] == 0 || dps_registration_id[0] == 0)
+    {
+        printf("ERROR: azure_iot_nx_client_dps_create incorrect parameters\r\n");
+        return NX_PTR_ERROR;
+    }
+
+    // Stash parameters
+    context->dps_id_scope        = dps_id_scope;
+    context->dps_registration_id = dps_registration_id;
+
+    if (context->dps_cache.driver != NX_NULL &&
+        dps_cache_load(&context->dps_cache,
+            dps_id_scope,
+            dps_registration_id,
+            context->azure_iot_hub_hostname,
+            sizeof(context->azure_iot_hub_hostname),
+            context->azure_iot_device_id,
+            sizeof(context->azure_iot_device_id)) == NX_SUCCESS)
+    {
+        printf("Using cached DPS assignment\r\n");
+        printf("\tIoT Hub hostname: %s\r\n", context->azure_iot_hub_hostname);
+        printf("\tDevice id: %s\r\n\r\n", context->azure_iot_device_id);
+
+        context->identity_cached = NX_TRUE;
+
+        return azure_iot_nx_client_hub_create_internal(context);
+    }
+
+    return dps_register(context);
+}
+
+UINT azure_iot_nx_client_dps_cache_set(
+    AZURE_IOT_NX_CONTEXT* context, const FLASH_DRIVER* driver, ULONG first_sector, ULONG sector_count)
+{
+    UINT status;
+
+    if (context == NULL || driver == NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    if ((status = dps_cache_open(&context->dps_cache, driver, first_sector, sector_count)))
+    {
+        printf("ERROR: failed to open DPS cache (0x%08x)\r\n", status);
+        context->dps_cache.driver = NX_NULL;
+        return status;
+    }
+
+    return NX_SUCCESS;
+}
+
+// Forget a cached assignment the hub did not accept and ask DPS for a fresh one
+static UINT dps_cache_reprovision(AZURE_IOT_NX_CONTEXT* context)
+{
+    UINT status;
+
+    printf("IoT Hub did not accept the cached DPS assignment, re-provisioning\r\n");
+
+    dps_cache_invalidate(&context->dps_cache);
+    context->identity_cached = NX_FALSE;
+
+    nx_azure_iot_hub_client_deinitialize(&context->iothub_client);
+
+    if ((status = dps_register(context)))
+    {
+        return status;
+    }
+
+    if ((status = hub_client_connect(context)))
+    {
+        printf("Failed on nx_azure_iot_hub_client_connect (0x%08x)\r\n", status);
+    }
+
+    return status;
+}
+
 UINT azure_iot_nx_client_delete(AZURE_IOT_NX_CONTEXT* context)
 {
+    // Stop the client thread and the timers that wake it before anything it uses goes away. A thread that was never
+    // started just fails these calls.
+    tx_thread_terminate(&context->azure_iot_thread);
+    tx_thread_delete(&context->azure_iot_thread);
+
+    tx_timer_deactivate(&context->reconnect_timer);
+    tx_timer_deactivate(&context->properties_retry_timer);
+#ifdef AZURE_IOT_STORE_FORWARD_ENABLE
+    tx_timer_deactivate(&context->replay_timer);
+#endif
+
+    context->connected = NX_FALSE;
+
     // Destroy IoTHub Client
     nx_azure_iot_hub_client_disconnect(&context->iothub_client);
     nx_azure_iot_hub_client_deinitialize(&context->iothub_client);
@@ -656,6 +1597,8 @@ UINT azure_iot_nx_client_delete(AZURE_IOT_NX_CONTEXT* context)
     // Destroy the common object
     nx_azure_iot_delete(&context->nx_azure_iot);
 
+    client_resources_delete(context);
+
     return NX_SUCCESS;
 }
 
@@ -664,12 +1607,19 @@ UINT azure_iot_nx_client_connect(AZURE_IOT_NX_CONTEXT* context)
     UINT status;
 
     // Connect to IoTHub client
-    if ((status = nx_azure_iot_hub_client_connect(&context->iothub_client, NX_TRUE, HUB_CONNECT_TIMEOUT_TICKS)))
+    if ((status = hub_client_connect(context)))
     {
         printf("Failed on nx_azure_iot_hub_client_connect (0x%08x)\r\n", status);
-        return status;
+
+        // A cached hub may have been deleted or the device moved, any failure is worth one trip through DPS
+        if (!context->identity_cached || (status = dps_cache_reprovision(context)))
+        {
+            return status;
+        }
     }
 
+    context->connected = NX_TRUE;
+
     if ((status = tx_thread_create(&context->azure_iot_thread,
              "Nx Thread",
              event_thread,
@@ -721,262 +1671,402 @@ UINT azure_iot_nx_client_device_twin_request_and_wait(AZURE_IOT_NX_CONTEXT* cont
 }
 
 UINT azure_iot_nx_client_publish_telemetry(
-    AZURE_IOT_NX_CONTEXT* context, UINT (*append_properties)(NX_AZURE_IOT_JSON_WRITER* json_builder_ptr, VOID* context))
+    AZURE_IOT_NX_CONTEXT* context, TELEMETRY_ENCODING encoding, func_ptr_telemetry_append append_properties)
 {
     UINT status;
     NX_PACKET* packet_ptr;
-    NX_AZURE_IOT_JSON_WRITER json_builder;
-    UINT telemetry_length;
-    UCHAR buffer[PUBLISH_BUFFER_SIZE];
+    UINT topic_length;
+    UINT payload_length;
+    UCHAR packet_id[MQTT_PACKET_ID_SIZE];
+    TELEMETRY_WRITER writer;
 
-    if ((status = nx_azure_iot_pnp_helper_telemetry_message_create(
-             &context->iothub_client, NX_NULL, 0, &packet_ptr, NX_WAIT_FOREVER)))
+    if ((status = telemetry_packet_create(
+             context, encoding, TELEMETRY_NO_SEQUENCE, &packet_ptr, &topic_length, packet_id, NX_WAIT_FOREVER)))
     {
-        printf("Telemetry message create failed!: error code = 0x%08x\r\n", status);
-        return (status);
+        return status;
     }
 
-    if ((status = nx_azure_iot_json_writer_with_buffer_init(&json_builder, buffer, PUBLISH_BUFFER_SIZE)))
+    // Writer appends to the packet, chaining more from the pool as the message grows
+    if ((status = telemetry_writer_init(&writer, encoding, packet_ptr, NX_WAIT_FOREVER)))
     {
-        printf("Failed to initialize json writer\r\n");
+        printf("Failed to initialize telemetry writer\r\n");
         nx_azure_iot_hub_client_telemetry_message_delete(packet_ptr);
         return NX_NOT_SUCCESSFUL;
     }
 
-    if ((status = nx_azure_iot_pnp_helper_build_reported_property(NULL, 0, append_properties, NX_NULL, &json_builder)))
+    if ((status = telemetry_writer_build(&writer, append_properties, NX_NULL)))
     {
-        printf("Failed to build telemetry!: error code = 0x%08x\r\n", status);
-        nx_azure_iot_json_writer_deinit(&json_builder);
+        // Nothing changed beyond its deadband, not an error
+        if (status != NX_NOT_FOUND)
+        {
+            printf("Failed to build telemetry!: error code = 0x%08x\r\n", status);
+        }
+
+        telemetry_writer_deinit(&writer);
         nx_azure_iot_hub_client_telemetry_message_delete(packet_ptr);
         return status;
     }
 
-    telemetry_length = nx_azure_iot_json_writer_get_bytes_used(&json_builder);
-    if ((status = nx_azure_iot_hub_client_telemetry_send(
-             &context->iothub_client, packet_ptr, buffer, telemetry_length, NX_WAIT_FOREVER)))
+    payload_length = telemetry_writer_get_bytes_used(&writer);
+    telemetry_writer_deinit(&writer);
+
+    if ((status = telemetry_packet_publish(context, packet_ptr, topic_length, packet_id, NX_WAIT_FOREVER)))
     {
-        printf("Telemetry message send failed (0x%08x)\r\n", status);
-        nx_azure_iot_json_writer_deinit(&json_builder);
-        nx_azure_iot_hub_client_telemetry_message_delete(packet_ptr);
+        telemetry_writer_deadbands_release(&writer);
         return status;
     }
 
-    printf("Telemetry message sent: %.*s.\r\n", telemetry_length, buffer);
-
-    nx_azure_iot_json_writer_deinit(&json_builder);
+    printf("Telemetry message sent (%d bytes)\r\n", payload_length);
 
-    return status;
+    return NX_SUCCESS;
 }
 
-UINT azure_iot_nx_client_publish_properties(AZURE_IOT_NX_CONTEXT* context,
-    CHAR* component,
-    UINT (*append_properties)(NX_AZURE_IOT_JSON_WRITER* json_builder_ptr, VOID* context))
+UINT azure_iot_nx_client_publish_telemetry_async(AZURE_IOT_NX_CONTEXT* context,
+    TELEMETRY_ENCODING encoding,
+    func_ptr_telemetry_append append_properties,
+    func_ptr_telemetry_complete complete_cb,
+    VOID* complete_context)
 {
-    UINT reported_properties_length;
     UINT status;
-    UINT response_status;
-    UINT request_id;
-    NX_AZURE_IOT_JSON_WRITER json_builder;
-    ULONG reported_property_version;
-    UCHAR buffer[PUBLISH_BUFFER_SIZE];
 
-    if ((status = nx_azure_iot_json_writer_with_buffer_init(&json_builder, buffer, PUBLISH_BUFFER_SIZE)))
+    if (context == NULL)
     {
-        printf("Failed to initialize json writer\r\n");
-        return NX_NOT_SUCCESSFUL;
+        printf("ERROR: context is NULL\r\n");
+        return NX_PTR_ERROR;
     }
 
-    if ((status = nx_azure_iot_pnp_helper_build_reported_property(
-             (UCHAR*)component, strlen(component), append_properties, NX_NULL, &json_builder)))
+    if ((status = telemetry_queue_push(
+             &context->telemetry_queue, encoding, append_properties, complete_cb, complete_context)))
     {
-        printf("Failed to build reported property!: error code = 0x%08x\r\n", status);
-        nx_azure_iot_json_writer_deinit(&json_builder);
+        if (status != NX_NOT_FOUND)
+        {
+            printf("Telemetry message enqueue failed (0x%08x)\r\n", status);
+        }
+
         return status;
     }
 
-    reported_properties_length = nx_azure_iot_json_writer_get_bytes_used(&json_builder);
-    if ((status = nx_azure_iot_hub_client_device_twin_reported_properties_send(&context->iothub_client,
-             buffer,
-             reported_properties_length,
-             &request_id,
-             &response_status,
-             &reported_property_version,
-             (5 * NX_IP_PERIODIC_RATE))))
+    // Wake the client thread to drain the queue
+    tx_event_flags_set(&context->events, TELEMETRY_QUEUE_EVENT, TX_OR);
+
+    return NX_SUCCESS;
+}
+
+UINT azure_iot_nx_client_telemetry_queue_policy_set(AZURE_IOT_NX_CONTEXT* context, TELEMETRY_QUEUE_POLICY policy)
+{
+    if (context == NULL)
     {
-        printf("Device twin reported properties failed!: error code = 0x%08x\r\n", status);
-        nx_azure_iot_json_writer_deinit(&json_builder);
-        return status;
+        return NX_PTR_ERROR;
     }
 
-    nx_azure_iot_json_writer_deinit(&json_builder);
+    return telemetry_queue_policy_set(&context->telemetry_queue, policy);
+}
 
-    if ((response_status < 200) || (response_status >= 300))
+UINT azure_iot_nx_client_telemetry_queue_stats_get(AZURE_IOT_NX_CONTEXT* context, TELEMETRY_QUEUE_STATS* stats)
+{
+    if (context == NULL)
     {
-        printf("device twin report properties failed with code : %d\r\n", response_status);
-        return NX_NOT_SUCCESSFUL;
+        return NX_PTR_ERROR;
     }
 
-    printf("Device twin property sent: %.*s.\r\n", reported_properties_length, buffer);
-
-    return status;
+    return telemetry_queue_stats_get(&context->telemetry_queue, stats);
 }
 
-UINT azure_iot_nx_client_publish_float_property(AZURE_IOT_NX_CONTEXT* context, CHAR* key, float value)
+#ifdef AZURE_IOT_TELEMETRY_BATCH_ENABLE
+UINT azure_iot_nx_client_publish_telemetry_batched(
+    AZURE_IOT_NX_CONTEXT* context, func_ptr_telemetry_append append_properties)
 {
     UINT status;
-    UINT response_status;
-    UINT request_id;
-    ULONG version;
-    CHAR buffer[PUBLISH_BUFFER_SIZE];
+    ULONG timestamp       = 0;
+    uint64_t timestamp_ms = 0;
 
-    int intvalue  = value;
-    int fracvalue = abs(100 * (value - (long)value));
+    if (context == NULL)
+    {
+        printf("ERROR: context is NULL\r\n");
+        return NX_PTR_ERROR;
+    }
 
-    if (snprintf(buffer, PUBLISH_BUFFER_SIZE, "{\"%s\":%d.%2d}", key, intvalue, fracvalue) > PUBLISH_BUFFER_SIZE - 1)
+    if (context->timestamp_get)
     {
-        printf("ERROR: insufficient buffer size to publish float property\r\n");
-        return NX_SIZE_ERROR;
+        timestamp_ms = context->timestamp_get();
+    }
+    else if (context->unix_time_get)
+    {
+        context->unix_time_get(&timestamp);
+        timestamp_ms = (uint64_t)timestamp * 1000;
     }
 
-    if ((status = nx_azure_iot_hub_client_device_twin_reported_properties_send(&context->iothub_client,
-             (UCHAR*)buffer,
-             strlen(buffer),
-             &request_id,
-             &response_status,
-             &version,
-             NX_WAIT_FOREVER)))
+    if ((status = telemetry_batch_append(&context->telemetry_batch, timestamp_ms, append_properties)))
     {
-        printf("Device twin reported properties failed (0x%08x)\r\n", status);
         return status;
     }
 
-    if ((response_status < 200) || (response_status >= 300))
+    // The sample may have completed a batch, let the client thread pick it up
+    tx_event_flags_set(&context->events, TELEMETRY_QUEUE_EVENT, TX_OR);
+
+    return NX_SUCCESS;
+}
+
+UINT azure_iot_nx_client_telemetry_batch_set(AZURE_IOT_NX_CONTEXT* context, UINT max_samples, UINT max_delay_secs)
+{
+    if (context == NULL)
     {
-        printf("device twin report properties failed (%d)\r\n", response_status);
-        return status;
+        return NX_PTR_ERROR;
+    }
+
+    return telemetry_batch_config_set(
+        &context->telemetry_batch, max_samples, max_delay_secs * TX_TIMER_TICKS_PER_SECOND);
+}
+
+UINT azure_iot_nx_client_timestamp_set(AZURE_IOT_NX_CONTEXT* context, uint64_t (*timestamp_get)(VOID))
+{
+    if (context == NULL)
+    {
+        return NX_PTR_ERROR;
     }
 
-    printf("Device twin property sent: %s\r\n", buffer);
+    context->timestamp_get = timestamp_get;
 
     return NX_SUCCESS;
 }
 
-UINT azure_iot_nx_client_publish_bool_property(AZURE_IOT_NX_CONTEXT* context, CHAR* key, bool value)
+UINT azure_iot_nx_client_telemetry_batch_flush(AZURE_IOT_NX_CONTEXT* context)
 {
     UINT status;
-    UINT response_status;
-    UINT request_id;
-    ULONG version;
-    CHAR buffer[PUBLISH_BUFFER_SIZE];
 
-    if (snprintf(buffer, PUBLISH_BUFFER_SIZE, "{\"%s\":%s}", key, (value ? "true" : "false")) > PUBLISH_BUFFER_SIZE - 1)
+    if (context == NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    if ((status = telemetry_batch_flush(&context->telemetry_batch)) == NX_SUCCESS)
     {
-        printf("ERROR: Unsufficient buffer size to publish bool property\r\n");
-        return NX_SIZE_ERROR;
+        tx_event_flags_set(&context->events, TELEMETRY_QUEUE_EVENT, TX_OR);
     }
 
-    if ((status = nx_azure_iot_hub_client_device_twin_reported_properties_send(&context->iothub_client,
-             (UCHAR*)buffer,
-             strlen(buffer),
-             &request_id,
-             &response_status,
-             &version,
-             NX_WAIT_FOREVER)))
+    return status;
+}
+#endif
+
+#ifdef AZURE_IOT_STORE_FORWARD_ENABLE
+UINT azure_iot_nx_client_store_forward_flash_set(AZURE_IOT_NX_CONTEXT* context, const FLASH_DRIVER* driver)
+{
+    UINT status;
+
+    if (context == NULL || driver == NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    if ((status = flash_segment_log_open(&context->flash_log, driver)))
     {
-        printf("Error: device twin reported properties failed (0x%08x)\r\n", status);
+        printf("ERROR: failed to open telemetry flash log (0x%08x)\r\n", status);
         return status;
     }
 
-    if ((response_status < 200) || (response_status >= 300))
+    if ((status = store_forward_flash_attach(&context->store_forward, &context->flash_log)))
     {
-        printf("Error: device twin report properties failed (%d)\r\n", response_status);
+        printf("ERROR: failed to attach telemetry flash log (0x%08x)\r\n", status);
         return status;
     }
 
-    printf("Device twin property sent: %s\r\n", buffer);
+    // Pick up anything left over from the last boot
+    tx_event_flags_set(&context->events, TELEMETRY_REPLAY_EVENT, TX_OR);
 
     return NX_SUCCESS;
 }
 
-UINT azure_iot_nx_client_publish_int_writeable_property(AZURE_IOT_NX_CONTEXT* context, CHAR* key, UINT value)
+UINT azure_iot_nx_client_store_forward_rate_set(AZURE_IOT_NX_CONTEXT* context, UINT records_per_second)
+{
+    if (context == NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    return store_forward_replay_rate_set(&context->store_forward, records_per_second);
+}
+
+UINT azure_iot_nx_client_store_forward_stats_get(AZURE_IOT_NX_CONTEXT* context, STORE_FORWARD_STATS* stats)
+{
+    if (context == NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    return store_forward_stats_get(&context->store_forward, stats);
+}
+#endif
+
+UINT azure_iot_nx_client_dispatch_stats_get(AZURE_IOT_NX_CONTEXT* context, AZURE_IOT_NX_DISPATCH_STATS* stats)
+{
+    if (context == NULL || stats == NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    *stats = context->dispatch_stats;
+
+    return NX_SUCCESS;
+}
+
+UINT azure_iot_nx_client_tls_stats_get(AZURE_IOT_NX_CONTEXT* context, TLS_HANDSHAKE_STATS* stats)
+{
+    if (context == NULL || stats == NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    *stats = context->tls_stats;
+
+    return NX_SUCCESS;
+}
+
+UINT azure_iot_nx_client_publish_properties(AZURE_IOT_NX_CONTEXT* context,
+    CHAR* component,
+    UINT (*append_properties)(NX_AZURE_IOT_JSON_WRITER* json_builder_ptr, VOID* context))
 {
+    UINT reported_properties_length;
     UINT status;
     UINT response_status;
     UINT request_id;
-    ULONG version;
-    CHAR buffer[PUBLISH_BUFFER_SIZE];
+    NX_PACKET* packet_ptr;
+    NX_AZURE_IOT_JSON_WRITER json_builder;
+    ULONG reported_property_version;
+
+    // Serialize into a pool packet rather than onto the thread stack
+    if ((status = nx_packet_allocate(context->nx_pool, &packet_ptr, NX_RECEIVE_PACKET, NX_WAIT_FOREVER)))
+    {
+        printf("Failed to allocate reported property packet (0x%08x)\r\n", status);
+        return status;
+    }
+
+    if ((status = nx_azure_iot_json_writer_init(&json_builder, packet_ptr, NX_WAIT_FOREVER)))
+    {
+        printf("Failed to initialize json writer\r\n");
+        nx_packet_release(packet_ptr);
+        return NX_NOT_SUCCESSFUL;
+    }
+
+    if ((status = nx_azure_iot_pnp_helper_build_reported_property(
+             (UCHAR*)component, strlen(component), append_properties, NX_NULL, &json_builder)))
+    {
+        printf("Failed to build reported property!: error code = 0x%08x\r\n", status);
+        nx_azure_iot_json_writer_deinit(&json_builder);
+        nx_packet_release(packet_ptr);
+        return status;
+    }
+
+    reported_properties_length = nx_azure_iot_json_writer_get_bytes_used(&json_builder);
+    nx_azure_iot_json_writer_deinit(&json_builder);
 
-    if (snprintf(buffer, PUBLISH_BUFFER_SIZE, "{\"%s\":{\"value\":%d,\"ac\":200,\"av\":1}}", key, value) >
-        PUBLISH_BUFFER_SIZE - 1)
+    // The twin API takes a flat buffer so the document has to fit in the first packet
+    if (packet_ptr->nx_packet_next != NX_NULL)
     {
-        printf("ERROR: Unsufficient buffer size to publish int property\r\n");
+        printf("ERROR: reported properties do not fit in a single packet (%d bytes)\r\n", reported_properties_length);
+        nx_packet_release(packet_ptr);
         return NX_SIZE_ERROR;
     }
 
     if ((status = nx_azure_iot_hub_client_device_twin_reported_properties_send(&context->iothub_client,
-             (UCHAR*)buffer,
-             strlen(buffer),
+             packet_ptr->nx_packet_prepend_ptr,
+             reported_properties_length,
              &request_id,
              &response_status,
-             &version,
-             NX_WAIT_FOREVER)))
+             &reported_property_version,
+             (5 * NX_IP_PERIODIC_RATE))))
     {
-        printf("Error: device twin reported properties failed (0x%08x)\r\n", status);
+        printf("Device twin reported properties failed!: error code = 0x%08x\r\n", status);
+        nx_packet_release(packet_ptr);
         return status;
     }
 
     if ((response_status < 200) || (response_status >= 300))
     {
-        printf("Error: device twin report properties failed (%d)\r\n", response_status);
-        return status;
+        printf("device twin report properties failed with code : %d\r\n", response_status);
+        nx_packet_release(packet_ptr);
+        return NX_NOT_SUCCESSFUL;
     }
 
-    printf("Device twin writeable property sent: %s\r\n", buffer);
+    printf("Device twin property sent: %.*s.\r\n", reported_properties_length, packet_ptr->nx_packet_prepend_ptr);
 
-    return NX_SUCCESS;
+    nx_packet_release(packet_ptr);
+
+    return status;
 }
 
-UINT azure_nx_client_respond_int_writeable_property(
-    AZURE_IOT_NX_CONTEXT* context, CHAR* property, int value, int http_status, int version)
+UINT azure_iot_nx_client_reported_properties_send_async(AZURE_IOT_NX_CONTEXT* context,
+    REPORTED_PROPERTIES* props,
+    func_ptr_reported_properties_complete complete_cb,
+    VOID* complete_context)
 {
     UINT status;
-    UINT response_status;
-    UINT request_id;
-    ULONG version_dt;
-    CHAR buffer[PUBLISH_BUFFER_SIZE];
-
-    if (snprintf(buffer,
-            PUBLISH_BUFFER_SIZE,
-            "{\"%s\":{\"value\":%d,\"ac\":%d,\"av\":%d}}",
-            property,
-            value,
-            http_status,
-            version) > PUBLISH_BUFFER_SIZE - 1)
-    {
-        printf("ERROR: insufficient buffer size to respond to writeable property\r\n");
-        return NX_SIZE_ERROR;
+
+    if (context == NULL || props == NULL)
+    {
+        return NX_PTR_ERROR;
     }
 
-    if ((status = nx_azure_iot_hub_client_device_twin_reported_properties_send(&context->iothub_client,
-             (UCHAR*)buffer,
-             strlen(buffer),
-             &request_id,
-             &response_status,
-             &version_dt,
-             NX_WAIT_FOREVER)))
+    if ((status = reported_properties_end(props)))
     {
-        printf("ERROR: device twin reported properties failed (0x%08x)\r\n", status);
+        return status;
     }
 
-    if ((response_status < 200) || (response_status >= 300))
+    if ((status = reported_properties_queue_push(
+             &context->reported_properties_queue, props, complete_cb, complete_context)))
     {
-        printf("ERROR: device twin report properties failed (%d)\r\n", response_status);
+        printf("ERROR: failed to queue reported properties (0x%08x)\r\n", status);
         return status;
     }
 
-    printf("Device twin writeable property response: %s\r\n", buffer);
+    tx_event_flags_set(&context->events, REPORTED_PROPERTIES_EVENT, TX_OR);
 
-    return status;
+    return NX_SUCCESS;
+}
+
+static UINT reported_properties_stage_send(AZURE_IOT_NX_CONTEXT* context)
+{
+    UINT status;
+
+    if ((status = reported_properties_queue_stage_push(&context->reported_properties_queue, NX_NULL, NX_NULL)))
+    {
+        printf("ERROR: failed to queue reported properties (0x%08x)\r\n", status);
+        return status;
+    }
+
+    tx_event_flags_set(&context->events, REPORTED_PROPERTIES_EVENT, TX_OR);
+
+    return NX_SUCCESS;
+}
+
+UINT azure_iot_nx_client_publish_float_property(AZURE_IOT_NX_CONTEXT* context, CHAR* key, float value)
+{
+    reported_properties_append_float(reported_properties_queue_stage(&context->reported_properties_queue), key, value);
+
+    return reported_properties_stage_send(context);
+}
+
+UINT azure_iot_nx_client_publish_bool_property(AZURE_IOT_NX_CONTEXT* context, CHAR* key, bool value)
+{
+    reported_properties_append_bool(reported_properties_queue_stage(&context->reported_properties_queue), key, value);
+
+    return reported_properties_stage_send(context);
+}
+
+UINT azure_iot_nx_client_publish_int_writeable_property(AZURE_IOT_NX_CONTEXT* context, CHAR* key, UINT value)
+{
+    reported_properties_append_writeable_ack(
+        reported_properties_queue_stage(&context->reported_properties_queue), key, value, 200, 1);
+
+    return reported_properties_stage_send(context);
+}
+
+UINT azure_nx_client_respond_int_writeable_property(
+    AZURE_IOT_NX_CONTEXT* context, CHAR* property, int value, int http_status, int version)
+{
+    reported_properties_append_writeable_ack(
+        reported_properties_queue_stage(&context->reported_properties_queue), property, value, http_status, version);
+
+    return reported_properties_stage_send(context);
 }
 
 VOID printf_packet(NX_PACKET* packet_ptr, CHAR* prepend)
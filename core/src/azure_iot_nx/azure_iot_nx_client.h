@@ -12,18 +12,53 @@
 #include "nx_azure_iot_provisioning_client.h"
 
 #include "azure_iot_ciphersuites.h"
+#include "dps_cache.h"
+#include "flash_driver.h"
+#include "reported_properties.h"
+#ifdef AZURE_IOT_STORE_FORWARD_ENABLE
+#include "store_forward.h"
+#endif
+#ifdef AZURE_IOT_TELEMETRY_BATCH_ENABLE
+#include "telemetry_batch.h"
+#endif
+#include "telemetry_queue.h"
+#include "telemetry_writer.h"
+#include "tls_handshake_stats.h"
 
 #define NX_AZURE_IOT_STACK_SIZE  (2 * 1024)
 #define AZURE_IOT_STACK_SIZE     (3 * 1024)
 #define AZURE_IOT_HOST_NAME_SIZE 128
 #define AZURE_IOT_DEVICE_ID_SIZE 64
 
+#define AZURE_IOT_DPS_ENDPOINT "global.azure-devices-provisioning.net"
+
+// Largest telemetry message kept for replay, bigger ones are only ever sent live
+#ifndef AZURE_IOT_STORE_FORWARD_MESSAGE_SIZE
+#define AZURE_IOT_STORE_FORWARD_MESSAGE_SIZE 512
+#endif
+
 #define AZURE_IOT_AUTH_MODE_UNKNOWN 0
 #define AZURE_IOT_AUTH_MODE_SAS     1
 #define AZURE_IOT_AUTH_MODE_CERT    2
 
 typedef struct AZURE_IOT_NX_CONTEXT_STRUCT AZURE_IOT_NX_CONTEXT;
 
+// Time in ticks from the middleware notification until the client thread has finished handling it
+typedef struct AZURE_IOT_NX_EVENT_STATS_STRUCT
+{
+    ULONG count;
+    ULONG latency_last;
+    ULONG latency_max;
+    ULONG latency_total;
+} AZURE_IOT_NX_EVENT_STATS;
+
+typedef struct AZURE_IOT_NX_DISPATCH_STATS_STRUCT
+{
+    AZURE_IOT_NX_EVENT_STATS direct_method;
+    AZURE_IOT_NX_EVENT_STATS twin_get;
+    AZURE_IOT_NX_EVENT_STATS desired_property;
+} AZURE_IOT_NX_DISPATCH_STATS;
+
 typedef void (*func_ptr_direct_method)(AZURE_IOT_NX_CONTEXT*, const UCHAR*, USHORT, UCHAR*, USHORT, VOID*, USHORT);
 typedef void (*func_ptr_device_twin_desired_prop)(UCHAR*, UINT, UCHAR*, UINT, NX_AZURE_IOT_JSON_READER, UINT, VOID*);
 typedef void (*func_ptr_device_twin_prop)(UCHAR*, UINT, UCHAR*, UINT, NX_AZURE_IOT_JSON_READER, UINT, VOID*);
@@ -46,9 +81,32 @@ struct AZURE_IOT_NX_CONTEXT_STRUCT
     CHAR azure_iot_device_id[AZURE_IOT_DEVICE_ID_SIZE];
     CHAR* azure_iot_model_id;
 
+    // Kept so the device can be re-provisioned if the hub stops accepting its identity
+    CHAR* dps_id_scope;
+    CHAR* dps_registration_id;
+
+    // Hub assignment from a previous boot, DPS only runs again if the hub turns it down
+    DPS_CACHE dps_cache;
+    UINT identity_cached;
+
     TX_THREAD azure_iot_thread;
     TX_EVENT_FLAGS_GROUP events;
 
+    // Connection supervisor, connected is written from the middleware thread and read on the client thread
+    volatile UINT connected;
+    UINT reconnect_attempts;
+    UINT provisioning_required;
+    TX_TIMER reconnect_timer;
+
+    // Handshakes with the hub
+    TLS_HANDSHAKE_STATS tls_stats;
+
+    UINT (*unix_time_get)(ULONG* unix_time);
+#ifdef AZURE_IOT_TELEMETRY_BATCH_ENABLE
+    uint64_t (*timestamp_get)(VOID);
+#endif
+    NX_PACKET_POOL* nx_pool;
+
     NX_AZURE_IOT nx_azure_iot;
 
     // Union dps and hub as they are used consecutively and will save RAM
@@ -63,6 +121,32 @@ struct AZURE_IOT_NX_CONTEXT_STRUCT
     func_ptr_direct_method direct_method_cb;
     func_ptr_device_twin_desired_prop device_twin_desired_prop_cb;
     func_ptr_device_twin_prop device_twin_get_cb;
+
+    // Arrival time of the oldest unhandled notification of each kind, zero when there is none
+    ULONG direct_method_time;
+    ULONG twin_get_time;
+    ULONG desired_property_time;
+    AZURE_IOT_NX_DISPATCH_STATS dispatch_stats;
+
+    // Outbound telemetry, drained by the client thread
+    TELEMETRY_QUEUE telemetry_queue;
+    TELEMETRY_QUEUE_ENTRY telemetry_in_flight;
+#ifdef AZURE_IOT_TELEMETRY_BATCH_ENABLE
+    TELEMETRY_BATCH telemetry_batch;
+#endif
+
+#ifdef AZURE_IOT_STORE_FORWARD_ENABLE
+    // Telemetry that could not be delivered, replayed once the hub is reachable again
+    STORE_FORWARD store_forward;
+    FLASH_SEGMENT_LOG flash_log;
+    TX_TIMER replay_timer;
+    UCHAR store_forward_buffer[AZURE_IOT_STORE_FORWARD_MESSAGE_SIZE]; // records on their way in and out
+#endif
+
+    // Reported property patches waiting to go out, the head is retried with backoff when its send fails
+    REPORTED_PROPERTIES_QUEUE reported_properties_queue;
+    TX_TIMER properties_retry_timer;
+    UINT reported_properties_attempts;
 };
 
 UINT azure_iot_nx_client_register_direct_method(AZURE_IOT_NX_CONTEXT* context, func_ptr_direct_method callback);
@@ -71,6 +155,7 @@ UINT azure_iot_nx_client_register_device_twin_desired_prop(
 UINT azure_iot_nx_client_register_device_twin_prop(AZURE_IOT_NX_CONTEXT* context, func_ptr_device_twin_prop callback);
 
 UINT azure_iot_nx_client_sas_set(AZURE_IOT_NX_CONTEXT* context, CHAR* device_sas_key);
+// The private key is DER, either PKCS#1 RSA or SEC1 EC, the latter needs the ECC ciphersuite profile
 UINT azure_iot_nx_client_cert_set(AZURE_IOT_NX_CONTEXT* context,
     UCHAR* device_x509_cert,
     UINT device_x509_cert_len,
@@ -87,17 +172,62 @@ UINT azure_iot_nx_client_create(AZURE_IOT_NX_CONTEXT* context,
 UINT azure_iot_nx_client_hub_create(AZURE_IOT_NX_CONTEXT* context, CHAR* iot_hub_hostname, CHAR* iot_device_id);
 UINT azure_iot_nx_client_dps_create(AZURE_IOT_NX_CONTEXT* context, CHAR* dps_id_scope, CHAR* dps_registration_id);
 
+// Persist the DPS assignment in flash so later boots skip provisioning, call before azure_iot_nx_client_dps_create
+UINT azure_iot_nx_client_dps_cache_set(
+    AZURE_IOT_NX_CONTEXT* context, const FLASH_DRIVER* driver, ULONG first_sector, ULONG sector_count);
+
 UINT azure_iot_nx_client_delete(AZURE_IOT_NX_CONTEXT* context);
 UINT azure_iot_nx_client_connect(AZURE_IOT_NX_CONTEXT* context);
 
 UINT azure_iot_nx_client_device_twin_request_and_wait(AZURE_IOT_NX_CONTEXT* context);
-
-UINT azure_iot_nx_client_publish_telemetry(AZURE_IOT_NX_CONTEXT* context,
-    UINT (*append_properties)(NX_AZURE_IOT_JSON_WRITER* json_builder_ptr, VOID* context));
+UINT azure_iot_nx_client_dispatch_stats_get(AZURE_IOT_NX_CONTEXT* context, AZURE_IOT_NX_DISPATCH_STATS* stats);
+UINT azure_iot_nx_client_tls_stats_get(AZURE_IOT_NX_CONTEXT* context, TLS_HANDSHAKE_STATS* stats);
+
+// The encoding is chosen per message, the content type and encoding system properties are set to match. A message
+// whose properties were all filtered out by their deadbands is not sent, the call returns NX_NOT_FOUND.
+UINT azure_iot_nx_client_publish_telemetry(
+    AZURE_IOT_NX_CONTEXT* context, TELEMETRY_ENCODING encoding, func_ptr_telemetry_append append_properties);
+
+UINT azure_iot_nx_client_publish_telemetry_async(AZURE_IOT_NX_CONTEXT* context,
+    TELEMETRY_ENCODING encoding,
+    func_ptr_telemetry_append append_properties,
+    func_ptr_telemetry_complete complete_cb,
+    VOID* complete_context);
+UINT azure_iot_nx_client_telemetry_queue_policy_set(AZURE_IOT_NX_CONTEXT* context, TELEMETRY_QUEUE_POLICY policy);
+UINT azure_iot_nx_client_telemetry_queue_stats_get(AZURE_IOT_NX_CONTEXT* context, TELEMETRY_QUEUE_STATS* stats);
+
+#ifdef AZURE_IOT_TELEMETRY_BATCH_ENABLE
+// Batches are always sent as JSON. Define AZURE_IOT_TELEMETRY_BATCH_ENABLE in nx_user.h to build them in, the batch
+// buffer costs a further TELEMETRY_BATCH_BUFFER_SIZE of RAM.
+UINT azure_iot_nx_client_publish_telemetry_batched(
+    AZURE_IOT_NX_CONTEXT* context, func_ptr_telemetry_append append_properties);
+UINT azure_iot_nx_client_telemetry_batch_set(AZURE_IOT_NX_CONTEXT* context, UINT max_samples, UINT max_delay_secs);
+
+// Stamp batched samples in Unix milliseconds rather than the whole seconds of the unix time callback
+UINT azure_iot_nx_client_timestamp_set(AZURE_IOT_NX_CONTEXT* context, uint64_t (*timestamp_get)(VOID));
+UINT azure_iot_nx_client_telemetry_batch_flush(AZURE_IOT_NX_CONTEXT* context);
+#endif
+
+#ifdef AZURE_IOT_STORE_FORWARD_ENABLE
+// Undelivered telemetry is kept for replay rather than dropped. Define AZURE_IOT_STORE_FORWARD_ENABLE in nx_user.h to
+// build it in, the RAM ring costs a further STORE_FORWARD_RAM_SIZE of RAM.
+UINT azure_iot_nx_client_store_forward_flash_set(AZURE_IOT_NX_CONTEXT* context, const FLASH_DRIVER* driver);
+UINT azure_iot_nx_client_store_forward_rate_set(AZURE_IOT_NX_CONTEXT* context, UINT records_per_second);
+UINT azure_iot_nx_client_store_forward_stats_get(AZURE_IOT_NX_CONTEXT* context, STORE_FORWARD_STATS* stats);
+#endif
 
 UINT azure_iot_nx_client_publish_properties(AZURE_IOT_NX_CONTEXT* context,
     CHAR* component,
     UINT (*append_properties)(NX_AZURE_IOT_JSON_WRITER* json_builder_ptr, VOID* context));
+// Closes props and queues it as a single twin patch, complete_cb runs on the client thread once the hub responds. A
+// patch that only repeats values the hub already acknowledged is not sent, complete_cb gets NX_SUCCESS and
+// REPORTED_PROPERTIES_STATUS_UNCHANGED.
+UINT azure_iot_nx_client_reported_properties_send_async(AZURE_IOT_NX_CONTEXT* context,
+    REPORTED_PROPERTIES* props,
+    func_ptr_reported_properties_complete complete_cb,
+    VOID* complete_context);
+// The single property helpers queue their patch like azure_iot_nx_client_reported_properties_send_async and return
+// without waiting for the hub, they are safe to call from the client thread callbacks
 UINT azure_iot_nx_client_publish_float_property(AZURE_IOT_NX_CONTEXT* context, CHAR* key, float value);
 UINT azure_iot_nx_client_publish_bool_property(AZURE_IOT_NX_CONTEXT* context, CHAR* key, bool value);
 
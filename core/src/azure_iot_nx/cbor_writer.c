@@ -0,0 +1,308 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include "cbor_writer.h"
+
+#include <string.h>
+
+#define CBOR_MAJOR_UNSIGNED 0x00
+#define CBOR_MAJOR_NEGATIVE 0x20
+#define CBOR_MAJOR_TEXT     0x60
+#define CBOR_MAJOR_MAP      0xA0
+
+#define CBOR_FALSE              0xF4
+#define CBOR_TRUE               0xF5
+#define CBOR_FLOAT32            0xFA
+#define CBOR_FLOAT64            0xFB
+#define CBOR_INDEFINITE_MAP     0xBF
+#define CBOR_BREAK              0xFF
+#define CBOR_ADDITIONAL_1_BYTE  24
+#define CBOR_ADDITIONAL_2_BYTES 25
+#define CBOR_ADDITIONAL_4_BYTES 26
+#define CBOR_ADDITIONAL_8_BYTES 27
+
+// Largest magnitude below which every integer is exactly representable as a double
+#define CBOR_EXACT_INTEGER_LIMIT 9007199254740992.0
+
+static const double powers_of_ten[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+
+static VOID cbor_write(CBOR_WRITER* writer, const UCHAR* data, UINT length)
+{
+    UINT status;
+
+    if (writer->status != NX_SUCCESS)
+    {
+        return;
+    }
+
+    if (writer->buffer_used + length > writer->buffer_size)
+    {
+        if (writer->packet == NX_NULL)
+        {
+            writer->status = NX_SIZE_ERROR;
+            return;
+        }
+
+        if (cbor_writer_flush(writer))
+        {
+            return;
+        }
+
+        // Too big to stage, e.g. a long string value, so it goes straight to the packet
+        if (length > writer->buffer_size)
+        {
+            if ((status = nx_packet_data_append(
+                     writer->packet, (VOID*)data, length, writer->packet->nx_packet_pool_owner, writer->wait_option)))
+            {
+                writer->status = status;
+                return;
+            }
+
+            writer->bytes_used += length;
+            return;
+        }
+    }
+
+    memcpy(writer->buffer + writer->buffer_used, data, length);
+    writer->buffer_used += length;
+    writer->bytes_used += length;
+}
+
+// Initial byte plus the shortest big-endian argument that holds value
+static VOID cbor_write_head(CBOR_WRITER* writer, UCHAR major, uint64_t value)
+{
+    UCHAR head[9];
+    UINT argument_length;
+    UINT i;
+
+    if (value < CBOR_ADDITIONAL_1_BYTE)
+    {
+        head[0] = major | (UCHAR)value;
+        cbor_write(writer, head, 1);
+        return;
+    }
+
+    if (value <= 0xFF)
+    {
+        head[0]         = major | CBOR_ADDITIONAL_1_BYTE;
+        argument_length = 1;
+    }
+    else if (value <= 0xFFFF)
+    {
+        head[0]         = major | CBOR_ADDITIONAL_2_BYTES;
+        argument_length = 2;
+    }
+    else if (value <= 0xFFFFFFFF)
+    {
+        head[0]         = major | CBOR_ADDITIONAL_4_BYTES;
+        argument_length = 4;
+    }
+    else
+    {
+        head[0]         = major | CBOR_ADDITIONAL_8_BYTES;
+        argument_length = 8;
+    }
+
+    for (i = 0; i < argument_length; i++)
+    {
+        head[argument_length - i] = (UCHAR)(value >> (8 * i));
+    }
+
+    cbor_write(writer, head, argument_length + 1);
+}
+
+static VOID cbor_write_integer(CBOR_WRITER* writer, int64_t value)
+{
+    if (value < 0)
+    {
+        cbor_write_head(writer, CBOR_MAJOR_NEGATIVE, (uint64_t)(-(value + 1)));
+    }
+    else
+    {
+        cbor_write_head(writer, CBOR_MAJOR_UNSIGNED, (uint64_t)value);
+    }
+}
+
+static VOID cbor_write_text(CBOR_WRITER* writer, const UCHAR* text, UINT length)
+{
+    cbor_write_head(writer, CBOR_MAJOR_TEXT, length);
+    cbor_write(writer, text, length);
+}
+
+static VOID cbor_write_double(CBOR_WRITER* writer, double value, UINT fractional_digits)
+{
+    UCHAR item[9];
+    double scale;
+    double scaled;
+    double error;
+    float single;
+    uint32_t single_bits;
+    uint64_t double_bits;
+    UINT i;
+
+    if (fractional_digits >= sizeof(powers_of_ten) / sizeof(powers_of_ten[0]))
+    {
+        fractional_digits = sizeof(powers_of_ten) / sizeof(powers_of_ten[0]) - 1;
+    }
+
+    scale  = powers_of_ten[fractional_digits];
+    scaled = value * scale;
+
+    // Round to the requested precision, the comparisons are false for NaN which is passed through untouched
+    if (scaled > -CBOR_EXACT_INTEGER_LIMIT && scaled < CBOR_EXACT_INTEGER_LIMIT)
+    {
+        value = (double)(int64_t)(scaled + (scaled < 0 ? -0.5 : 0.5)) / scale;
+
+        if (value == (double)(int64_t)value)
+        {
+            cbor_write_integer(writer, (int64_t)value);
+            return;
+        }
+    }
+
+    // Single precision is enough whenever it keeps every requested fractional digit
+    single = (float)value;
+    error  = (double)single - value;
+    if (value != value || (error < 0.5 / scale && error > -0.5 / scale))
+    {
+        memcpy(&single_bits, &single, sizeof(single_bits));
+
+        item[0] = CBOR_FLOAT32;
+        for (i = 0; i < 4; i++)
+        {
+            item[4 - i] = (UCHAR)(single_bits >> (8 * i));
+        }
+
+        cbor_write(writer, item, 5);
+        return;
+    }
+
+    memcpy(&double_bits, &value, sizeof(double_bits));
+
+    item[0] = CBOR_FLOAT64;
+    for (i = 0; i < 8; i++)
+    {
+        item[8 - i] = (UCHAR)(double_bits >> (8 * i));
+    }
+
+    cbor_write(writer, item, 9);
+}
+
+UINT cbor_writer_init(CBOR_WRITER* writer, NX_PACKET* packet, UINT wait_option)
+{
+    if (writer == NX_NULL || packet == NX_NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    writer->packet      = packet;
+    writer->wait_option = wait_option;
+    writer->buffer      = writer->staging;
+    writer->buffer_size = sizeof(writer->staging);
+    writer->buffer_used = 0;
+    writer->bytes_used  = 0;
+    writer->status      = NX_SUCCESS;
+
+    return NX_SUCCESS;
+}
+
+UINT cbor_writer_with_buffer_init(CBOR_WRITER* writer, UCHAR* buffer, UINT buffer_size)
+{
+    if (writer == NX_NULL || buffer == NX_NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    writer->packet      = NX_NULL;
+    writer->wait_option = NX_NO_WAIT;
+    writer->buffer      = buffer;
+    writer->buffer_size = buffer_size;
+    writer->buffer_used = 0;
+    writer->bytes_used  = 0;
+    writer->status      = NX_SUCCESS;
+
+    return NX_SUCCESS;
+}
+
+UINT cbor_writer_flush(CBOR_WRITER* writer)
+{
+    UINT status;
+
+    if (writer->status != NX_SUCCESS || writer->packet == NX_NULL || writer->buffer_used == 0)
+    {
+        return writer->status;
+    }
+
+    if ((status = nx_packet_data_append(writer->packet,
+             writer->buffer,
+             writer->buffer_used,
+             writer->packet->nx_packet_pool_owner,
+             writer->wait_option)))
+    {
+        writer->status = status;
+    }
+
+    writer->buffer_used = 0;
+
+    return writer->status;
+}
+
+UINT cbor_writer_get_bytes_used(CBOR_WRITER* writer)
+{
+    return writer->bytes_used;
+}
+
+UINT cbor_writer_append_begin_map(CBOR_WRITER* writer)
+{
+    UCHAR item = CBOR_INDEFINITE_MAP;
+
+    cbor_write(writer, &item, 1);
+
+    return writer->status;
+}
+
+UINT cbor_writer_append_end_map(CBOR_WRITER* writer)
+{
+    UCHAR item = CBOR_BREAK;
+
+    cbor_write(writer, &item, 1);
+
+    return writer->status;
+}
+
+UINT cbor_writer_append_property_with_double_value(
+    CBOR_WRITER* writer, const UCHAR* name, UINT name_length, double value, UINT fractional_digits)
+{
+    cbor_write_text(writer, name, name_length);
+    cbor_write_double(writer, value, fractional_digits);
+
+    return writer->status;
+}
+
+UINT cbor_writer_append_property_with_int32_value(
+    CBOR_WRITER* writer, const UCHAR* name, UINT name_length, int32_t value)
+{
+    cbor_write_text(writer, name, name_length);
+    cbor_write_integer(writer, value);
+
+    return writer->status;
+}
+
+UINT cbor_writer_append_property_with_bool_value(CBOR_WRITER* writer, const UCHAR* name, UINT name_length, bool value)
+{
+    UCHAR item = value ? CBOR_TRUE : CBOR_FALSE;
+
+    cbor_write_text(writer, name, name_length);
+    cbor_write(writer, &item, 1);
+
+    return writer->status;
+}
+
+UINT cbor_writer_append_property_with_string_value(
+    CBOR_WRITER* writer, const UCHAR* name, UINT name_length, const UCHAR* value, UINT value_length)
+{
+    cbor_write_text(writer, name, name_length);
+    cbor_write_text(writer, value, value_length);
+
+    return writer->status;
+}
@@ -0,0 +1,56 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _CBOR_WRITER_H
+#define _CBOR_WRITER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nx_api.h"
+
+// Bytes collected before they are appended to the packet, sized to hold a few typical telemetry properties
+#ifndef CBOR_WRITER_STAGING_SIZE
+#define CBOR_WRITER_STAGING_SIZE 64
+#endif
+
+// Minimal RFC 8949 encoder for flat telemetry objects. The calling pattern mirrors NX_AZURE_IOT_JSON_WRITER so either
+// can sit behind the same append callback. Maps are written with indefinite length so they can be streamed without
+// knowing the property count up front. Errors are sticky, only the final status needs checking.
+typedef struct CBOR_WRITER_STRUCT
+{
+    NX_PACKET* packet;
+    UINT wait_option;
+
+    UCHAR* buffer;
+    UINT buffer_size;
+    UINT buffer_used;
+
+    UINT bytes_used;
+    UINT status;
+
+    UCHAR staging[CBOR_WRITER_STAGING_SIZE];
+} CBOR_WRITER;
+
+// Append to the end of packet, chaining more from its pool as the message grows
+UINT cbor_writer_init(CBOR_WRITER* writer, NX_PACKET* packet, UINT wait_option);
+UINT cbor_writer_with_buffer_init(CBOR_WRITER* writer, UCHAR* buffer, UINT buffer_size);
+
+// Push anything still staged into the packet, a no-op for buffer writers
+UINT cbor_writer_flush(CBOR_WRITER* writer);
+UINT cbor_writer_get_bytes_used(CBOR_WRITER* writer);
+
+UINT cbor_writer_append_begin_map(CBOR_WRITER* writer);
+UINT cbor_writer_append_end_map(CBOR_WRITER* writer);
+
+// Doubles are rounded to fractional_digits, then written as an integer, single or double precision float, whichever
+// is the smallest that still holds the rounded value
+UINT cbor_writer_append_property_with_double_value(
+    CBOR_WRITER* writer, const UCHAR* name, UINT name_length, double value, UINT fractional_digits);
+UINT cbor_writer_append_property_with_int32_value(
+    CBOR_WRITER* writer, const UCHAR* name, UINT name_length, int32_t value);
+UINT cbor_writer_append_property_with_bool_value(CBOR_WRITER* writer, const UCHAR* name, UINT name_length, bool value);
+UINT cbor_writer_append_property_with_string_value(
+    CBOR_WRITER* writer, const UCHAR* name, UINT name_length, const UCHAR* value, UINT value_length);
+
+#endif // _CBOR_WRITER_H
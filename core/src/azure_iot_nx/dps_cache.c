@@ -0,0 +1,105 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include "dps_cache.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "nx_api.h"
+
+#define DPS_CACHE_MAGIC 0x53505044 // "DPPS"
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME        16777619u
+
+// One hub assignment
+typedef struct DPS_CACHE_RECORD_STRUCT
+{
+    FLASH_RECORD_HEADER header;
+
+    uint32_t identity_hash;
+    uint32_t reserved;
+
+    CHAR hostname[DPS_CACHE_HOST_NAME_SIZE];
+    CHAR device_id[DPS_CACHE_DEVICE_ID_SIZE];
+} DPS_CACHE_RECORD;
+
+static uint32_t fnv_hash(uint32_t hash, const UCHAR* data, UINT length)
+{
+    while (length--)
+    {
+        hash = (hash ^ *data++) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+// Which provisioning identity an assignment was made for, changing the configuration invalidates the cache
+static uint32_t identity_hash(const CHAR* id_scope, const CHAR* registration_id)
+{
+    uint32_t hash = fnv_hash(FNV_OFFSET_BASIS, (const UCHAR*)id_scope, strlen(id_scope));
+
+    hash = fnv_hash(hash, (const UCHAR*)"/", 1);
+
+    return fnv_hash(hash, (const UCHAR*)registration_id, strlen(registration_id));
+}
+
+UINT dps_cache_open(DPS_CACHE* cache, const FLASH_DRIVER* driver, ULONG first_sector, ULONG sector_count)
+{
+    return flash_record_store_open(
+        cache, driver, first_sector, sector_count, DPS_CACHE_MAGIC, sizeof(DPS_CACHE_RECORD), "DPS cache");
+}
+
+UINT dps_cache_load(DPS_CACHE* cache,
+    const CHAR* id_scope,
+    const CHAR* registration_id,
+    CHAR* hostname,
+    UINT hostname_size,
+    CHAR* device_id,
+    UINT device_id_size)
+{
+    DPS_CACHE_RECORD record;
+
+    if (flash_record_load(cache, &record) || record.hostname[sizeof(record.hostname) - 1] != 0 ||
+        record.device_id[sizeof(record.device_id) - 1] != 0 ||
+        record.identity_hash != identity_hash(id_scope, registration_id))
+    {
+        return NX_NOT_FOUND;
+    }
+
+    if (strlen(record.hostname) >= hostname_size || strlen(record.device_id) >= device_id_size)
+    {
+        return NX_SIZE_ERROR;
+    }
+
+    strcpy(hostname, record.hostname);
+    strcpy(device_id, record.device_id);
+
+    return NX_SUCCESS;
+}
+
+UINT dps_cache_save(
+    DPS_CACHE* cache, const CHAR* id_scope, const CHAR* registration_id, const CHAR* hostname, const CHAR* device_id)
+{
+    DPS_CACHE_RECORD record;
+
+    if (strlen(hostname) >= sizeof(record.hostname) || strlen(device_id) >= sizeof(record.device_id))
+    {
+        return NX_SIZE_ERROR;
+    }
+
+    memset(&record, 0, sizeof(record));
+    record.identity_hash = identity_hash(id_scope, registration_id);
+    strcpy(record.hostname, hostname);
+    strcpy(record.device_id, device_id);
+
+    // DPS handing out the same assignment again writes nothing, losing power mid save just means provisioning again
+    return flash_record_save(cache, &record);
+}
+
+UINT dps_cache_invalidate(DPS_CACHE* cache)
+{
+    return flash_record_invalidate(cache);
+}
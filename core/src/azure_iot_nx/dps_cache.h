@@ -0,0 +1,38 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _DPS_CACHE_H
+#define _DPS_CACHE_H
+
+#include "tx_api.h"
+
+#include "flash_driver.h"
+#include "flash_record_store.h"
+
+#define DPS_CACHE_HOST_NAME_SIZE 128
+#define DPS_CACHE_DEVICE_ID_SIZE 64
+
+// Keeps the hub assignment returned by the Device Provisioning Service in flash, so a reboot can connect straight to
+// the hub
+typedef FLASH_RECORD_STORE DPS_CACHE;
+
+// Keep the assignment in sector_count sectors from first_sector of the flash region, apart from anything else kept
+// there
+UINT dps_cache_open(DPS_CACHE* cache, const FLASH_DRIVER* driver, ULONG first_sector, ULONG sector_count);
+
+// Fetch the assignment made for this id scope and registration id, NX_NOT_FOUND when there is none
+UINT dps_cache_load(DPS_CACHE* cache,
+    const CHAR* id_scope,
+    const CHAR* registration_id,
+    CHAR* hostname,
+    UINT hostname_size,
+    CHAR* device_id,
+    UINT device_id_size);
+
+UINT dps_cache_save(
+    DPS_CACHE* cache, const CHAR* id_scope, const CHAR* registration_id, const CHAR* hostname, const CHAR* device_id);
+
+// Drop the current assignment, for when the hub no longer accepts it
+UINT dps_cache_invalidate(DPS_CACHE* cache);
+
+#endif // _DPS_CACHE_H
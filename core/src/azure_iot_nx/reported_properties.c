@@ -0,0 +1,467 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include "reported_properties.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "nx_azure_iot.h"
+
+static const CHAR component_type_property_name[] = "__t";
+static const CHAR component_type_value[]         = "c";
+static const CHAR ack_value_property_name[]      = "value";
+static const CHAR ack_code_property_name[]       = "ac";
+static const CHAR ack_version_property_name[]    = "av";
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME        16777619u
+
+// Latch the first failure, later appends become no-ops
+static UINT props_result(REPORTED_PROPERTIES* props, UINT result)
+{
+    if (result != NX_AZURE_IOT_SUCCESS && props->status == NX_SUCCESS)
+    {
+        printf("Failed to build reported properties\r\n");
+        props->status = NX_NOT_SUCCESSFUL;
+    }
+
+    return props->status;
+}
+
+static ULONG fnv_hash(ULONG hash, const UCHAR* data, UINT length)
+{
+    while (length--)
+    {
+        hash = ((hash ^ *data++) * FNV_PRIME) & 0xFFFFFFFF;
+    }
+
+    return hash;
+}
+
+// Document can no longer be matched against acknowledged values, it will always be sent
+static VOID items_untrack(REPORTED_PROPERTIES* props)
+{
+    props->trackable  = false;
+    props->item_count = 0;
+}
+
+// Record what the typed append that started at offset wrote, as a key and value hash
+static UINT item_track(REPORTED_PROPERTIES* props, const CHAR* key, UINT offset)
+{
+    REPORTED_PROPERTIES_ITEM* item;
+    ULONG key_hash = FNV_OFFSET_BASIS;
+    UINT end;
+
+    if (props->status != NX_SUCCESS || !props->trackable)
+    {
+        return props->status;
+    }
+
+    if (props->item_count == REPORTED_PROPERTIES_MAX_ITEMS)
+    {
+        items_untrack(props);
+        return props->status;
+    }
+
+    if (props->component != NX_NULL)
+    {
+        key_hash = fnv_hash(key_hash, (const UCHAR*)props->component, strlen(props->component));
+        key_hash = fnv_hash(key_hash, (const UCHAR*)"/", 1);
+    }
+
+    // Skip the separator the writer puts in front of every property but the first
+    end = nx_azure_iot_json_writer_get_bytes_used(&props->json_writer);
+    if (offset < end && props->document[offset] == ',')
+    {
+        offset++;
+    }
+
+    item             = &props->items[props->item_count++];
+    item->key_hash   = fnv_hash(key_hash, (const UCHAR*)key, strlen(key));
+    item->value_hash = fnv_hash(FNV_OFFSET_BASIS, &props->document[offset], end - offset);
+
+    return props->status;
+}
+
+UINT reported_properties_begin(REPORTED_PROPERTIES* props)
+{
+    if (props == NX_NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    props->length     = 0;
+    props->component  = NX_NULL;
+    props->status     = NX_SUCCESS;
+    props->item_count = 0;
+    props->trackable  = true;
+
+    if (nx_azure_iot_json_writer_with_buffer_init(&props->json_writer, props->document, sizeof(props->document)))
+    {
+        printf("Failed to initialize json writer\r\n");
+        props->status = NX_NOT_SUCCESSFUL;
+        return props->status;
+    }
+
+    return props_result(props, nx_azure_iot_json_writer_append_begin_object(&props->json_writer));
+}
+
+UINT reported_properties_component_set(REPORTED_PROPERTIES* props, CHAR* component)
+{
+    if (props->status != NX_SUCCESS)
+    {
+        return props->status;
+    }
+
+    if (props->component == component ||
+        (props->component != NX_NULL && component != NX_NULL && strcmp(props->component, component) == 0))
+    {
+        return NX_SUCCESS;
+    }
+
+    if (props->component != NX_NULL &&
+        props_result(props, nx_azure_iot_json_writer_append_end_object(&props->json_writer)))
+    {
+        return props->status;
+    }
+
+    props->component = component;
+
+    if (component == NX_NULL)
+    {
+        return NX_SUCCESS;
+    }
+
+    return props_result(props,
+        nx_azure_iot_json_writer_append_property_name(&props->json_writer, (UCHAR*)component, strlen(component)) ||
+            nx_azure_iot_json_writer_append_begin_object(&props->json_writer) ||
+            nx_azure_iot_json_writer_append_property_with_string_value(&props->json_writer,
+                (UCHAR*)component_type_property_name,
+                sizeof(component_type_property_name) - 1,
+                (UCHAR*)component_type_value,
+                sizeof(component_type_value) - 1));
+}
+
+UINT reported_properties_append(REPORTED_PROPERTIES* props,
+    UINT (*append_properties)(NX_AZURE_IOT_JSON_WRITER* json_builder_ptr, VOID* context),
+    VOID* context)
+{
+    if (props->status != NX_SUCCESS)
+    {
+        return props->status;
+    }
+
+    items_untrack(props);
+
+    return props_result(props, append_properties(&props->json_writer, context));
+}
+
+UINT reported_properties_append_float(REPORTED_PROPERTIES* props, CHAR* key, float value)
+{
+    UINT offset;
+
+    if (props->status != NX_SUCCESS)
+    {
+        return props->status;
+    }
+
+    offset = nx_azure_iot_json_writer_get_bytes_used(&props->json_writer);
+    props_result(props,
+        nx_azure_iot_json_writer_append_property_with_double_value(
+            &props->json_writer, (UCHAR*)key, strlen(key), value, 2));
+
+    return item_track(props, key, offset);
+}
+
+UINT reported_properties_append_bool(REPORTED_PROPERTIES* props, CHAR* key, bool value)
+{
+    UINT offset;
+
+    if (props->status != NX_SUCCESS)
+    {
+        return props->status;
+    }
+
+    offset = nx_azure_iot_json_writer_get_bytes_used(&props->json_writer);
+    props_result(props,
+        nx_azure_iot_json_writer_append_property_with_bool_value(&props->json_writer, (UCHAR*)key, strlen(key), value));
+
+    return item_track(props, key, offset);
+}
+
+UINT reported_properties_append_int(REPORTED_PROPERTIES* props, CHAR* key, INT value)
+{
+    UINT offset;
+
+    if (props->status != NX_SUCCESS)
+    {
+        return props->status;
+    }
+
+    offset = nx_azure_iot_json_writer_get_bytes_used(&props->json_writer);
+    props_result(props,
+        nx_azure_iot_json_writer_append_property_with_int32_value(
+            &props->json_writer, (UCHAR*)key, strlen(key), value));
+
+    return item_track(props, key, offset);
+}
+
+UINT reported_properties_append_writeable_ack(
+    REPORTED_PROPERTIES* props, CHAR* key, INT value, UINT ack_code, UINT ack_version)
+{
+    UINT offset;
+
+    if (props->status != NX_SUCCESS)
+    {
+        return props->status;
+    }
+
+    offset = nx_azure_iot_json_writer_get_bytes_used(&props->json_writer);
+    props_result(props,
+        nx_azure_iot_json_writer_append_property_name(&props->json_writer, (UCHAR*)key, strlen(key)) ||
+            nx_azure_iot_json_writer_append_begin_object(&props->json_writer) ||
+            nx_azure_iot_json_writer_append_property_with_int32_value(&props->json_writer,
+                (UCHAR*)ack_value_property_name,
+                sizeof(ack_value_property_name) - 1,
+                value) ||
+            nx_azure_iot_json_writer_append_property_with_int32_value(&props->json_writer,
+                (UCHAR*)ack_code_property_name,
+                sizeof(ack_code_property_name) - 1,
+                (INT)ack_code) ||
+            nx_azure_iot_json_writer_append_property_with_int32_value(&props->json_writer,
+                (UCHAR*)ack_version_property_name,
+                sizeof(ack_version_property_name) - 1,
+                (INT)ack_version) ||
+            nx_azure_iot_json_writer_append_end_object(&props->json_writer));
+
+    return item_track(props, key, offset);
+}
+
+UINT reported_properties_end(REPORTED_PROPERTIES* props)
+{
+    if (props->status == NX_SUCCESS && props->component != NX_NULL)
+    {
+        props_result(props, nx_azure_iot_json_writer_append_end_object(&props->json_writer));
+    }
+
+    if (props->status == NX_SUCCESS &&
+        props_result(props, nx_azure_iot_json_writer_append_end_object(&props->json_writer)) == NX_SUCCESS)
+    {
+        props->length = nx_azure_iot_json_writer_get_bytes_used(&props->json_writer);
+    }
+
+    nx_azure_iot_json_writer_deinit(&props->json_writer);
+
+    return props->status;
+}
+
+UINT reported_properties_queue_create(REPORTED_PROPERTIES_QUEUE* queue)
+{
+    UINT status;
+
+    if (queue == NX_NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    memset(queue, 0, sizeof(REPORTED_PROPERTIES_QUEUE));
+
+    if ((status = tx_mutex_create(&queue->mutex, "reported properties", TX_INHERIT)))
+    {
+        printf("ERROR: failed to create reported properties mutex (0x%08x)\r\n", status);
+        return status;
+    }
+
+    return NX_SUCCESS;
+}
+
+UINT reported_properties_queue_delete(REPORTED_PROPERTIES_QUEUE* queue)
+{
+    REPORTED_PROPERTIES_REQUEST* request;
+
+    // Fail anything that never went out so the owners can release their resources
+    while ((request = reported_properties_queue_peek(queue)) != NX_NULL)
+    {
+        if (request->complete_cb)
+        {
+            request->complete_cb(NX_NOT_SUCCESSFUL, 0, 0, 0, request->complete_context);
+        }
+
+        reported_properties_queue_remove(queue);
+    }
+
+    tx_mutex_delete(&queue->mutex);
+
+    return NX_SUCCESS;
+}
+
+UINT reported_properties_queue_push(REPORTED_PROPERTIES_QUEUE* queue,
+    REPORTED_PROPERTIES* props,
+    func_ptr_reported_properties_complete complete_cb,
+    VOID* complete_context)
+{
+    REPORTED_PROPERTIES_REQUEST* request;
+
+    if (props->status != NX_SUCCESS || props->length == 0)
+    {
+        return NX_INVALID_PARAMETERS;
+    }
+
+    tx_mutex_get(&queue->mutex, TX_WAIT_FOREVER);
+
+    if (queue->count == REPORTED_PROPERTIES_QUEUE_DEPTH)
+    {
+        tx_mutex_put(&queue->mutex);
+        return NX_OVERFLOW;
+    }
+
+    request = &queue->requests[(queue->head + queue->count) % REPORTED_PROPERTIES_QUEUE_DEPTH];
+
+    memcpy(request->document, props->document, props->length);
+    memcpy(request->items, props->items, props->item_count * sizeof(REPORTED_PROPERTIES_ITEM));
+    request->length           = props->length;
+    request->item_count       = props->item_count;
+    request->complete_cb      = complete_cb;
+    request->complete_context = complete_context;
+
+    queue->count++;
+
+    tx_mutex_put(&queue->mutex);
+
+    return NX_SUCCESS;
+}
+
+REPORTED_PROPERTIES* reported_properties_queue_stage(REPORTED_PROPERTIES_QUEUE* queue)
+{
+    // Released by reported_properties_queue_stage_push, the push nests the mutex
+    tx_mutex_get(&queue->mutex, TX_WAIT_FOREVER);
+
+    reported_properties_begin(&queue->staging);
+
+    return &queue->staging;
+}
+
+UINT reported_properties_queue_stage_push(REPORTED_PROPERTIES_QUEUE* queue,
+    func_ptr_reported_properties_complete complete_cb,
+    VOID* complete_context)
+{
+    UINT status;
+
+    if ((status = reported_properties_end(&queue->staging)) == NX_SUCCESS)
+    {
+        status = reported_properties_queue_push(queue, &queue->staging, complete_cb, complete_context);
+    }
+
+    tx_mutex_put(&queue->mutex);
+
+    return status;
+}
+
+REPORTED_PROPERTIES_REQUEST* reported_properties_queue_peek(REPORTED_PROPERTIES_QUEUE* queue)
+{
+    REPORTED_PROPERTIES_REQUEST* request = NX_NULL;
+
+    tx_mutex_get(&queue->mutex, TX_WAIT_FOREVER);
+
+    if (queue->count > 0)
+    {
+        request = &queue->requests[queue->head];
+    }
+
+    tx_mutex_put(&queue->mutex);
+
+    return request;
+}
+
+VOID reported_properties_queue_remove(REPORTED_PROPERTIES_QUEUE* queue)
+{
+    tx_mutex_get(&queue->mutex, TX_WAIT_FOREVER);
+
+    if (queue->count > 0)
+    {
+        queue->head = (queue->head + 1) % REPORTED_PROPERTIES_QUEUE_DEPTH;
+        queue->count--;
+    }
+
+    tx_mutex_put(&queue->mutex);
+}
+
+// Must be called with the queue mutex held
+static REPORTED_PROPERTIES_ITEM* acked_find(REPORTED_PROPERTIES_QUEUE* queue, ULONG key_hash)
+{
+    UINT i;
+
+    for (i = 0; i < queue->acked_count; i++)
+    {
+        if (queue->acked[i].key_hash == key_hash)
+        {
+            return &queue->acked[i];
+        }
+    }
+
+    return NX_NULL;
+}
+
+bool reported_properties_queue_unchanged(
+    REPORTED_PROPERTIES_QUEUE* queue, const REPORTED_PROPERTIES_ITEM* items, UINT item_count)
+{
+    REPORTED_PROPERTIES_ITEM* acked;
+    bool unchanged = item_count > 0;
+    UINT i;
+
+    tx_mutex_get(&queue->mutex, TX_WAIT_FOREVER);
+
+    for (i = 0; i < item_count && unchanged; i++)
+    {
+        acked     = acked_find(queue, items[i].key_hash);
+        unchanged = acked != NX_NULL && acked->value_hash == items[i].value_hash;
+    }
+
+    if (unchanged)
+    {
+        queue->suppressed++;
+    }
+
+    tx_mutex_put(&queue->mutex);
+
+    return unchanged;
+}
+
+VOID reported_properties_queue_acknowledge(
+    REPORTED_PROPERTIES_QUEUE* queue, const REPORTED_PROPERTIES_ITEM* items, UINT item_count)
+{
+    REPORTED_PROPERTIES_ITEM* acked;
+    UINT i;
+
+    tx_mutex_get(&queue->mutex, TX_WAIT_FOREVER);
+
+    for (i = 0; i < item_count; i++)
+    {
+        if ((acked = acked_find(queue, items[i].key_hash)) == NX_NULL)
+        {
+            // Replace round robin once full, a forgotten property only costs one redundant PATCH
+            acked = &queue->acked[queue->acked_next];
+
+            queue->acked_next = (queue->acked_next + 1) % REPORTED_PROPERTIES_CACHE_SIZE;
+            if (queue->acked_count < REPORTED_PROPERTIES_CACHE_SIZE)
+            {
+                queue->acked_count++;
+            }
+        }
+
+        *acked = items[i];
+    }
+
+    tx_mutex_put(&queue->mutex);
+}
+
+VOID reported_properties_queue_acknowledged_clear(REPORTED_PROPERTIES_QUEUE* queue)
+{
+    tx_mutex_get(&queue->mutex, TX_WAIT_FOREVER);
+
+    queue->acked_count = 0;
+    queue->acked_next  = 0;
+
+    tx_mutex_put(&queue->mutex);
+}
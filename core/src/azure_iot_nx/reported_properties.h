@@ -0,0 +1,144 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _REPORTED_PROPERTIES_H
+#define _REPORTED_PROPERTIES_H
+
+#include <stdbool.h>
+
+#include "tx_api.h"
+
+#include "nx_api.h"
+#include "nx_azure_iot_json_writer.h"
+
+#ifndef REPORTED_PROPERTIES_DOCUMENT_SIZE
+#define REPORTED_PROPERTIES_DOCUMENT_SIZE 512
+#endif
+
+#ifndef REPORTED_PROPERTIES_QUEUE_DEPTH
+#define REPORTED_PROPERTIES_QUEUE_DEPTH 4
+#endif
+
+// Properties tracked per document, a document with more is always sent
+#ifndef REPORTED_PROPERTIES_MAX_ITEMS
+#define REPORTED_PROPERTIES_MAX_ITEMS 8
+#endif
+
+// Acknowledged property values remembered to suppress PATCHes that would not change the twin
+#ifndef REPORTED_PROPERTIES_CACHE_SIZE
+#define REPORTED_PROPERTIES_CACHE_SIZE 16
+#endif
+
+// Response status passed to complete_cb when a document was not sent because the hub already holds every value
+#define REPORTED_PROPERTIES_STATUS_UNCHANGED 304
+
+typedef VOID (*func_ptr_reported_properties_complete)(
+    UINT status, UINT request_id, UINT response_status, ULONG version, VOID* context);
+
+// Hashes of a property's component qualified name and of its serialized value
+typedef struct REPORTED_PROPERTIES_ITEM_STRUCT
+{
+    ULONG key_hash;
+    ULONG value_hash;
+} REPORTED_PROPERTIES_ITEM;
+
+// Accumulates any number of reported properties, across components, into a single twin PATCH document. Errors are
+// sticky so a sequence of appends only needs to be checked once when the document is closed.
+typedef struct REPORTED_PROPERTIES_STRUCT
+{
+    NX_AZURE_IOT_JSON_WRITER json_writer;
+    UCHAR document[REPORTED_PROPERTIES_DOCUMENT_SIZE];
+    UINT length;
+
+    CHAR* component;
+    UINT status;
+
+    // Properties written through the typed appends. Raw appends can not be tracked and leave item_count at 0, which
+    // makes the document always go out.
+    REPORTED_PROPERTIES_ITEM items[REPORTED_PROPERTIES_MAX_ITEMS];
+    UINT item_count;
+    bool trackable;
+} REPORTED_PROPERTIES;
+
+typedef struct REPORTED_PROPERTIES_REQUEST_STRUCT
+{
+    UCHAR document[REPORTED_PROPERTIES_DOCUMENT_SIZE];
+    UINT length;
+
+    REPORTED_PROPERTIES_ITEM items[REPORTED_PROPERTIES_MAX_ITEMS];
+    UINT item_count;
+
+    func_ptr_reported_properties_complete complete_cb;
+    VOID* complete_context;
+} REPORTED_PROPERTIES_REQUEST;
+
+typedef struct REPORTED_PROPERTIES_QUEUE_STRUCT
+{
+    TX_MUTEX mutex;
+
+    REPORTED_PROPERTIES_REQUEST requests[REPORTED_PROPERTIES_QUEUE_DEPTH];
+    UINT head;
+    UINT count;
+
+    // Shared document for patches built by the client's single property helpers, so callers on small thread stacks do
+    // not need one of their own
+    REPORTED_PROPERTIES staging;
+
+    // Last value the hub acknowledged for each recently reported property
+    REPORTED_PROPERTIES_ITEM acked[REPORTED_PROPERTIES_CACHE_SIZE];
+    UINT acked_count;
+    UINT acked_next;
+    ULONG suppressed;
+} REPORTED_PROPERTIES_QUEUE;
+
+UINT reported_properties_begin(REPORTED_PROPERTIES* props);
+
+// Properties appended after this belong to component, NX_NULL switches back to the root of the document
+UINT reported_properties_component_set(REPORTED_PROPERTIES* props, CHAR* component);
+
+UINT reported_properties_append(REPORTED_PROPERTIES* props,
+    UINT (*append_properties)(NX_AZURE_IOT_JSON_WRITER* json_builder_ptr, VOID* context),
+    VOID* context);
+UINT reported_properties_append_float(REPORTED_PROPERTIES* props, CHAR* key, float value);
+UINT reported_properties_append_bool(REPORTED_PROPERTIES* props, CHAR* key, bool value);
+UINT reported_properties_append_int(REPORTED_PROPERTIES* props, CHAR* key, INT value);
+
+// Writeable property acknowledgement in the {"value":..,"ac":..,"av":..} form
+UINT reported_properties_append_writeable_ack(
+    REPORTED_PROPERTIES* props, CHAR* key, INT value, UINT ack_code, UINT ack_version);
+
+UINT reported_properties_end(REPORTED_PROPERTIES* props);
+
+UINT reported_properties_queue_create(REPORTED_PROPERTIES_QUEUE* queue);
+UINT reported_properties_queue_delete(REPORTED_PROPERTIES_QUEUE* queue);
+
+// Queue a closed document, fails with NX_OVERFLOW rather than dropping an earlier update
+UINT reported_properties_queue_push(REPORTED_PROPERTIES_QUEUE* queue,
+    REPORTED_PROPERTIES* props,
+    func_ptr_reported_properties_complete complete_cb,
+    VOID* complete_context);
+
+// Begin the shared staging document. The queue stays locked until reported_properties_queue_stage_push, which must
+// follow, closes and queues the document.
+REPORTED_PROPERTIES* reported_properties_queue_stage(REPORTED_PROPERTIES_QUEUE* queue);
+UINT reported_properties_queue_stage_push(REPORTED_PROPERTIES_QUEUE* queue,
+    func_ptr_reported_properties_complete complete_cb,
+    VOID* complete_context);
+
+// Only the consumer removes requests so the oldest one can be sent in place, without holding the queue lock
+REPORTED_PROPERTIES_REQUEST* reported_properties_queue_peek(REPORTED_PROPERTIES_QUEUE* queue);
+VOID reported_properties_queue_remove(REPORTED_PROPERTIES_QUEUE* queue);
+
+// True when every item already has the same acknowledged value, so sending the document would not change the twin.
+// Counts the suppression.
+bool reported_properties_queue_unchanged(
+    REPORTED_PROPERTIES_QUEUE* queue, const REPORTED_PROPERTIES_ITEM* items, UINT item_count);
+
+// Record the values of a document the hub accepted
+VOID reported_properties_queue_acknowledge(
+    REPORTED_PROPERTIES_QUEUE* queue, const REPORTED_PROPERTIES_ITEM* items, UINT item_count);
+
+// Forget every acknowledged value, for when the twin may have been replaced
+VOID reported_properties_queue_acknowledged_clear(REPORTED_PROPERTIES_QUEUE* queue);
+
+#endif // _REPORTED_PROPERTIES_H
@@ -0,0 +1,260 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include "telemetry_batch.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const CHAR timestamp_property_name[] = "ts";
+
+static VOID deadline_timer_expired(ULONG parameter)
+{
+    TELEMETRY_BATCH* batch = (TELEMETRY_BATCH*)parameter;
+
+    // Timer context, defer the flush to the owning thread
+    tx_event_flags_set(batch->events, batch->deadline_event, TX_OR);
+}
+
+// The following helpers must be called with the batch mutex held
+static UINT batch_open(TELEMETRY_BATCH* batch)
+{
+    UINT status;
+
+    if ((status = telemetry_writer_with_buffer_init(
+             &batch->writer, TELEMETRY_ENCODING_JSON, batch->buffer, sizeof(batch->buffer))))
+    {
+        printf("Failed to initialize json writer\r\n");
+        return NX_NOT_SUCCESSFUL;
+    }
+
+    if ((status = nx_azure_iot_json_writer_append_begin_array(&batch->writer.encoder.json)))
+    {
+        printf("Failed to open telemetry batch (0x%08x)\r\n", status);
+        telemetry_writer_deinit(&batch->writer);
+        return status;
+    }
+
+    // Start the latency budget from the first sample
+    tx_timer_deactivate(&batch->deadline_timer);
+    tx_timer_change(&batch->deadline_timer, batch->max_delay_ticks, 0);
+    tx_timer_activate(&batch->deadline_timer);
+
+    return NX_SUCCESS;
+}
+
+static UINT batch_close(TELEMETRY_BATCH* batch)
+{
+    UINT status;
+
+    if (batch->sample_count == 0)
+    {
+        return NX_NOT_FOUND;
+    }
+
+    tx_timer_deactivate(&batch->deadline_timer);
+
+    if ((status = nx_azure_iot_json_writer_append_end_array(&batch->writer.encoder.json)))
+    {
+        printf("Failed to close telemetry batch (0x%08x)\r\n", status);
+    }
+    else if ((status = telemetry_queue_payload_push(batch->queue,
+                  batch->buffer,
+                  telemetry_writer_get_bytes_used(&batch->writer),
+                  &batch->deadbands,
+                  NX_NULL,
+                  NX_NULL)))
+    {
+        printf("Failed to enqueue telemetry batch of %d samples (0x%08x)\r\n", batch->sample_count, status);
+    }
+
+    // The queue owns the deadbands once the batch is in it
+    if (status)
+    {
+        telemetry_deadband_list_release(&batch->deadbands, NX_NULL);
+    }
+
+    batch->deadbands.count = 0;
+
+    telemetry_writer_deinit(&batch->writer);
+    batch->sample_count = 0;
+
+    return status;
+}
+
+static UINT sample_append(
+    TELEMETRY_BATCH* batch, uint64_t timestamp_ms, func_ptr_telemetry_append append_properties)
+{
+    // Keep a copy so a sample that does not fit can be rolled back without corrupting the batch
+    TELEMETRY_WRITER snapshot = batch->writer;
+    UINT index;
+
+    batch->writer.property_count  = 0;
+    batch->writer.deadbands.count = 0;
+
+    if (nx_azure_iot_json_writer_append_begin_object(&batch->writer.encoder.json) ||
+        nx_azure_iot_json_writer_append_property_with_double_value(&batch->writer.encoder.json,
+            (UCHAR*)timestamp_property_name,
+            sizeof(timestamp_property_name) - 1,
+            (double)timestamp_ms / 1000,
+            3) ||
+        (append_properties(&batch->writer, NX_NULL) != NX_AZURE_IOT_SUCCESS) ||
+        nx_azure_iot_json_writer_append_end_object(&batch->writer.encoder.json) ||
+        (telemetry_writer_get_bytes_used(&batch->writer) >= sizeof(batch->buffer)))
+    {
+        // Roll back, leaving room for the closing bracket. The deadbands this sample passed are released so a retry
+        // in a fresh batch makes the same decisions rather than filtering against the values that were just lost.
+        telemetry_writer_deadbands_release(&batch->writer);
+        batch->writer = snapshot;
+        return NX_SIZE_ERROR;
+    }
+
+    if (batch->writer.property_count == 0)
+    {
+        // Every property was filtered out, a bare timestamp is not worth sending
+        batch->writer = snapshot;
+        return NX_NOT_FOUND;
+    }
+
+    for (index = 0; index < batch->writer.deadbands.count; index++)
+    {
+        telemetry_deadband_list_add(&batch->deadbands, batch->writer.deadbands.deadbands[index]);
+    }
+
+    batch->sample_count++;
+
+    return NX_SUCCESS;
+}
+
+UINT telemetry_batch_create(
+    TELEMETRY_BATCH* batch, TELEMETRY_QUEUE* queue, TX_EVENT_FLAGS_GROUP* events, ULONG deadline_event)
+{
+    UINT status;
+
+    if (batch == NX_NULL || queue == NX_NULL || events == NX_NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    memset(batch, 0, sizeof(TELEMETRY_BATCH));
+
+    batch->queue           = queue;
+    batch->events          = events;
+    batch->deadline_event  = deadline_event;
+    batch->max_samples     = TELEMETRY_BATCH_DEFAULT_MAX_SAMPLES;
+    batch->max_delay_ticks = TELEMETRY_BATCH_DEFAULT_MAX_DELAY_TICKS;
+
+    if ((status = tx_mutex_create(&batch->mutex, "telemetry batch", TX_INHERIT)))
+    {
+        printf("ERROR: failed to create telemetry batch mutex (0x%08x)\r\n", status);
+        return status;
+    }
+
+    if ((status = tx_timer_create(&batch->deadline_timer,
+             "telemetry batch",
+             deadline_timer_expired,
+             (ULONG)batch,
+             batch->max_delay_ticks,
+             0,
+             TX_NO_ACTIVATE)))
+    {
+        printf("ERROR: failed to create telemetry batch timer (0x%08x)\r\n", status);
+        tx_mutex_delete(&batch->mutex);
+        return status;
+    }
+
+    return NX_SUCCESS;
+}
+
+UINT telemetry_batch_delete(TELEMETRY_BATCH* batch)
+{
+    telemetry_batch_flush(batch);
+
+    tx_timer_delete(&batch->deadline_timer);
+    tx_mutex_delete(&batch->mutex);
+
+    return NX_SUCCESS;
+}
+
+UINT telemetry_batch_config_set(TELEMETRY_BATCH* batch, UINT max_samples, ULONG max_delay_ticks)
+{
+    if (max_samples == 0 || max_delay_ticks == 0)
+    {
+        return NX_INVALID_PARAMETERS;
+    }
+
+    tx_mutex_get(&batch->mutex, TX_WAIT_FOREVER);
+
+    batch->max_samples     = max_samples;
+    batch->max_delay_ticks = max_delay_ticks;
+
+    // Don't let a shrunk batch size hold back samples that are already due
+    if (batch->sample_count >= batch->max_samples)
+    {
+        batch_close(batch);
+    }
+
+    tx_mutex_put(&batch->mutex);
+
+    return NX_SUCCESS;
+}
+
+UINT telemetry_batch_append(
+    TELEMETRY_BATCH* batch, uint64_t timestamp_ms, func_ptr_telemetry_append append_properties)
+{
+    UINT status;
+
+    tx_mutex_get(&batch->mutex, TX_WAIT_FOREVER);
+
+    if (batch->sample_count == 0 && (status = batch_open(batch)))
+    {
+        tx_mutex_put(&batch->mutex);
+        return status;
+    }
+
+    status = sample_append(batch, timestamp_ms, append_properties);
+
+    // Batch is out of room, ship what we have and start a new one with this sample
+    if (status == NX_SIZE_ERROR && batch->sample_count > 0)
+    {
+        batch_close(batch);
+
+        if ((status = batch_open(batch)) == NX_SUCCESS)
+        {
+            status = sample_append(batch, timestamp_ms, append_properties);
+        }
+    }
+
+    if (status != NX_SUCCESS)
+    {
+        if (status != NX_NOT_FOUND)
+        {
+            printf("Failed to add sample to telemetry batch (0x%08x)\r\n", status);
+        }
+
+        if (batch->sample_count == 0)
+        {
+            tx_timer_deactivate(&batch->deadline_timer);
+            telemetry_writer_deinit(&batch->writer);
+        }
+    }
+    else if (batch->sample_count >= batch->max_samples)
+    {
+        status = batch_close(batch);
+    }
+
+    tx_mutex_put(&batch->mutex);
+
+    return status;
+}
+
+UINT telemetry_batch_flush(TELEMETRY_BATCH* batch)
+{
+    UINT status;
+
+    tx_mutex_get(&batch->mutex, TX_WAIT_FOREVER);
+    status = batch_close(batch);
+    tx_mutex_put(&batch->mutex);
+
+    return status;
+}
@@ -0,0 +1,61 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _TELEMETRY_BATCH_H
+#define _TELEMETRY_BATCH_H
+
+#include <stdint.h>
+
+#include "tx_api.h"
+
+#include "nx_api.h"
+
+#include "telemetry_queue.h"
+#include "telemetry_writer.h"
+
+#define TELEMETRY_BATCH_DEFAULT_MAX_SAMPLES     10
+#define TELEMETRY_BATCH_DEFAULT_MAX_DELAY_TICKS (60 * TX_TIMER_TICKS_PER_SECOND)
+
+// Batches are built in RAM so a sample that does not fit can be rolled back, and copied into a packet once closed
+#ifndef TELEMETRY_BATCH_BUFFER_SIZE
+#define TELEMETRY_BATCH_BUFFER_SIZE 512
+#endif
+
+typedef struct TELEMETRY_BATCH_STRUCT
+{
+    TX_MUTEX mutex;
+    TX_TIMER deadline_timer;
+
+    TELEMETRY_QUEUE* queue;
+    TX_EVENT_FLAGS_GROUP* events;
+    ULONG deadline_event;
+
+    UINT max_samples;
+    ULONG max_delay_ticks;
+
+    // Batches are always JSON arrays
+    TELEMETRY_WRITER writer;
+    UCHAR buffer[TELEMETRY_BATCH_BUFFER_SIZE];
+    UINT sample_count;
+
+    // Deadbands of every sample in the batch, handed to the queue with it
+    TELEMETRY_DEADBAND_LIST deadbands;
+} TELEMETRY_BATCH;
+
+// A closed batch is handed to queue. When the latency budget expires deadline_event is raised on events, the owner
+// is expected to call telemetry_batch_flush from its own thread.
+UINT telemetry_batch_create(
+    TELEMETRY_BATCH* batch, TELEMETRY_QUEUE* queue, TX_EVENT_FLAGS_GROUP* events, ULONG deadline_event);
+UINT telemetry_batch_delete(TELEMETRY_BATCH* batch);
+
+UINT telemetry_batch_config_set(TELEMETRY_BATCH* batch, UINT max_samples, ULONG max_delay_ticks);
+
+// A sample whose properties were all filtered out is dropped with NX_NOT_FOUND. append_properties runs a second time
+// when the sample has to start a new batch, deadbands checked through telemetry_writer_deadband_check are released
+// in between so the second run still includes the values the first one let through.
+// The sample is stamped as Unix seconds with millisecond precision.
+UINT telemetry_batch_append(
+    TELEMETRY_BATCH* batch, uint64_t timestamp_ms, func_ptr_telemetry_append append_properties);
+UINT telemetry_batch_flush(TELEMETRY_BATCH* batch);
+
+#endif // _TELEMETRY_BATCH_H
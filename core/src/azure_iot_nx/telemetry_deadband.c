@@ -0,0 +1,99 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include "telemetry_deadband.h"
+
+VOID telemetry_deadband_set(TELEMETRY_DEADBAND* deadband, double absolute, double percent, UINT heartbeat_secs)
+{
+    deadband->absolute        = absolute;
+    deadband->percent         = percent;
+    deadband->heartbeat_ticks = heartbeat_secs * TX_TIMER_TICKS_PER_SECOND;
+
+    // Let the next sample through so the new thresholds apply from a fresh reference
+    deadband->reported = false;
+}
+
+bool telemetry_deadband_check(TELEMETRY_DEADBAND* deadband, double value)
+{
+    ULONG now = tx_time_get();
+    double change;
+    double reference;
+    bool send;
+
+    if (!deadband->reported)
+    {
+        send = true;
+    }
+    else if (deadband->heartbeat_ticks != 0 && now - deadband->last_time >= deadband->heartbeat_ticks)
+    {
+        send = true;
+    }
+    else
+    {
+        change    = value - deadband->last_value;
+        change    = change < 0 ? -change : change;
+        reference = deadband->last_value < 0 ? -deadband->last_value : deadband->last_value;
+
+        if (deadband->absolute == 0 && deadband->percent == 0)
+        {
+            send = change != 0;
+        }
+        else
+        {
+            send = (deadband->absolute != 0 && change >= deadband->absolute) ||
+                   (deadband->percent != 0 && change >= reference * deadband->percent / 100);
+        }
+    }
+
+    if (send)
+    {
+        deadband->last_value = value;
+        deadband->last_time  = now;
+        deadband->reported   = true;
+    }
+
+    return send;
+}
+
+VOID telemetry_deadband_invalidate(TELEMETRY_DEADBAND* deadband)
+{
+    deadband->reported = false;
+}
+
+static bool list_contains(const TELEMETRY_DEADBAND_LIST* list, TELEMETRY_DEADBAND* deadband)
+{
+    UINT index;
+
+    for (index = 0; index < list->count; index++)
+    {
+        if (list->deadbands[index] == deadband)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+VOID telemetry_deadband_list_add(TELEMETRY_DEADBAND_LIST* list, TELEMETRY_DEADBAND* deadband)
+{
+    if (list->count < TELEMETRY_DEADBAND_LIST_MAX && !list_contains(list, deadband))
+    {
+        list->deadbands[list->count++] = deadband;
+    }
+}
+
+VOID telemetry_deadband_list_release(TELEMETRY_DEADBAND_LIST* list, const TELEMETRY_DEADBAND_LIST* keep)
+{
+    UINT index;
+
+    for (index = 0; index < list->count; index++)
+    {
+        if (keep == TX_NULL || !list_contains(keep, list->deadbands[index]))
+        {
+            telemetry_deadband_invalidate(list->deadbands[index]);
+        }
+    }
+
+    list->count = 0;
+}
@@ -0,0 +1,57 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _TELEMETRY_DEADBAND_H
+#define _TELEMETRY_DEADBAND_H
+
+#include <stdbool.h>
+
+#include "tx_api.h"
+
+// Report by exception for a single telemetry signal. A value is only sent when it has moved beyond the absolute or
+// percent threshold from the last value sent, or when the signal has been silent for the heartbeat interval. As the
+// comparison is against the last sent value, noise around a threshold does not cause repeated sends.
+typedef struct TELEMETRY_DEADBAND_STRUCT
+{
+    double absolute;       // minimum change in signal units, 0 to disable
+    double percent;        // minimum change relative to the last sent value, 0 to disable
+    ULONG heartbeat_ticks; // longest silence before the value is resent anyway, 0 to disable
+
+    double last_value;
+    ULONG last_time;
+    bool reported;
+} TELEMETRY_DEADBAND;
+
+// Deadbands whose last sent value travels in one message, any beyond this keep their value if the message is lost
+#ifndef TELEMETRY_DEADBAND_LIST_MAX
+#define TELEMETRY_DEADBAND_LIST_MAX 4
+#endif
+
+// The value a deadband records is committed optimistically, when the message carrying it is built. The list follows
+// the message so that if it is dropped or fails to send, each deadband lets its next sample through again.
+typedef struct TELEMETRY_DEADBAND_LIST_STRUCT
+{
+    TELEMETRY_DEADBAND* deadbands[TELEMETRY_DEADBAND_LIST_MAX];
+    UINT count;
+} TELEMETRY_DEADBAND_LIST;
+
+// With both thresholds at 0 any change is reported
+#define TELEMETRY_DEADBAND_INIT(absolute, percent, heartbeat_secs) \
+    {(absolute), (percent), (heartbeat_secs)*TX_TIMER_TICKS_PER_SECOND, 0, 0, false}
+
+VOID telemetry_deadband_set(TELEMETRY_DEADBAND* deadband, double absolute, double percent, UINT heartbeat_secs);
+
+// Returns true when value should be sent and records it as the last sent value
+bool telemetry_deadband_check(TELEMETRY_DEADBAND* deadband, double value);
+
+// Forget the last sent value so the next sample goes through, for when the message carrying it was never delivered
+VOID telemetry_deadband_invalidate(TELEMETRY_DEADBAND* deadband);
+
+// Add deadband to list unless it is already there
+VOID telemetry_deadband_list_add(TELEMETRY_DEADBAND_LIST* list, TELEMETRY_DEADBAND* deadband);
+
+// Invalidate every deadband in list and empty it. Deadbands also in keep, which may be TX_NULL, are left alone as a
+// newer message still carries their value.
+VOID telemetry_deadband_list_release(TELEMETRY_DEADBAND_LIST* list, const TELEMETRY_DEADBAND_LIST* keep);
+
+#endif // _TELEMETRY_DEADBAND_H
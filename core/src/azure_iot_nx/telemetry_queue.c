@@ -0,0 +1,396 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include "telemetry_queue.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Give a payload packet back to its pool
+static VOID payload_release(TELEMETRY_QUEUE_ENTRY* entry)
+{
+    if (entry->payload != NX_NULL)
+    {
+        nx_packet_release(entry->payload);
+        entry->payload = NX_NULL;
+    }
+}
+
+UINT telemetry_queue_create(TELEMETRY_QUEUE* queue, NX_PACKET_POOL* pool, TELEMETRY_QUEUE_POLICY policy)
+{
+    UINT status;
+
+    if (queue == NX_NULL || pool == NX_NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    memset(queue, 0, sizeof(TELEMETRY_QUEUE));
+
+    queue->policy = policy;
+    queue->pool   = pool;
+
+    if ((status = tx_mutex_create(&queue->mutex, "telemetry queue", TX_INHERIT)))
+    {
+        printf("ERROR: failed to create telemetry queue mutex (0x%08x)\r\n", status);
+        return status;
+    }
+
+    if ((status = tx_mutex_create(&queue->producer_mutex, "telemetry queue producer", TX_INHERIT)))
+    {
+        printf("ERROR: failed to create telemetry queue producer mutex (0x%08x)\r\n", status);
+        tx_mutex_delete(&queue->mutex);
+        return status;
+    }
+
+    return NX_SUCCESS;
+}
+
+UINT telemetry_queue_delete(TELEMETRY_QUEUE* queue)
+{
+    TELEMETRY_QUEUE_ENTRY* entry;
+
+    tx_mutex_get(&queue->mutex, TX_WAIT_FOREVER);
+
+    // Fail anything still waiting to go out so the owners can release their resources
+    while (queue->count > 0)
+    {
+        entry = &queue->entries[queue->head];
+
+        if (entry->complete_cb)
+        {
+            entry->complete_cb(NX_NOT_SUCCESSFUL, entry->complete_context);
+        }
+
+        telemetry_deadband_list_release(&entry->deadbands, NX_NULL);
+        payload_release(entry);
+
+        queue->head = (queue->head + 1) % TELEMETRY_QUEUE_SLOTS;
+        queue->count--;
+        queue->stats.failed++;
+    }
+
+    tx_mutex_put(&queue->mutex);
+
+    tx_mutex_delete(&queue->producer_mutex);
+    tx_mutex_delete(&queue->mutex);
+
+    return NX_SUCCESS;
+}
+
+UINT telemetry_queue_policy_set(TELEMETRY_QUEUE* queue, TELEMETRY_QUEUE_POLICY policy)
+{
+    tx_mutex_get(&queue->mutex, TX_WAIT_FOREVER);
+    queue->policy = policy;
+    tx_mutex_put(&queue->mutex);
+
+    return NX_SUCCESS;
+}
+
+// Claim the free slot past the tail, applying the DROP_NEWEST policy up front. Nothing is evicted here so a message
+// that fails to build costs nothing. Must be called with the producer mutex held.
+static TELEMETRY_QUEUE_ENTRY* slot_reserve(TELEMETRY_QUEUE* queue)
+{
+    TELEMETRY_QUEUE_ENTRY* entry = NX_NULL;
+
+    tx_mutex_get(&queue->mutex, TX_WAIT_FOREVER);
+
+    if (queue->count == TELEMETRY_QUEUE_DEPTH && queue->policy == TELEMETRY_QUEUE_DROP_NEWEST)
+    {
+        queue->stats.dropped_newest++;
+    }
+    else
+    {
+        // The consumer only ever advances the head past occupied slots, so this slot stays ours until the commit
+        entry = &queue->entries[(queue->head + queue->count) % TELEMETRY_QUEUE_SLOTS];
+    }
+
+    tx_mutex_put(&queue->mutex);
+
+    return entry;
+}
+
+// Publish a filled slot to the consumer, evicting the oldest message if the ring is still full. Only producers add
+// messages and they are serialized, so a full ring here means DROP_OLDEST was in force at reserve time. Must be called
+// with the producer mutex held, the evicted owner is notified once the lock is released.
+static VOID slot_commit(TELEMETRY_QUEUE* queue,
+    TELEMETRY_QUEUE_ENTRY* entry,
+    NX_PACKET* payload,
+    TELEMETRY_ENCODING encoding,
+    const TELEMETRY_DEADBAND_LIST* deadbands,
+    func_ptr_telemetry_complete complete_cb,
+    VOID* complete_context,
+    func_ptr_telemetry_complete* evicted_cb,
+    VOID** evicted_context)
+{
+    TELEMETRY_QUEUE_ENTRY* oldest;
+
+    *evicted_cb      = NX_NULL;
+    *evicted_context = NX_NULL;
+
+    entry->payload          = payload;
+    entry->encoding         = encoding;
+    entry->complete_cb      = complete_cb;
+    entry->complete_context = complete_context;
+    entry->deadbands.count  = 0;
+
+    if (deadbands != NX_NULL)
+    {
+        entry->deadbands = *deadbands;
+    }
+
+    tx_mutex_get(&queue->mutex, TX_WAIT_FOREVER);
+
+    if (queue->count == TELEMETRY_QUEUE_DEPTH)
+    {
+        oldest           = &queue->entries[queue->head];
+        *evicted_cb      = oldest->complete_cb;
+        *evicted_context = oldest->complete_context;
+
+        // Deadbands are only changed with the producer mutex held
+        telemetry_deadband_list_release(&oldest->deadbands, &entry->deadbands);
+        payload_release(oldest);
+
+        queue->head = (queue->head + 1) % TELEMETRY_QUEUE_SLOTS;
+        queue->count--;
+        queue->stats.dropped_oldest++;
+    }
+
+    queue->count++;
+    queue->stats.enqueued++;
+
+    if (queue->count > queue->stats.depth_high_watermark)
+    {
+        queue->stats.depth_high_watermark = queue->count;
+    }
+
+    tx_mutex_put(&queue->mutex);
+}
+
+// The pool is shared with the connection, so a message that finds it empty is refused rather than waited for. No room
+// is left for headers, the payload is chained behind the packet carrying the topic when it is sent.
+static UINT payload_allocate(TELEMETRY_QUEUE* queue, NX_PACKET** packet_pptr)
+{
+    UINT status;
+
+    if ((status = nx_packet_allocate(queue->pool, packet_pptr, NX_RECEIVE_PACKET, NX_NO_WAIT)))
+    {
+        tx_mutex_get(&queue->mutex, TX_WAIT_FOREVER);
+        queue->stats.no_packet++;
+        tx_mutex_put(&queue->mutex);
+
+        return status;
+    }
+
+    return NX_SUCCESS;
+}
+
+UINT telemetry_queue_push(TELEMETRY_QUEUE* queue,
+    TELEMETRY_ENCODING encoding,
+    func_ptr_telemetry_append append_properties,
+    func_ptr_telemetry_complete complete_cb,
+    VOID* complete_context)
+{
+    UINT status;
+    TELEMETRY_WRITER writer;
+    TELEMETRY_QUEUE_ENTRY* entry;
+    NX_PACKET* payload;
+    func_ptr_telemetry_complete evicted_cb = NX_NULL;
+    VOID* evicted_context                  = NX_NULL;
+
+    tx_mutex_get(&queue->producer_mutex, TX_WAIT_FOREVER);
+
+    if ((entry = slot_reserve(queue)) == NX_NULL)
+    {
+        tx_mutex_put(&queue->producer_mutex);
+        return NX_OVERFLOW;
+    }
+
+    if ((status = payload_allocate(queue, &payload)))
+    {
+        tx_mutex_put(&queue->producer_mutex);
+        return status;
+    }
+
+    if ((status = telemetry_writer_init(&writer, encoding, payload, NX_NO_WAIT)))
+    {
+        printf("Failed to initialize telemetry writer\r\n");
+        nx_packet_release(payload);
+        status = NX_NOT_SUCCESSFUL;
+    }
+    else
+    {
+        if ((status = telemetry_writer_build(&writer, append_properties, NX_NULL)) == NX_NOT_FOUND)
+        {
+            tx_mutex_get(&queue->mutex, TX_WAIT_FOREVER);
+            queue->stats.suppressed++;
+            tx_mutex_put(&queue->mutex);
+            nx_packet_release(payload);
+        }
+        else if (status)
+        {
+            printf("Failed to build telemetry!: error code = 0x%08x\r\n", status);
+            nx_packet_release(payload);
+        }
+        else
+        {
+            slot_commit(queue,
+                entry,
+                payload,
+                encoding,
+                &writer.deadbands,
+                complete_cb,
+                complete_context,
+                &evicted_cb,
+                &evicted_context);
+        }
+
+        telemetry_writer_deinit(&writer);
+    }
+
+    tx_mutex_put(&queue->producer_mutex);
+
+    if (evicted_cb)
+    {
+        evicted_cb(NX_OVERFLOW, evicted_context);
+    }
+
+    return status;
+}
+
+UINT telemetry_queue_payload_push(TELEMETRY_QUEUE* queue,
+    const UCHAR* payload,
+    UINT payload_length,
+    const TELEMETRY_DEADBAND_LIST* deadbands,
+    func_ptr_telemetry_complete complete_cb,
+    VOID* complete_context)
+{
+    UINT status;
+    TELEMETRY_QUEUE_ENTRY* entry;
+    NX_PACKET* packet;
+    func_ptr_telemetry_complete evicted_cb;
+    VOID* evicted_context;
+
+    tx_mutex_get(&queue->producer_mutex, TX_WAIT_FOREVER);
+
+    if ((entry = slot_reserve(queue)) == NX_NULL)
+    {
+        tx_mutex_put(&queue->producer_mutex);
+        return NX_OVERFLOW;
+    }
+
+    if ((status = payload_allocate(queue, &packet)))
+    {
+        tx_mutex_put(&queue->producer_mutex);
+        return status;
+    }
+
+    if ((status = nx_packet_data_append(packet, (VOID*)payload, payload_length, queue->pool, NX_NO_WAIT)))
+    {
+        printf("Failed to copy telemetry into packet (0x%08x)\r\n", status);
+        nx_packet_release(packet);
+        tx_mutex_put(&queue->producer_mutex);
+        return status;
+    }
+
+    slot_commit(queue,
+        entry,
+        packet,
+        telemetry_payload_encoding(payload, payload_length),
+        deadbands,
+        complete_cb,
+        complete_context,
+        &evicted_cb,
+        &evicted_context);
+
+    tx_mutex_put(&queue->producer_mutex);
+
+    if (evicted_cb)
+    {
+        evicted_cb(NX_OVERFLOW, evicted_context);
+    }
+
+    return NX_SUCCESS;
+}
+
+UINT telemetry_queue_pop(TELEMETRY_QUEUE* queue, TELEMETRY_QUEUE_ENTRY* entry)
+{
+    TELEMETRY_QUEUE_ENTRY* head;
+
+    tx_mutex_get(&queue->mutex, TX_WAIT_FOREVER);
+
+    if (queue->count == 0)
+    {
+        tx_mutex_put(&queue->mutex);
+        return NX_NOT_FOUND;
+    }
+
+    head = &queue->entries[queue->head];
+
+    entry->payload          = head->payload;
+    entry->encoding         = head->encoding;
+    entry->complete_cb      = head->complete_cb;
+    entry->complete_context = head->complete_context;
+    entry->deadbands        = head->deadbands;
+
+    head->payload = NX_NULL;
+
+    queue->head = (queue->head + 1) % TELEMETRY_QUEUE_SLOTS;
+    queue->count--;
+
+    tx_mutex_put(&queue->mutex);
+
+    return NX_SUCCESS;
+}
+
+VOID telemetry_queue_complete(TELEMETRY_QUEUE* queue, TELEMETRY_QUEUE_ENTRY* entry, UINT status)
+{
+    tx_mutex_get(&queue->mutex, TX_WAIT_FOREVER);
+
+    if (status == NX_SUCCESS)
+    {
+        queue->stats.sent++;
+    }
+    else if (status == NX_IN_PROGRESS)
+    {
+        queue->stats.deferred++;
+    }
+    else
+    {
+        queue->stats.failed++;
+    }
+
+    tx_mutex_put(&queue->mutex);
+
+    // The next sample of each deadband goes out rather than being filtered against a value the hub never saw
+    if (status != NX_SUCCESS && status != NX_IN_PROGRESS)
+    {
+        tx_mutex_get(&queue->producer_mutex, TX_WAIT_FOREVER);
+        telemetry_deadband_list_release(&entry->deadbands, NX_NULL);
+        tx_mutex_put(&queue->producer_mutex);
+    }
+
+    payload_release(entry);
+
+    if (entry->complete_cb)
+    {
+        entry->complete_cb(status, entry->complete_context);
+    }
+}
+
+UINT telemetry_queue_stats_get(TELEMETRY_QUEUE* queue, TELEMETRY_QUEUE_STATS* stats)
+{
+    if (queue == NX_NULL || stats == NX_NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    tx_mutex_get(&queue->mutex, TX_WAIT_FOREVER);
+
+    *stats       = queue->stats;
+    stats->depth = queue->count;
+
+    tx_mutex_put(&queue->mutex);
+
+    return NX_SUCCESS;
+}
@@ -0,0 +1,102 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _TELEMETRY_QUEUE_H
+#define _TELEMETRY_QUEUE_H
+
+#include "tx_api.h"
+
+#include "nx_api.h"
+
+#include "telemetry_writer.h"
+
+#ifndef TELEMETRY_QUEUE_DEPTH
+#define TELEMETRY_QUEUE_DEPTH 8
+#endif
+
+typedef enum TELEMETRY_QUEUE_POLICY_ENUM
+{
+    TELEMETRY_QUEUE_DROP_OLDEST,
+    TELEMETRY_QUEUE_DROP_NEWEST
+} TELEMETRY_QUEUE_POLICY;
+
+typedef VOID (*func_ptr_telemetry_complete)(UINT status, VOID* context);
+
+typedef struct TELEMETRY_QUEUE_ENTRY_STRUCT
+{
+    // Serialized straight into packets of the queue pool, chained when it outgrows one. The entry owns the packet
+    // until it is sent, a message that is dropped or fails releases it.
+    NX_PACKET* payload;
+    TELEMETRY_ENCODING encoding;
+
+    func_ptr_telemetry_complete complete_cb;
+    VOID* complete_context;
+
+    // Released when the message is evicted or fails to send
+    TELEMETRY_DEADBAND_LIST deadbands;
+} TELEMETRY_QUEUE_ENTRY;
+
+typedef struct TELEMETRY_QUEUE_STATS_STRUCT
+{
+    UINT depth;
+    UINT depth_high_watermark;
+    ULONG enqueued;
+    ULONG sent;
+    ULONG failed;
+    ULONG deferred;
+    ULONG dropped_oldest;
+    ULONG dropped_newest;
+    ULONG no_packet; // messages refused because the pool was empty
+    ULONG suppressed; // messages whose every property was filtered out by a deadband
+} TELEMETRY_QUEUE_STATS;
+
+// One slot more than the depth, the slot after the tail is always free and is where producers serialize
+#define TELEMETRY_QUEUE_SLOTS (TELEMETRY_QUEUE_DEPTH + 1)
+
+typedef struct TELEMETRY_QUEUE_STRUCT
+{
+    TX_MUTEX mutex;
+    TX_MUTEX producer_mutex; // serializes producers, held while the application builds a message
+    TELEMETRY_QUEUE_POLICY policy;
+    NX_PACKET_POOL* pool;
+
+    TELEMETRY_QUEUE_ENTRY entries[TELEMETRY_QUEUE_SLOTS];
+    UINT head;
+    UINT count;
+
+    TELEMETRY_QUEUE_STATS stats;
+} TELEMETRY_QUEUE;
+
+// Messages are built in packets of pool, ideally the pool the hub connection sends from so they go out without a copy
+UINT telemetry_queue_create(TELEMETRY_QUEUE* queue, NX_PACKET_POOL* pool, TELEMETRY_QUEUE_POLICY policy);
+UINT telemetry_queue_delete(TELEMETRY_QUEUE* queue);
+UINT telemetry_queue_policy_set(TELEMETRY_QUEUE* queue, TELEMETRY_QUEUE_POLICY policy);
+
+// Serialize a message into a packet for the free slot past the tail, never blocks on the network or the pool.
+// append_properties runs without the queue lock held and the oldest message is only evicted once the new one is
+// built. Returns NX_NOT_FOUND without queueing or evicting anything when append_properties filtered out every property.
+UINT telemetry_queue_push(TELEMETRY_QUEUE* queue,
+    TELEMETRY_ENCODING encoding,
+    func_ptr_telemetry_append append_properties,
+    func_ptr_telemetry_complete complete_cb,
+    VOID* complete_context);
+
+// Enqueue an already serialized message, deadbands (may be NX_NULL) holds those whose value it carries
+UINT telemetry_queue_payload_push(TELEMETRY_QUEUE* queue,
+    const UCHAR* payload,
+    UINT payload_length,
+    const TELEMETRY_DEADBAND_LIST* deadbands,
+    func_ptr_telemetry_complete complete_cb,
+    VOID* complete_context);
+
+// Move the oldest message into entry so it can be sent without holding the queue lock, the payload packet moves with it
+UINT telemetry_queue_pop(TELEMETRY_QUEUE* queue, TELEMETRY_QUEUE_ENTRY* entry);
+
+// Account for a popped message and fire its completion callback, NX_IN_PROGRESS marks it as handed off for later.
+// A failed message releases its deadbands. Whatever payload packet is still left in entry is released, a sender that
+// handed it to the network clears entry->payload first.
+VOID telemetry_queue_complete(TELEMETRY_QUEUE* queue, TELEMETRY_QUEUE_ENTRY* entry, UINT status);
+
+UINT telemetry_queue_stats_get(TELEMETRY_QUEUE* queue, TELEMETRY_QUEUE_STATS* stats);
+
+#endif // _TELEMETRY_QUEUE_H
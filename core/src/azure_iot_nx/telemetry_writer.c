@@ -0,0 +1,192 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include "telemetry_writer.h"
+
+#include <stdio.h>
+
+#include "nx_azure_iot.h"
+
+UINT telemetry_writer_init(TELEMETRY_WRITER* writer, TELEMETRY_ENCODING encoding, NX_PACKET* packet, UINT wait_option)
+{
+    writer->encoding       = encoding;
+    writer->property_count  = 0;
+    writer->deadbands.count = 0;
+
+    if (encoding == TELEMETRY_ENCODING_CBOR)
+    {
+        return cbor_writer_init(&writer->encoder.cbor, packet, wait_option);
+    }
+
+    return nx_azure_iot_json_writer_init(&writer->encoder.json, packet, wait_option);
+}
+
+UINT telemetry_writer_with_buffer_init(
+    TELEMETRY_WRITER* writer, TELEMETRY_ENCODING encoding, UCHAR* buffer, UINT buffer_size)
+{
+    writer->encoding       = encoding;
+    writer->property_count  = 0;
+    writer->deadbands.count = 0;
+
+    if (encoding == TELEMETRY_ENCODING_CBOR)
+    {
+        return cbor_writer_with_buffer_init(&writer->encoder.cbor, buffer, buffer_size);
+    }
+
+    return nx_azure_iot_json_writer_with_buffer_init(&writer->encoder.json, buffer, buffer_size);
+}
+
+VOID telemetry_writer_deinit(TELEMETRY_WRITER* writer)
+{
+    if (writer->encoding == TELEMETRY_ENCODING_JSON)
+    {
+        nx_azure_iot_json_writer_deinit(&writer->encoder.json);
+    }
+}
+
+UINT telemetry_writer_build(TELEMETRY_WRITER* writer, func_ptr_telemetry_append append_properties, VOID* context)
+{
+    UINT status;
+
+    if (writer->encoding == TELEMETRY_ENCODING_CBOR)
+    {
+        status = cbor_writer_append_begin_map(&writer->encoder.cbor);
+    }
+    else
+    {
+        status = nx_azure_iot_json_writer_append_begin_object(&writer->encoder.json);
+    }
+
+    if (status || append_properties(writer, context) != NX_AZURE_IOT_SUCCESS)
+    {
+        telemetry_writer_deadbands_release(writer);
+        return NX_NOT_SUCCESSFUL;
+    }
+
+    if (writer->property_count == 0)
+    {
+        return NX_NOT_FOUND;
+    }
+
+    if (writer->encoding == TELEMETRY_ENCODING_CBOR)
+    {
+        status = cbor_writer_append_end_map(&writer->encoder.cbor) || cbor_writer_flush(&writer->encoder.cbor);
+    }
+    else
+    {
+        status = nx_azure_iot_json_writer_append_end_object(&writer->encoder.json);
+    }
+
+    if (status)
+    {
+        telemetry_writer_deadbands_release(writer);
+        return NX_NOT_SUCCESSFUL;
+    }
+
+    return NX_AZURE_IOT_SUCCESS;
+}
+
+bool telemetry_writer_deadband_check(TELEMETRY_WRITER* writer, TELEMETRY_DEADBAND* deadband, double value)
+{
+    if (!telemetry_deadband_check(deadband, value))
+    {
+        return false;
+    }
+
+    telemetry_deadband_list_add(&writer->deadbands, deadband);
+
+    return true;
+}
+
+VOID telemetry_writer_deadbands_release(TELEMETRY_WRITER* writer)
+{
+    telemetry_deadband_list_release(&writer->deadbands, NX_NULL);
+}
+
+UINT telemetry_writer_get_bytes_used(TELEMETRY_WRITER* writer)
+{
+    if (writer->encoding == TELEMETRY_ENCODING_CBOR)
+    {
+        return cbor_writer_get_bytes_used(&writer->encoder.cbor);
+    }
+
+    return nx_azure_iot_json_writer_get_bytes_used(&writer->encoder.json);
+}
+
+UINT telemetry_writer_append_property_with_double_value(
+    TELEMETRY_WRITER* writer, const UCHAR* name, UINT name_length, double value, UINT fractional_digits)
+{
+    // A failed append fails the whole message, so counting attempts is enough to tell an empty one
+    writer->property_count++;
+
+    if (writer->encoding == TELEMETRY_ENCODING_CBOR)
+    {
+        return cbor_writer_append_property_with_double_value(
+            &writer->encoder.cbor, name, name_length, value, fractional_digits);
+    }
+
+    return nx_azure_iot_json_writer_append_property_with_double_value(
+        &writer->encoder.json, name, name_length, value, fractional_digits);
+}
+
+UINT telemetry_writer_append_property_with_int32_value(
+    TELEMETRY_WRITER* writer, const UCHAR* name, UINT name_length, int32_t value)
+{
+    writer->property_count++;
+
+    if (writer->encoding == TELEMETRY_ENCODING_CBOR)
+    {
+        return cbor_writer_append_property_with_int32_value(&writer->encoder.cbor, name, name_length, value);
+    }
+
+    return nx_azure_iot_json_writer_append_property_with_int32_value(&writer->encoder.json, name, name_length, value);
+}
+
+UINT telemetry_writer_append_property_with_bool_value(
+    TELEMETRY_WRITER* writer, const UCHAR* name, UINT name_length, bool value)
+{
+    writer->property_count++;
+
+    if (writer->encoding == TELEMETRY_ENCODING_CBOR)
+    {
+        return cbor_writer_append_property_with_bool_value(&writer->encoder.cbor, name, name_length, value);
+    }
+
+    return nx_azure_iot_json_writer_append_property_with_bool_value(&writer->encoder.json, name, name_length, value);
+}
+
+UINT telemetry_writer_append_property_with_string_value(
+    TELEMETRY_WRITER* writer, const UCHAR* name, UINT name_length, const UCHAR* value, UINT value_length)
+{
+    writer->property_count++;
+
+    if (writer->encoding == TELEMETRY_ENCODING_CBOR)
+    {
+        return cbor_writer_append_property_with_string_value(
+            &writer->encoder.cbor, name, name_length, value, value_length);
+    }
+
+    return nx_azure_iot_json_writer_append_property_with_string_value(
+        &writer->encoder.json, name, name_length, value, value_length);
+}
+
+TELEMETRY_ENCODING telemetry_payload_encoding(const UCHAR* payload, UINT payload_length)
+{
+    if (payload_length > 0 && (payload[0] & 0xE0) == 0xA0)
+    {
+        return TELEMETRY_ENCODING_CBOR;
+    }
+
+    return TELEMETRY_ENCODING_JSON;
+}
+
+const CHAR* telemetry_encoding_content_type(TELEMETRY_ENCODING encoding)
+{
+    return encoding == TELEMETRY_ENCODING_CBOR ? "application%2Fcbor" : "application%2Fjson";
+}
+
+const CHAR* telemetry_encoding_content_encoding(TELEMETRY_ENCODING encoding)
+{
+    // IoT Hub only decodes utf-8 bodies for routing queries, CBOR is passed through untouched
+    return encoding == TELEMETRY_ENCODING_CBOR ? "identity" : "utf-8";
+}
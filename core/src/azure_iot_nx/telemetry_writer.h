@@ -0,0 +1,73 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _TELEMETRY_WRITER_H
+#define _TELEMETRY_WRITER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nx_api.h"
+#include "nx_azure_iot_json_writer.h"
+
+#include "cbor_writer.h"
+#include "telemetry_deadband.h"
+
+typedef enum TELEMETRY_ENCODING_ENUM
+{
+    TELEMETRY_ENCODING_JSON,
+    TELEMETRY_ENCODING_CBOR
+} TELEMETRY_ENCODING;
+
+// Encoding neutral front end for telemetry append callbacks, so the same callback can produce either wire format
+typedef struct TELEMETRY_WRITER_STRUCT
+{
+    TELEMETRY_ENCODING encoding;
+    UINT property_count;
+
+    // Deadbands that let a value into this message, released if the message is discarded
+    TELEMETRY_DEADBAND_LIST deadbands;
+
+    union TELEMETRY_ENCODER_UNION {
+        NX_AZURE_IOT_JSON_WRITER json;
+        CBOR_WRITER cbor;
+    } encoder;
+} TELEMETRY_WRITER;
+
+typedef UINT (*func_ptr_telemetry_append)(TELEMETRY_WRITER* writer, VOID* context);
+
+UINT telemetry_writer_init(TELEMETRY_WRITER* writer, TELEMETRY_ENCODING encoding, NX_PACKET* packet, UINT wait_option);
+UINT telemetry_writer_with_buffer_init(
+    TELEMETRY_WRITER* writer, TELEMETRY_ENCODING encoding, UCHAR* buffer, UINT buffer_size);
+VOID telemetry_writer_deinit(TELEMETRY_WRITER* writer);
+
+// Write one complete message object, with the properties supplied by append_properties. Returns NX_NOT_FOUND when
+// append_properties filtered out every property, there is nothing worth sending. A message that fails to build
+// releases its deadbands.
+UINT telemetry_writer_build(TELEMETRY_WRITER* writer, func_ptr_telemetry_append append_properties, VOID* context);
+UINT telemetry_writer_get_bytes_used(TELEMETRY_WRITER* writer);
+
+// telemetry_deadband_check for a value about to be appended to writer, the deadband is remembered with the message
+bool telemetry_writer_deadband_check(TELEMETRY_WRITER* writer, TELEMETRY_DEADBAND* deadband, double value);
+
+// The message will not be delivered, let the next sample of each of its deadbands through
+VOID telemetry_writer_deadbands_release(TELEMETRY_WRITER* writer);
+
+UINT telemetry_writer_append_property_with_double_value(
+    TELEMETRY_WRITER* writer, const UCHAR* name, UINT name_length, double value, UINT fractional_digits);
+UINT telemetry_writer_append_property_with_int32_value(
+    TELEMETRY_WRITER* writer, const UCHAR* name, UINT name_length, int32_t value);
+UINT telemetry_writer_append_property_with_bool_value(
+    TELEMETRY_WRITER* writer, const UCHAR* name, UINT name_length, bool value);
+UINT telemetry_writer_append_property_with_string_value(
+    TELEMETRY_WRITER* writer, const UCHAR* name, UINT name_length, const UCHAR* value, UINT value_length);
+
+// Recover the encoding of a serialized message. JSON documents start with '{' or '[' while a CBOR map starts with a
+// major type 5 byte, so stored payloads do not need to carry a separate tag.
+TELEMETRY_ENCODING telemetry_payload_encoding(const UCHAR* payload, UINT payload_length);
+
+// Values for the $.ct and $.ce message system properties, already escaped for the MQTT topic
+const CHAR* telemetry_encoding_content_type(TELEMETRY_ENCODING encoding);
+const CHAR* telemetry_encoding_content_encoding(TELEMETRY_ENCODING encoding);
+
+#endif // _TELEMETRY_WRITER_H
@@ -0,0 +1,168 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include "dhcp_lease.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DHCP_LEASE_MAGIC 0x45534C44 // "DLSE"
+
+// One lease, in fixed width fields so the layout is the same whatever the width of ULONG
+typedef struct DHCP_LEASE_RECORD_STRUCT
+{
+    FLASH_RECORD_HEADER header;
+
+    uint32_t ip_address;
+    uint32_t network_mask;
+    uint32_t gateway_address;
+    uint32_t server_address;
+    uint32_t dns_server_address[DHCP_LEASE_DNS_SERVER_COUNT];
+    uint32_t lease_time;
+} DHCP_LEASE_RECORD;
+
+static VOID print_address(CHAR* preamble, ULONG address)
+{
+    printf("\t%s: %lu.%lu.%lu.%lu\r\n",
+        preamble,
+        address >> 24,
+        address >> 16 & 0xFF,
+        address >> 8 & 0xFF,
+        address & 0xFF);
+}
+
+UINT dhcp_lease_store_open(DHCP_LEASE_STORE* store, const FLASH_DRIVER* driver, ULONG first_sector, ULONG sector_count)
+{
+    return flash_record_store_open(
+        store, driver, first_sector, sector_count, DHCP_LEASE_MAGIC, sizeof(DHCP_LEASE_RECORD), "DHCP lease");
+}
+
+UINT dhcp_lease_load(DHCP_LEASE_STORE* store, DHCP_LEASE* lease)
+{
+    DHCP_LEASE_RECORD record;
+    UINT i;
+
+    if (flash_record_load(store, &record) || record.ip_address == 0)
+    {
+        return NX_NOT_FOUND;
+    }
+
+    lease->ip_address      = record.ip_address;
+    lease->network_mask    = record.network_mask;
+    lease->gateway_address = record.gateway_address;
+    lease->server_address  = record.server_address;
+    for (i = 0; i < DHCP_LEASE_DNS_SERVER_COUNT; i++)
+    {
+        lease->dns_server_address[i] = record.dns_server_address[i];
+    }
+    lease->lease_time = record.lease_time;
+
+    return NX_SUCCESS;
+}
+
+UINT dhcp_lease_save(DHCP_LEASE_STORE* store, const DHCP_LEASE* lease)
+{
+    DHCP_LEASE_RECORD record;
+    UINT i;
+
+    memset(&record, 0, sizeof(record));
+    record.ip_address      = (uint32_t)lease->ip_address;
+    record.network_mask    = (uint32_t)lease->network_mask;
+    record.gateway_address = (uint32_t)lease->gateway_address;
+    record.server_address  = (uint32_t)lease->server_address;
+    for (i = 0; i < DHCP_LEASE_DNS_SERVER_COUNT; i++)
+    {
+        record.dns_server_address[i] = (uint32_t)lease->dns_server_address[i];
+    }
+    record.lease_time = (uint32_t)lease->lease_time;
+
+    // Renewing the same binding on every boot writes nothing, losing power mid save just means a full discovery
+    return flash_record_save(store, &record);
+}
+
+UINT dhcp_lease_invalidate(DHCP_LEASE_STORE* store)
+{
+    return flash_record_invalidate(store);
+}
+
+UINT dhcp_lease_acquire(NX_DHCP* dhcp_ptr, DHCP_LEASE_STORE* store, DHCP_LEASE* lease)
+{
+    NX_IP* ip_ptr = dhcp_ptr->nx_dhcp_ip_ptr;
+    DHCP_LEASE cached;
+    ULONG actual_status;
+    UINT rebooting;
+    UINT size;
+    UINT status;
+
+    // INIT-REBOOT, a single REQUEST for the cached address instead of DISCOVER, OFFER and REQUEST
+    rebooting = dhcp_lease_load(store, &cached) == NX_SUCCESS;
+    if (rebooting)
+    {
+        print_address("Cached address", cached.ip_address);
+
+        if ((status = nx_dhcp_request_client_ip(dhcp_ptr, cached.ip_address, NX_TRUE)))
+        {
+            return status;
+        }
+    }
+
+    if ((status = nx_dhcp_start(dhcp_ptr)))
+    {
+        return status;
+    }
+
+    status = nx_ip_status_check(
+        ip_ptr, NX_IP_ADDRESS_RESOLVED, &actual_status, rebooting ? DHCP_LEASE_REBOOT_WAIT_TICKS : NX_WAIT_FOREVER);
+
+    // Nobody answered, the lease may have moved to another network. Discovery still hints at the old address.
+    if (rebooting && status != NX_SUCCESS)
+    {
+        printf("\tCached address not confirmed, discovering\r\n");
+
+        if ((status = nx_dhcp_stop(dhcp_ptr)) || (status = nx_dhcp_reinitialize(dhcp_ptr)) ||
+            (status = nx_dhcp_request_client_ip(dhcp_ptr, cached.ip_address, NX_FALSE)) ||
+            (status = nx_dhcp_start(dhcp_ptr)))
+        {
+            return status;
+        }
+
+        status = nx_ip_status_check(ip_ptr, NX_IP_ADDRESS_RESOLVED, &actual_status, NX_WAIT_FOREVER);
+    }
+
+    if (status != NX_SUCCESS)
+    {
+        return status;
+    }
+
+    memset(lease, 0, sizeof(DHCP_LEASE));
+    nx_ip_address_get(ip_ptr, &lease->ip_address, &lease->network_mask);
+    nx_ip_gateway_address_get(ip_ptr, &lease->gateway_address);
+    nx_dhcp_server_address_get(dhcp_ptr, &lease->server_address);
+
+    size = sizeof(lease->dns_server_address);
+    if (nx_dhcp_interface_user_option_retrieve(
+            dhcp_ptr, 0, NX_DHCP_OPTION_DNS_SVR, (UCHAR*)lease->dns_server_address, &size))
+    {
+        memset(lease->dns_server_address, 0, sizeof(lease->dns_server_address));
+    }
+
+    size = sizeof(lease->lease_time);
+    if (nx_dhcp_interface_user_option_retrieve(
+            dhcp_ptr, 0, NX_DHCP_OPTION_DHCP_LEASE, (UCHAR*)&lease->lease_time, &size))
+    {
+        lease->lease_time = 0;
+    }
+
+    if (rebooting && lease->ip_address == cached.ip_address)
+    {
+        printf("\tCached address confirmed\r\n");
+    }
+
+    if (store->driver != NX_NULL)
+    {
+        dhcp_lease_save(store, lease);
+    }
+
+    return NX_SUCCESS;
+}
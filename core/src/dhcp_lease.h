@@ -0,0 +1,54 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _DHCP_LEASE_H
+#define _DHCP_LEASE_H
+
+#include "tx_api.h"
+
+#include "nx_api.h"
+#include "nxd_dhcp_client.h"
+
+#include "flash_driver.h"
+#include "flash_record_store.h"
+
+#define DHCP_LEASE_DNS_SERVER_COUNT 3
+
+// How long a server gets to confirm the cached address before falling back to discovery
+#ifndef DHCP_LEASE_REBOOT_WAIT_TICKS
+#define DHCP_LEASE_REBOOT_WAIT_TICKS (3 * NX_IP_PERIODIC_RATE)
+#endif
+
+// The binding handed out by the DHCP server, all addresses in host byte order
+typedef struct DHCP_LEASE_STRUCT
+{
+    ULONG ip_address;
+    ULONG network_mask;
+    ULONG gateway_address;
+    ULONG server_address;
+    ULONG dns_server_address[DHCP_LEASE_DNS_SERVER_COUNT];
+
+    // Seconds granted by the server
+    ULONG lease_time;
+} DHCP_LEASE;
+
+// Keeps the last lease in flash so a reboot can ask for the same address straight away
+typedef FLASH_RECORD_STORE DHCP_LEASE_STORE;
+
+// Keep the lease in sector_count sectors from first_sector of the flash region, apart from anything else kept there
+UINT dhcp_lease_store_open(DHCP_LEASE_STORE* store, const FLASH_DRIVER* driver, ULONG first_sector, ULONG sector_count);
+
+// Fetch the last lease, NX_NOT_FOUND when there is none
+UINT dhcp_lease_load(DHCP_LEASE_STORE* store, DHCP_LEASE* lease);
+
+UINT dhcp_lease_save(DHCP_LEASE_STORE* store, const DHCP_LEASE* lease);
+
+// Drop the current lease, for when the network no longer honours it
+UINT dhcp_lease_invalidate(DHCP_LEASE_STORE* store);
+
+// Start the created DHCP client and wait for an address. With a stored lease the client first sends an INIT-REBOOT
+// REQUEST for the cached address and only runs discovery when no server confirms it. The new lease is returned and
+// saved. A store that was never opened just runs discovery.
+UINT dhcp_lease_acquire(NX_DHCP* dhcp_ptr, DHCP_LEASE_STORE* store, DHCP_LEASE* lease);
+
+#endif // _DHCP_LEASE_H
@@ -0,0 +1,821 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include "dns_resolver.h"
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DNS_PORT         53
+#define DNS_MESSAGE_SIZE 512
+#define DNS_HEADER_SIZE  12
+#define DNS_NAME_MAX     255
+#define DNS_LABEL_MAX    63
+
+#define DNS_FLAG_RESPONSE  0x8000
+#define DNS_FLAG_TRUNCATED 0x0200
+#define DNS_FLAG_RECURSION 0x0100
+#define DNS_RCODE_MASK     0x000F
+#define DNS_RCODE_NXDOMAIN 3
+
+// Queries go out from a random port in the dynamic range, so a spoofed answer has to guess it as well as the id
+#define DNS_SOURCE_PORT_BASE     49152
+#define DNS_SOURCE_PORT_RANGE    16384
+#define DNS_SOURCE_PORT_ATTEMPTS 4
+
+#define DNS_TYPE_A     1
+#define DNS_TYPE_CNAME 5
+#define DNS_TYPE_SOA   6
+#define DNS_CLASS_IN   1
+
+// Every server is asked again after this long without an answer, doubling each time
+#define DNS_RESOLVER_RETRY_TICKS NX_IP_PERIODIC_RATE
+
+// Bytes of the DNS client cache, which holds the records the Azure IoT middleware resolves through it
+#ifndef DNS_RESOLVER_CLIENT_CACHE_SIZE
+#define DNS_RESOLVER_CLIENT_CACHE_SIZE 2048
+#endif
+
+typedef enum DNS_RESPONSE_ENUM
+{
+    DNS_RESPONSE_IGNORE,
+    DNS_RESPONSE_ANSWER,
+    DNS_RESPONSE_NEGATIVE,
+    DNS_RESPONSE_FAILURE
+} DNS_RESPONSE;
+
+typedef struct DNS_RESOLVER_ENTRY_STRUCT
+{
+    CHAR host_name[DNS_RESOLVER_HOST_NAME_SIZE];
+
+    // Zero for a name that does not exist
+    ULONG address;
+    ULONG expiry_time;
+    ULONG used_time;
+} DNS_RESOLVER_ENTRY;
+
+static NX_DNS* resolver_dns;
+
+// One socket per server, offloaded network stacks tie a UDP socket to the first address it sends to
+static ULONG resolver_servers[DNS_RESOLVER_SERVER_MAX];
+static NX_UDP_SOCKET resolver_sockets[DNS_RESOLVER_SERVER_MAX];
+static UINT resolver_server_count;
+
+// The server the DNS client asks first, the middleware's lookups go through it one server at a time
+static UINT resolver_client_first;
+
+static TX_MUTEX cache_mutex;
+static DNS_RESOLVER_ENTRY resolver_cache[DNS_RESOLVER_CACHE_SIZE];
+static DNS_RESOLVER_STATS resolver_stats;
+
+// Queries go out one at a time and share the message buffer
+static TX_MUTEX query_mutex;
+static TX_EVENT_FLAGS_GROUP query_events;
+static UCHAR query_buffer[DNS_MESSAGE_SIZE];
+static USHORT query_id;
+
+// Replies are read into the query buffer, the question is kept aside to check each reply is for it
+static UCHAR query_question[DNS_NAME_MAX + 1 + 4];
+static UINT query_question_length;
+
+#ifdef NX_DNS_CACHE_ENABLE
+static ULONG dns_client_cache[DNS_RESOLVER_CLIENT_CACHE_SIZE / sizeof(ULONG)];
+#endif
+
+static USHORT get_ushort(const UCHAR* data)
+{
+    return (USHORT)(data[0] << 8 | data[1]);
+}
+
+static ULONG get_ulong(const UCHAR* data)
+{
+    return (ULONG)data[0] << 24 | (ULONG)data[1] << 16 | (ULONG)data[2] << 8 | data[3];
+}
+
+static bool time_reached(ULONG time, ULONG now)
+{
+    return (LONG)(time - now) <= 0;
+}
+
+static ULONG ttl_ticks(ULONG ttl_secs, ULONG max_secs)
+{
+    return (ttl_secs < max_secs ? ttl_secs : max_secs) * TX_TIMER_TICKS_PER_SECOND;
+}
+
+static DNS_RESOLVER_ENTRY* cache_find(const CHAR* host_name)
+{
+    UINT i;
+
+    for (i = 0; i < DNS_RESOLVER_CACHE_SIZE; i++)
+    {
+        if (resolver_cache[i].host_name[0] != 0 && strcmp(resolver_cache[i].host_name, host_name) == 0)
+        {
+            return &resolver_cache[i];
+        }
+    }
+
+    return NX_NULL;
+}
+
+static UINT cache_lookup(const CHAR* host_name, ULONG* host_address)
+{
+    DNS_RESOLVER_ENTRY* entry;
+    ULONG now = tx_time_get();
+    UINT status;
+
+    tx_mutex_get(&cache_mutex, TX_WAIT_FOREVER);
+
+    entry = cache_find(host_name);
+    if (entry == NX_NULL || time_reached(entry->expiry_time, now))
+    {
+        status = NX_DNS_QUERY_FAILED;
+    }
+    else if (entry->address == 0)
+    {
+        resolver_stats.negative_hits++;
+        status = NX_NOT_FOUND;
+    }
+    else
+    {
+        resolver_stats.cache_hits++;
+        entry->used_time = now;
+        *host_address    = entry->address;
+        status           = NX_SUCCESS;
+    }
+
+    tx_mutex_put(&cache_mutex);
+
+    return status;
+}
+
+static VOID cache_store(const CHAR* host_name, ULONG host_address, ULONG ttl)
+{
+    DNS_RESOLVER_ENTRY* entry;
+    ULONG now = tx_time_get();
+    UINT i;
+
+    if (ttl == 0 || strlen(host_name) >= DNS_RESOLVER_HOST_NAME_SIZE)
+    {
+        return;
+    }
+
+    tx_mutex_get(&cache_mutex, TX_WAIT_FOREVER);
+
+    // Reuse the entry for this name, otherwise evict the least recently used one
+    entry = cache_find(host_name);
+    for (i = 0; entry == NX_NULL && i < DNS_RESOLVER_CACHE_SIZE; i++)
+    {
+        if (resolver_cache[i].host_name[0] == 0)
+        {
+            entry = &resolver_cache[i];
+        }
+    }
+
+    if (entry == NX_NULL)
+    {
+        entry = &resolver_cache[0];
+        for (i = 1; i < DNS_RESOLVER_CACHE_SIZE; i++)
+        {
+            if (now - resolver_cache[i].used_time > now - entry->used_time)
+            {
+                entry = &resolver_cache[i];
+            }
+        }
+    }
+
+    strcpy(entry->host_name, host_name);
+    entry->address     = host_address;
+    entry->expiry_time = now + ttl;
+    entry->used_time   = now;
+
+    tx_mutex_put(&cache_mutex);
+}
+
+static UINT query_build(const CHAR* host_name, UINT* length)
+{
+    const CHAR* label = host_name;
+    UINT label_length;
+    UINT offset = DNS_HEADER_SIZE;
+
+    if (strlen(host_name) > DNS_NAME_MAX - 2)
+    {
+        return NX_DNS_PARAM_ERROR;
+    }
+
+    memset(query_buffer, 0, DNS_HEADER_SIZE);
+    query_buffer[0] = (UCHAR)(query_id >> 8);
+    query_buffer[1] = (UCHAR)query_id;
+    query_buffer[2] = DNS_FLAG_RECURSION >> 8;
+    query_buffer[5] = 1;
+
+    while (*label)
+    {
+        label_length = 0;
+        while (label[label_length] != 0 && label[label_length] != '.')
+        {
+            label_length++;
+        }
+
+        if (label_length == 0 || label_length > DNS_LABEL_MAX)
+        {
+            return NX_DNS_PARAM_ERROR;
+        }
+
+        query_buffer[offset++] = (UCHAR)label_length;
+        memcpy(&query_buffer[offset], label, label_length);
+        offset += label_length;
+
+        label += label_length;
+        if (*label == '.')
+        {
+            label++;
+        }
+    }
+
+    query_buffer[offset++] = 0;
+    query_buffer[offset++] = 0;
+    query_buffer[offset++] = DNS_TYPE_A;
+    query_buffer[offset++] = 0;
+    query_buffer[offset++] = DNS_CLASS_IN;
+
+    query_question_length = offset - DNS_HEADER_SIZE;
+    memcpy(query_question, &query_buffer[DNS_HEADER_SIZE], query_question_length);
+
+    *length = offset;
+
+    return NX_SUCCESS;
+}
+
+// Offset just past a name, which may end in a compression pointer, or zero when it runs off the message
+static UINT name_skip(const UCHAR* message, UINT length, UINT offset)
+{
+    while (offset < length)
+    {
+        if ((message[offset] & 0xC0) == 0xC0)
+        {
+            return offset + 2 <= length ? offset + 2 : 0;
+        }
+
+        if (message[offset] & 0xC0)
+        {
+            return 0;
+        }
+
+        if (message[offset] == 0)
+        {
+            return offset + 1;
+        }
+
+        offset += message[offset] + 1;
+    }
+
+    return 0;
+}
+
+// The reply must repeat the name, type and class that were asked, names compare without regard to case
+static bool question_match(const UCHAR* message, UINT length)
+{
+    UINT i;
+
+    if (get_ushort(&message[4]) != 1 || length - DNS_HEADER_SIZE < query_question_length)
+    {
+        return false;
+    }
+
+    for (i = 0; i < query_question_length; i++)
+    {
+        if (tolower(message[DNS_HEADER_SIZE + i]) != tolower(query_question[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static DNS_RESPONSE response_parse(const UCHAR* message, UINT length, ULONG* host_address, ULONG* ttl)
+{
+    USHORT flags;
+    UINT question_count;
+    UINT answer_count;
+    UINT authority_count;
+    UINT offset = DNS_HEADER_SIZE;
+    UINT data_length;
+    USHORT type;
+    USHORT record_class;
+    ULONG record_ttl;
+    ULONG chain_ttl = DNS_RESOLVER_TTL_MAX_SECS;
+    UINT i;
+
+    if (length < DNS_HEADER_SIZE || get_ushort(message) != query_id)
+    {
+        return DNS_RESPONSE_IGNORE;
+    }
+
+    flags           = get_ushort(&message[2]);
+    question_count  = get_ushort(&message[4]);
+    answer_count    = get_ushort(&message[6]);
+    authority_count = get_ushort(&message[8]);
+
+    // Anything else is not the reply to this query, whoever sent it, and must not end up in the cache
+    if ((flags & DNS_FLAG_RESPONSE) == 0 || !question_match(message, length))
+    {
+        return DNS_RESPONSE_IGNORE;
+    }
+
+    if ((flags & DNS_RCODE_MASK) != 0 && (flags & DNS_RCODE_MASK) != DNS_RCODE_NXDOMAIN)
+    {
+        return DNS_RESPONSE_FAILURE;
+    }
+
+    for (i = 0; i < question_count; i++)
+    {
+        if ((offset = name_skip(message, length, offset)) == 0 || (offset += 4) > length)
+        {
+            return DNS_RESPONSE_FAILURE;
+        }
+    }
+
+    // Follow the answer section to the first address, a CNAME chain only lives as long as its shortest link
+    for (i = 0; (flags & DNS_RCODE_MASK) == 0 && i < answer_count; i++)
+    {
+        if ((offset = name_skip(message, length, offset)) == 0 || offset + 10 > length)
+        {
+            return DNS_RESPONSE_FAILURE;
+        }
+
+        type         = get_ushort(&message[offset]);
+        record_class = get_ushort(&message[offset + 2]);
+        record_ttl   = get_ulong(&message[offset + 4]);
+        data_length  = get_ushort(&message[offset + 8]);
+        offset += 10;
+
+        if (offset + data_length > length)
+        {
+            return DNS_RESPONSE_FAILURE;
+        }
+
+        if (type == DNS_TYPE_A || type == DNS_TYPE_CNAME)
+        {
+            chain_ttl = record_ttl < chain_ttl ? record_ttl : chain_ttl;
+        }
+
+        if (type == DNS_TYPE_A && record_class == DNS_CLASS_IN && data_length == 4)
+        {
+            *host_address = get_ulong(&message[offset]);
+            *ttl          = ttl_ticks(chain_ttl, DNS_RESOLVER_TTL_MAX_SECS);
+            return DNS_RESPONSE_ANSWER;
+        }
+
+        offset += data_length;
+    }
+
+    if (flags & DNS_FLAG_TRUNCATED)
+    {
+        return DNS_RESPONSE_FAILURE;
+    }
+
+    // No such name, or no address for it. The SOA record in the authority section says how long that holds.
+    *ttl = ttl_ticks(DNS_RESOLVER_NEGATIVE_TTL_SECS, DNS_RESOLVER_NEGATIVE_TTL_MAX_SECS);
+
+    for (i = 0; i < authority_count; i++)
+    {
+        if ((offset = name_skip(message, length, offset)) == 0 || offset + 10 > length)
+        {
+            break;
+        }
+
+        type        = get_ushort(&message[offset]);
+        record_ttl  = get_ulong(&message[offset + 4]);
+        data_length = get_ushort(&message[offset + 8]);
+        offset += 10;
+
+        if (offset + data_length > length)
+        {
+            break;
+        }
+
+        if (type == DNS_TYPE_SOA)
+        {
+            UINT soa_offset = name_skip(message, offset + data_length, offset);
+
+            if (soa_offset != 0 && (soa_offset = name_skip(message, offset + data_length, soa_offset)) != 0 &&
+                soa_offset + 20 <= offset + data_length)
+            {
+                ULONG minimum = get_ulong(&message[soa_offset + 16]);
+
+                *ttl = ttl_ticks(minimum < record_ttl ? minimum : record_ttl, DNS_RESOLVER_NEGATIVE_TTL_MAX_SECS);
+            }
+            break;
+        }
+
+        offset += data_length;
+    }
+
+    return DNS_RESPONSE_NEGATIVE;
+}
+
+static VOID socket_receive_notify(NX_UDP_SOCKET* socket_ptr)
+{
+    tx_event_flags_set(&query_events, 1UL << (socket_ptr - resolver_sockets), TX_OR);
+}
+
+static VOID query_send(const CHAR* host_name, UINT server, UINT length)
+{
+    NX_PACKET* packet_ptr;
+    UINT status;
+
+    // IPv4 headers only, NX_UDP_PACKET leaves room for IPv6 and puts the frame off the driver's buffer alignment
+    if ((status = nx_packet_allocate(
+             resolver_dns->nx_dns_packet_pool_ptr, &packet_ptr, NX_IPv4_UDP_PACKET, DNS_RESOLVER_RETRY_TICKS)))
+    {
+        printf("ERROR: DNS query allocate failed (0x%08x)\r\n", status);
+        return;
+    }
+
+    if ((status = nx_packet_data_append(packet_ptr,
+             query_buffer,
+             length,
+             resolver_dns->nx_dns_packet_pool_ptr,
+             DNS_RESOLVER_RETRY_TICKS)) ||
+        (status = nx_udp_socket_send(&resolver_sockets[server], packet_ptr, resolver_servers[server], DNS_PORT)))
+    {
+        printf("ERROR: DNS query for %s failed to send (0x%08x)\r\n", host_name, status);
+        nx_packet_release(packet_ptr);
+    }
+}
+
+// Drain the replies that arrived on a server's socket, stopping at the first one that settles the query
+static DNS_RESPONSE server_receive(UINT server, ULONG* host_address, ULONG* ttl)
+{
+    NX_PACKET* packet_ptr;
+    DNS_RESPONSE response = DNS_RESPONSE_IGNORE;
+    ULONG source_address;
+    UINT source_port;
+    ULONG length;
+
+    while (response == DNS_RESPONSE_IGNORE &&
+           nx_udp_socket_receive(&resolver_sockets[server], &packet_ptr, NX_NO_WAIT) == NX_SUCCESS)
+    {
+        if (nx_udp_source_extract(packet_ptr, &source_address, &source_port) == NX_SUCCESS &&
+            source_address == resolver_servers[server] && source_port == DNS_PORT &&
+            packet_ptr->nx_packet_length <= sizeof(query_buffer) &&
+            nx_packet_data_retrieve(packet_ptr, query_buffer, &length) == NX_SUCCESS)
+        {
+            response = response_parse(query_buffer, length, host_address, ttl);
+        }
+
+        nx_packet_release(packet_ptr);
+    }
+
+    return response;
+}
+
+static VOID socket_bind(NX_UDP_SOCKET* socket_ptr)
+{
+    UINT port;
+    UINT i;
+
+    for (i = 0; i < DNS_SOURCE_PORT_ATTEMPTS; i++)
+    {
+        port = DNS_SOURCE_PORT_BASE + (UINT)NX_RAND() % DNS_SOURCE_PORT_RANGE;
+        if (nx_udp_socket_bind(socket_ptr, port, NX_NO_WAIT) == NX_SUCCESS)
+        {
+            return;
+        }
+    }
+
+    nx_udp_socket_bind(socket_ptr, NX_ANY_PORT, NX_NO_WAIT);
+}
+
+// Move the server that won a race to the head of the DNS client's list, which it works through in order
+static VOID client_servers_order(UINT first)
+{
+    UINT server;
+
+    if (first == resolver_client_first || nx_dns_server_remove_all(resolver_dns))
+    {
+        return;
+    }
+
+    nx_dns_server_add(resolver_dns, resolver_servers[first]);
+
+    for (server = 0; server < resolver_server_count; server++)
+    {
+        if (server != first)
+        {
+            nx_dns_server_add(resolver_dns, resolver_servers[server]);
+        }
+    }
+
+    resolver_client_first = first;
+}
+
+static VOID queries_send(const CHAR* host_name, ULONG servers)
+{
+    UINT length;
+    UINT server;
+
+    // Replies are read into the same buffer, so it is built again for every round
+    if (query_build(host_name, &length))
+    {
+        return;
+    }
+
+    for (server = 0; server < resolver_server_count; server++)
+    {
+        if (servers & (1UL << server))
+        {
+            query_send(host_name, server, length);
+        }
+    }
+}
+
+static UINT query_run(const CHAR* host_name, ULONG* host_address, ULONG* ttl, ULONG wait_option)
+{
+    DNS_RESPONSE response;
+    ULONG start_time  = tx_time_get();
+    ULONG retry_ticks = DNS_RESOLVER_RETRY_TICKS;
+    ULONG pending     = (1UL << resolver_server_count) - 1;
+    ULONG send_time;
+    ULONG elapsed;
+    ULONG wait_ticks;
+    ULONG events;
+    UINT length;
+    UINT server;
+    UINT status;
+
+    query_id = (USHORT)NX_RAND();
+
+    if ((status = query_build(host_name, &length)))
+    {
+        return status;
+    }
+
+    for (server = 0; server < resolver_server_count; server++)
+    {
+        socket_bind(&resolver_sockets[server]);
+    }
+
+    tx_event_flags_get(&query_events, pending, TX_OR_CLEAR, &events, TX_NO_WAIT);
+
+    queries_send(host_name, pending);
+    send_time = start_time + retry_ticks;
+
+    status = NX_NO_RESPONSE;
+
+    while (pending != 0 && (elapsed = tx_time_get() - start_time) < wait_option)
+    {
+        wait_ticks = time_reached(send_time, tx_time_get()) ? 0 : send_time - tx_time_get();
+        if (wait_ticks > wait_option - elapsed)
+        {
+            wait_ticks = wait_option - elapsed;
+        }
+
+        if (tx_event_flags_get(&query_events, pending, TX_OR_CLEAR, &events, wait_ticks) != TX_SUCCESS)
+        {
+            events = 0;
+        }
+
+        for (server = 0; server < resolver_server_count; server++)
+        {
+            if ((events & (1UL << server)) == 0)
+            {
+                continue;
+            }
+
+            response = server_receive(server, host_address, ttl);
+
+            if (response == DNS_RESPONSE_ANSWER || response == DNS_RESPONSE_NEGATIVE)
+            {
+                tx_mutex_get(&cache_mutex, TX_WAIT_FOREVER);
+                resolver_stats.answers[server]++;
+                tx_mutex_put(&cache_mutex);
+
+                client_servers_order(server);
+
+                pending = 0;
+                status  = response == DNS_RESPONSE_ANSWER ? NX_SUCCESS : NX_NOT_FOUND;
+                break;
+            }
+
+            // A server that can't answer drops out, the query fails once all of them have
+            if (response == DNS_RESPONSE_FAILURE)
+            {
+                pending &= ~(1UL << server);
+            }
+        }
+
+        // Ask the servers still in the race again, backing off each round
+        if (pending != 0 && time_reached(send_time, tx_time_get()))
+        {
+            queries_send(host_name, pending);
+            retry_ticks *= 2;
+            send_time += retry_ticks;
+        }
+    }
+
+    for (server = 0; server < resolver_server_count; server++)
+    {
+        nx_udp_socket_unbind(&resolver_sockets[server]);
+    }
+
+    // Every server gave up before the time ran out
+    if (status == NX_NO_RESPONSE && pending == 0)
+    {
+        status = NX_DNS_QUERY_FAILED;
+    }
+
+    return status;
+}
+
+UINT dns_resolver_create(NX_DNS* dns)
+{
+    UINT status;
+
+    if (dns == NX_NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    if ((status = tx_mutex_create(&cache_mutex, "DNS cache", TX_NO_INHERIT)))
+    {
+        printf("ERROR: failed to create DNS cache mutex (0x%08x)\r\n", status);
+        return status;
+    }
+
+    if ((status = tx_mutex_create(&query_mutex, "DNS query", TX_INHERIT)))
+    {
+        printf("ERROR: failed to create DNS query mutex (0x%08x)\r\n", status);
+        tx_mutex_delete(&cache_mutex);
+        return status;
+    }
+
+    if ((status = tx_event_flags_create(&query_events, "DNS query")))
+    {
+        printf("ERROR: failed to create DNS query event flags (0x%08x)\r\n", status);
+        tx_mutex_delete(&query_mutex);
+        tx_mutex_delete(&cache_mutex);
+        return status;
+    }
+
+#ifdef NX_DNS_CACHE_ENABLE
+    // The middleware resolves through the DNS client, give it a cache that honours record TTLs too
+    if ((status = nx_dns_cache_initialize(dns, dns_client_cache, sizeof(dns_client_cache))))
+    {
+        printf("ERROR: failed to initialize DNS client cache (0x%08x)\r\n", status);
+    }
+#endif
+
+    resolver_dns          = dns;
+    resolver_server_count = 0;
+    resolver_client_first = 0;
+
+    return NX_SUCCESS;
+}
+
+UINT dns_resolver_server_add(ULONG server_address)
+{
+    NX_UDP_SOCKET* socket_ptr;
+    UINT status;
+    UINT i;
+
+    if (resolver_dns == NX_NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    if (server_address == 0)
+    {
+        return NX_INVALID_PARAMETERS;
+    }
+
+    for (i = 0; i < resolver_server_count; i++)
+    {
+        if (resolver_servers[i] == server_address)
+        {
+            return NX_SUCCESS;
+        }
+    }
+
+    if (resolver_server_count == DNS_RESOLVER_SERVER_MAX)
+    {
+        return NX_NO_MORE_ENTRIES;
+    }
+
+    socket_ptr = &resolver_sockets[resolver_server_count];
+
+    if ((status = nx_udp_socket_create(resolver_dns->nx_dns_ip_ptr,
+             socket_ptr,
+             "DNS resolver",
+             NX_IP_NORMAL,
+             NX_FRAGMENT_OKAY,
+             NX_IP_TIME_TO_LIVE,
+             4)))
+    {
+        printf("ERROR: failed to create DNS resolver socket (0x%08x)\r\n", status);
+        return status;
+    }
+
+    if ((status = nx_udp_socket_receive_notify(socket_ptr, socket_receive_notify)) ||
+        (status = nx_dns_server_add(resolver_dns, server_address)))
+    {
+        printf("ERROR: failed to add DNS server (0x%08x)\r\n", status);
+        nx_udp_socket_delete(socket_ptr);
+        return status;
+    }
+
+    resolver_servers[resolver_server_count++] = server_address;
+
+    return NX_SUCCESS;
+}
+
+UINT dns_resolver_host_by_name_get(const CHAR* host_name, ULONG* host_address, ULONG wait_option)
+{
+    ULONG address;
+    ULONG ttl;
+    UINT status;
+
+    if (resolver_dns == NX_NULL || host_name == NX_NULL || host_address == NX_NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    if ((status = cache_lookup(host_name, host_address)) != NX_DNS_QUERY_FAILED)
+    {
+        return status;
+    }
+
+    // Not waiting at all only looks in the cache
+    if (wait_option == NX_NO_WAIT)
+    {
+        return NX_NO_RESPONSE;
+    }
+
+    if (resolver_server_count == 0)
+    {
+        return NX_DNS_NO_SERVER;
+    }
+
+    tx_mutex_get(&query_mutex, TX_WAIT_FOREVER);
+
+    // Another thread may have resolved the same name while this one waited for the query
+    if ((status = cache_lookup(host_name, host_address)) == NX_DNS_QUERY_FAILED)
+    {
+        status = query_run(host_name, &address, &ttl, wait_option);
+
+        tx_mutex_get(&cache_mutex, TX_WAIT_FOREVER);
+        resolver_stats.queries++;
+        if (status != NX_SUCCESS && status != NX_NOT_FOUND)
+        {
+            resolver_stats.failures++;
+        }
+        tx_mutex_put(&cache_mutex);
+
+        if (status == NX_SUCCESS)
+        {
+            cache_store(host_name, address, ttl);
+            *host_address = address;
+        }
+        else if (status == NX_NOT_FOUND)
+        {
+            cache_store(host_name, 0, ttl);
+        }
+    }
+
+    tx_mutex_put(&query_mutex);
+
+    return status;
+}
+
+UINT dns_resolver_prefetch(const CHAR* host_name, ULONG wait_option)
+{
+    ULONG host_address;
+    UINT status;
+
+    if (host_name == NX_NULL || host_name[0] == 0)
+    {
+        return NX_DNS_PARAM_ERROR;
+    }
+
+    if ((status = dns_resolver_host_by_name_get(host_name, &host_address, wait_option)))
+    {
+        return status;
+    }
+
+#ifdef NX_DNS_CACHE_ENABLE
+    // The race left the server that answered at the head of the client's list, so this is one more round trip
+    status = nx_dns_host_by_name_get(resolver_dns, (UCHAR*)host_name, &host_address, wait_option);
+#endif
+
+    return status;
+}
+
+VOID dns_resolver_stats_get(DNS_RESOLVER_STATS* stats)
+{
+    tx_mutex_get(&cache_mutex, TX_WAIT_FOREVER);
+    *stats = resolver_stats;
+    tx_mutex_put(&cache_mutex);
+}
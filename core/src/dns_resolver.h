@@ -0,0 +1,61 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _DNS_RESOLVER_H
+#define _DNS_RESOLVER_H
+
+#include "tx_api.h"
+
+#include "nx_api.h"
+#include "nxd_dns.h"
+
+// DHCP hands out up to three servers
+#define DNS_RESOLVER_SERVER_MAX 3
+
+#ifndef DNS_RESOLVER_CACHE_SIZE
+#define DNS_RESOLVER_CACHE_SIZE 8
+#endif
+
+#define DNS_RESOLVER_HOST_NAME_SIZE 128
+
+// How long a name that does not resolve is remembered when the server sends no SOA record to say so, and the most
+// any negative answer is remembered for
+#ifndef DNS_RESOLVER_NEGATIVE_TTL_SECS
+#define DNS_RESOLVER_NEGATIVE_TTL_SECS 30
+#endif
+#ifndef DNS_RESOLVER_NEGATIVE_TTL_MAX_SECS
+#define DNS_RESOLVER_NEGATIVE_TTL_MAX_SECS (5 * 60)
+#endif
+
+#ifndef DNS_RESOLVER_TTL_MAX_SECS
+#define DNS_RESOLVER_TTL_MAX_SECS (24 * 60 * 60)
+#endif
+
+typedef struct DNS_RESOLVER_STATS_STRUCT
+{
+    ULONG cache_hits;
+    ULONG negative_hits;
+    ULONG queries;
+    ULONG failures;
+
+    // Which server's answer arrived first
+    ULONG answers[DNS_RESOLVER_SERVER_MAX];
+} DNS_RESOLVER_STATS;
+
+// Take over server registration for the DNS client, which keeps being used by the Azure IoT middleware. The client
+// asks its servers one after another and is not raced, the server that won the last race is moved to the front.
+UINT dns_resolver_create(NX_DNS* dns);
+
+// Register a server with both the resolver and the DNS client, zero addresses are refused and duplicates ignored
+UINT dns_resolver_server_add(ULONG server_address);
+
+// Resolve an IPv4 address from the cache, or by asking every server at once and taking the first answer that
+// repeats the question. NX_NOT_FOUND when the name does not exist, NX_NO_WAIT only looks in the cache.
+UINT dns_resolver_host_by_name_get(const CHAR* host_name, ULONG* host_address, ULONG wait_option);
+
+// Resolve a host ahead of time, into the resolver cache and the DNS client cache the middleware looks it up in
+UINT dns_resolver_prefetch(const CHAR* host_name, ULONG wait_option);
+
+VOID dns_resolver_stats_get(DNS_RESOLVER_STATS* stats);
+
+#endif // _DNS_RESOLVER_H
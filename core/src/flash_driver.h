@@ -0,0 +1,23 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _FLASH_DRIVER_H
+#define _FLASH_DRIVER_H
+
+#include "tx_api.h"
+
+// Board supplied access to a region of NOR style flash. Offsets are relative to the start of the region. Programming
+// may only clear bits, an erased sector reads back as 0xFF, and writes are a multiple of FLASH_DRIVER_WRITE_ALIGN.
+#define FLASH_DRIVER_WRITE_ALIGN 8
+
+typedef struct FLASH_DRIVER_STRUCT
+{
+    UINT (*read)(ULONG offset, UCHAR* buffer, ULONG length);
+    UINT (*write)(ULONG offset, const UCHAR* buffer, ULONG length);
+    UINT (*erase)(ULONG sector_offset);
+
+    ULONG sector_size;
+    ULONG sector_count;
+} FLASH_DRIVER;
+
+#endif // _FLASH_DRIVER_H
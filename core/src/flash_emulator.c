@@ -0,0 +1,107 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include "flash_emulator.h"
+
+#include <string.h>
+
+#include "nx_api.h"
+
+#define FLASH_EMULATOR_REGION_SIZE (FLASH_EMULATOR_SECTOR_SIZE * FLASH_EMULATOR_SECTOR_COUNT)
+#define FLASH_EMULATOR_NO_FAILURE  0xFFFFFFFF
+
+static FLASH_EMULATOR_STORAGE_ATTRIBUTE UCHAR flash_emulator_storage[FLASH_EMULATOR_REGION_SIZE];
+
+// Bytes left to program before the simulated power failure
+static ULONG flash_emulator_write_budget = FLASH_EMULATOR_NO_FAILURE;
+
+static UINT flash_emulator_read(ULONG offset, UCHAR* buffer, ULONG length)
+{
+    if (offset > FLASH_EMULATOR_REGION_SIZE || length > FLASH_EMULATOR_REGION_SIZE - offset)
+    {
+        return NX_INVALID_PARAMETERS;
+    }
+
+    memcpy(buffer, &flash_emulator_storage[offset], length);
+
+    return NX_SUCCESS;
+}
+
+static UINT flash_emulator_write(ULONG offset, const UCHAR* buffer, ULONG length)
+{
+    ULONG i;
+
+    if (offset % FLASH_DRIVER_WRITE_ALIGN || length % FLASH_DRIVER_WRITE_ALIGN || offset > FLASH_EMULATOR_REGION_SIZE ||
+        length > FLASH_EMULATOR_REGION_SIZE - offset)
+    {
+        return NX_INVALID_PARAMETERS;
+    }
+
+    // Programming can only clear bits, check the whole write first so a refused one leaves the region untouched
+    for (i = 0; i < length; i++)
+    {
+        if ((buffer[i] & ~flash_emulator_storage[offset + i]) != 0)
+        {
+            return NX_NOT_SUCCESSFUL;
+        }
+    }
+
+    // Bytes are programmed in order so a power failure can land anywhere, including in the middle of an aligned word
+    for (i = 0; i < length; i++)
+    {
+        if (flash_emulator_write_budget != FLASH_EMULATOR_NO_FAILURE)
+        {
+            if (flash_emulator_write_budget == 0)
+            {
+                return NX_NOT_SUCCESSFUL;
+            }
+
+            flash_emulator_write_budget--;
+        }
+
+        flash_emulator_storage[offset + i] &= buffer[i];
+    }
+
+    return NX_SUCCESS;
+}
+
+static UINT flash_emulator_erase(ULONG sector_offset)
+{
+    if (sector_offset % FLASH_EMULATOR_SECTOR_SIZE || sector_offset >= FLASH_EMULATOR_REGION_SIZE)
+    {
+        return NX_INVALID_PARAMETERS;
+    }
+
+    // An erase is cut short by a power failure just like a write
+    if (flash_emulator_write_budget == 0)
+    {
+        return NX_NOT_SUCCESSFUL;
+    }
+
+    memset(&flash_emulator_storage[sector_offset], 0xFF, FLASH_EMULATOR_SECTOR_SIZE);
+
+    return NX_SUCCESS;
+}
+
+const FLASH_DRIVER flash_emulator = {
+    flash_emulator_read,
+    flash_emulator_write,
+    flash_emulator_erase,
+    FLASH_EMULATOR_SECTOR_SIZE,
+    FLASH_EMULATOR_SECTOR_COUNT,
+};
+
+VOID flash_emulator_format(VOID)
+{
+    memset(flash_emulator_storage, 0xFF, sizeof(flash_emulator_storage));
+}
+
+VOID flash_emulator_power_fail_after(ULONG bytes)
+{
+    flash_emulator_write_budget = bytes;
+}
+
+VOID flash_emulator_power_restore(VOID)
+{
+    flash_emulator_write_budget = FLASH_EMULATOR_NO_FAILURE;
+}
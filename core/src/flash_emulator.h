@@ -0,0 +1,40 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _FLASH_EMULATOR_H
+#define _FLASH_EMULATOR_H
+
+#include "tx_api.h"
+
+#include "nx_api.h"
+
+#include "flash_driver.h"
+
+// RAM backed FLASH_DRIVER with NOR semantics, for exercising flash users on a host or on a board without a flash
+// driver. Programming a bit from 0 back to 1 and misaligned writes fail the same way real parts refuse them.
+#ifndef FLASH_EMULATOR_SECTOR_SIZE
+#define FLASH_EMULATOR_SECTOR_SIZE 4096
+#endif
+
+#ifndef FLASH_EMULATOR_SECTOR_COUNT
+#define FLASH_EMULATOR_SECTOR_COUNT 2
+#endif
+
+// Place the storage in a RAM section the startup code leaves alone to keep its contents over a warm reset, boards set
+// this in nx_user.h
+#ifndef FLASH_EMULATOR_STORAGE_ATTRIBUTE
+#define FLASH_EMULATOR_STORAGE_ATTRIBUTE
+#endif
+
+extern const FLASH_DRIVER flash_emulator;
+
+// Return the whole region to the erased state, as a blank part would read
+VOID flash_emulator_format(VOID);
+
+// Program only the next bytes bytes, then refuse every write and erase until flash_emulator_power_restore. Leaves
+// behind the partially programmed data a reset in the middle of a write would, the storage itself is kept so a test
+// can reboot by reopening whatever uses it.
+VOID flash_emulator_power_fail_after(ULONG bytes);
+VOID flash_emulator_power_restore(VOID);
+
+#endif // _FLASH_EMULATOR_H
@@ -0,0 +1,252 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include "flash_record_store.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "nx_api.h"
+
+#define FLASH_RECORD_ERASED 0xFFFFFFFF
+#define FLASH_RECORD_NONE   0xFFFFFFFF
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME        16777619u
+
+static uint32_t record_check(FLASH_RECORD_STORE* store, const VOID* record)
+{
+    const UCHAR* data = (const UCHAR*)record + sizeof(FLASH_RECORD_HEADER);
+    uint32_t hash     = FNV_OFFSET_BASIS;
+    UINT i;
+
+    for (i = 0; i < store->record_size - sizeof(FLASH_RECORD_HEADER); i++)
+    {
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+static bool record_valid(FLASH_RECORD_STORE* store, const VOID* record)
+{
+    const FLASH_RECORD_HEADER* header = (const FLASH_RECORD_HEADER*)record;
+
+    return header->magic == store->magic && header->revoked[0] == FLASH_RECORD_ERASED &&
+           header->check == record_check(store, record);
+}
+
+static bool record_erased(FLASH_RECORD_STORE* store, const VOID* record)
+{
+    const UCHAR* bytes = (const UCHAR*)record;
+    UINT i;
+
+    for (i = 0; i < store->record_size; i++)
+    {
+        if (bytes[i] != 0xFF)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static UINT record_read(FLASH_RECORD_STORE* store, ULONG offset, VOID* record)
+{
+    return store->driver->read(store->base_offset + offset, (UCHAR*)record, store->record_size);
+}
+
+static UINT record_write(FLASH_RECORD_STORE* store, ULONG offset, const VOID* record)
+{
+    return store->driver->write(store->base_offset + offset, (const UCHAR*)record, store->record_size);
+}
+
+// Records never straddle a sector, the tail of each sector is left unused
+static ULONG slot_next(FLASH_RECORD_STORE* store, ULONG offset)
+{
+    ULONG sector = offset - (offset % store->driver->sector_size);
+
+    offset += store->record_size;
+    if (offset + store->record_size > sector + store->driver->sector_size)
+    {
+        offset = sector + store->driver->sector_size;
+    }
+
+    return offset;
+}
+
+static UINT region_erase(FLASH_RECORD_STORE* store)
+{
+    ULONG offset;
+    UINT status;
+
+    for (offset = 0; offset < store->region_size; offset += store->driver->sector_size)
+    {
+        if ((status = store->driver->erase(store->base_offset + offset)))
+        {
+            printf("ERROR: failed to erase %s sector %lu (0x%08x)\r\n",
+                store->name,
+                (store->base_offset + offset) / store->driver->sector_size,
+                status);
+            return status;
+        }
+    }
+
+    store->record_offset = FLASH_RECORD_NONE;
+    store->free_offset   = 0;
+
+    return NX_SUCCESS;
+}
+
+UINT flash_record_store_open(FLASH_RECORD_STORE* store,
+    const FLASH_DRIVER* driver,
+    ULONG first_sector,
+    ULONG sector_count,
+    uint32_t magic,
+    ULONG record_size,
+    const CHAR* name)
+{
+    ULONG record[FLASH_RECORD_SIZE_MAX / sizeof(ULONG)];
+    ULONG offset;
+
+    if (store == NX_NULL || driver == NX_NULL || name == NX_NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    if (record_size % FLASH_DRIVER_WRITE_ALIGN || record_size <= sizeof(FLASH_RECORD_HEADER) ||
+        record_size > FLASH_RECORD_SIZE_MAX || driver->sector_size < record_size ||
+        driver->sector_size % FLASH_DRIVER_WRITE_ALIGN || sector_count == 0 || first_sector >= driver->sector_count ||
+        sector_count > driver->sector_count - first_sector)
+    {
+        printf("ERROR: flash region unsuitable for the %s\r\n", name);
+        return NX_INVALID_PARAMETERS;
+    }
+
+    store->driver        = driver;
+    store->name          = name;
+    store->magic         = magic;
+    store->record_size   = record_size;
+    store->base_offset   = first_sector * driver->sector_size;
+    store->region_size   = sector_count * driver->sector_size;
+    store->record_offset = FLASH_RECORD_NONE;
+    store->free_offset   = FLASH_RECORD_NONE;
+
+    // Records are appended in order, the last valid one is current and the first erased slot is where the next goes
+    for (offset = 0; offset < store->region_size; offset = slot_next(store, offset))
+    {
+        if (record_read(store, offset, record))
+        {
+            continue;
+        }
+
+        if (record_erased(store, record))
+        {
+            if (store->free_offset == FLASH_RECORD_NONE)
+            {
+                store->free_offset = offset;
+            }
+        }
+        else
+        {
+            store->free_offset = FLASH_RECORD_NONE;
+
+            if (record_valid(store, record))
+            {
+                store->record_offset = offset;
+            }
+        }
+    }
+
+    return NX_SUCCESS;
+}
+
+UINT flash_record_load(FLASH_RECORD_STORE* store, VOID* record)
+{
+    if (store->driver == NX_NULL || store->record_offset == FLASH_RECORD_NONE ||
+        record_read(store, store->record_offset, record) || !record_valid(store, record))
+    {
+        return NX_NOT_FOUND;
+    }
+
+    return NX_SUCCESS;
+}
+
+UINT flash_record_save(FLASH_RECORD_STORE* store, VOID* record)
+{
+    FLASH_RECORD_HEADER* header = (FLASH_RECORD_HEADER*)record;
+    ULONG current[FLASH_RECORD_SIZE_MAX / sizeof(ULONG)];
+    UINT status;
+
+    if (store->driver == NX_NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    header->magic      = store->magic;
+    header->revoked[0] = FLASH_RECORD_ERASED;
+    header->revoked[1] = FLASH_RECORD_ERASED;
+    header->check      = record_check(store, record);
+
+    // Saving the same record again, as every boot may, must not wear the flash
+    if (store->record_offset != FLASH_RECORD_NONE && record_read(store, store->record_offset, current) == NX_SUCCESS &&
+        memcmp(current, record, store->record_size) == 0)
+    {
+        return NX_SUCCESS;
+    }
+
+    // Only one record may be valid, losing power before the new one lands just loses the record
+    if ((status = flash_record_invalidate(store)))
+    {
+        return status;
+    }
+
+    if (store->free_offset == FLASH_RECORD_NONE && (status = region_erase(store)))
+    {
+        return status;
+    }
+
+    // A slot that reads erased but will not program is recovered by starting the region over
+    if (record_write(store, store->free_offset, record) &&
+        ((status = region_erase(store)) || (status = record_write(store, 0, record))))
+    {
+        printf("ERROR: failed to write %s (0x%08x)\r\n", store->name, status);
+        return status;
+    }
+
+    store->record_offset = store->free_offset;
+    store->free_offset   = slot_next(store, store->free_offset);
+
+    if (store->free_offset >= store->region_size)
+    {
+        store->free_offset = FLASH_RECORD_NONE;
+    }
+
+    return NX_SUCCESS;
+}
+
+UINT flash_record_invalidate(FLASH_RECORD_STORE* store)
+{
+    uint32_t revoked[2] = {0, 0};
+    ULONG offset;
+    UINT status;
+
+    if (store->driver == NX_NULL || store->record_offset == FLASH_RECORD_NONE)
+    {
+        return NX_SUCCESS;
+    }
+
+    offset = store->base_offset + store->record_offset + offsetof(FLASH_RECORD_HEADER, revoked);
+    if ((status = store->driver->write(offset, (UCHAR*)revoked, sizeof(revoked))))
+    {
+        printf("ERROR: failed to invalidate %s (0x%08x)\r\n", store->name, status);
+        return status;
+    }
+
+    store->record_offset = FLASH_RECORD_NONE;
+
+    return NX_SUCCESS;
+}
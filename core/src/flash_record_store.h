@@ -0,0 +1,61 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _FLASH_RECORD_STORE_H
+#define _FLASH_RECORD_STORE_H
+
+#include <stdint.h>
+
+#include "tx_api.h"
+
+#include "flash_driver.h"
+
+// Largest record a store keeps, it is read onto the stack
+#define FLASH_RECORD_SIZE_MAX 256
+
+// Every record starts with this header, the store fills it in. The record is programmed at once, check covers what
+// follows the header and catches one torn by a reset. The revoked words stay erased until the record is superseded,
+// so that needs no erase. Fixed width fields keep the layout the same whatever the width of ULONG.
+typedef struct FLASH_RECORD_HEADER_STRUCT
+{
+    uint32_t magic;
+    uint32_t check;
+    uint32_t revoked[2];
+} FLASH_RECORD_HEADER;
+
+// Keeps one current record in a run of sectors of a flash region. Records are appended and superseded ones are revoked
+// in place until the sectors have to be erased.
+typedef struct FLASH_RECORD_STORE_STRUCT
+{
+    const FLASH_DRIVER* driver;
+    const CHAR* name;
+    uint32_t magic;
+    ULONG record_size;
+    ULONG base_offset;
+    ULONG region_size;
+
+    // Relative to base_offset
+    ULONG record_offset;
+    ULONG free_offset;
+} FLASH_RECORD_STORE;
+
+// Find the current record in sector_count sectors from first_sector. record_size includes the header and is a
+// multiple of FLASH_DRIVER_WRITE_ALIGN, name is only used in messages.
+UINT flash_record_store_open(FLASH_RECORD_STORE* store,
+    const FLASH_DRIVER* driver,
+    ULONG first_sector,
+    ULONG sector_count,
+    uint32_t magic,
+    ULONG record_size,
+    const CHAR* name);
+
+// Read the current record, header included, NX_NOT_FOUND when there is none
+UINT flash_record_load(FLASH_RECORD_STORE* store, VOID* record);
+
+// Make record the current one, its header is filled in here. Saving the current record again writes nothing.
+UINT flash_record_save(FLASH_RECORD_STORE* store, VOID* record);
+
+// Drop the current record
+UINT flash_record_invalidate(FLASH_RECORD_STORE* store);
+
+#endif // _FLASH_RECORD_STORE_H
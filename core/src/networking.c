@@ -10,10 +10,21 @@
 #include "nxd_dhcp_client.h"
 #include "nxd_dns.h"
 
+#include "dhcp_lease.h"
+#include "dns_resolver.h"
+#include "packet_pools.h"
+
 #define THREADX_IP_STACK_SIZE 2048
-#define THREADX_PACKET_COUNT 60
 #define THREADX_PACKET_SIZE 1536
-#define THREADX_POOL_SIZE ((THREADX_PACKET_SIZE + sizeof(NX_PACKET)) * THREADX_PACKET_COUNT)
+
+// Receive needs enough packets to queue a full TLS record, sends are small telemetry messages. Boards whose Ethernet
+// driver keeps a large receive ring filled from this pool raise the count in their nx_user.h.
+#ifndef THREADX_STACK_PACKET_COUNT
+#define THREADX_STACK_PACKET_COUNT    24
+#endif
+#define THREADX_CLOUD_PACKET_COUNT       20
+#define THREADX_CLOUD_SMALL_PACKET_COUNT 16
+#define THREADX_SERVICES_PACKET_COUNT    8
 #define THREADX_ARP_CACHE_SIZE 512
 
 #define THREADX_IPV4_ADDRESS IP_ADDRESS(0, 0, 0, 0)
@@ -21,14 +32,21 @@
 
 // Define the stack/cache for ThreadX.
 static UCHAR threadx_ip_stack[THREADX_IP_STACK_SIZE];
-static UCHAR threadx_ip_pool[THREADX_POOL_SIZE];
+static UCHAR threadx_stack_pool[PACKET_POOL_MEMORY_SIZE(THREADX_PACKET_SIZE, THREADX_STACK_PACKET_COUNT)];
+static UCHAR threadx_cloud_pool[PACKET_POOL_MEMORY_SIZE(THREADX_PACKET_SIZE, THREADX_CLOUD_PACKET_COUNT)];
+static UCHAR threadx_cloud_small_pool[
+    PACKET_POOL_MEMORY_SIZE(PACKET_POOL_CLOUD_SMALL_PAYLOAD_SIZE, THREADX_CLOUD_SMALL_PACKET_COUNT)];
+static UCHAR threadx_services_pool[
+    PACKET_POOL_MEMORY_SIZE(PACKET_POOL_SERVICES_PAYLOAD_SIZE, THREADX_SERVICES_PACKET_COUNT)];
 static UCHAR threadx_arp_cache_area[THREADX_ARP_CACHE_SIZE];
 
 NX_IP           nx_ip;
-NX_PACKET_POOL  nx_pool;
 NX_DNS          nx_dns_client;
 NX_DHCP         nx_dhcp_client;
 
+static DHCP_LEASE_STORE dhcp_lease_store;
+static DHCP_LEASE       dhcp_lease;
+
 // Print IPv4 address
 static void print_address(CHAR* preable, ULONG address)
 {
@@ -43,21 +61,19 @@ static void print_address(CHAR* preable, ULONG address)
 static UINT dhcp_wait()
 {
     UINT status;
-    ULONG actual_status;
-    ULONG ip_address;
-    ULONG network_mask;
-    ULONG gateway_address;
 
     printf("Initializing DHCP\r\n");
 
     // Create the DHCP instance.
     status = nx_dhcp_create(&nx_dhcp_client, &nx_ip, "azure_iot");
 
-    // Start the DHCP Client.
-    status = nx_dhcp_start(&nx_dhcp_client);
+#ifdef NX_DHCP_CLIENT_USER_CREATE_PACKET_POOL
+    // DHCP messages come from the services pool rather than a pool of their own
+    status = nx_dhcp_packet_pool_set(&nx_dhcp_client, packet_pool_get(PACKET_POOL_SERVICES));
+#endif
 
-    // Wait until address is solved.
-    status = nx_ip_status_check(&nx_ip, NX_IP_ADDRESS_RESOLVED, &actual_status, NX_WAIT_FOREVER);
+    // Start the DHCP Client, confirming the stored lease first, and wait until address is solved.
+    status = dhcp_lease_acquire(&nx_dhcp_client, &dhcp_lease_store, &dhcp_lease);
     if (status != NX_SUCCESS)
     {
         // DHCP Failed...  no IP address!
@@ -65,14 +81,10 @@ static UINT dhcp_wait()
         return status;
     }
 
-    // Get IP address and gateway address
-    nx_ip_address_get(&nx_ip, &ip_address, &network_mask);
-    nx_ip_gateway_address_get(&nx_ip, &gateway_address);
-
     // Output IP address and gateway address
-    print_address("IP address", ip_address);
-    print_address("Mask", network_mask);
-    print_address("Gateway", gateway_address);
+    print_address("IP address", dhcp_lease.ip_address);
+    print_address("Mask", dhcp_lease.network_mask);
+    print_address("Gateway", dhcp_lease.gateway_address);
 
     printf("SUCCESS: DHCP initialized\r\n\r\n");
 
@@ -82,8 +94,7 @@ static UINT dhcp_wait()
 static UINT dns_create()
 {
     UINT status;
-    ULONG dns_server_address[3] = { 0 };
-    UINT dns_server_address_size = 12;
+    UINT i;
 
     printf("Initializing DNS client\r\n");
 
@@ -98,7 +109,7 @@ static UINT dns_create()
 
 #ifdef NX_DNS_CLIENT_USER_CREATE_PACKET_POOL
     // Use the packet pool here
-    status = nx_dns_packet_pool_set(&nx_dns_client, nx_ip.nx_ip_default_packet_pool);
+    status = nx_dns_packet_pool_set(&nx_dns_client, packet_pool_get(PACKET_POOL_SERVICES));
     if (status != NX_SUCCESS)
     {
         nx_dns_delete(&nx_dns_client);
@@ -106,25 +117,51 @@ static UINT dns_create()
     }
 #endif
 
-    // Retrieve DNS server address
-    nx_dhcp_interface_user_option_retrieve(&nx_dhcp_client, 0, NX_DHCP_OPTION_DNS_SVR, (UCHAR*)dns_server_address, &dns_server_address_size); 
-    
-    // Add an IPv4 server address to the Client list
-    status = nx_dns_server_add(&nx_dns_client, dns_server_address[0]);
+    status = dns_resolver_create(&nx_dns_client);
+    if (status != NX_SUCCESS)
+    {
+        nx_dns_delete(&nx_dns_client);
+        return status;
+    }
+
+    // Add every IPv4 server address of the lease so that queries can go to all of them at once
+    status = NX_DNS_NO_SERVER;
+    for (i = 0; i < DHCP_LEASE_DNS_SERVER_COUNT; i++)
+    {
+        if (dhcp_lease.dns_server_address[i] != 0 &&
+            dns_resolver_server_add(dhcp_lease.dns_server_address[i]) == NX_SUCCESS)
+        {
+            // Output DNS Server address
+            print_address("DNS address", dhcp_lease.dns_server_address[i]);
+            status = NX_SUCCESS;
+        }
+    }
+
     if (status != NX_SUCCESS)
     {
         nx_dns_delete(&nx_dns_client);
         return status;
     }
-    
-    // Output DNS Server address
-    print_address("DNS address", dns_server_address[0]);
 
     printf("SUCCESS: DNS client initialized\r\n\r\n");
 
     return NX_SUCCESS;
 }
 
+UINT network_dhcp_lease_store_set(const FLASH_DRIVER* driver, ULONG first_sector, ULONG sector_count)
+{
+    UINT status;
+
+    if ((status = dhcp_lease_store_open(&dhcp_lease_store, driver, first_sector, sector_count)))
+    {
+        printf("ERROR: failed to open DHCP lease store (0x%08x)\r\n", status);
+        dhcp_lease_store.driver = NX_NULL;
+        return status;
+    }
+
+    return NX_SUCCESS;
+}
+
 bool network_init(VOID (*ip_link_driver)(struct NX_IP_DRIVER_STRUCT *))
 {
     UINT status;
@@ -132,12 +169,19 @@ bool network_init(VOID (*ip_link_driver)(struct NX_IP_DRIVER_STRUCT *))
     // Initialize the NetX system.
     nx_system_initialize();
 
-    // Create a packet pool.
-    status = nx_packet_pool_create(&nx_pool, "NetX Packet Pool",
-        THREADX_PACKET_SIZE, 
-        threadx_ip_pool, THREADX_POOL_SIZE);
-    if (status != NX_SUCCESS)
+    // Create the packet pools.
+    if (packet_pool_create(PACKET_POOL_STACK, THREADX_PACKET_SIZE, threadx_stack_pool, sizeof(threadx_stack_pool)) ||
+        packet_pool_create(PACKET_POOL_CLOUD, THREADX_PACKET_SIZE, threadx_cloud_pool, sizeof(threadx_cloud_pool)) ||
+        packet_pool_create(PACKET_POOL_CLOUD_SMALL,
+            PACKET_POOL_CLOUD_SMALL_PAYLOAD_SIZE,
+            threadx_cloud_small_pool,
+            sizeof(threadx_cloud_small_pool)) ||
+        packet_pool_create(PACKET_POOL_SERVICES,
+            PACKET_POOL_SERVICES_PAYLOAD_SIZE,
+            threadx_services_pool,
+            sizeof(threadx_services_pool)))
     {
+        packet_pools_delete();
         printf("THREADX platform initialize fail: PACKET POOL CREATE FAIL.\r\n");
         return false;
     }
@@ -145,11 +189,11 @@ bool network_init(VOID (*ip_link_driver)(struct NX_IP_DRIVER_STRUCT *))
     // Create an IP instance
     status = nx_ip_create(&nx_ip, "NetX IP Instance 0", 
         THREADX_IPV4_ADDRESS, THREADX_IPV4_MASK,
-        &nx_pool, ip_link_driver, 
+        packet_pool_get(PACKET_POOL_STACK), ip_link_driver, 
         (UCHAR*)threadx_ip_stack, THREADX_IP_STACK_SIZE, 1);
     if (status != NX_SUCCESS)
     {
-        nx_packet_pool_delete(&nx_pool);
+        packet_pools_delete();
         printf("THREADX platform initialize fail: IP CREATE FAIL.\r\n");
         return false;
     }
@@ -159,7 +203,7 @@ bool network_init(VOID (*ip_link_driver)(struct NX_IP_DRIVER_STRUCT *))
     if (status != NX_SUCCESS)
     {
         nx_ip_delete(&nx_ip);
-        nx_packet_pool_delete(&nx_pool);
+        packet_pools_delete();
         printf("THREADX platform initialize fail: ARP ENABLE FAIL.\r\n");
         return false;
     }
@@ -169,7 +213,7 @@ bool network_init(VOID (*ip_link_driver)(struct NX_IP_DRIVER_STRUCT *))
     if (status != NX_SUCCESS)
     {
         nx_ip_delete(&nx_ip);
-        nx_packet_pool_delete(&nx_pool);
+        packet_pools_delete();
         printf("THREADX platform initialize fail: TCP ENABLE FAIL.\r\n");
         return false;
     }
@@ -179,7 +223,7 @@ bool network_init(VOID (*ip_link_driver)(struct NX_IP_DRIVER_STRUCT *))
     if (status != NX_SUCCESS)
     {
         nx_ip_delete(&nx_ip);
-        nx_packet_pool_delete(&nx_pool);
+        packet_pools_delete();
         printf("THREADX platform initialize fail: UDP ENABLE FAIL.\r\n");
         return false;
     }
@@ -189,7 +233,7 @@ bool network_init(VOID (*ip_link_driver)(struct NX_IP_DRIVER_STRUCT *))
     if (status != NX_SUCCESS)
     {
         nx_ip_delete(&nx_ip);
-        nx_packet_pool_delete(&nx_pool);
+        packet_pools_delete();
         printf("THREADX platform initialize fail: ICMP ENABLE FAIL.\r\n");
         return false;
     }
@@ -197,9 +241,11 @@ bool network_init(VOID (*ip_link_driver)(struct NX_IP_DRIVER_STRUCT *))
     status = dhcp_wait();
     if (status != NX_SUCCESS)
     {
+        nx_dhcp_delete(&nx_dhcp_client);
         nx_ip_delete(&nx_ip);
-        nx_packet_pool_delete(&nx_pool);
+        packet_pools_delete();
         printf("Failed to create DHCP\r\n");
+        return false;
     }
 
     // Create DNS
@@ -208,7 +254,7 @@ bool network_init(VOID (*ip_link_driver)(struct NX_IP_DRIVER_STRUCT *))
     {
         nx_dhcp_delete(&nx_dhcp_client);
         nx_ip_delete(&nx_ip);
-        nx_packet_pool_delete(&nx_pool);
+        packet_pools_delete();
         printf("THREADX platform initialize fail: DNS CREATE FAIL.\r\n");
         return false;
     }
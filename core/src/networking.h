@@ -9,9 +9,15 @@
 #include "nx_api.h"
 #include "nxd_dns.h"
 
-extern NX_IP          nx_ip;
-extern NX_PACKET_POOL nx_pool;
-extern NX_DNS         nx_dns_client;
+#include "flash_driver.h"
+#include "packet_pools.h"
+
+extern NX_IP  nx_ip;
+extern NX_DNS nx_dns_client;
+
+// Keep the DHCP lease in these sectors of a flash region so the next boot can confirm it instead of running
+// discovery. Call before network_init.
+UINT network_dhcp_lease_store_set(const FLASH_DRIVER* driver, ULONG first_sector, ULONG sector_count);
 
 bool network_init(VOID (*ip_link_driver)(struct NX_IP_DRIVER_STRUCT *));
 
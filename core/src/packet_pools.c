@@ -0,0 +1,133 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include "packet_pools.h"
+
+#include <stdio.h>
+
+static const CHAR* const packet_pool_names[PACKET_POOL_COUNT] = {
+    "NetX stack packet pool",
+    "NetX cloud packet pool",
+    "NetX cloud small packet pool",
+    "NetX services packet pool",
+};
+
+// The pool each size class belongs to, a subsystem only ever draws on its own packets
+static const PACKET_POOL_ID packet_pool_owners[PACKET_POOL_COUNT] = {
+    PACKET_POOL_STACK,
+    PACKET_POOL_CLOUD,
+    PACKET_POOL_CLOUD,
+    PACKET_POOL_SERVICES,
+};
+
+static NX_PACKET_POOL packet_pools[PACKET_POOL_COUNT];
+static UINT packet_pools_created = 0;
+
+static UINT pool_created(PACKET_POOL_ID id)
+{
+    return packet_pools_created & (1 << id);
+}
+
+UINT packet_pool_create(PACKET_POOL_ID id, ULONG payload_size, VOID* memory, ULONG memory_size)
+{
+    UINT status;
+
+    if (id >= PACKET_POOL_COUNT || memory == NX_NULL)
+    {
+        return NX_INVALID_PARAMETERS;
+    }
+
+    if (pool_created(id))
+    {
+        return NX_ALREADY_ENABLED;
+    }
+
+    if ((status = nx_packet_pool_create(
+             &packet_pools[id], (CHAR*)packet_pool_names[id], payload_size, memory, memory_size)))
+    {
+        printf("ERROR: failed to create %s (0x%08x)\r\n", packet_pool_names[id], status);
+        return status;
+    }
+
+    packet_pools_created |= 1 << id;
+
+    return NX_SUCCESS;
+}
+
+VOID packet_pools_delete(VOID)
+{
+    UINT id;
+
+    for (id = 0; id < PACKET_POOL_COUNT; id++)
+    {
+        if (pool_created(id))
+        {
+            nx_packet_pool_delete(&packet_pools[id]);
+        }
+    }
+
+    packet_pools_created = 0;
+}
+
+NX_PACKET_POOL* packet_pool_get(PACKET_POOL_ID id)
+{
+    if (id >= PACKET_POOL_COUNT || !pool_created(id))
+    {
+        return NX_NULL;
+    }
+
+    return &packet_pools[id];
+}
+
+UINT packet_pool_allocate(
+    PACKET_POOL_ID id, ULONG size, ULONG packet_type, NX_PACKET** packet_pptr, ULONG wait_option)
+{
+    NX_PACKET_POOL* best = NX_NULL;
+    UINT class_id;
+
+    if (id >= PACKET_POOL_COUNT || id == PACKET_POOL_STACK)
+    {
+        return NX_INVALID_PARAMETERS;
+    }
+
+    for (class_id = PACKET_POOL_STACK + 1; class_id < PACKET_POOL_COUNT; class_id++)
+    {
+        if (packet_pool_owners[class_id] == packet_pool_owners[id] && pool_created(class_id) &&
+            packet_pools[class_id].nx_packet_pool_payload_size >= packet_type + size &&
+            (best == NX_NULL ||
+                packet_pools[class_id].nx_packet_pool_payload_size < best->nx_packet_pool_payload_size))
+        {
+            best = &packet_pools[class_id];
+        }
+    }
+
+    if (best == NX_NULL)
+    {
+        return NX_INVALID_PARAMETERS;
+    }
+
+    // Empty pool requests are counted by NetX and show in packet_pool_stats_get
+    return nx_packet_allocate(best, packet_pptr, packet_type, wait_option);
+}
+
+UINT packet_pool_stats_get(PACKET_POOL_ID id, PACKET_POOL_STATS* stats)
+{
+    if (id >= PACKET_POOL_COUNT || stats == NX_NULL)
+    {
+        return NX_INVALID_PARAMETERS;
+    }
+
+    if (!pool_created(id))
+    {
+        return NX_NOT_ENABLED;
+    }
+
+    stats->payload_size = packet_pools[id].nx_packet_pool_payload_size;
+
+    return nx_packet_pool_info_get(&packet_pools[id],
+        &stats->total_packets,
+        &stats->free_packets,
+        &stats->empty_requests,
+        &stats->empty_suspensions,
+        &stats->invalid_releases);
+}
@@ -0,0 +1,66 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _PACKET_POOLS_H
+#define _PACKET_POOLS_H
+
+#include "tx_api.h"
+
+#include "nx_api.h"
+
+// Each subsystem draws on a pool of its own, so a burst in one can't leave another without packets
+typedef enum PACKET_POOL_ID_ENUM
+{
+    // The IP default pool, only NetX allocates from it for driver receive, TCP ACKs, ARP and ICMP
+    PACKET_POOL_STACK = 0,
+
+    // TLS records of the hub connection
+    PACKET_POOL_CLOUD,
+
+    // Small size class of the cloud pool, queued telemetry payloads are built in it and chained behind the message
+    // header when sent
+    PACKET_POOL_CLOUD_SMALL,
+
+    // DNS, DHCP and SNTP datagrams
+    PACKET_POOL_SERVICES,
+
+    PACKET_POOL_COUNT
+} PACKET_POOL_ID;
+
+// Fits a DHCP message, the largest of the services, with its headers
+#define PACKET_POOL_SERVICES_PAYLOAD_SIZE 640
+
+// Fits a typical telemetry message whole, larger ones take a chain
+#define PACKET_POOL_CLOUD_SMALL_PAYLOAD_SIZE 256
+
+#define PACKET_POOL_MEMORY_SIZE(payload_size, packet_count) (((payload_size) + sizeof(NX_PACKET)) * (packet_count))
+
+typedef struct PACKET_POOL_STATS_STRUCT
+{
+    ULONG payload_size;
+    ULONG total_packets;
+    ULONG free_packets;
+
+    // Allocations that found the pool empty, and of those the ones that waited for a packet
+    ULONG empty_requests;
+    ULONG empty_suspensions;
+
+    ULONG invalid_releases;
+} PACKET_POOL_STATS;
+
+UINT packet_pool_create(PACKET_POOL_ID id, ULONG payload_size, VOID* memory, ULONG memory_size);
+
+// Delete every pool created so far
+VOID packet_pools_delete(VOID);
+
+// NX_NULL when the board did not create the pool
+NX_PACKET_POOL* packet_pool_get(PACKET_POOL_ID id);
+
+// Allocate from the smallest of the pool id and its size classes whose packets fit size bytes after the packet_type
+// headers. The stack pool is never used, it stays reserved for NetX.
+UINT packet_pool_allocate(
+    PACKET_POOL_ID id, ULONG size, ULONG packet_type, NX_PACKET** packet_pptr, ULONG wait_option);
+
+UINT packet_pool_stats_get(PACKET_POOL_ID id, PACKET_POOL_STATS* stats);
+
+#endif // _PACKET_POOLS_H
@@ -3,25 +3,60 @@
 
 #include "sntp_client.h"
 
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #include "nx_api.h"
-#include "nxd_dns.h"
-#include "nxd_sntp_client.h"
 
+#include "dns_resolver.h"
 #include "networking.h"
+#include "packet_pools.h"
 
 #define SNTP_THREAD_STACK_SIZE 2048
 #define SNTP_THREAD_PRIORITY   9
 
-#define SNTP_UPDATE_EVENT  1
 #define SNTP_NEW_TIME      2
 #define SNTP_STOP_EVENT    4
 #define SNTP_STOPPED_EVENT 8
 
-// Seconds between Unix Epoch (1/1/1970) and NTP Epoch (1/1/1999)
+// One event per server being queried
+#define SNTP_REPLY_EVENT(index) (16UL << (index))
+#define SNTP_REPLY_EVENTS       (SNTP_REPLY_EVENT(SNTP_QUERY_MAX) - SNTP_REPLY_EVENT(0))
+
+// Seconds between Unix Epoch (1/1/1970) and NTP Epoch (1/1/1900)
 #define UNIX_TO_NTP_EPOCH_SECS 0x83AA7E80
 
+#define NTP_PORT        123
+#define NTP_PACKET_SIZE 48
+#define NTP_VERSION     4
+#define NTP_MODE_CLIENT 3
+#define NTP_MODE_SERVER 4
+#define NTP_LEAP_ALARM  3
+
+// Servers asked at once, each needs a socket of its own while the query runs
+#ifndef SNTP_QUERY_MAX
+#define SNTP_QUERY_MAX 3
+#endif
+
+// How long the servers get to answer, and once one has how much longer the others get to beat it
+#define SNTP_QUERY_TIMEOUT_TICKS (3 * NX_IP_PERIODIC_RATE)
+#define SNTP_COLLECT_TICKS       (NX_IP_PERIODIC_RATE / 4)
+
+// Time all the server names of a round share to resolve, one that does not answer can't hold up the rest for long
+#define SNTP_RESOLVE_TIMEOUT_TICKS (5 * NX_IP_PERIODIC_RATE)
+
+#define SNTP_POLL_TICKS      (64 * NX_IP_PERIODIC_RATE)
+#define SNTP_RETRY_MIN_TICKS (2 * NX_IP_PERIODIC_RATE)
+
+#ifdef NX_SNTP_CLIENT_MIN_SERVER_STRATUM
+#define SNTP_STRATUM_MAX NX_SNTP_CLIENT_MIN_SERVER_STRATUM
+#else
+#define SNTP_STRATUM_MAX 15
+#endif
+
+#define SNTP_JITTER_WEIGHT 4
+
 static const char* SNTP_SERVER[] = {
     "0.pool.ntp.org",
     "1.pool.ntp.org",
@@ -30,227 +65,694 @@ static const char* SNTP_SERVER[] = {
 };
 static UINT sntp_server_count = 0;
 
+typedef struct SNTP_QUERY_STRUCT
+{
+    NX_UDP_SOCKET socket;
+    ULONG server_address;
+
+    // Sent as the transmit timestamp, a genuine reply echoes it as the originate timestamp
+    ULONG nonce[2];
+
+    ULONG send_ticks;
+    ULONG receive_ticks;
+} SNTP_QUERY;
+
+typedef struct SNTP_SAMPLE_STRUCT
+{
+    SNTP_QUERY* query;
+    UINT stratum;
+
+    // Local receive time and the correction the server suggests for it
+    ULONG ticks;
+    int64_t offset_ms;
+    LONG delay_ms;
+
+    // Root distance, how far the server's clock may be from the reference
+    LONG distance_ms;
+} SNTP_SAMPLE;
+
 static ULONG sntp_thread_stack[SNTP_THREAD_STACK_SIZE / sizeof(ULONG)];
 static TX_THREAD sntp_client_thread;
 
-static NX_SNTP_CLIENT sntp_client;
+static SNTP_QUERY sntp_queries[SNTP_QUERY_MAX];
 static TX_EVENT_FLAGS_GROUP sntp_flags;
 
-// Variables to keep track of time
-static TX_MUTEX time_mutex;
-static ULONG sntp_last_time = 0;
-static ULONG tx_last_ticks  = 0;
-static bool first_sync      = false;
+static SNTP_STATS sntp_stats;
+
+// Offsets below this are slewed out, larger ones and the first sync step the clock
+#define SNTP_CLOCK_STEP_MS 1000
+
+// Most the clock is sped up or slowed down while slewing, in parts per million
+#define SNTP_CLOCK_SLEW_PPM 500
+
+// Drift is only learned over intervals long enough for the tick resolution not to dominate, and an error above the
+// maximum is taken as the server changing its mind rather than the local crystal
+#define SNTP_CLOCK_DRIFT_MIN_TICKS (10 * 60 * TX_TIMER_TICKS_PER_SECOND)
+#define SNTP_CLOCK_DRIFT_MAX_PPB   1000000
+#define SNTP_CLOCK_DRIFT_WEIGHT    4
+
+// Fold elapsed time into the base regularly so the tick difference never wraps
+#define SNTP_CLOCK_REBASE_TICKS (60 * 60 * TX_TIMER_TICKS_PER_SECOND)
+
+typedef struct SNTP_CLOCK_STRUCT
+{
+    // Unix time in milliseconds at base_ticks
+    ULONG base_ticks;
+    uint64_t base_ms;
+
+    // Rate error of the local tick being compensated, and the correction still to be slewed in
+    LONG drift_ppb;
+    LONG slew_ms;
+} SNTP_CLOCK;
+
+// Only the SNTP thread writes the clock, into the copy readers are not using, before publishing it by bumping the
+// sequence. Readers retry if the sequence moved while they copied, so they never wait for a preempted writer.
+static volatile SNTP_CLOCK sntp_clocks[2];
+static volatile ULONG sntp_clock_sequence = 0;
+
+// Last server sample the drift is measured against
+static ULONG drift_reference_ticks = 0;
+static uint64_t drift_reference_ms = 0;
+
+static bool first_sync = false;
+
+static void print_address(CHAR* preable, ULONG ipv4)
+{
+    printf("\t%s: %d.%d.%d.%d\r\n",
+        preable,
+        (uint8_t)(ipv4 >> 24),
+        (uint8_t)(ipv4 >> 16 & 0xFF),
+        (uint8_t)(ipv4 >> 8 & 0xFF),
+        (uint8_t)(ipv4 & 0xFF));
+}
+
+static uint64_t ticks_to_ms(ULONG ticks)
+{
+    return (uint64_t)ticks * 1000 / TX_TIMER_TICKS_PER_SECOND;
+}
 
-static void print_address(CHAR* preable, NXD_ADDRESS address)
+// Unix time in milliseconds at ticks, which must not be before the clock's base
+static uint64_t clock_at(const SNTP_CLOCK* clock, ULONG ticks, LONG* slewed_ms)
 {
-    if (address.nxd_ip_version == NX_IP_VERSION_V4)
+    uint64_t elapsed_ms = ticks_to_ms(ticks - clock->base_ticks);
+    int64_t slew_max_ms = (int64_t)(elapsed_ms * SNTP_CLOCK_SLEW_PPM / 1000000);
+    int64_t slew_ms     = clock->slew_ms;
+
+    if (slew_ms > slew_max_ms)
     {
-        ULONG ipv4 = address.nxd_ip_address.v4;
-
-        printf("\t%s: %d.%d.%d.%d\r\n",
-            preable,
-            (uint8_t)(ipv4 >> 24),
-            (uint8_t)(ipv4 >> 16 & 0xFF),
-            (uint8_t)(ipv4 >> 8 & 0xFF),
-            (uint8_t)(ipv4 & 0xFF));
+        slew_ms = slew_max_ms;
     }
-    else
+    else if (slew_ms < -slew_max_ms)
+    {
+        slew_ms = -slew_max_ms;
+    }
+
+    if (slewed_ms != NX_NULL)
     {
-        printf("\tUnsupported address format\r\n");
+        *slewed_ms = (LONG)slew_ms;
     }
+
+    return clock->base_ms + elapsed_ms + (int64_t)elapsed_ms * clock->drift_ppb / 1000000000 + slew_ms;
+}
+
+static VOID clock_read(SNTP_CLOCK* clock)
+{
+    ULONG sequence;
+
+    do
+    {
+        sequence = sntp_clock_sequence;
+        *clock   = sntp_clocks[sequence & 1];
+    } while (sequence != sntp_clock_sequence);
 }
 
-static VOID time_update_callback(NX_SNTP_TIME_MESSAGE* time_update_ptr, NX_SNTP_TIME* local_time)
+static VOID clock_publish(const SNTP_CLOCK* clock)
 {
-    // Set the update flag so we pick up the new time in the SNTP thread
-    tx_event_flags_set(&sntp_flags, SNTP_UPDATE_EVENT, TX_OR);
+    ULONG sequence = sntp_clock_sequence + 1;
+
+    sntp_clocks[sequence & 1] = *clock;
+    sntp_clock_sequence       = sequence;
 }
 
-static void set_sntp_time()
+// Move the base up to ticks, keeping whatever of the slew has not been applied yet
+static VOID clock_rebase(SNTP_CLOCK* clock, ULONG ticks)
 {
-    ULONG seconds;
-    ULONG milliseconds;
-    ULONG previous_time;
-    UINT status;
-    CHAR time_buffer[64];
+    LONG slewed_ms;
 
-    status = nx_sntp_client_get_local_time(&sntp_client, &seconds, &milliseconds, NX_NULL);
-    if (status != NX_SUCCESS)
+    clock->base_ms    = clock_at(clock, ticks, &slewed_ms);
+    clock->base_ticks = ticks;
+    clock->slew_ms -= slewed_ms;
+}
+
+// Learn the local tick rate error from the server time elapsed over a long enough interval
+static VOID clock_drift_update(SNTP_CLOCK* clock, uint64_t server_ms, ULONG ticks)
+{
+    ULONG interval_ticks = ticks - drift_reference_ticks;
+    int64_t local_ms;
+    int64_t error_ppb;
+
+    if (first_sync && interval_ticks < SNTP_CLOCK_DRIFT_MIN_TICKS)
     {
-        printf("FAIL: Internal error with getting local time (0x%04x)\n", status);
         return;
     }
 
-    // calculate the time correction for printout
-    previous_time = sntp_time_get();
+    if (first_sync)
+    {
+        local_ms  = (int64_t)ticks_to_ms(interval_ticks);
+        error_ppb = ((int64_t)(server_ms - drift_reference_ms) - local_ms) * 1000000000 / local_ms;
 
-    tx_mutex_get(&time_mutex, TX_WAIT_FOREVER);
+        if (error_ppb >= -SNTP_CLOCK_DRIFT_MAX_PPB && error_ppb <= SNTP_CLOCK_DRIFT_MAX_PPB)
+        {
+            // The first measurement is taken as is, later ones are smoothed to ride out network jitter
+            if (clock->drift_ppb == 0)
+            {
+                clock->drift_ppb = (LONG)error_ppb;
+            }
+            else
+            {
+                clock->drift_ppb += (LONG)((error_ppb - clock->drift_ppb) / SNTP_CLOCK_DRIFT_WEIGHT);
+            }
+        }
+    }
 
-    // Stash the Unix and ThreadX times
-    sntp_last_time = seconds - UNIX_TO_NTP_EPOCH_SECS;
-    tx_last_ticks  = tx_time_get();
+    drift_reference_ticks = ticks;
+    drift_reference_ms    = server_ms;
+}
 
-    tx_mutex_put(&time_mutex);
+static VOID clock_rebase_check()
+{
+    SNTP_CLOCK clock;
+    ULONG ticks = tx_time_get();
 
-    nx_sntp_client_utility_display_date_time(&sntp_client, time_buffer, sizeof(time_buffer));
+    clock_read(&clock);
 
-    if (first_sync == false)
+    if (ticks - clock.base_ticks >= SNTP_CLOCK_REBASE_TICKS)
     {
-        printf("\tSNTP time update: %s\r\n", time_buffer);
-        printf("SUCCESS: SNTP initialized\r\n\r\n");
-        first_sync = true;
+        clock_rebase(&clock, ticks);
+        clock_publish(&clock);
+    }
+}
+
+// Steer the clock towards a server sample taken at ticks
+static VOID clock_sample(uint64_t server_ms, ULONG ticks, int64_t* offset_ms)
+{
+    SNTP_CLOCK clock;
+
+    clock_read(&clock);
+
+    // The periodic rebase may have happened between the callback and now
+    if ((LONG)(ticks - clock.base_ticks) < 0)
+    {
+        ticks = clock.base_ticks;
+    }
+
+    clock_drift_update(&clock, server_ms, ticks);
+
+    clock_rebase(&clock, ticks);
+    *offset_ms = (int64_t)(server_ms - clock.base_ms);
+
+    if (!first_sync || *offset_ms <= -SNTP_CLOCK_STEP_MS || *offset_ms >= SNTP_CLOCK_STEP_MS)
+    {
+        clock.base_ms = server_ms;
+        clock.slew_ms = 0;
     }
     else
     {
-        printf("SNTP time update: %s\r\n", time_buffer);
-        printf("\tdrift correction: %ld seconds\r\n", sntp_time_get() - previous_time);
+        // Replaces what was left of the previous correction, the offset already accounts for it
+        clock.slew_ms = (LONG)*offset_ms;
     }
 
-    // Flag the sync was successful
-    tx_event_flags_set(&sntp_flags, SNTP_NEW_TIME, TX_OR);
+    clock_publish(&clock);
+}
+
+static ULONG read_ulong(const UCHAR* data)
+{
+    return (ULONG)data[0] << 24 | (ULONG)data[1] << 16 | (ULONG)data[2] << 8 | data[3];
 }
 
-static UINT sntp_client_run()
+static VOID write_ulong(UCHAR* data, ULONG value)
 {
+    data[0] = (UCHAR)(value >> 24);
+    data[1] = (UCHAR)(value >> 16);
+    data[2] = (UCHAR)(value >> 8);
+    data[3] = (UCHAR)value;
+}
+
+// NTP timestamps count from 1900 and wrap in 2036, after which the seconds restart below the Unix epoch
+static uint64_t ntp_to_unix_ms(const UCHAR* timestamp)
+{
+    ULONG seconds  = read_ulong(timestamp);
+    ULONG fraction = read_ulong(timestamp + 4);
+    uint64_t unix_seconds;
+
+    if (seconds >= UNIX_TO_NTP_EPOCH_SECS)
+    {
+        unix_seconds = seconds - UNIX_TO_NTP_EPOCH_SECS;
+    }
+    else
+    {
+        unix_seconds = (uint64_t)seconds + 0x100000000ULL - UNIX_TO_NTP_EPOCH_SECS;
+    }
+
+    return unix_seconds * 1000 + (((uint64_t)fraction * 1000) >> 32);
+}
+
+// Root delay and dispersion are seconds in 16.16 fixed point
+static LONG ntp_short_to_ms(const UCHAR* value)
+{
+    return (LONG)(((uint64_t)read_ulong(value) * 1000) >> 16);
+}
+
+static VOID time_format(uint64_t unix_ms, CHAR* buffer, UINT buffer_size)
+{
+    ULONG seconds = (ULONG)(unix_ms / 1000);
+    LONG days     = (LONG)(seconds / 86400);
+    LONG era;
+    ULONG day_of_era;
+    ULONG year_of_era;
+    ULONG day_of_year;
+    ULONG month_index;
+    LONG year;
+
+    // Civil date from days since the epoch, counting years from March so the leap day comes last
+    days        = days + 719468;
+    era         = days / 146097;
+    day_of_era  = (ULONG)(days - era * 146097);
+    year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    month_index = (5 * day_of_year + 2) / 153;
+    year        = (LONG)year_of_era + era * 400 + (month_index >= 10 ? 1 : 0);
+
+    snprintf(buffer,
+        buffer_size,
+        "%04ld-%02lu-%02luT%02lu:%02lu:%02lu.%03luZ",
+        year,
+        month_index < 10 ? month_index + 3 : month_index - 9,
+        day_of_year - (153 * month_index + 2) / 5 + 1,
+        seconds / 3600 % 24,
+        seconds / 60 % 60,
+        seconds % 60,
+        (ULONG)(unix_ms % 1000));
+}
+
+static VOID socket_receive_notify(NX_UDP_SOCKET* socket_ptr)
+{
+    // The socket is the first member, and the receive time wants taking before the SNTP thread gets to run
+    SNTP_QUERY* query = (SNTP_QUERY*)socket_ptr;
+
+    query->receive_ticks = tx_time_get();
+
+    tx_event_flags_set(&sntp_flags, SNTP_REPLY_EVENT(query - sntp_queries), TX_OR);
+}
+
+static UINT query_send(SNTP_QUERY* query)
+{
+    NX_PACKET* packet_ptr;
+    UCHAR request[NTP_PACKET_SIZE] = {0};
     UINT status;
-    NXD_ADDRESS sntp_address;
 
-    printf("\tSNTP server %s\r\n", SNTP_SERVER[sntp_server_count]);
+    // No leap indicator, client mode, everything else is optional for SNTP
+    request[0] = NTP_VERSION << 3 | NTP_MODE_CLIENT;
+
+    query->nonce[0] = (ULONG)NX_RAND();
+    query->nonce[1] = (ULONG)NX_RAND();
+    write_ulong(&request[40], query->nonce[0]);
+    write_ulong(&request[44], query->nonce[1]);
+
+    // Boards that keep a single pool have no services pool to take the request from. The servers are IPv4, so leave
+    // room for IPv4 headers only and the Ethernet frame starts aligned
+    status = packet_pool_allocate(PACKET_POOL_SERVICES, sizeof(request), NX_IPv4_UDP_PACKET, &packet_ptr, NX_NO_WAIT);
+    if (status == NX_INVALID_PARAMETERS)
+    {
+        status = nx_packet_allocate(nx_ip.nx_ip_default_packet_pool, &packet_ptr, NX_IPv4_UDP_PACKET, NX_NO_WAIT);
+    }
 
-    status = nxd_dns_host_by_name_get(&nx_dns_client,
-        (UCHAR*)SNTP_SERVER[sntp_server_count],
-        &sntp_address,
-        5 * NX_IP_PERIODIC_RATE,
-        NX_IP_VERSION_V4);
     if (status != NX_SUCCESS)
     {
-        printf("\tFAIL: Unable to resolve DNS for SNTP Server %s (0x%04x)\r\n", SNTP_SERVER[sntp_server_count], status);
         return status;
     }
 
-    // rotate to the next sntp dns service
-    sntp_server_count = (sntp_server_count + 1) % (sizeof(SNTP_SERVER) / sizeof(&SNTP_SERVER));
-
-    print_address("SNTP IP address", sntp_address);
-    status = nxd_sntp_client_initialize_unicast(&sntp_client, &sntp_address);
-    if (status != NX_SUCCESS)
+    if ((status = nx_packet_data_append(
+             packet_ptr, request, sizeof(request), packet_ptr->nx_packet_pool_owner, NX_NO_WAIT)))
     {
-        printf("\tFAIL: Unable to initialize unicast SNTP client (0x%04x)\r\n", status);
-        nx_sntp_client_delete(&sntp_client);
+        nx_packet_release(packet_ptr);
         return status;
     }
 
-    // Run Unicast client
-    status = nx_sntp_client_run_unicast(&sntp_client);
-    if (status != NX_SUCCESS)
+    query->send_ticks = tx_time_get();
+
+    if ((status = nx_udp_socket_send(&query->socket, packet_ptr, query->server_address, NTP_PORT)))
     {
-        printf("\tFAIL: Unable to start unicast SNTP client (0x%04x)\r\n", status);
-        nx_sntp_client_stop(&sntp_client);
+        nx_packet_release(packet_ptr);
         return status;
     }
 
     return NX_SUCCESS;
 }
 
-static void sntp_thread_entry(ULONG info)
+static bool reply_parse(SNTP_QUERY* query, const UCHAR* reply, ULONG length, SNTP_SAMPLE* sample)
 {
-    UINT status;
-    UINT server_status;
-    ULONG events = 0;
-
-    printf("Initializing SNTP client\r\n");
-
-    status = tx_mutex_create(&time_mutex, "time mutex", TX_NO_INHERIT);
-    if (status != TX_SUCCESS)
+    SNTP_CLOCK clock;
+    uint64_t originate_ms;
+    uint64_t receive_ms;
+    uint64_t transmit_ms;
+    uint64_t destination_ms;
+    int64_t delay_ms;
+
+    if (length < NTP_PACKET_SIZE || (reply[0] & 0x7) != NTP_MODE_SERVER || (reply[0] >> 6) == NTP_LEAP_ALARM ||
+        reply[1] == 0 || reply[1] > SNTP_STRATUM_MAX || read_ulong(&reply[24]) != query->nonce[0] ||
+        read_ulong(&reply[28]) != query->nonce[1] || read_ulong(&reply[40]) == 0)
     {
-        printf("FAIL: Unable to create SNTP time mutex (0x%04x)\r\n", status);
-        return;
+        return false;
     }
 
-    status = nx_sntp_client_create(&sntp_client, &nx_ip, 0, nx_ip.nx_ip_default_packet_pool, NX_NULL, NX_NULL, NULL);
-    if (status != NX_SUCCESS)
+    // Both ends of the exchange in local time, the clock only changes on this thread
+    clock_read(&clock);
+    originate_ms   = clock_at(&clock, query->send_ticks, NX_NULL);
+    destination_ms = clock_at(&clock, query->receive_ticks, NX_NULL);
+
+    receive_ms  = ntp_to_unix_ms(&reply[32]);
+    transmit_ms = ntp_to_unix_ms(&reply[40]);
+
+    delay_ms = (int64_t)(destination_ms - originate_ms) - (int64_t)(transmit_ms - receive_ms);
+    if (delay_ms < 0)
     {
-        printf("\tFAIL: SNTP client create failed (0x%04x)\r\n", status);
-        return;
+        // The tick is coarser than a fast server's turnaround
+        delay_ms = 0;
     }
 
-    status = nx_sntp_client_set_local_time(&sntp_client, 0, 0);
-    if (status != NX_SUCCESS)
+    sample->query     = query;
+    sample->stratum   = reply[1];
+    sample->ticks     = query->receive_ticks;
+    sample->offset_ms = ((int64_t)(receive_ms - originate_ms) + (int64_t)(transmit_ms - destination_ms)) / 2;
+    sample->delay_ms  = (LONG)delay_ms;
+
+    // Half the round trips to the reference plus how far its error may have spread
+    sample->distance_ms = ntp_short_to_ms(&reply[4]) / 2 + ntp_short_to_ms(&reply[8]) + sample->delay_ms / 2;
+
+    return true;
+}
+
+// The sample closest to the reference wins, the lower stratum when they are as close
+static bool sample_better(const SNTP_SAMPLE* sample, const SNTP_SAMPLE* best)
+{
+    if (best->query == NX_NULL || sample->distance_ms < best->distance_ms)
     {
-        printf("\tFAIL: Unable to set local time for SNTP client (0x%04x)\r\n", status);
-        nx_sntp_client_delete(&sntp_client);
-        return;
+        return true;
     }
 
-    // Setup time update callback function
-    status = nx_sntp_client_set_time_update_notify(&sntp_client, time_update_callback);
-    if (status != NX_SUCCESS)
+    return sample->distance_ms == best->distance_ms && sample->stratum < best->stratum;
+}
+
+static VOID query_receive(SNTP_QUERY* query, SNTP_SAMPLE* best)
+{
+    NX_PACKET* packet_ptr;
+    UCHAR reply[NTP_PACKET_SIZE];
+    SNTP_SAMPLE sample;
+    ULONG source_address;
+    UINT source_port;
+    ULONG length;
+
+    while (nx_udp_socket_receive(&query->socket, &packet_ptr, NX_NO_WAIT) == NX_SUCCESS)
     {
-        printf("\tFAIL: Unable to set time update notify CB (0x%04x)\r\n", status);
-        nx_sntp_client_delete(&sntp_client);
-        return;
+        if (nx_udp_source_extract(packet_ptr, &source_address, &source_port) == NX_SUCCESS &&
+            source_address == query->server_address && source_port == NTP_PORT &&
+            packet_ptr->nx_packet_length <= sizeof(reply) &&
+            nx_packet_data_retrieve(packet_ptr, reply, &length) == NX_SUCCESS &&
+            reply_parse(query, reply, length, &sample))
+        {
+            sntp_stats.answers++;
+
+            if (sample_better(&sample, best))
+            {
+                *best = sample;
+            }
+        }
+
+        nx_packet_release(packet_ptr);
     }
+}
 
-    sntp_client_run();
+// Resolve the next few servers in the list and ask each as soon as it resolves, the caller unbinds the sockets
+static ULONG queries_start(VOID)
+{
+    SNTP_QUERY* query;
+    ULONG resolve_deadline = tx_time_get() + SNTP_RESOLVE_TIMEOUT_TICKS;
+    ULONG server_address;
+    ULONG wait_ticks;
+    ULONG pending = 0;
+    UINT status;
+    UINT i;
+    UINT j;
 
-    while (true)
+    for (i = 0; i < SNTP_QUERY_MAX; i++)
     {
-        // Wait for an incoming SNTP message
-        tx_event_flags_get(&sntp_flags, SNTP_UPDATE_EVENT | SNTP_STOP_EVENT, TX_OR_CLEAR, &events, 5 * NX_IP_PERIODIC_RATE);
+        const CHAR* server = SNTP_SERVER[(sntp_server_count + i) % (sizeof(SNTP_SERVER) / sizeof(SNTP_SERVER[0]))];
+
+        query                 = &sntp_queries[i];
+        query->server_address = 0;
+
+        // Names already cached still resolve once the time is used up
+        wait_ticks = (LONG)(resolve_deadline - tx_time_get()) > 0 ? resolve_deadline - tx_time_get() : 0;
 
-        status = nx_sntp_client_receiving_updates(&sntp_client, &server_status);
+        status = dns_resolver_host_by_name_get(server, &server_address, wait_ticks);
         if (status != NX_SUCCESS)
         {
-            printf("FAIL: SNTP receiving updates call failed (0x%04x)\r\n", status);
+            printf("\tFAIL: Unable to resolve DNS for SNTP Server %s (0x%04x)\r\n", server, status);
             continue;
         }
 
-        if (server_status == NX_FALSE)
+        // Pool names can hand out the same server
+        for (j = 0; j < i && sntp_queries[j].server_address != server_address; j++)
+        {
+        }
+
+        if (j < i)
         {
-            // Failed to read from server, restart the client
-            printf("SNTP server timeout, restarting client\r\n");
-            nx_sntp_client_stop(&sntp_client);
-            sntp_client_run();
             continue;
         }
 
-        if (events & SNTP_UPDATE_EVENT)
+        query->server_address = server_address;
+
+        if ((status = nx_udp_socket_bind(&query->socket, NX_ANY_PORT, NX_NO_WAIT)) || (status = query_send(query)))
         {
-            // New time, update our local time
-            set_sntp_time();
-            events = 0;
+            printf("\tFAIL: Unable to query SNTP Server %s (0x%04x)\r\n", server, status);
+            continue;
+        }
+
+        pending |= SNTP_REPLY_EVENT(i);
+    }
+
+    // Start the next round one server further along so every server gets asked
+    sntp_server_count = (sntp_server_count + 1) % (sizeof(SNTP_SERVER) / sizeof(SNTP_SERVER[0]));
+
+    return pending;
+}
+
+// Ask several servers at once and keep the best sample that arrives shortly after the first one
+static UINT sntp_query(SNTP_SAMPLE* best, bool* stopped)
+{
+    ULONG deadline;
+    ULONG pending;
+    ULONG events;
+    ULONG now;
+    UINT i;
+
+    best->query = NX_NULL;
+    *stopped    = false;
+
+    tx_event_flags_get(&sntp_flags, SNTP_REPLY_EVENTS, TX_OR_CLEAR, &events, TX_NO_WAIT);
+
+    pending = queries_start();
+
+    // Name resolution doesn't eat into the time the servers get, the replies queue on their sockets meanwhile
+    deadline = tx_time_get() + SNTP_QUERY_TIMEOUT_TICKS;
+
+    while (pending != 0 && (LONG)(deadline - (now = tx_time_get())) > 0)
+    {
+        if (tx_event_flags_get(&sntp_flags, pending | SNTP_STOP_EVENT, TX_OR_CLEAR, &events, deadline - now) !=
+            TX_SUCCESS)
+        {
+            break;
         }
 
         if (events & SNTP_STOP_EVENT)
         {
-            // Time to finish
+            *stopped = true;
+            break;
+        }
+
+        for (i = 0; i < SNTP_QUERY_MAX; i++)
+        {
+            if (events & SNTP_REPLY_EVENT(i))
+            {
+                query_receive(&sntp_queries[i], best);
+            }
+        }
+
+        // Don't hold up boot waiting for stragglers
+        if (best->query != NX_NULL && (LONG)(deadline - (tx_time_get() + SNTP_COLLECT_TICKS)) > 0)
+        {
+            deadline = tx_time_get() + SNTP_COLLECT_TICKS;
+        }
+    }
+
+    for (i = 0; i < SNTP_QUERY_MAX; i++)
+    {
+        nx_udp_socket_unbind(&sntp_queries[i].socket);
+    }
+
+    return best->query != NX_NULL ? NX_SUCCESS : NX_NO_RESPONSE;
+}
+
+static VOID sntp_sample_apply(const SNTP_SAMPLE* sample)
+{
+    SNTP_CLOCK clock;
+    SNTP_CLOCK before;
+    int64_t offset_ms;
+    int64_t difference_ms;
+    CHAR time_buffer[32];
+
+    clock_read(&before);
+
+    clock_sample(clock_at(&before, sample->ticks, NX_NULL) + sample->offset_ms, sample->ticks, &offset_ms);
+
+    // Jitter follows how much successive offsets disagree, steps say nothing about it
+    if (first_sync && offset_ms > -SNTP_CLOCK_STEP_MS && offset_ms < SNTP_CLOCK_STEP_MS)
+    {
+        difference_ms = offset_ms - sntp_stats.offset_ms;
+        if (difference_ms < 0)
+        {
+            difference_ms = -difference_ms;
+        }
+
+        if (difference_ms < SNTP_CLOCK_STEP_MS)
+        {
+            sntp_stats.jitter_ms += ((LONG)difference_ms - sntp_stats.jitter_ms) / SNTP_JITTER_WEIGHT;
+        }
+    }
+
+    sntp_stats.syncs++;
+    sntp_stats.offset_ms      = offset_ms;
+    sntp_stats.delay_ms       = sample->delay_ms;
+    sntp_stats.stratum        = sample->stratum;
+    sntp_stats.server_address = sample->query->server_address;
+
+    time_format(sntp_time_ms_get(), time_buffer, sizeof(time_buffer));
+
+    if (first_sync == false)
+    {
+        printf("\tSNTP time update: %s\r\n", time_buffer);
+        print_address("SNTP IP address", sample->query->server_address);
+        printf("SUCCESS: SNTP initialized\r\n\r\n");
+        first_sync = true;
+    }
+    else
+    {
+        clock_read(&clock);
+
+        printf("SNTP time update: %s\r\n", time_buffer);
+        print_address("SNTP IP address", sample->query->server_address);
+        printf("\tstratum %u, delay %ld ms, jitter %ld ms\r\n",
+            sample->stratum,
+            sample->delay_ms,
+            sntp_stats.jitter_ms);
+
+        if (clock.slew_ms == 0 && offset_ms != 0)
+        {
+            printf("\tclock stepped: %ld seconds\r\n", (LONG)(offset_ms / 1000));
+        }
+        else
+        {
+            printf("\tclock slewing: %ld ms\r\n", clock.slew_ms);
+        }
+
+        printf("\tlocal clock drift: %ld ppb\r\n", clock.drift_ppb);
+    }
+
+    // Flag the sync was successful
+    tx_event_flags_set(&sntp_flags, SNTP_NEW_TIME, TX_OR);
+}
+
+static void sntp_thread_entry(ULONG info)
+{
+    SNTP_SAMPLE sample;
+    ULONG retry_ticks = SNTP_RETRY_MIN_TICKS;
+    ULONG wait_ticks;
+    ULONG events;
+    bool stopped = false;
+    UINT status;
+    UINT i;
+
+    printf("Initializing SNTP client\r\n");
+
+    for (i = 0; i < SNTP_QUERY_MAX; i++)
+    {
+        if ((status = nx_udp_socket_create(&nx_ip,
+                 &sntp_queries[i].socket,
+                 "SNTP client",
+                 NX_IP_NORMAL,
+                 NX_FRAGMENT_OKAY,
+                 NX_IP_TIME_TO_LIVE,
+                 2)) ||
+            (status = nx_udp_socket_receive_notify(&sntp_queries[i].socket, socket_receive_notify)))
+        {
+            printf("\tFAIL: SNTP client create failed (0x%04x)\r\n", status);
+            return;
+        }
+    }
+
+    while (!stopped)
+    {
+        status = sntp_query(&sample, &stopped);
+        if (stopped)
+        {
             break;
         }
+
+        if (status == NX_SUCCESS)
+        {
+            sntp_sample_apply(&sample);
+            wait_ticks  = SNTP_POLL_TICKS;
+            retry_ticks = SNTP_RETRY_MIN_TICKS;
+        }
+        else
+        {
+            // Back off while no server answers, without ever waiting longer than a normal poll
+            printf("SNTP servers did not answer, retrying\r\n");
+            sntp_stats.failures++;
+            wait_ticks  = retry_ticks;
+            retry_ticks = retry_ticks * 2 < SNTP_POLL_TICKS ? retry_ticks * 2 : SNTP_POLL_TICKS;
+        }
+
+        clock_rebase_check();
+
+        stopped = tx_event_flags_get(&sntp_flags, SNTP_STOP_EVENT, TX_OR_CLEAR, &events, wait_ticks) == TX_SUCCESS;
     }
 
-    nx_sntp_client_stop(&sntp_client);
-    nx_sntp_client_delete(&sntp_client);
-    tx_mutex_delete(&time_mutex);
+    for (i = 0; i < SNTP_QUERY_MAX; i++)
+    {
+        nx_udp_socket_delete(&sntp_queries[i].socket);
+    }
 
     tx_event_flags_set(&sntp_flags, SNTP_STOPPED_EVENT, TX_OR);
 
     return;
 }
 
-ULONG sntp_time_get()
+uint64_t sntp_time_ms_get()
 {
-    tx_mutex_get(&time_mutex, TX_WAIT_FOREVER);
+    SNTP_CLOCK clock;
 
-    // Calculate how many seconds have elapsed since the last sync
-    ULONG tx_time_delta = (tx_time_get() - tx_last_ticks) / TX_TIMER_TICKS_PER_SECOND;
+    clock_read(&clock);
 
-    // Add this to the last sync time to get the current time
-    ULONG sntp_time = sntp_last_time + tx_time_delta;
-
-    tx_mutex_put(&time_mutex);
+    // Read the tick after the clock, a clock published later can't have a base ahead of it
+    return clock_at(&clock, tx_time_get(), NX_NULL);
+}
 
-    return sntp_time;
+ULONG sntp_time_get()
+{
+    return (ULONG)(sntp_time_ms_get() / 1000);
 }
 
 UINT sntp_time(ULONG* unix_time)
@@ -259,6 +761,11 @@ UINT sntp_time(ULONG* unix_time)
     return NX_SUCCESS;
 }
 
+VOID sntp_stats_get(SNTP_STATS* stats)
+{
+    *stats = sntp_stats;
+}
+
 UINT sntp_sync_wait()
 {
     ULONG events = 0;
@@ -4,11 +4,38 @@
 #ifndef _SNTP_CLIENT_H
 #define _SNTP_CLIENT_H
 
+#include <stdint.h>
+
 #include <tx_api.h>
 
+typedef struct SNTP_STATS_STRUCT
+{
+    ULONG syncs;
+    ULONG failures;
+
+    // Usable replies from every server asked, only the best of each round is applied
+    ULONG answers;
+
+    // Of the last sample applied, offset is how far the clock was off before it was corrected
+    int64_t offset_ms;
+    LONG delay_ms;
+    UINT stratum;
+    ULONG server_address;
+
+    // Smoothed difference between successive offsets
+    LONG jitter_ms;
+} SNTP_STATS;
+
+// Unix time in milliseconds, lock free and cheap enough to stamp every sample with. Counts from boot until the first
+// sync, after which small corrections are slewed in and the local tick drift is compensated.
+uint64_t sntp_time_ms_get();
+
 ULONG sntp_time_get();
 UINT sntp_time(ULONG* unix_time);
 
+// Several servers are asked at once and the sample closest to its reference wins
+VOID sntp_stats_get(SNTP_STATS* stats);
+
 UINT sntp_sync_wait();
 UINT sntp_start();
 UINT sntp_stop();
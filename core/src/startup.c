@@ -0,0 +1,230 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include "startup.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "nx_api.h"
+
+#define STARTUP_STAGE_DONE_EVENT  1
+#define STARTUP_WORKER_DONE_EVENT 2
+
+// Split so that the multiply can't overflow after a long wait for the network
+#define TICKS_TO_MS(ticks) \
+    ((ticks) / TX_TIMER_TICKS_PER_SECOND * 1000 + (ticks) % TX_TIMER_TICKS_PER_SECOND * 1000 / TX_TIMER_TICKS_PER_SECOND)
+
+typedef struct STARTUP_STRUCT
+{
+    STARTUP_STAGE* stages;
+    UINT stage_count;
+
+    ULONG started;
+    ULONG finished;
+    UINT status;
+
+    TX_MUTEX mutex;
+    TX_EVENT_FLAGS_GROUP events;
+} STARTUP;
+
+static STARTUP startup;
+static STARTUP_STATS startup_stats;
+
+static TX_THREAD startup_worker;
+static ULONG startup_worker_stack[STARTUP_WORKER_STACK_SIZE / sizeof(ULONG)];
+
+// Claim the first stage that has not started and whose dependencies have all finished
+static bool stage_claim(UINT* index)
+{
+    UINT i;
+
+    for (i = 0; i < startup.stage_count; i++)
+    {
+        if ((startup.started & STARTUP_AFTER(i)) == 0 && (startup.stages[i].depends & ~startup.finished) == 0)
+        {
+            startup.started |= STARTUP_AFTER(i);
+            *index = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static VOID stage_run(STARTUP_STAGE* stage)
+{
+    stage->start_time = tx_time_get();
+    stage->status     = stage->entry(stage->context);
+    stage->end_time   = tx_time_get();
+
+    if (stage->status != NX_SUCCESS)
+    {
+        printf("ERROR: startup stage %s failed (0x%08x)\r\n", stage->name, stage->status);
+    }
+}
+
+// Both the calling thread and the worker run this until every stage has been claimed or one of them failed
+static VOID stages_process(VOID)
+{
+    UINT index;
+    ULONG events;
+    bool claimed;
+
+    while (true)
+    {
+        tx_mutex_get(&startup.mutex, TX_WAIT_FOREVER);
+
+        if (startup.status != NX_SUCCESS || startup.started == STARTUP_AFTER(startup.stage_count) - 1)
+        {
+            tx_mutex_put(&startup.mutex);
+            return;
+        }
+
+        claimed = stage_claim(&index);
+
+        tx_mutex_put(&startup.mutex);
+
+        if (!claimed)
+        {
+            // A stage finishing while we looked leaves the flag set, so this can't miss the wake up
+            tx_event_flags_get(&startup.events, STARTUP_STAGE_DONE_EVENT, TX_OR_CLEAR, &events, TX_WAIT_FOREVER);
+            continue;
+        }
+
+        stage_run(&startup.stages[index]);
+
+        tx_mutex_get(&startup.mutex, TX_WAIT_FOREVER);
+
+        startup.finished |= STARTUP_AFTER(index);
+        if (startup.status == NX_SUCCESS)
+        {
+            startup.status = startup.stages[index].status;
+        }
+
+        tx_mutex_put(&startup.mutex);
+
+        tx_event_flags_set(&startup.events, STARTUP_STAGE_DONE_EVENT, TX_OR);
+    }
+}
+
+static VOID startup_worker_entry(ULONG parameter)
+{
+    stages_process();
+
+    // The calling thread may be waiting for a stage that will now never be claimed
+    tx_event_flags_set(&startup.events, STARTUP_STAGE_DONE_EVENT | STARTUP_WORKER_DONE_EVENT, TX_OR);
+}
+
+static VOID stages_print(VOID)
+{
+    UINT i;
+
+    printf("Startup stages\r\n");
+
+    for (i = 0; i < startup.stage_count; i++)
+    {
+        if (startup.finished & STARTUP_AFTER(i))
+        {
+            printf("\t%s: %lu - %lu ms\r\n",
+                startup.stages[i].name,
+                TICKS_TO_MS(startup.stages[i].start_time),
+                TICKS_TO_MS(startup.stages[i].end_time));
+        }
+    }
+
+    printf("\tTotal: %lu ms\r\n\r\n", TICKS_TO_MS(startup_stats.startup_ticks));
+}
+
+UINT startup_run(STARTUP_STAGE* stages, UINT stage_count)
+{
+    ULONG events;
+    UINT status;
+    UINT i;
+
+    if (stages == NX_NULL || stage_count == 0 || stage_count > STARTUP_STAGE_MAX)
+    {
+        return NX_INVALID_PARAMETERS;
+    }
+
+    // Only depending on earlier stages rules out a cycle that would stall both threads
+    for (i = 0; i < stage_count; i++)
+    {
+        if (stages[i].entry == NX_NULL || (stages[i].depends & ~(STARTUP_AFTER(i) - 1)) != 0)
+        {
+            printf("ERROR: startup stage %d is invalid\r\n", i);
+            return NX_INVALID_PARAMETERS;
+        }
+    }
+
+    startup.stages      = stages;
+    startup.stage_count = stage_count;
+    startup.started     = 0;
+    startup.finished    = 0;
+    startup.status      = NX_SUCCESS;
+
+    if ((status = tx_mutex_create(&startup.mutex, "startup", TX_NO_INHERIT)))
+    {
+        printf("ERROR: failed to create startup mutex (0x%08x)\r\n", status);
+        return status;
+    }
+
+    if ((status = tx_event_flags_create(&startup.events, "startup")))
+    {
+        printf("ERROR: failed to create startup event flags (0x%08x)\r\n", status);
+        tx_mutex_delete(&startup.mutex);
+        return status;
+    }
+
+    // The worker shares the priority of the calling thread so neither starves the other
+    if ((status = tx_thread_create(&startup_worker,
+             "startup worker",
+             startup_worker_entry,
+             0,
+             startup_worker_stack,
+             STARTUP_WORKER_STACK_SIZE,
+             tx_thread_identify()->tx_thread_priority,
+             tx_thread_identify()->tx_thread_priority,
+             TX_NO_TIME_SLICE,
+             TX_AUTO_START)))
+    {
+        printf("ERROR: failed to create startup worker (0x%08x)\r\n", status);
+        tx_event_flags_delete(&startup.events);
+        tx_mutex_delete(&startup.mutex);
+        return status;
+    }
+
+    stages_process();
+
+    // Wait for the stage the worker may still be running
+    tx_event_flags_get(&startup.events, STARTUP_WORKER_DONE_EVENT, TX_OR_CLEAR, &events, TX_WAIT_FOREVER);
+
+    tx_thread_terminate(&startup_worker);
+    tx_thread_delete(&startup_worker);
+    tx_event_flags_delete(&startup.events);
+    tx_mutex_delete(&startup.mutex);
+
+    startup_stats.startup_ticks = tx_time_get();
+
+    stages_print();
+
+    return startup.status;
+}
+
+VOID startup_telemetry_sent(VOID)
+{
+    if (startup_stats.first_telemetry_ticks != 0)
+    {
+        return;
+    }
+
+    // ThreadX starts counting ticks at boot
+    startup_stats.first_telemetry_ticks = tx_time_get();
+
+    printf("Time to first telemetry: %lu ms\r\n", TICKS_TO_MS(startup_stats.first_telemetry_ticks));
+}
+
+VOID startup_stats_get(STARTUP_STATS* stats)
+{
+    *stats = startup_stats;
+}
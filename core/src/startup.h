@@ -0,0 +1,51 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _STARTUP_H
+#define _STARTUP_H
+
+#include "tx_api.h"
+
+#define STARTUP_STAGE_MAX 8
+
+// Stack of the extra thread that runs a stage while the calling thread runs another one
+#ifndef STARTUP_WORKER_STACK_SIZE
+#define STARTUP_WORKER_STACK_SIZE 4096
+#endif
+
+// Mask of the stages, by index in the table, that have to finish before a stage may start
+#define STARTUP_AFTER(index) (1UL << (index))
+
+typedef UINT (*func_ptr_startup_stage)(VOID* context);
+
+typedef struct STARTUP_STAGE_STRUCT
+{
+    const CHAR* name;
+    func_ptr_startup_stage entry;
+    VOID* context;
+    ULONG depends;
+
+    // Filled in by startup_run
+    UINT status;
+    ULONG start_time;
+    ULONG end_time;
+} STARTUP_STAGE;
+
+typedef struct STARTUP_STATS_STRUCT
+{
+    ULONG startup_ticks;
+    ULONG first_telemetry_ticks;
+} STARTUP_STATS;
+
+// Run the stages, each as soon as the ones it depends on have finished, two at a time. Stages may only depend on
+// stages earlier in the table. Returns once all of them have finished, or the status of the first one that failed
+// after the stages already running have finished.
+UINT startup_run(STARTUP_STAGE* stages, UINT stage_count);
+
+// Call when telemetry has been handed to the hub, only the first call after boot is recorded
+VOID startup_telemetry_sent(VOID);
+
+// Ticks since boot taken by startup_run and to the first telemetry, zero until they happened
+VOID startup_stats_get(STARTUP_STATS* stats);
+
+#endif // _STARTUP_H
@@ -0,0 +1,373 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include "flash_segment_log.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "nx_api.h"
+
+#define FLASH_LOG_MAGIC  0x474F4C53 // "SLOG"
+#define FLASH_LOG_ERASED 0xFFFFFFFF
+
+#define FLASH_LOG_ALIGN(length) (((length) + FLASH_DRIVER_WRITE_ALIGN - 1) & ~(FLASH_DRIVER_WRITE_ALIGN - 1))
+#define FLASH_LOG_RECORD_SIZE(length) (sizeof(FLASH_LOG_HEADER) + FLASH_LOG_ALIGN(length))
+
+// Header is programmed after the payload so a record torn by a reset is never mistaken for a valid one. The
+// consumed words stay erased until the record has been replayed. Fixed width fields keep the layout the same whatever
+// the width of ULONG.
+typedef struct FLASH_LOG_HEADER_STRUCT
+{
+    uint32_t magic;
+    uint32_t sequence;
+    uint32_t length;
+    uint32_t length_check;
+    uint32_t consumed[2];
+} FLASH_LOG_HEADER;
+
+static ULONG region_size(FLASH_SEGMENT_LOG* log)
+{
+    return log->driver->sector_size * log->driver->sector_count;
+}
+
+static ULONG sector_start(FLASH_SEGMENT_LOG* log, ULONG offset)
+{
+    return offset - (offset % log->driver->sector_size);
+}
+
+static ULONG sector_next(FLASH_SEGMENT_LOG* log, ULONG offset)
+{
+    return (sector_start(log, offset) + log->driver->sector_size) % region_size(log);
+}
+
+static UINT header_read(FLASH_SEGMENT_LOG* log, ULONG offset, FLASH_LOG_HEADER* header)
+{
+    ULONG sector_used = offset % log->driver->sector_size;
+
+    if (sector_used + sizeof(FLASH_LOG_HEADER) > log->driver->sector_size ||
+        log->driver->read(offset, (UCHAR*)header, sizeof(FLASH_LOG_HEADER)))
+    {
+        return NX_NOT_FOUND;
+    }
+
+    if (header->magic != FLASH_LOG_MAGIC || header->length_check != ~header->length ||
+        header->length > log->driver->sector_size ||
+        sector_used + FLASH_LOG_RECORD_SIZE(header->length) > log->driver->sector_size)
+    {
+        return NX_NOT_FOUND;
+    }
+
+    return NX_SUCCESS;
+}
+
+static UINT header_consumed(FLASH_LOG_HEADER* header)
+{
+    return header->consumed[0] != FLASH_LOG_ERASED;
+}
+
+// Move the read position past consumed records and unused sector tails onto the oldest live record
+static VOID read_offset_normalize(FLASH_SEGMENT_LOG* log)
+{
+    FLASH_LOG_HEADER header;
+    ULONG sectors_skipped = 0;
+
+    log->read_offset %= region_size(log);
+
+    while (log->records > 0 && sectors_skipped <= log->driver->sector_count)
+    {
+        if (header_read(log, log->read_offset, &header) != NX_SUCCESS)
+        {
+            log->read_offset = sector_next(log, log->read_offset);
+            sectors_skipped++;
+        }
+        else if (header_consumed(&header))
+        {
+            log->read_offset = (log->read_offset + FLASH_LOG_RECORD_SIZE(header.length)) % region_size(log);
+        }
+        else
+        {
+            return;
+        }
+    }
+
+    if (log->records > 0)
+    {
+        printf("ERROR: flash log lost track of %lu records\r\n", log->records);
+        log->records = 0;
+        log->bytes   = 0;
+    }
+}
+
+// Make room for a record of size bytes, recycling the oldest sector when the current one is full
+static UINT segment_reserve(FLASH_SEGMENT_LOG* log, ULONG size, ULONG* dropped)
+{
+    FLASH_LOG_HEADER header;
+    ULONG next;
+    ULONG offset;
+    UINT status;
+
+    if (log->write_offset + size <= log->write_sector + log->driver->sector_size)
+    {
+        return NX_SUCCESS;
+    }
+
+    next = sector_next(log, log->write_sector);
+
+    // Anything still unread in the sector we are about to erase is lost
+    if (log->records > 0 && sector_start(log, log->read_offset) == next)
+    {
+        offset = log->read_offset;
+
+        while (offset < next + log->driver->sector_size && header_read(log, offset, &header) == NX_SUCCESS)
+        {
+            if (!header_consumed(&header))
+            {
+                log->records--;
+                log->bytes -= header.length;
+                (*dropped)++;
+            }
+
+            offset += FLASH_LOG_RECORD_SIZE(header.length);
+        }
+
+        log->read_offset = sector_next(log, next);
+        read_offset_normalize(log);
+    }
+
+    if ((status = log->driver->erase(next)))
+    {
+        printf("ERROR: failed to erase flash log sector 0x%08lx (0x%08x)\r\n", next, status);
+        return status;
+    }
+
+    log->write_sector = next;
+    log->write_offset = next;
+
+    return NX_SUCCESS;
+}
+
+UINT flash_segment_log_open(FLASH_SEGMENT_LOG* log, const FLASH_DRIVER* driver)
+{
+    FLASH_LOG_HEADER header;
+    uint32_t blank[FLASH_DRIVER_WRITE_ALIGN / sizeof(uint32_t)];
+    uint32_t newest_sequence = 0;
+    ULONG newest_end         = 0;
+    UINT found               = NX_FALSE;
+    ULONG sector;
+    ULONG offset;
+    ULONG index;
+    UINT status;
+
+    if (log == NX_NULL || driver == NX_NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    if (driver->sector_count < 2 || driver->sector_size % FLASH_DRIVER_WRITE_ALIGN ||
+        driver->sector_size < FLASH_LOG_RECORD_SIZE(FLASH_DRIVER_WRITE_ALIGN))
+    {
+        printf("ERROR: flash log needs at least two aligned sectors\r\n");
+        return NX_INVALID_PARAMETERS;
+    }
+
+    memset(log, 0, sizeof(FLASH_SEGMENT_LOG));
+    log->driver = driver;
+
+    // Locate the most recently written record, this is where appending resumes
+    for (sector = 0; sector < region_size(log); sector += driver->sector_size)
+    {
+        for (offset = sector;
+             offset < sector + driver->sector_size && header_read(log, offset, &header) == NX_SUCCESS;
+             offset += FLASH_LOG_RECORD_SIZE(header.length))
+        {
+            if (!found || (int32_t)(header.sequence - newest_sequence) > 0)
+            {
+                newest_sequence = header.sequence;
+                newest_end      = offset + FLASH_LOG_RECORD_SIZE(header.length);
+                found           = NX_TRUE;
+            }
+        }
+    }
+
+    if (found)
+    {
+        log->write_sector  = sector_start(log, newest_end - 1);
+        log->write_offset  = newest_end;
+        log->next_sequence = newest_sequence + 1;
+
+        // Walk the ring from the oldest sector forwards to rebuild the backlog
+        sector = log->write_sector;
+        for (index = 0; index < driver->sector_count; index++)
+        {
+            sector = sector_next(log, sector);
+
+            for (offset = sector;
+                 offset < sector + driver->sector_size && header_read(log, offset, &header) == NX_SUCCESS;
+                 offset += FLASH_LOG_RECORD_SIZE(header.length))
+            {
+                if (!header_consumed(&header))
+                {
+                    if (log->records == 0)
+                    {
+                        log->read_offset = offset;
+                    }
+
+                    log->records++;
+                    log->bytes += header.length;
+                }
+            }
+        }
+    }
+
+    // A reset in the middle of a write leaves a partially programmed record behind, never program over it
+    for (offset = log->write_offset; offset < log->write_sector + driver->sector_size; offset += sizeof(blank))
+    {
+        if ((status = driver->read(offset, (UCHAR*)blank, sizeof(blank))))
+        {
+            printf("ERROR: failed to read flash log (0x%08x)\r\n", status);
+            return status;
+        }
+
+        if (blank[0] != FLASH_LOG_ERASED || blank[1] != FLASH_LOG_ERASED)
+        {
+            log->write_offset = log->write_sector + driver->sector_size;
+            break;
+        }
+    }
+
+    printf("\tFlash log recovered %lu records (%lu bytes)\r\n", log->records, log->bytes);
+
+    return NX_SUCCESS;
+}
+
+UINT flash_segment_log_append(FLASH_SEGMENT_LOG* log, ULONG sequence, const UCHAR* payload, UINT length, ULONG* dropped)
+{
+    FLASH_LOG_HEADER header;
+    UCHAR tail[FLASH_DRIVER_WRITE_ALIGN];
+    ULONG payload_offset;
+    UINT aligned_length = length & ~(FLASH_DRIVER_WRITE_ALIGN - 1);
+    ULONG size          = FLASH_LOG_RECORD_SIZE(length);
+    UINT status         = NX_SUCCESS;
+
+    *dropped = 0;
+
+    if (size > log->driver->sector_size)
+    {
+        return NX_SIZE_ERROR;
+    }
+
+    if ((status = segment_reserve(log, size, dropped)))
+    {
+        return status;
+    }
+
+    payload_offset = log->write_offset + sizeof(FLASH_LOG_HEADER);
+
+    if (aligned_length > 0)
+    {
+        status = log->driver->write(payload_offset, payload, aligned_length);
+    }
+
+    if (status == NX_SUCCESS && aligned_length < length)
+    {
+        memset(tail, 0xFF, sizeof(tail));
+        memcpy(tail, payload + aligned_length, length - aligned_length);
+        status = log->driver->write(payload_offset + aligned_length, tail, sizeof(tail));
+    }
+
+    if (status == NX_SUCCESS)
+    {
+        header.magic        = FLASH_LOG_MAGIC;
+        header.sequence     = (uint32_t)sequence;
+        header.length       = length;
+        header.length_check = ~(uint32_t)length;
+        status = log->driver->write(log->write_offset, (UCHAR*)&header, offsetof(FLASH_LOG_HEADER, consumed));
+    }
+
+    // Whatever happened the space is spoilt
+    if (log->records == 0)
+    {
+        log->read_offset = log->write_offset;
+    }
+    log->write_offset += size;
+
+    if (status)
+    {
+        printf("ERROR: failed to write flash log (0x%08x)\r\n", status);
+        return status;
+    }
+
+    log->records++;
+    log->bytes += length;
+    log->next_sequence = sequence + 1;
+
+    return NX_SUCCESS;
+}
+
+UINT flash_segment_log_peek(FLASH_SEGMENT_LOG* log, UCHAR* buffer, UINT buffer_size, UINT* length, ULONG* sequence)
+{
+    FLASH_LOG_HEADER header;
+    UINT status;
+
+    if (log->records == 0)
+    {
+        return NX_NOT_FOUND;
+    }
+
+    if ((status = header_read(log, log->read_offset, &header)))
+    {
+        return status;
+    }
+
+    if (buffer != NX_NULL)
+    {
+        if (header.length > buffer_size)
+        {
+            return NX_SIZE_ERROR;
+        }
+
+        if ((status = log->driver->read(log->read_offset + sizeof(FLASH_LOG_HEADER), buffer, header.length)))
+        {
+            return status;
+        }
+    }
+
+    *length   = header.length;
+    *sequence = header.sequence;
+
+    return NX_SUCCESS;
+}
+
+UINT flash_segment_log_consume(FLASH_SEGMENT_LOG* log)
+{
+    FLASH_LOG_HEADER header;
+    static const uint32_t consumed[2] = {0, 0};
+    UINT status;
+
+    if (log->records == 0)
+    {
+        return NX_NOT_FOUND;
+    }
+
+    if ((status = header_read(log, log->read_offset, &header)))
+    {
+        return status;
+    }
+
+    if ((status = log->driver->write(
+             log->read_offset + offsetof(FLASH_LOG_HEADER, consumed), (const UCHAR*)consumed, sizeof(consumed))))
+    {
+        printf("ERROR: failed to mark flash log record consumed (0x%08x)\r\n", status);
+        return status;
+    }
+
+    log->records--;
+    log->bytes -= header.length;
+    log->read_offset += FLASH_LOG_RECORD_SIZE(header.length);
+    read_offset_normalize(log);
+
+    return NX_SUCCESS;
+}
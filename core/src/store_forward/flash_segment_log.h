@@ -0,0 +1,37 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _FLASH_SEGMENT_LOG_H
+#define _FLASH_SEGMENT_LOG_H
+
+#include "tx_api.h"
+
+#include "flash_driver.h"
+
+// Append only log of records spread over the sectors of a flash region, which are reused as a ring of segments.
+// Replayed records are marked consumed in place so the backlog survives a reboot.
+typedef struct FLASH_SEGMENT_LOG_STRUCT
+{
+    const FLASH_DRIVER* driver;
+
+    ULONG write_sector;
+    ULONG write_offset;
+    ULONG read_offset;
+
+    ULONG records;
+    ULONG bytes;
+    ULONG next_sequence;
+} FLASH_SEGMENT_LOG;
+
+// Scans the region to recover the backlog left by a previous boot
+UINT flash_segment_log_open(FLASH_SEGMENT_LOG* log, const FLASH_DRIVER* driver);
+
+// Unconsumed records lost when the oldest segment has to be recycled are reported through dropped
+UINT flash_segment_log_append(
+    FLASH_SEGMENT_LOG* log, ULONG sequence, const UCHAR* payload, UINT length, ULONG* dropped);
+
+// A null buffer only fetches the length and sequence number of the oldest record
+UINT flash_segment_log_peek(FLASH_SEGMENT_LOG* log, UCHAR* buffer, UINT buffer_size, UINT* length, ULONG* sequence);
+UINT flash_segment_log_consume(FLASH_SEGMENT_LOG* log);
+
+#endif // _FLASH_SEGMENT_LOG_H
@@ -0,0 +1,384 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include "store_forward.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "nx_api.h"
+
+#define RAM_RECORD_ALIGN         8
+#define RAM_RECORD_PAD           0xFFFF
+#define RAM_RECORD_ALIGN_UP(len) (((len) + RAM_RECORD_ALIGN - 1) & ~(RAM_RECORD_ALIGN - 1))
+#define RAM_RECORD_SIZE(length)  (sizeof(RAM_RECORD_HEADER) + RAM_RECORD_ALIGN_UP(length))
+#define REPLAY_THROUGHPUT_WINDOW TX_TIMER_TICKS_PER_SECOND
+
+typedef struct RAM_RECORD_HEADER_STRUCT
+{
+    uint32_t sequence;
+    uint16_t length;
+    uint16_t marker;
+} RAM_RECORD_HEADER;
+
+// The following helpers must be called with the store mutex held
+static RAM_RECORD_HEADER* ram_record(STORE_FORWARD* sf, UINT offset)
+{
+    return (RAM_RECORD_HEADER*)&sf->ram[offset];
+}
+
+static VOID ram_head_advance(STORE_FORWARD* sf, UINT size)
+{
+    sf->ram_used -= size;
+    sf->ram_head = (sf->ram_head + size) % STORE_FORWARD_RAM_SIZE;
+
+    // Skip the padding left behind when a record did not fit at the end of the ring
+    if (sf->ram_used > 0 && ram_record(sf, sf->ram_head)->marker == RAM_RECORD_PAD)
+    {
+        sf->ram_used -= STORE_FORWARD_RAM_SIZE - sf->ram_head;
+        sf->ram_head = 0;
+    }
+}
+
+static VOID ram_evict_oldest(STORE_FORWARD* sf)
+{
+    RAM_RECORD_HEADER* header = ram_record(sf, sf->ram_head);
+    ULONG flash_dropped       = 0;
+
+    if (sf->flash_log == NX_NULL)
+    {
+        sf->stats.dropped++;
+    }
+    else if (flash_segment_log_append(
+                 sf->flash_log, header->sequence, (UCHAR*)(header + 1), header->length, &flash_dropped))
+    {
+        sf->stats.dropped++;
+    }
+    else
+    {
+        sf->stats.spilled++;
+        sf->stats.dropped += flash_dropped;
+    }
+
+    sf->ram_records--;
+    sf->ram_bytes -= header->length;
+    ram_head_advance(sf, RAM_RECORD_SIZE(header->length));
+}
+
+static UINT ram_fits(STORE_FORWARD* sf, UINT size)
+{
+    if (sf->ram_used == 0)
+    {
+        sf->ram_head = 0;
+        sf->ram_tail = 0;
+        return NX_TRUE;
+    }
+
+    if (sf->ram_tail > sf->ram_head)
+    {
+        return STORE_FORWARD_RAM_SIZE - sf->ram_tail >= size;
+    }
+
+    return sf->ram_head - sf->ram_tail >= size;
+}
+
+static VOID replay_tokens_refill(STORE_FORWARD* sf)
+{
+    ULONG now     = tx_time_get();
+    ULONG elapsed = now - sf->replay_refill_time;
+    ULONG tokens  = elapsed * sf->replay_rate / TX_TIMER_TICKS_PER_SECOND;
+
+    if (sf->replay_tokens + tokens >= sf->replay_rate)
+    {
+        // Bucket is full, the burst allowance is one second worth of records
+        sf->replay_tokens      = sf->replay_rate;
+        sf->replay_refill_time = now;
+    }
+    else if (tokens > 0)
+    {
+        sf->replay_tokens += tokens;
+        sf->replay_refill_time += tokens * TX_TIMER_TICKS_PER_SECOND / sf->replay_rate;
+    }
+}
+
+UINT store_forward_create(STORE_FORWARD* sf)
+{
+    UINT status;
+
+    if (sf == NX_NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    memset(sf, 0, sizeof(STORE_FORWARD));
+
+    sf->replay_rate         = STORE_FORWARD_DEFAULT_REPLAY_RATE;
+    sf->replay_tokens       = STORE_FORWARD_DEFAULT_REPLAY_RATE;
+    sf->replay_refill_time  = tx_time_get();
+    sf->replay_window_start = sf->replay_refill_time;
+
+    if ((status = tx_mutex_create(&sf->mutex, "store forward", TX_INHERIT)))
+    {
+        printf("ERROR: failed to create store forward mutex (0x%08x)\r\n", status);
+        return status;
+    }
+
+    return NX_SUCCESS;
+}
+
+UINT store_forward_delete(STORE_FORWARD* sf)
+{
+    if (sf->ram_records > 0)
+    {
+        printf("Discarding %lu stored telemetry records\r\n", sf->ram_records);
+    }
+
+    tx_mutex_delete(&sf->mutex);
+
+    return NX_SUCCESS;
+}
+
+UINT store_forward_flash_attach(STORE_FORWARD* sf, FLASH_SEGMENT_LOG* flash_log)
+{
+    if (flash_log == NX_NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    tx_mutex_get(&sf->mutex, TX_WAIT_FOREVER);
+
+    if (sf->ram_records > 0 || sf->flash_log != NX_NULL)
+    {
+        tx_mutex_put(&sf->mutex);
+        return NX_INVALID_PARAMETERS;
+    }
+
+    // Carry on numbering from where the previous boot left off
+    sf->flash_log     = flash_log;
+    sf->next_sequence = flash_log->next_sequence;
+
+    tx_mutex_put(&sf->mutex);
+
+    return NX_SUCCESS;
+}
+
+UINT store_forward_append(STORE_FORWARD* sf, const UCHAR* payload, UINT length)
+{
+    RAM_RECORD_HEADER* header;
+    UINT size = RAM_RECORD_SIZE(length);
+
+    if (length >= RAM_RECORD_PAD || size > STORE_FORWARD_RAM_SIZE)
+    {
+        return NX_SIZE_ERROR;
+    }
+
+    tx_mutex_get(&sf->mutex, TX_WAIT_FOREVER);
+
+    while (!ram_fits(sf, size))
+    {
+        if (sf->ram_tail > sf->ram_head)
+        {
+            // Not enough room before the end of the ring, pad it out and wrap around
+            ram_record(sf, sf->ram_tail)->marker = RAM_RECORD_PAD;
+            sf->ram_used += STORE_FORWARD_RAM_SIZE - sf->ram_tail;
+            sf->ram_tail = 0;
+        }
+        else
+        {
+            ram_evict_oldest(sf);
+        }
+    }
+
+    header           = ram_record(sf, sf->ram_tail);
+    header->sequence = (uint32_t)sf->next_sequence++;
+    header->length   = (uint16_t)length;
+    header->marker   = 0;
+    memcpy(header + 1, payload, length);
+
+    sf->ram_tail = (sf->ram_tail + size) % STORE_FORWARD_RAM_SIZE;
+    sf->ram_used += size;
+    sf->ram_records++;
+    sf->ram_bytes += length;
+    sf->stats.stored++;
+
+    tx_mutex_put(&sf->mutex);
+
+    return NX_SUCCESS;
+}
+
+UINT store_forward_peek(STORE_FORWARD* sf, UCHAR* buffer, UINT buffer_size, UINT* length, ULONG* sequence)
+{
+    RAM_RECORD_HEADER* header;
+    UINT status = NX_NOT_FOUND;
+
+    tx_mutex_get(&sf->mutex, TX_WAIT_FOREVER);
+
+    // Anything that made it to flash is older than what is still in RAM
+    if (sf->flash_log && sf->flash_log->records > 0)
+    {
+        status = flash_segment_log_peek(sf->flash_log, buffer, buffer_size, length, sequence);
+    }
+    else if (sf->ram_records > 0)
+    {
+        header = ram_record(sf, sf->ram_head);
+
+        if (header->length > buffer_size)
+        {
+            status = NX_SIZE_ERROR;
+        }
+        else
+        {
+            memcpy(buffer, header + 1, header->length);
+            *length   = header->length;
+            *sequence = header->sequence;
+            status    = NX_SUCCESS;
+        }
+    }
+
+    tx_mutex_put(&sf->mutex);
+
+    return status;
+}
+
+UINT store_forward_replay_complete(STORE_FORWARD* sf, ULONG sequence, UINT length, UINT status)
+{
+    RAM_RECORD_HEADER* header;
+    ULONG sequence_check;
+    UINT length_check;
+    ULONG now;
+
+    tx_mutex_get(&sf->mutex, TX_WAIT_FOREVER);
+
+    if (status != NX_SUCCESS)
+    {
+        // Record stays at the head of the backlog and is retried on the next replay
+        sf->stats.replay_failed++;
+        tx_mutex_put(&sf->mutex);
+        return NX_SUCCESS;
+    }
+
+    sf->stats.replayed++;
+    sf->stats.replayed_bytes += length;
+    sf->replay_window_bytes += length;
+
+    now = tx_time_get();
+    if (now - sf->replay_window_start >= REPLAY_THROUGHPUT_WINDOW)
+    {
+        sf->stats.replay_bytes_per_second =
+            sf->replay_window_bytes * TX_TIMER_TICKS_PER_SECOND / (now - sf->replay_window_start);
+        sf->replay_window_start = now;
+        sf->replay_window_bytes = 0;
+    }
+
+    // The record may have been pushed out to flash while it was being sent, match on the sequence number
+    status = NX_NOT_FOUND;
+    if (sf->flash_log && sf->flash_log->records > 0)
+    {
+        if (flash_segment_log_peek(sf->flash_log, NX_NULL, 0, &length_check, &sequence_check) == NX_SUCCESS &&
+            sequence_check == sequence)
+        {
+            status = flash_segment_log_consume(sf->flash_log);
+        }
+    }
+    else if (sf->ram_records > 0)
+    {
+        header = ram_record(sf, sf->ram_head);
+
+        if (header->sequence == sequence)
+        {
+            sf->ram_records--;
+            sf->ram_bytes -= header->length;
+            ram_head_advance(sf, RAM_RECORD_SIZE(header->length));
+            status = NX_SUCCESS;
+        }
+    }
+
+    tx_mutex_put(&sf->mutex);
+
+    return status;
+}
+
+UINT store_forward_replay_acquire(STORE_FORWARD* sf)
+{
+    UINT allowed = NX_FALSE;
+
+    tx_mutex_get(&sf->mutex, TX_WAIT_FOREVER);
+
+    replay_tokens_refill(sf);
+
+    // Don't let the idle time between backlogs dilute the throughput figure
+    if (sf->replay_window_bytes == 0)
+    {
+        sf->replay_window_start = tx_time_get();
+    }
+
+    if (sf->replay_tokens > 0)
+    {
+        sf->replay_tokens--;
+        allowed = NX_TRUE;
+    }
+
+    tx_mutex_put(&sf->mutex);
+
+    return allowed;
+}
+
+UINT store_forward_replay_rate_set(STORE_FORWARD* sf, UINT records_per_second)
+{
+    if (records_per_second == 0)
+    {
+        return NX_INVALID_PARAMETERS;
+    }
+
+    tx_mutex_get(&sf->mutex, TX_WAIT_FOREVER);
+
+    sf->replay_rate        = records_per_second;
+    sf->replay_tokens      = 0;
+    sf->replay_refill_time = tx_time_get();
+
+    tx_mutex_put(&sf->mutex);
+
+    return NX_SUCCESS;
+}
+
+ULONG store_forward_backlog_get(STORE_FORWARD* sf)
+{
+    ULONG records;
+
+    tx_mutex_get(&sf->mutex, TX_WAIT_FOREVER);
+
+    records = sf->ram_records;
+    if (sf->flash_log)
+    {
+        records += sf->flash_log->records;
+    }
+
+    tx_mutex_put(&sf->mutex);
+
+    return records;
+}
+
+UINT store_forward_stats_get(STORE_FORWARD* sf, STORE_FORWARD_STATS* stats)
+{
+    if (sf == NX_NULL || stats == NX_NULL)
+    {
+        return NX_PTR_ERROR;
+    }
+
+    tx_mutex_get(&sf->mutex, TX_WAIT_FOREVER);
+
+    *stats                 = sf->stats;
+    stats->backlog_records = sf->ram_records;
+    stats->backlog_bytes   = sf->ram_bytes;
+
+    if (sf->flash_log)
+    {
+        stats->backlog_records += sf->flash_log->records;
+        stats->backlog_bytes += sf->flash_log->bytes;
+    }
+
+    tx_mutex_put(&sf->mutex);
+
+    return NX_SUCCESS;
+}
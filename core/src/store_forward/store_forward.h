@@ -0,0 +1,73 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _STORE_FORWARD_H
+#define _STORE_FORWARD_H
+
+#include "tx_api.h"
+
+#include "flash_segment_log.h"
+
+#ifndef STORE_FORWARD_RAM_SIZE
+#define STORE_FORWARD_RAM_SIZE 4096
+#endif
+
+#define STORE_FORWARD_DEFAULT_REPLAY_RATE 2 // records per second
+
+typedef struct STORE_FORWARD_STATS_STRUCT
+{
+    ULONG backlog_records;
+    ULONG backlog_bytes;
+    ULONG stored;
+    ULONG spilled;
+    ULONG dropped;
+    ULONG replayed;
+    ULONG replay_failed;
+    ULONG replayed_bytes;
+    ULONG replay_bytes_per_second;
+} STORE_FORWARD_STATS;
+
+typedef struct STORE_FORWARD_STRUCT
+{
+    TX_MUTEX mutex;
+
+    // Records are kept in RAM and the oldest ones are pushed out to flash, when available, as the ring fills
+    UCHAR ram[STORE_FORWARD_RAM_SIZE];
+    UINT ram_head;
+    UINT ram_tail;
+    UINT ram_used;
+    ULONG ram_records;
+    ULONG ram_bytes;
+
+    FLASH_SEGMENT_LOG* flash_log;
+    ULONG next_sequence;
+
+    UINT replay_rate;
+    UINT replay_tokens;
+    ULONG replay_refill_time;
+    ULONG replay_window_start;
+    ULONG replay_window_bytes;
+
+    STORE_FORWARD_STATS stats;
+} STORE_FORWARD;
+
+UINT store_forward_create(STORE_FORWARD* sf);
+UINT store_forward_delete(STORE_FORWARD* sf);
+
+// Optional overflow for the RAM ring, flash_log must already be open and any backlog it holds is replayed first
+UINT store_forward_flash_attach(STORE_FORWARD* sf, FLASH_SEGMENT_LOG* flash_log);
+
+UINT store_forward_append(STORE_FORWARD* sf, const UCHAR* payload, UINT length);
+
+// Fetch the oldest record, it stays in the backlog until store_forward_replay_complete reports it delivered
+UINT store_forward_peek(STORE_FORWARD* sf, UCHAR* buffer, UINT buffer_size, UINT* length, ULONG* sequence);
+UINT store_forward_replay_complete(STORE_FORWARD* sf, ULONG sequence, UINT length, UINT status);
+
+// Token bucket that paces the replay so live telemetry keeps flowing, returns NX_TRUE when a record may be sent
+UINT store_forward_replay_acquire(STORE_FORWARD* sf);
+UINT store_forward_replay_rate_set(STORE_FORWARD* sf, UINT records_per_second);
+
+ULONG store_forward_backlog_get(STORE_FORWARD* sf);
+UINT store_forward_stats_get(STORE_FORWARD* sf, STORE_FORWARD_STATS* stats);
+
+#endif // _STORE_FORWARD_H
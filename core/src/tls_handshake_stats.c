@@ -0,0 +1,21 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include "tls_handshake_stats.h"
+
+VOID tls_handshake_stats_start(TLS_HANDSHAKE_STATS* stats)
+{
+    stats->start_time = tx_time_get();
+}
+
+VOID tls_handshake_stats_update(TLS_HANDSHAKE_STATS* stats, UINT status)
+{
+    if (status != TX_SUCCESS)
+    {
+        stats->failed_handshakes++;
+        return;
+    }
+
+    stats->handshakes++;
+    stats->last_connect_ticks = tx_time_get() - stats->start_time;
+}
@@ -0,0 +1,30 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _TLS_HANDSHAKE_STATS_H
+#define _TLS_HANDSHAKE_STATS_H
+
+#include "tx_api.h"
+
+// Counts the TLS connects a client makes and how long the last one took.
+//
+// Every handshake is a full one. The NetX Secure client always sends an empty session ID and cannot complete the
+// abbreviated handshake, and it has no session ticket support, so neither client can resume a session and there is
+// no resumed count to report. Nor does it signal the end of the handshake, so the time covers the whole connect:
+// the TCP connect, the TLS handshake and the MQTT CONNECT round trip.
+typedef struct TLS_HANDSHAKE_STATS_STRUCT
+{
+    ULONG handshakes;
+    ULONG failed_handshakes;
+    ULONG last_connect_ticks;
+
+    ULONG start_time;
+} TLS_HANDSHAKE_STATS;
+
+// Call before the TCP connect starts
+VOID tls_handshake_stats_start(TLS_HANDSHAKE_STATS* stats);
+
+// Call with the outcome of the connect
+VOID tls_handshake_stats_update(TLS_HANDSHAKE_STATS* stats, UINT status);
+
+#endif // _TLS_HANDSHAKE_STATS_H
@@ -0,0 +1,706 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT License.
+
+"""Generate the C bindings for a DTDL v2 device model.
+
+The output is a pnp_model.h/pnp_model.c pair holding the model id, the names of every telemetry, property and command
+as constant keys, perfect hash routers for incoming commands and properties and typed serializers and deserializers.
+Telemetry serializers write through TELEMETRY_WRITER so they work for any telemetry encoding, numeric telemetry also
+gets a filtered variant that only writes when its TELEMETRY_DEADBAND lets the value through. Property serializers and
+readers use the NetX Duo Azure IoT json reader and writer.
+"""
+
+import argparse
+import glob
+import json
+import os
+import re
+import sys
+
+FNV_PRIME = 16777619
+FNV_MASK = 0xFFFFFFFF
+SLOT_EMPTY = 0xFF
+LINE_LIMIT = 120
+
+# DTDL schema -> (C type, writer function suffix, reader function)
+READER = "nx_azure_iot_json_reader_token_"
+SCHEMAS = {
+    "boolean": ("bool", "bool_value", READER + "bool_get"),
+    "double": ("double", "double_value", READER + "double_get"),
+    "float": ("double", "double_value", READER + "double_get"),
+    "integer": ("int32_t", "int32_value", READER + "int32_get"),
+    "string": ("const CHAR*", "string_value", READER + "string_get"),
+}
+
+# Telemetry goes through the encoding neutral writer, twin properties are always JSON
+TELEMETRY_WRITER = ("TELEMETRY_WRITER* writer", "telemetry_writer_append_property_with_")
+PROPERTY_WRITER = ("NX_AZURE_IOT_JSON_WRITER* json_writer", "nx_azure_iot_json_writer_append_property_with_")
+
+HEADER = """/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+// Generated from {model} by tools/dtdl_codegen.py, do not edit
+"""
+
+
+class ModelError(Exception):
+    pass
+
+
+def snake(name):
+    return re.sub(r"(?<=[a-z0-9])(?=[A-Z])", "_", name).lower()
+
+
+def upper(name):
+    return snake(name).upper()
+
+
+def content_types(content):
+    types = content.get("@type", [])
+    return types if isinstance(types, list) else [types]
+
+
+def schema_of(content, owner):
+    schema = content.get("schema")
+    if not isinstance(schema, str) or schema not in SCHEMAS:
+        raise ModelError("{}: unsupported schema {!r} for {}".format(owner, schema, content.get("name")))
+    return schema
+
+
+def fnv_hash(seed, data):
+    value = seed
+    for byte in data:
+        value = ((value ^ byte) * FNV_PRIME) & FNV_MASK
+    return value
+
+
+def fold(value):
+    # Multiplication only carries upwards, fold the high bits in so the seed reaches the slot index
+    return value ^ (value >> 16)
+
+
+def perfect_hash(keys):
+    """Find a seed and power of two table size that gives every key its own slot."""
+    size = 1
+    while size < 2 * len(keys):
+        size *= 2
+
+    if not keys:
+        return 0, 1, [SLOT_EMPTY]
+
+    if len(keys) >= SLOT_EMPTY:
+        raise ModelError("too many names for the router tables")
+
+    while True:
+        for seed in range(1, 1 << 16):
+            slots = [SLOT_EMPTY] * size
+            for index, key in enumerate(keys):
+                slot = fold(fnv_hash(seed, key)) & (size - 1)
+                if slots[slot] != SLOT_EMPTY:
+                    break
+                slots[slot] = index
+            else:
+                return seed, size, slots
+        size *= 2
+
+
+def c_call(prefix, args, suffix, indent):
+    """Lay out a call or declaration the way clang-format does for this repo."""
+    line = "{}{}({}){}".format(indent, prefix, ", ".join(args), suffix)
+    if len(line) <= LINE_LIMIT:
+        return [line]
+
+    inner = indent + "    "
+    line = "{}{}(".format(indent, prefix)
+    wrapped = "{}{}){}".format(inner, ", ".join(args), suffix)
+    if len(wrapped) <= LINE_LIMIT:
+        return [line, wrapped]
+
+    lines = ["{}{}({},".format(indent, prefix, args[0])]
+    for arg in args[1:-1]:
+        lines.append("{}{},".format(inner, arg))
+    lines.append("{}{}){}".format(inner, args[-1], suffix))
+    return lines
+
+
+class Model:
+    def __init__(self, path, model_dir):
+        self.path = path
+        self.interfaces = self._load_interfaces(model_dir)
+        root = self._load(path)
+
+        self.model_id = root["@id"]
+        self.telemetry = []
+        self.properties = []
+        self.commands = []
+        self.components = []
+
+        self._collect(root, None)
+
+    @staticmethod
+    def _load(path):
+        with open(path, encoding="utf-8") as model_file:
+            return json.load(model_file)
+
+    def _load_interfaces(self, model_dir):
+        interfaces = {}
+        for path in glob.glob(os.path.join(model_dir, "*.json")):
+            try:
+                interface = self._load(path)
+            except ValueError:
+                continue
+            if isinstance(interface, dict) and "@id" in interface:
+                interfaces[interface["@id"]] = interface
+        return interfaces
+
+    def _collect(self, interface, component):
+        owner = interface["@id"]
+
+        for content in interface.get("contents", []):
+            types = content_types(content)
+            name = content["name"]
+
+            if "Component" in types:
+                if component is not None:
+                    raise ModelError("{}: nested component {}".format(owner, name))
+                schema = content.get("schema")
+                if schema not in self.interfaces:
+                    raise ModelError("{}: component {} uses unknown interface {}".format(owner, name, schema))
+                self.components.append(name)
+                self._collect(self.interfaces[schema], name)
+
+            elif "Telemetry" in types:
+                if component is not None:
+                    raise ModelError("{}: component telemetry is not supported".format(owner))
+                self.telemetry.append({"name": name, "schema": schema_of(content, owner)})
+
+            elif "Property" in types:
+                self.properties.append(
+                    {
+                        "name": name,
+                        "component": component,
+                        "schema": schema_of(content, owner),
+                        "writable": bool(content.get("writable", False)),
+                    }
+                )
+
+            elif "Command" in types:
+                request = content.get("request")
+                self.commands.append(
+                    {
+                        "name": name,
+                        "component": component,
+                        "request": request,
+                        "schema": schema_of(request, owner) if request else None,
+                    }
+                )
+
+    # Identifiers
+    @staticmethod
+    def telemetry_macro(telemetry):
+        return "PNP_TELEMETRY_" + upper(telemetry["name"])
+
+    @staticmethod
+    def scope(item):
+        return "" if item["component"] is None else upper(item["component"]) + "_"
+
+    def property_macro(self, prop):
+        return "PNP_{}PROPERTY_{}".format(self.scope(prop), upper(prop["name"]))
+
+    def property_id(self, prop):
+        return "PNP_PROPERTY_ID_{}{}".format(self.scope(prop), upper(prop["name"]))
+
+    def property_function(self, prop, verb):
+        scope = "" if prop["component"] is None else snake(prop["component"]) + "_"
+        return "pnp_{}property_{}_{}".format(scope, snake(prop["name"]), verb)
+
+    def command_macro(self, command):
+        return "PNP_{}COMMAND_{}".format(self.scope(command), upper(command["name"]))
+
+    def command_id(self, command):
+        return "PNP_COMMAND_ID_{}{}".format(self.scope(command), upper(command["name"]))
+
+    def command_function(self, command):
+        scope = "" if command["component"] is None else snake(command["component"]) + "_"
+        return "pnp_{}command_{}_parse".format(scope, snake(command["name"]))
+
+    @staticmethod
+    def command_method_name(command):
+        # Component commands arrive as "component*command"
+        if command["component"] is None:
+            return command["name"]
+        return "{}*{}".format(command["component"], command["name"])
+
+    @staticmethod
+    def property_hash_key(prop):
+        if prop["component"] is None:
+            return prop["name"].encode()
+        return "{}/{}".format(prop["component"], prop["name"]).encode()
+
+    # Prototypes
+    def telemetry_prototype(self, telemetry):
+        ctype = SCHEMAS[telemetry["schema"]][0]
+        name = "UINT pnp_telemetry_{}_append".format(snake(telemetry["name"]))
+        return name, [TELEMETRY_WRITER[0], "{} value".format(ctype)]
+
+    def telemetry_filtered_prototype(self, telemetry):
+        ctype = SCHEMAS[telemetry["schema"]][0]
+        name = "UINT pnp_telemetry_{}_append_filtered".format(snake(telemetry["name"]))
+        return name, [TELEMETRY_WRITER[0], "TELEMETRY_DEADBAND* deadband", "{} value".format(ctype)]
+
+    @staticmethod
+    def telemetry_filterable(telemetry):
+        return telemetry["schema"] in ("double", "float", "integer")
+
+    def property_append_prototype(self, prop):
+        ctype = SCHEMAS[prop["schema"]][0]
+        name = "UINT " + self.property_function(prop, "append")
+        return name, [PROPERTY_WRITER[0], "{} value".format(ctype)]
+
+    def property_read_prototype(self, prop):
+        name = "UINT " + self.property_function(prop, "read")
+        args = ["NX_AZURE_IOT_JSON_READER* json_reader"]
+        return name, args + self.value_out_args(prop["schema"], "value")
+
+    def command_prototype(self, command):
+        name = "UINT " + self.command_function(command)
+        args = ["const UCHAR* payload", "UINT payload_length"]
+        return name, args + self.value_out_args(command["schema"], snake(command["request"]["name"]))
+
+    @staticmethod
+    def value_out_args(schema, name):
+        if schema == "string":
+            return ["CHAR* {}".format(name), "UINT {}_size".format(name), "UINT* {}_length".format(name)]
+        return ["{}* {}".format(SCHEMAS[schema][0], name)]
+
+    # Header
+    def header(self, model_name):
+        out = [HEADER.format(model=model_name)]
+        out.append("#ifndef _PNP_MODEL_H")
+        out.append("#define _PNP_MODEL_H")
+        out.append("")
+        out.append("#include <stdbool.h>")
+        out.append("#include <stdint.h>")
+        out.append("")
+        out.append('#include "nx_api.h"')
+        out.append('#include "nx_azure_iot_json_reader.h"')
+        out.append('#include "nx_azure_iot_json_writer.h"')
+        out.append("")
+        out.append('#include "telemetry_deadband.h"')
+        out.append('#include "telemetry_writer.h"')
+        out.append("")
+        out.append("#ifndef PNP_DOUBLE_PRECISION")
+        out.append("#define PNP_DOUBLE_PRECISION 2")
+        out.append("#endif")
+        out.append("")
+        out.append('#define PNP_MODEL_ID "{}"'.format(self.model_id))
+
+        if self.components:
+            out.append("")
+            out.extend(self.aligned_defines(
+                [("PNP_COMPONENT_" + upper(name), name) for name in self.components]))
+
+        if self.telemetry:
+            out.append("")
+            out.append("// Telemetry names")
+            out.extend(self.aligned_defines([(self.telemetry_macro(t), t["name"]) for t in self.telemetry]))
+
+        if self.properties:
+            out.append("")
+            out.append("// Property names")
+            out.extend(self.aligned_defines([(self.property_macro(p), p["name"]) for p in self.properties]))
+
+        if self.commands:
+            out.append("")
+            out.append("// Command names")
+            out.extend(self.aligned_defines([(self.command_macro(c), c["name"]) for c in self.commands]))
+
+        out.append("")
+        out.append("typedef enum PNP_PROPERTY_ID_ENUM")
+        out.append("{")
+        for prop in self.properties:
+            out.append("    {},".format(self.property_id(prop)))
+        out.append("    PNP_PROPERTY_ID_UNKNOWN")
+        out.append("} PNP_PROPERTY_ID;")
+        out.append("")
+        out.append("typedef enum PNP_COMMAND_ID_ENUM")
+        out.append("{")
+        for command in self.commands:
+            out.append("    {},".format(self.command_id(command)))
+        out.append("    PNP_COMMAND_ID_UNKNOWN")
+        out.append("} PNP_COMMAND_ID;")
+        out.append("")
+
+        out.append("// Constant time routing of incoming names, component is NX_NULL or empty for the root interface")
+        out.extend(c_call("PNP_PROPERTY_ID pnp_property_lookup",
+                          ["const UCHAR* component", "UINT component_length", "const UCHAR* name", "UINT name_length"],
+                          ";", ""))
+        out.append("PNP_COMMAND_ID pnp_command_lookup(const UCHAR* method_name, UINT method_name_length);")
+
+        if self.telemetry:
+            out.append("")
+            out.append("// Telemetry serializers")
+            for telemetry in self.telemetry:
+                out.extend(c_call(*self.telemetry_prototype(telemetry), ";", ""))
+
+        filterable = [t for t in self.telemetry if self.telemetry_filterable(t)]
+        if filterable:
+            out.append("")
+            out.append("// Report by exception, write the value only when the deadband lets it through")
+            for telemetry in filterable:
+                out.extend(c_call(*self.telemetry_filtered_prototype(telemetry), ";", ""))
+
+        if self.properties:
+            out.append("")
+            out.append("// Property serializers")
+            for prop in self.properties:
+                out.extend(c_call(*self.property_append_prototype(prop), ";", ""))
+
+        writable = [p for p in self.properties if p["writable"]]
+        if writable:
+            out.append("")
+            out.append("// Writable property deserializers, json_reader must be positioned on the value")
+            for prop in writable:
+                out.extend(c_call(*self.property_read_prototype(prop), ";", ""))
+
+        with_request = [c for c in self.commands if c["request"]]
+        if with_request:
+            out.append("")
+            out.append("// Command request deserializers")
+            for command in with_request:
+                out.extend(c_call(*self.command_prototype(command), ";", ""))
+
+        out.append("")
+        out.append("#endif // _PNP_MODEL_H")
+        return "\n".join(out) + "\n"
+
+    @staticmethod
+    def aligned_defines(defines):
+        width = max(len(name) for name, _ in defines)
+        return ['#define {} "{}"'.format(name.ljust(width), value) for name, value in defines]
+
+    # Source
+    def source(self, model_name):
+        out = [HEADER.format(model=model_name)]
+        out.append('#include "pnp_model.h"')
+        out.append("")
+        out.append("#include <string.h>")
+        out.append("")
+        out.append("#define PNP_SLOT_EMPTY 0x{:02X}".format(SLOT_EMPTY))
+        out.append("#define PNP_FNV_PRIME  {}u".format(FNV_PRIME))
+        out.append("")
+
+        property_keys = [self.property_hash_key(p) for p in self.properties]
+        property_seed, property_size, property_slots = perfect_hash(property_keys)
+        command_keys = [self.command_method_name(c).encode() for c in self.commands]
+        command_seed, command_size, command_slots = perfect_hash(command_keys)
+
+        out.extend(self.aligned_defines_raw([
+            ("PNP_PROPERTY_HASH_SEED", "0x{:08X}u".format(property_seed)),
+            ("PNP_PROPERTY_HASH_MASK", "0x{:X}u".format(property_size - 1)),
+            ("PNP_COMMAND_HASH_SEED", "0x{:08X}u".format(command_seed)),
+            ("PNP_COMMAND_HASH_MASK", "0x{:X}u".format(command_size - 1)),
+        ]))
+        out.append("")
+        out.append("typedef struct PNP_PROPERTY_KEY_STRUCT")
+        out.append("{")
+        out.append("    const CHAR* component;")
+        out.append("    UINT component_length;")
+        out.append("    const CHAR* name;")
+        out.append("    UINT name_length;")
+        out.append("} PNP_PROPERTY_KEY;")
+        out.append("")
+        out.append("typedef struct PNP_COMMAND_KEY_STRUCT")
+        out.append("{")
+        out.append("    const CHAR* method_name;")
+        out.append("    UINT method_name_length;")
+        out.append("} PNP_COMMAND_KEY;")
+        out.append("")
+
+        out.append("// Indexed by PNP_PROPERTY_ID")
+        out.append("static const PNP_PROPERTY_KEY pnp_property_keys[] = {")
+        if not self.properties:
+            out.append("    {NX_NULL, 0, NX_NULL, 0},")
+        for prop in self.properties:
+            if prop["component"] is None:
+                component = "NX_NULL, 0"
+            else:
+                component = '"{}", {}'.format(prop["component"], len(prop["component"]))
+            out.append('    {{{}, "{}", {}}},'.format(component, prop["name"], len(prop["name"])))
+        out.append("};")
+        out.append("")
+
+        out.append("// Indexed by PNP_COMMAND_ID")
+        out.append("static const PNP_COMMAND_KEY pnp_command_keys[] = {")
+        if not self.commands:
+            out.append("    {NX_NULL, 0},")
+        for command in self.commands:
+            method_name = self.command_method_name(command)
+            out.append('    {{"{}", {}}},'.format(method_name, len(method_name)))
+        out.append("};")
+        out.append("")
+
+        out.extend(self.slot_table("pnp_property_slots", property_slots))
+        out.append("")
+        out.extend(self.slot_table("pnp_command_slots", command_slots))
+        out.append("")
+
+        out.append("// 32 bit FNV-1a, the generator picks the seeds so every name lands in its own slot")
+        out.append("static uint32_t pnp_hash(uint32_t hash, const UCHAR* data, UINT length)")
+        out.append("{")
+        out.append("    while (length--)")
+        out.append("    {")
+        out.append("        hash = (hash ^ *data++) * PNP_FNV_PRIME;")
+        out.append("    }")
+        out.append("")
+        out.append("    return hash;")
+        out.append("}")
+        out.append("")
+        out.append("// Multiplication only carries upwards, fold the high bits in so the seed reaches the slot index")
+        out.append("static UINT pnp_slot(uint32_t hash, uint32_t mask)")
+        out.append("{")
+        out.append("    return (hash ^ (hash >> 16)) & mask;")
+        out.append("}")
+        out.append("")
+
+        out.extend(c_call("PNP_PROPERTY_ID pnp_property_lookup",
+                          ["const UCHAR* component", "UINT component_length", "const UCHAR* name", "UINT name_length"],
+                          "", ""))
+        out.append("{")
+        out.append("    const PNP_PROPERTY_KEY* key;")
+        out.append("    uint32_t hash = PNP_PROPERTY_HASH_SEED;")
+        out.append("    UCHAR slot;")
+        out.append("")
+        out.append("    if (component == NX_NULL)")
+        out.append("    {")
+        out.append("        component_length = 0;")
+        out.append("    }")
+        out.append("")
+        out.append("    if (component_length > 0)")
+        out.append("    {")
+        out.append("        hash = pnp_hash(hash, component, component_length);")
+        out.append('        hash = pnp_hash(hash, (const UCHAR*)"/", 1);')
+        out.append("    }")
+        out.append("")
+        out.append("    hash = pnp_hash(hash, name, name_length);")
+        out.append("    slot = pnp_property_slots[pnp_slot(hash, PNP_PROPERTY_HASH_MASK)];")
+        out.append("    if (slot == PNP_SLOT_EMPTY)")
+        out.append("    {")
+        out.append("        return PNP_PROPERTY_ID_UNKNOWN;")
+        out.append("    }")
+        out.append("")
+        out.append("    key = &pnp_property_keys[slot];")
+        out.append("    if (key->component_length != component_length || key->name_length != name_length ||")
+        out.append("        memcmp(key->component, component, component_length) != 0 ||")
+        out.append("        memcmp(key->name, name, name_length) != 0)")
+        out.append("    {")
+        out.append("        return PNP_PROPERTY_ID_UNKNOWN;")
+        out.append("    }")
+        out.append("")
+        out.append("    return (PNP_PROPERTY_ID)slot;")
+        out.append("}")
+        out.append("")
+
+        out.append("PNP_COMMAND_ID pnp_command_lookup(const UCHAR* method_name, UINT method_name_length)")
+        out.append("{")
+        out.append("    const PNP_COMMAND_KEY* key;")
+        out.append("    uint32_t hash = pnp_hash(PNP_COMMAND_HASH_SEED, method_name, method_name_length);")
+        out.append("    UCHAR slot    = pnp_command_slots[pnp_slot(hash, PNP_COMMAND_HASH_MASK)];")
+        out.append("")
+        out.append("    if (slot == PNP_SLOT_EMPTY)")
+        out.append("    {")
+        out.append("        return PNP_COMMAND_ID_UNKNOWN;")
+        out.append("    }")
+        out.append("")
+        out.append("    key = &pnp_command_keys[slot];")
+        out.append("    if (key->method_name_length != method_name_length ||")
+        out.append("        memcmp(key->method_name, method_name, method_name_length) != 0)")
+        out.append("    {")
+        out.append("        return PNP_COMMAND_ID_UNKNOWN;")
+        out.append("    }")
+        out.append("")
+        out.append("    return (PNP_COMMAND_ID)slot;")
+        out.append("}")
+
+        for telemetry in self.telemetry:
+            out.append("")
+            out.extend(self.append_body(self.telemetry_prototype(telemetry), self.telemetry_macro(telemetry),
+                                        telemetry["schema"], TELEMETRY_WRITER))
+
+        for telemetry in self.telemetry:
+            if self.telemetry_filterable(telemetry):
+                out.append("")
+                out.extend(self.filtered_body(telemetry))
+
+        for prop in self.properties:
+            out.append("")
+            out.extend(self.append_body(self.property_append_prototype(prop), self.property_macro(prop),
+                                        prop["schema"], PROPERTY_WRITER))
+
+        for prop in self.properties:
+            if prop["writable"]:
+                out.append("")
+                out.extend(self.read_body(self.property_read_prototype(prop), prop["schema"], "value"))
+
+        for command in self.commands:
+            if command["request"]:
+                out.append("")
+                out.extend(self.command_body(command))
+
+        return "\n".join(out) + "\n"
+
+    @staticmethod
+    def aligned_defines_raw(defines):
+        width = max(len(name) for name, _ in defines)
+        return ["#define {} {}".format(name.ljust(width), value) for name, value in defines]
+
+    @staticmethod
+    def slot_table(name, slots):
+        out = ["static const UCHAR {}[] = {{".format(name)]
+        for start in range(0, len(slots), 16):
+            out.append("    " + " ".join("0x{:02X},".format(slot) for slot in slots[start:start + 16]))
+        out.append("};")
+        return out
+
+    @staticmethod
+    def append_body(prototype, macro, schema, writer):
+        writer_arg, writer_prefix = writer
+        args = [writer_arg.split("*")[1].strip(), "(UCHAR*){}".format(macro), "sizeof({}) - 1".format(macro)]
+        if schema == "string":
+            args += ["(const UCHAR*)value", "strlen(value)"]
+        elif schema in ("double", "float"):
+            args += ["value", "PNP_DOUBLE_PRECISION"]
+        else:
+            args += ["value"]
+
+        out = c_call(*prototype, "", "")
+        out.append("{")
+        out.extend(c_call("return " + writer_prefix + SCHEMAS[schema][1], args, ";", "    "))
+        out.append("}")
+        return out
+
+    def filtered_body(self, telemetry):
+        out = c_call(*self.telemetry_filtered_prototype(telemetry), "", "")
+        out.append("{")
+        out.append("    if (!telemetry_writer_deadband_check(writer, deadband, value))")
+        out.append("    {")
+        out.append("        return NX_AZURE_IOT_SUCCESS;")
+        out.append("    }")
+        out.append("")
+        out.append("    return {}(writer, value);".format(self.telemetry_prototype(telemetry)[0][len("UINT "):]))
+        out.append("}")
+        return out
+
+    @staticmethod
+    def read_statements(schema, name, indent):
+        reader = SCHEMAS[schema][2]
+        if schema == "string":
+            return c_call("return " + reader, ["json_reader", "(UCHAR*){}".format(name), "{}_size".format(name),
+                                               "{}_length".format(name)], ";", indent)
+        if schema == "boolean":
+            out = ["{}UINT bool_value;".format(indent), ""]
+            out.append("{}if ((status = {}(json_reader, &bool_value)) == NX_AZURE_IOT_SUCCESS)".format(indent, reader))
+            out.append("{}{{".format(indent))
+            out.append("{}    *{} = bool_value;".format(indent, name))
+            out.append("{}}}".format(indent))
+            out.append("")
+            out.append("{}return status;".format(indent))
+            return out
+        if schema in ("double", "float"):
+            out = ["{}DOUBLE double_value;".format(indent), ""]
+            out.append("{}if ((status = {}(json_reader, &double_value)) == NX_AZURE_IOT_SUCCESS)".format(indent, reader))
+            out.append("{}{{".format(indent))
+            out.append("{}    *{} = double_value;".format(indent, name))
+            out.append("{}}}".format(indent))
+            out.append("")
+            out.append("{}return status;".format(indent))
+            return out
+        return ["{}return {}(json_reader, {});".format(indent, reader, name)]
+
+    def read_body(self, prototype, schema, name):
+        out = c_call(*prototype, "", "")
+        out.append("{")
+        statements = self.read_statements(schema, name, "    ")
+        if schema in ("boolean", "double", "float"):
+            out.append("    UINT status;")
+        out.extend(statements)
+        out.append("}")
+        return out
+
+    def command_body(self, command):
+        schema = command["schema"]
+        name = snake(command["request"]["name"])
+        reader = SCHEMAS[schema][2]
+
+        out = c_call(*self.command_prototype(command), "", "")
+        out.append("{")
+        out.append("    NX_AZURE_IOT_JSON_READER reader;")
+        out.append("    NX_AZURE_IOT_JSON_READER* json_reader = &reader;")
+        if schema == "boolean":
+            out.append("    UINT bool_value;")
+        elif schema in ("double", "float"):
+            out.append("    DOUBLE double_value;")
+        out.append("    UINT status;")
+        out.append("")
+        out.append("    if ((status = nx_azure_iot_json_reader_with_buffer_init(json_reader, payload, payload_length)) ||")
+        out.append("        (status = nx_azure_iot_json_reader_next_token(json_reader)))")
+        out.append("    {")
+        out.append("        return status;")
+        out.append("    }")
+        out.append("")
+
+        if schema == "string":
+            out.extend(c_call("return " + reader,
+                              ["json_reader", "(UCHAR*){}".format(name), "{}_size".format(name),
+                               "{}_length".format(name)], ";", "    "))
+        elif schema == "boolean":
+            out.append("    if ((status = {}(json_reader, &bool_value)) == NX_AZURE_IOT_SUCCESS)".format(reader))
+            out.append("    {")
+            out.append("        *{} = bool_value;".format(name))
+            out.append("    }")
+            out.append("")
+            out.append("    return status;")
+        elif schema in ("double", "float"):
+            out.append("    if ((status = {}(json_reader, &double_value)) == NX_AZURE_IOT_SUCCESS)".format(reader))
+            out.append("    {")
+            out.append("        *{} = double_value;".format(name))
+            out.append("    }")
+            out.append("")
+            out.append("    return status;")
+        else:
+            out.append("    return {}(json_reader, {});".format(reader, name))
+
+        out.append("}")
+        return out
+
+
+def write(path, text):
+    with open(path, "w", encoding="utf-8", newline="\n") as output:
+        output.write(text)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--model", required=True, help="DTDL interface implemented by the device")
+    parser.add_argument("--model-dir", help="directory holding the component interfaces, defaults to the model's")
+    parser.add_argument("--output", required=True, help="directory for pnp_model.h and pnp_model.c")
+    args = parser.parse_args()
+
+    model_dir = args.model_dir or os.path.dirname(os.path.abspath(args.model))
+    model_name = os.path.basename(args.model)
+
+    try:
+        model = Model(args.model, model_dir)
+    except (ModelError, KeyError, ValueError) as error:
+        print("dtdl_codegen: {}: {}".format(args.model, error), file=sys.stderr)
+        return 1
+
+    os.makedirs(args.output, exist_ok=True)
+    write(os.path.join(args.output, "pnp_model.h"), model.header(model_name))
+    write(os.path.join(args.output, "pnp_model.c"), model.source(model_name))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
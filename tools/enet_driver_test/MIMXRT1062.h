@@ -0,0 +1,112 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _MIMXRT1062_H
+#define _MIMXRT1062_H
+
+#include "fsl_common.h"
+
+// The ENET registers the driver uses, held in memory and worked by sim_enet.c in place of the DMA
+typedef struct
+{
+    volatile uint32_t EIR;
+    volatile uint32_t EIMR;
+    volatile uint32_t RDAR;
+    volatile uint32_t TDAR;
+    volatile uint32_t ECR;
+    volatile uint32_t RCR;
+    volatile uint32_t TCR;
+    volatile uint32_t IALR;
+    volatile uint32_t IAUR;
+    volatile uint32_t GALR;
+    volatile uint32_t GAUR;
+    volatile uint32_t TFWR;
+    volatile uint32_t RDSR;
+    volatile uint32_t TDSR;
+    volatile uint32_t MRBR;
+    volatile uint32_t RXIC;
+    volatile uint32_t TACC;
+    volatile uint32_t RACC;
+} ENET_Type;
+
+extern ENET_Type sim_enet_registers;
+
+#define ENET (&sim_enet_registers)
+
+#define ENET_IRQn 114
+
+#define FSL_FEATURE_ENET_HAS_INTERRUPT_COALESCE (1)
+
+#define ENET_EIR_RXF_MASK       (0x2000000U)
+#define ENET_EIR_TXF_MASK       (0x8000000U)
+#define ENET_EIMR_RXF_MASK      (0x2000000U)
+#define ENET_EIMR_TXF_MASK      (0x8000000U)
+#define ENET_RDAR_RDAR_MASK     (0x1000000U)
+#define ENET_TDAR_TDAR_MASK     (0x1000000U)
+#define ENET_ECR_ETHEREN_MASK   (0x2U)
+#define ENET_ECR_EN1588_MASK    (0x10U)
+#define ENET_ECR_DBSWP_MASK     (0x100U)
+#define ENET_RCR_DRT_MASK       (0x2U)
+#define ENET_RCR_MII_MODE_MASK  (0x4U)
+#define ENET_RCR_RMII_MODE_MASK (0x100U)
+#define ENET_RCR_RMII_10T_MASK  (0x200U)
+#define ENET_RCR_CRCFWD_MASK    (0x4000U)
+#define ENET_RCR_MAX_FL(x)      (((uint32_t)(x) << 16U) & 0x3FFF0000U)
+#define ENET_TCR_FDEN_MASK      (0x4U)
+#define ENET_TFWR_STRFWD_MASK   (0x100U)
+#define ENET_RXIC_ICTT(x)       ((uint32_t)(x)&0xFFFFU)
+#define ENET_RXIC_ICFT(x)       (((uint32_t)(x) << 20U) & 0xFF00000U)
+#define ENET_RXIC_ICCS_MASK     (0x40000000U)
+#define ENET_RXIC_ICEN_MASK     (0x80000000U)
+#define ENET_TACC_SHIFT16_MASK  (0x1U)
+#define ENET_TACC_IPCHK_MASK    (0x8U)
+#define ENET_TACC_PROCHK_MASK   (0x10U)
+#define ENET_RACC_IPDIS_MASK    (0x2U)
+#define ENET_RACC_PRODIS_MASK   (0x4U)
+#define ENET_RACC_LINEDIS_MASK  (0x40U)
+#define ENET_RACC_SHIFT16_MASK  (0x80U)
+
+// Pin, clock and GPIO setup of BOARD_InitModule, none of which matters on the host
+typedef enum
+{
+    kCLOCK_AhbClk
+} clock_name_t;
+
+typedef struct
+{
+    bool enableClkOutput;
+    bool enableClkOutput25M;
+    uint8_t loopDivider;
+    uint8_t src;
+    bool enableClkOutput1;
+    uint8_t loopDivider1;
+} clock_enet_pll_config_t;
+
+typedef enum
+{
+    kGPIO_DigitalInput,
+    kGPIO_DigitalOutput
+} gpio_pin_direction_t;
+
+typedef enum
+{
+    kGPIO_NoIntmode
+} gpio_interrupt_mode_t;
+
+typedef struct
+{
+    gpio_pin_direction_t direction;
+    uint8_t outputLogic;
+    gpio_interrupt_mode_t interruptMode;
+} gpio_pin_config_t;
+
+#define CLOCK_GetFreq(name)      ((uint32_t)600000000U)
+#define CLOCK_InitEnetPll(...)   ((void)0)
+#define CLOCK_EnableClock(...)   ((void)0)
+#define IOMUXC_EnableMode(...)   ((void)0)
+#define IOMUXC_SetPinMux(...)    ((void)0)
+#define IOMUXC_SetPinConfig(...) ((void)0)
+#define GPIO_PinInit(...)        ((void)0)
+#define GPIO_PinWrite(...)       ((void)0)
+
+#endif // _MIMXRT1062_H
@@ -0,0 +1,9 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _BOARD_H
+#define _BOARD_H
+
+// Included by the driver, the pin and clock setup it needs is stubbed in MIMXRT1062.h
+
+#endif // _BOARD_H
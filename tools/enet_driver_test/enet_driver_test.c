@@ -0,0 +1,704 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tx_api.h"
+
+#include "nx_api.h"
+#include "nx_driver_imxrt1062.h"
+
+#include "fsl_enet.h"
+
+#include "sim_enet.h"
+
+#define TEST_STACK_SIZE (16 * 1024)
+#define TEST_PRIORITY   4
+
+// Packets as small as a receive buffer may be, so a payload of a few hundred bytes is already a chain
+#define TEST_PACKET_PAYLOAD 256
+#define TEST_PACKET_COUNT   64
+
+// Packets the driver keeps for itself, the receive ring and the reserve behind it
+#define TEST_DRIVER_PACKETS (NX_DRIVER_RX_DESCRIPTORS + NX_DRIVER_RX_SPARE_PACKETS)
+
+// Received frames short enough for one buffer, and long enough for three
+#define TEST_SHORT_FRAME 64
+#define TEST_LONG_FRAME  600
+
+// Headers the IP layer puts in front of the payload, and the body of an ARP packet
+#define TEST_IPV4_UDP_HEADERS 28
+#define TEST_IPV4_TCP_HEADERS 40
+#define TEST_ARP_LENGTH       28
+
+#define TEST_ETHERNET_HEADER 14
+#define TEST_ETHERNET_IP     0x0800
+#define TEST_ETHERNET_ARP    0x0806
+
+// The peer every frame goes to or comes from
+#define TEST_PEER_MSW 0x0200
+#define TEST_PEER_LSW 0x00000001
+
+#define TEST_ASSERT(condition)                                                                                         \
+    if (!(condition))                                                                                                  \
+    {                                                                                                                  \
+        printf("  FAIL: %s:%d: %s\n", __FILE__, __LINE__, #condition);                                                 \
+        return NX_NOT_SUCCESSFUL;                                                                                      \
+    }
+
+typedef UINT (*func_ptr_test)(VOID);
+
+static TX_THREAD test_thread;
+static ULONG test_stack[TEST_STACK_SIZE / sizeof(ULONG)];
+
+// The driver only takes the default packet pool from the IP instance, the rest of it is never used
+static NX_IP ip;
+static NX_INTERFACE ip_interface;
+static NX_PACKET_POOL pool;
+static UINT pool_created;
+static UCHAR pool_memory[TEST_PACKET_COUNT * (TEST_PACKET_PAYLOAD + sizeof(NX_PACKET) + NX_PACKET_ALIGNMENT)];
+
+// Frames the driver handed up, in order, and whether it asked for its deferred processing to run
+static NX_PACKET* received_head;
+static NX_PACKET* received_tail;
+static ULONG received_count;
+static UINT deferred_requested;
+
+// Packets the test took from the pool, to leave the driver with its reserve only
+static NX_PACKET* held_head;
+
+static UCHAR pattern[2048];
+static UCHAR frame[2048];
+static UCHAR buffer[2048];
+
+static VOID received_append(NX_PACKET* packet_ptr)
+{
+    packet_ptr->nx_packet_queue_next = NX_NULL;
+
+    if (received_tail)
+    {
+        received_tail->nx_packet_queue_next = packet_ptr;
+    }
+    else
+    {
+        received_head = packet_ptr;
+    }
+
+    received_tail = packet_ptr;
+    received_count++;
+}
+
+static VOID received_release(VOID)
+{
+    NX_PACKET* packet_ptr;
+
+    while ((packet_ptr = received_head))
+    {
+        received_head = packet_ptr->nx_packet_queue_next;
+        nx_packet_release(packet_ptr);
+    }
+
+    received_tail  = NX_NULL;
+    received_count = 0;
+}
+
+static NX_PACKET* received_take(VOID)
+{
+    NX_PACKET* packet_ptr = received_head;
+
+    if (packet_ptr)
+    {
+        received_count--;
+        received_head = packet_ptr->nx_packet_queue_next;
+        if (received_head == NX_NULL)
+        {
+            received_tail = NX_NULL;
+        }
+    }
+
+    return packet_ptr;
+}
+
+// Take every packet left in the pool
+static VOID pool_drain(VOID)
+{
+    NX_PACKET* packet_ptr;
+
+    while (nx_packet_allocate(&pool, &packet_ptr, NX_RECEIVE_PACKET, NX_NO_WAIT) == NX_SUCCESS)
+    {
+        packet_ptr->nx_packet_queue_next = held_head;
+        held_head                        = packet_ptr;
+    }
+}
+
+static VOID held_release(VOID)
+{
+    NX_PACKET* packet_ptr;
+
+    while ((packet_ptr = held_head))
+    {
+        held_head = packet_ptr->nx_packet_queue_next;
+        nx_packet_release(packet_ptr);
+    }
+}
+
+// The driver's calls into the IP instance, renamed to these by the build
+VOID test_ip_packet_receive(NX_IP* ip_ptr, NX_PACKET* packet_ptr)
+{
+    received_append(packet_ptr);
+}
+
+VOID test_arp_packet_receive(NX_IP* ip_ptr, NX_PACKET* packet_ptr)
+{
+    received_append(packet_ptr);
+}
+
+VOID test_rarp_packet_receive(NX_IP* ip_ptr, NX_PACKET* packet_ptr)
+{
+    received_append(packet_ptr);
+}
+
+VOID test_ip_driver_deferred_processing(NX_IP* ip_ptr)
+{
+    deferred_requested = NX_TRUE;
+}
+
+static UINT driver_request(UINT command, NX_PACKET* packet_ptr)
+{
+    NX_IP_DRIVER request;
+
+    memset(&request, 0, sizeof(request));
+    request.nx_ip_driver_command              = command;
+    request.nx_ip_driver_ptr                  = &ip;
+    request.nx_ip_driver_interface            = &ip_interface;
+    request.nx_ip_driver_packet               = packet_ptr;
+    request.nx_ip_driver_physical_address_msw = TEST_PEER_MSW;
+    request.nx_ip_driver_physical_address_lsw = TEST_PEER_LSW;
+
+    nx_driver_imx(&request);
+
+    return request.nx_ip_driver_status;
+}
+
+// Run the driver's deferred processing once if it asked for it, the way the IP thread does
+static UINT deferred_pass(VOID)
+{
+    if (!deferred_requested)
+    {
+        return NX_FALSE;
+    }
+
+    deferred_requested = NX_FALSE;
+    driver_request(NX_LINK_DEFERRED_PROCESSING, NX_NULL);
+
+    return NX_TRUE;
+}
+
+// Run the driver's deferred processing until it stops asking for more, returns the number of passes
+static UINT deferred_run(VOID)
+{
+    UINT passes = 0;
+
+    while (deferred_pass())
+    {
+        passes++;
+    }
+
+    return passes;
+}
+
+// Start a test on a fresh controller and pool, with the driver initialized and enabled on them
+static UINT test_open(VOID)
+{
+    UINT status;
+
+    received_release();
+    held_release();
+    deferred_requested = NX_FALSE;
+
+    // The packets the driver held for the last test go with the old pool
+    if (pool_created)
+    {
+        nx_packet_pool_delete(&pool);
+        pool_created = NX_FALSE;
+    }
+
+    if ((status = nx_packet_pool_create(
+             &pool, "enet driver test", TEST_PACKET_PAYLOAD, pool_memory, sizeof(pool_memory))))
+    {
+        return status;
+    }
+
+    pool_created = NX_TRUE;
+
+    memset(&ip, 0, sizeof(ip));
+    memset(&ip_interface, 0, sizeof(ip_interface));
+    ip.nx_ip_default_packet_pool = &pool;
+
+    sim_enet_reset();
+
+    if ((status = driver_request(NX_LINK_INTERFACE_ATTACH, NX_NULL)) ||
+        (status = driver_request(NX_LINK_INITIALIZE, NX_NULL)) || (status = driver_request(NX_LINK_ENABLE, NX_NULL)))
+    {
+        return status;
+    }
+
+    return NX_SUCCESS;
+}
+
+// Release what the test kept, after which the pool must only be short of the driver's own packets
+static UINT test_close(VOID)
+{
+    received_release();
+    held_release();
+
+    return (pool.nx_packet_pool_available == pool.nx_packet_pool_total - TEST_DRIVER_PACKETS) ? NX_SUCCESS
+                                                                                              : NX_NOT_SUCCESSFUL;
+}
+
+// A packet the way the IP layer hands it to the driver: allocated for packet_type, with header_length bytes of headers
+// in front of length bytes of payload, all of them taken from pattern
+static UINT packet_build(NX_PACKET** packet_ptr, ULONG packet_type, ULONG header_length, ULONG length)
+{
+    UINT status;
+
+    if ((status = nx_packet_allocate(&pool, packet_ptr, packet_type, NX_NO_WAIT)))
+    {
+        return status;
+    }
+
+    if ((status = nx_packet_data_append(*packet_ptr, pattern + header_length, length, &pool, NX_NO_WAIT)))
+    {
+        nx_packet_release(*packet_ptr);
+        return status;
+    }
+
+    (*packet_ptr)->nx_packet_prepend_ptr -= header_length;
+    (*packet_ptr)->nx_packet_length += header_length;
+    (*packet_ptr)->nx_packet_ip_version = NX_IP_VERSION_V4;
+    memcpy((*packet_ptr)->nx_packet_prepend_ptr, pattern, header_length);
+
+    return NX_SUCCESS;
+}
+
+// Check a frame sent for a packet from packet_build, length counts its headers and payload
+static UINT frame_check(const UCHAR* frame_ptr, ULONG frame_length, USHORT type, ULONG length)
+{
+    UCHAR peer[6]  = {TEST_PEER_MSW >> 8, TEST_PEER_MSW & 0xFF, 0, 0, 0, TEST_PEER_LSW};
+    UCHAR local[6] = {(UCHAR)(ip_interface.nx_interface_physical_address_msw >> 8),
+        (UCHAR)ip_interface.nx_interface_physical_address_msw,
+        (UCHAR)(ip_interface.nx_interface_physical_address_lsw >> 24),
+        (UCHAR)(ip_interface.nx_interface_physical_address_lsw >> 16),
+        (UCHAR)(ip_interface.nx_interface_physical_address_lsw >> 8),
+        (UCHAR)ip_interface.nx_interface_physical_address_lsw};
+
+    TEST_ASSERT(frame_length == TEST_ETHERNET_HEADER + length);
+    TEST_ASSERT(memcmp(frame_ptr, peer, sizeof(peer)) == 0);
+    TEST_ASSERT(memcmp(frame_ptr + 6, local, sizeof(local)) == 0);
+    TEST_ASSERT(frame_ptr[12] == (type >> 8) && frame_ptr[13] == (type & 0xFF));
+    TEST_ASSERT(memcmp(frame_ptr + TEST_ETHERNET_HEADER, pattern, length) == 0);
+
+    return NX_SUCCESS;
+}
+
+// Send a packet from packet_build through the driver and the simulated DMA, then let the driver release it
+static UINT frame_send(UINT command, ULONG packet_type, ULONG header_length, ULONG length, USHORT type)
+{
+    NX_PACKET* packet_ptr;
+    ULONG frame_length;
+
+    TEST_ASSERT(packet_build(&packet_ptr, packet_type, header_length, length) == NX_SUCCESS);
+    TEST_ASSERT(driver_request(command, packet_ptr) == NX_SUCCESS);
+
+    frame_length = sim_enet_transmit(frame, sizeof(frame));
+    TEST_ASSERT(frame_check(frame, frame_length, type, header_length + length) == NX_SUCCESS);
+
+    sim_enet_interrupt();
+    TEST_ASSERT(deferred_run() == 1);
+
+    return NX_SUCCESS;
+}
+
+// Packets allocated for the headers they carry go out from where they are
+static UINT test_transmit_aligned(VOID)
+{
+    static const struct
+    {
+        UINT command;
+        ULONG packet_type;
+        ULONG header_length;
+        ULONG length;
+        USHORT type;
+    } sends[] = {
+        {NX_LINK_PACKET_SEND, NX_IPv4_UDP_PACKET, TEST_IPV4_UDP_HEADERS, 100, TEST_ETHERNET_IP},
+        {NX_LINK_PACKET_SEND, NX_IPv4_TCP_PACKET, TEST_IPV4_TCP_HEADERS, 100, TEST_ETHERNET_IP},
+        {NX_LINK_ARP_SEND, NX_PHYSICAL_HEADER, 0, TEST_ARP_LENGTH, TEST_ETHERNET_ARP},
+    };
+    const UINT count = sizeof(sends) / sizeof(sends[0]);
+    SIM_ENET_STATS stats;
+    ULONG zero_copy_count[2];
+    ULONG copy_count[2];
+    UINT i;
+
+    TEST_ASSERT(test_open() == NX_SUCCESS);
+    TEST_ASSERT(nx_driver_imx_transmit_count_get(&zero_copy_count[0], &copy_count[0]) == NX_SUCCESS);
+
+    for (i = 0; i < count; i++)
+    {
+        TEST_ASSERT(frame_send(sends[i].command,
+                        sends[i].packet_type,
+                        sends[i].header_length,
+                        sends[i].length,
+                        sends[i].type) == NX_SUCCESS);
+    }
+
+    sim_enet_stats_get(&stats);
+    TEST_ASSERT(stats.transmitted == count);
+    TEST_ASSERT(stats.transmit_descriptors == count);
+    TEST_ASSERT(stats.transmit_misaligned == 0);
+
+    TEST_ASSERT(nx_driver_imx_transmit_count_get(&zero_copy_count[1], &copy_count[1]) == NX_SUCCESS);
+    TEST_ASSERT(zero_copy_count[1] - zero_copy_count[0] == count);
+    TEST_ASSERT(copy_count[1] == copy_count[0]);
+
+    TEST_ASSERT(test_close() == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+// A packet allocated with room for IPv6 headers but carrying IPv4 ones is moved back to the alignment before it goes
+static UINT test_transmit_copied(VOID)
+{
+    SIM_ENET_STATS stats;
+    ULONG zero_copy_count[2];
+    ULONG copy_count[2];
+
+    TEST_ASSERT(test_open() == NX_SUCCESS);
+    TEST_ASSERT(nx_driver_imx_transmit_count_get(&zero_copy_count[0], &copy_count[0]) == NX_SUCCESS);
+
+    TEST_ASSERT(frame_send(NX_LINK_PACKET_SEND, NX_UDP_PACKET, TEST_IPV4_UDP_HEADERS, 100, TEST_ETHERNET_IP) ==
+                NX_SUCCESS);
+
+    sim_enet_stats_get(&stats);
+    TEST_ASSERT(stats.transmitted == 1);
+    TEST_ASSERT(stats.transmit_misaligned == 0);
+
+    TEST_ASSERT(nx_driver_imx_transmit_count_get(&zero_copy_count[1], &copy_count[1]) == NX_SUCCESS);
+    TEST_ASSERT(zero_copy_count[1] == zero_copy_count[0]);
+    TEST_ASSERT(copy_count[1] - copy_count[0] == 1);
+
+    TEST_ASSERT(test_close() == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+// A chain goes out with a descriptor per packet, only the first of which the driver aligns, moving it if it has to
+static UINT test_transmit_chain(VOID)
+{
+    SIM_ENET_STATS stats;
+    ULONG zero_copy_count[2];
+    ULONG copy_count[2];
+
+    TEST_ASSERT(test_open() == NX_SUCCESS);
+    TEST_ASSERT(nx_driver_imx_transmit_count_get(&zero_copy_count[0], &copy_count[0]) == NX_SUCCESS);
+
+    TEST_ASSERT(frame_send(NX_LINK_PACKET_SEND, NX_IPv4_UDP_PACKET, TEST_IPV4_UDP_HEADERS, 400, TEST_ETHERNET_IP) ==
+                NX_SUCCESS);
+    TEST_ASSERT(frame_send(NX_LINK_PACKET_SEND, NX_UDP_PACKET, TEST_IPV4_UDP_HEADERS, 400, TEST_ETHERNET_IP) ==
+                NX_SUCCESS);
+
+    sim_enet_stats_get(&stats);
+    TEST_ASSERT(stats.transmitted == 2);
+    TEST_ASSERT(stats.transmit_descriptors == 4);
+    TEST_ASSERT(stats.transmit_misaligned == 0);
+
+    TEST_ASSERT(nx_driver_imx_transmit_count_get(&zero_copy_count[1], &copy_count[1]) == NX_SUCCESS);
+    TEST_ASSERT(zero_copy_count[1] - zero_copy_count[0] == 1);
+    TEST_ASSERT(copy_count[1] - copy_count[0] == 1);
+
+    TEST_ASSERT(test_close() == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+// A frame from the peer to the driver, with length bytes of payload taken from pattern at sequence, returns its length
+static ULONG frame_build(UCHAR* frame_ptr, USHORT type, UINT sequence, ULONG length)
+{
+    frame_ptr[0]  = (UCHAR)(ip_interface.nx_interface_physical_address_msw >> 8);
+    frame_ptr[1]  = (UCHAR)ip_interface.nx_interface_physical_address_msw;
+    frame_ptr[2]  = (UCHAR)(ip_interface.nx_interface_physical_address_lsw >> 24);
+    frame_ptr[3]  = (UCHAR)(ip_interface.nx_interface_physical_address_lsw >> 16);
+    frame_ptr[4]  = (UCHAR)(ip_interface.nx_interface_physical_address_lsw >> 8);
+    frame_ptr[5]  = (UCHAR)ip_interface.nx_interface_physical_address_lsw;
+    frame_ptr[6]  = TEST_PEER_MSW >> 8;
+    frame_ptr[7]  = TEST_PEER_MSW & 0xFF;
+    frame_ptr[8]  = 0;
+    frame_ptr[9]  = 0;
+    frame_ptr[10] = 0;
+    frame_ptr[11] = TEST_PEER_LSW;
+    frame_ptr[12] = (UCHAR)(type >> 8);
+    frame_ptr[13] = (UCHAR)type;
+    memcpy(frame_ptr + TEST_ETHERNET_HEADER, pattern + sequence, length);
+
+    return TEST_ETHERNET_HEADER + length;
+}
+
+// Receive count IP frames from frame_build, the first with payload from sequence and each after it from the next one
+static UINT frames_receive(UINT sequence, UINT count, ULONG length)
+{
+    ULONG frame_length;
+    UINT i;
+
+    for (i = 0; i < count; i++)
+    {
+        frame_length = frame_build(frame, TEST_ETHERNET_IP, sequence + i, length);
+        TEST_ASSERT(sim_enet_receive(frame, frame_length) == NX_SUCCESS);
+    }
+
+    return NX_SUCCESS;
+}
+
+// Check the next packet the driver handed up is the IP frame from frame_build for sequence, without its Ethernet header
+static UINT received_check(UINT sequence, ULONG length)
+{
+    NX_PACKET* packet_ptr = received_take();
+    ULONG bytes;
+
+    TEST_ASSERT(packet_ptr != NX_NULL);
+    TEST_ASSERT(packet_ptr->nx_packet_ip_interface == &ip_interface);
+    TEST_ASSERT(packet_ptr->nx_packet_length == length);
+    TEST_ASSERT(nx_packet_data_retrieve(packet_ptr, buffer, &bytes) == NX_SUCCESS);
+    TEST_ASSERT(bytes == length);
+    TEST_ASSERT(memcmp(buffer, pattern + sequence, length) == 0);
+
+    nx_packet_release(packet_ptr);
+
+    return NX_SUCCESS;
+}
+
+// A burst over the budget is handed up over several passes, with the receive interrupt masked until the ring is drained
+static UINT test_receive_budget(VOID)
+{
+    const UINT count = NX_DRIVER_RX_BUDGET + NX_DRIVER_RX_BUDGET / 2;
+    SIM_ENET_STATS stats;
+    UINT i;
+
+    TEST_ASSERT(test_open() == NX_SUCCESS);
+    TEST_ASSERT(frames_receive(0, count, TEST_SHORT_FRAME) == NX_SUCCESS);
+
+    sim_enet_interrupt();
+    TEST_ASSERT((ENET->EIMR & ENET_EIMR_RXF_MASK) == 0);
+
+    // The first pass stops at the budget and asks for another
+    TEST_ASSERT(deferred_pass());
+    TEST_ASSERT(received_count == NX_DRIVER_RX_BUDGET);
+    TEST_ASSERT(deferred_requested);
+    TEST_ASSERT((ENET->EIMR & ENET_EIMR_RXF_MASK) == 0);
+
+    // Frames arriving in between wait for the next pass, without another interrupt
+    TEST_ASSERT(frames_receive(count, 2, TEST_SHORT_FRAME) == NX_SUCCESS);
+    sim_enet_interrupt();
+
+    TEST_ASSERT(deferred_pass());
+    TEST_ASSERT(received_count == count + 2);
+    TEST_ASSERT(!deferred_requested);
+    TEST_ASSERT(ENET->EIMR & ENET_EIMR_RXF_MASK);
+
+    sim_enet_stats_get(&stats);
+    TEST_ASSERT(stats.received == count + 2);
+    TEST_ASSERT(stats.interrupts == 1);
+
+    for (i = 0; i < count + 2; i++)
+    {
+        TEST_ASSERT(received_check(i, TEST_SHORT_FRAME) == NX_SUCCESS);
+    }
+
+    TEST_ASSERT(test_close() == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+// A full ring stops the DMA, and each pass starts it again
+static UINT test_receive_ring_full(VOID)
+{
+    SIM_ENET_STATS stats;
+    UINT i;
+
+    TEST_ASSERT(test_open() == NX_SUCCESS);
+    TEST_ASSERT(frames_receive(0, NX_DRIVER_RX_DESCRIPTORS, TEST_SHORT_FRAME) == NX_SUCCESS);
+    TEST_ASSERT(ENET->RDAR == 0);
+    TEST_ASSERT(sim_enet_receive(frame, TEST_ETHERNET_HEADER + TEST_SHORT_FRAME) == NX_OVERFLOW);
+
+    sim_enet_interrupt();
+    TEST_ASSERT(deferred_pass());
+    TEST_ASSERT(ENET->RDAR != 0);
+
+    deferred_run();
+    TEST_ASSERT(received_count == NX_DRIVER_RX_DESCRIPTORS);
+
+    sim_enet_stats_get(&stats);
+    TEST_ASSERT(stats.receive_overruns == 1);
+
+    for (i = 0; i < NX_DRIVER_RX_DESCRIPTORS; i++)
+    {
+        TEST_ASSERT(received_check(i, TEST_SHORT_FRAME) == NX_SUCCESS);
+    }
+
+    TEST_ASSERT(test_close() == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+// With the pool empty the reserve stands in for the packets handed up, and once it is gone too a frame is dropped and
+// its packet put back in the ring
+static UINT test_receive_spare(VOID)
+{
+    ULONG drop_count[2];
+    UINT i;
+
+    TEST_ASSERT(test_open() == NX_SUCCESS);
+    TEST_ASSERT(nx_driver_imx_receive_drop_count_get(&drop_count[0]) == NX_SUCCESS);
+
+    pool_drain();
+    TEST_ASSERT(frames_receive(0, NX_DRIVER_RX_SPARE_PACKETS + 1, TEST_SHORT_FRAME) == NX_SUCCESS);
+    sim_enet_interrupt();
+    deferred_run();
+
+    TEST_ASSERT(received_count == NX_DRIVER_RX_SPARE_PACKETS);
+    TEST_ASSERT(nx_driver_imx_receive_drop_count_get(&drop_count[1]) == NX_SUCCESS);
+    TEST_ASSERT(drop_count[1] - drop_count[0] == 1);
+
+    for (i = 0; i < NX_DRIVER_RX_SPARE_PACKETS; i++)
+    {
+        TEST_ASSERT(received_check(i, TEST_SHORT_FRAME) == NX_SUCCESS);
+    }
+
+    // Once packets are back the reserve fills up again, and a lap of the ring goes through the descriptor that dropped
+    held_release();
+    TEST_ASSERT(frames_receive(100, NX_DRIVER_RX_DESCRIPTORS, TEST_SHORT_FRAME) == NX_SUCCESS);
+    sim_enet_interrupt();
+    deferred_run();
+
+    TEST_ASSERT(received_count == NX_DRIVER_RX_DESCRIPTORS);
+    for (i = 0; i < NX_DRIVER_RX_DESCRIPTORS; i++)
+    {
+        TEST_ASSERT(received_check(100 + i, TEST_SHORT_FRAME) == NX_SUCCESS);
+    }
+
+    TEST_ASSERT(test_close() == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+// A frame over several descriptors that gets only some of its replacements is dropped without losing a packet
+static UINT test_receive_chain_drop(VOID)
+{
+    ULONG drop_count[2];
+    ULONG frame_length;
+    UINT i;
+
+    TEST_ASSERT(test_open() == NX_SUCCESS);
+    TEST_ASSERT(nx_driver_imx_receive_drop_count_get(&drop_count[0]) == NX_SUCCESS);
+
+    // Leave one packet in the reserve for the three the long frame needs
+    pool_drain();
+    TEST_ASSERT(frames_receive(0, NX_DRIVER_RX_SPARE_PACKETS - 1, TEST_SHORT_FRAME) == NX_SUCCESS);
+    frame_length = frame_build(frame, TEST_ETHERNET_IP, 10, TEST_LONG_FRAME);
+    TEST_ASSERT(frame_length > 2 * ENET->MRBR);
+    TEST_ASSERT(sim_enet_receive(frame, frame_length) == NX_SUCCESS);
+    sim_enet_interrupt();
+    deferred_run();
+
+    TEST_ASSERT(received_count == NX_DRIVER_RX_SPARE_PACKETS - 1);
+    TEST_ASSERT(nx_driver_imx_receive_drop_count_get(&drop_count[1]) == NX_SUCCESS);
+    TEST_ASSERT(drop_count[1] - drop_count[0] == 1);
+
+    for (i = 0; i < NX_DRIVER_RX_SPARE_PACKETS - 1; i++)
+    {
+        TEST_ASSERT(received_check(i, TEST_SHORT_FRAME) == NX_SUCCESS);
+    }
+
+    // The same frame gets through once packets are back, and so do frames through the descriptors it left behind
+    held_release();
+    TEST_ASSERT(sim_enet_receive(frame, frame_length) == NX_SUCCESS);
+    TEST_ASSERT(frames_receive(100, NX_DRIVER_RX_DESCRIPTORS - 3, TEST_SHORT_FRAME) == NX_SUCCESS);
+    sim_enet_interrupt();
+    deferred_run();
+
+    TEST_ASSERT(received_count == NX_DRIVER_RX_DESCRIPTORS - 2);
+    TEST_ASSERT(received_check(10, TEST_LONG_FRAME) == NX_SUCCESS);
+    for (i = 0; i < NX_DRIVER_RX_DESCRIPTORS - 3; i++)
+    {
+        TEST_ASSERT(received_check(100 + i, TEST_SHORT_FRAME) == NX_SUCCESS);
+    }
+
+    TEST_ASSERT(test_close() == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+static const struct
+{
+    const CHAR* name;
+    func_ptr_test run;
+} tests[] = {
+    {"transmit_aligned", test_transmit_aligned},
+    {"transmit_copied", test_transmit_copied},
+    {"transmit_chain", test_transmit_chain},
+    {"receive_budget", test_receive_budget},
+    {"receive_ring_full", test_receive_ring_full},
+    {"receive_spare", test_receive_spare},
+    {"receive_chain_drop", test_receive_chain_drop},
+};
+
+static VOID test_entry(ULONG parameter)
+{
+    UINT failures = 0;
+    UINT i;
+
+    for (i = 0; i < sizeof(pattern); i++)
+    {
+        pattern[i] = (UCHAR)(i * 7 + i / 251);
+    }
+
+    nx_system_initialize();
+
+    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    {
+        printf("%s\n", tests[i].name);
+
+        if (tests[i].run() != NX_SUCCESS)
+        {
+            failures++;
+        }
+    }
+
+    printf("%u of %u tests passed\n",
+        (UINT)(sizeof(tests) / sizeof(tests[0])) - failures,
+        (UINT)(sizeof(tests) / sizeof(tests[0])));
+
+    exit(failures ? 1 : 0);
+}
+
+VOID tx_application_define(VOID* first_unused_memory)
+{
+    tx_thread_create(&test_thread,
+        "enet driver test",
+        test_entry,
+        0,
+        test_stack,
+        sizeof(test_stack),
+        TEST_PRIORITY,
+        TEST_PRIORITY,
+        TX_NO_TIME_SLICE,
+        TX_AUTO_START);
+}
+
+int main(int argc, char* argv[])
+{
+    tx_kernel_enter();
+
+    return 0;
+}
@@ -0,0 +1,11 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _FSL_DEBUG_CONSOLE_H
+#define _FSL_DEBUG_CONSOLE_H
+
+#include <stdio.h>
+
+#define PRINTF printf
+
+#endif // _FSL_DEBUG_CONSOLE_H
@@ -0,0 +1,55 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _FSL_ENET_H
+#define _FSL_ENET_H
+
+#include "MIMXRT1062.h"
+#include "fsl_common.h"
+
+// The legacy buffer descriptors the driver uses, ENET_ENHANCEDBUFFERDESCRIPTOR_MODE is not defined
+#define ENET_BUFFDESCRIPTOR_RX_EMPTY_MASK      0x8000U
+#define ENET_BUFFDESCRIPTOR_RX_WRAP_MASK       0x2000U
+#define ENET_BUFFDESCRIPTOR_RX_LAST_MASK       0x0800U
+#define ENET_BUFFDESCRIPTOR_RX_BROADCAST_MASK  0x0080U
+#define ENET_BUFFDESCRIPTOR_TX_READY_MASK      0x8000U
+#define ENET_BUFFDESCRIPTOR_TX_WRAP_MASK       0x2000U
+#define ENET_BUFFDESCRIPTOR_TX_LAST_MASK       0x0800U
+#define ENET_BUFFDESCRIPTOR_TX_TRANMITCRC_MASK 0x0400U
+#define ENET_BUFFDESCRIPTOR_TX_INTERRUPT_MASK  0x4000U
+
+typedef struct _enet_rx_bd_struct
+{
+    uint16_t length;
+    uint16_t control;
+    uint8_t* buffer;
+} enet_rx_bd_struct_t;
+
+typedef struct _enet_tx_bd_struct
+{
+    uint16_t length;
+    uint16_t control;
+    uint8_t* buffer;
+} enet_tx_bd_struct_t;
+
+typedef enum
+{
+    kENET_MiiMode,
+    kENET_RmiiMode
+} enet_mii_mode_t;
+
+typedef enum
+{
+    kENET_MiiSpeed10M,
+    kENET_MiiSpeed100M
+} enet_mii_speed_t;
+
+typedef enum
+{
+    kENET_MiiHalfDuplex,
+    kENET_MiiFullDuplex
+} enet_mii_duplex_t;
+
+#define ENET_SetMacAddr(base, address) ((void)(address))
+
+#endif // _FSL_ENET_H
@@ -0,0 +1,9 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _FSL_IOMUXC_H
+#define _FSL_IOMUXC_H
+
+// Included by the driver, the pin and clock setup it needs is stubbed in MIMXRT1062.h
+
+#endif // _FSL_IOMUXC_H
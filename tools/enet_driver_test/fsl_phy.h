@@ -0,0 +1,41 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _FSL_PHY_H
+#define _FSL_PHY_H
+
+#include "fsl_common.h"
+#include "fsl_enet.h"
+
+typedef enum
+{
+    kPHY_Speed10M,
+    kPHY_Speed100M
+} phy_speed_t;
+
+typedef enum
+{
+    kPHY_HalfDuplex,
+    kPHY_FullDuplex
+} phy_duplex_t;
+
+// A PHY that comes up at once with the link down, so the driver keeps its 100M full duplex default
+static inline status_t PHY_Init(ENET_Type* base, uint32_t phyAddr, uint32_t srcClock_Hz)
+{
+    return kStatus_Success;
+}
+
+static inline status_t PHY_GetLinkStatus(ENET_Type* base, uint32_t phyAddr, bool* status)
+{
+    *status = false;
+    return kStatus_Success;
+}
+
+static inline status_t PHY_GetLinkSpeedDuplex(ENET_Type* base, uint32_t phyAddr, phy_speed_t* speed, phy_duplex_t* duplex)
+{
+    *speed  = kPHY_Speed100M;
+    *duplex = kPHY_FullDuplex;
+    return kStatus_Success;
+}
+
+#endif // _FSL_PHY_H
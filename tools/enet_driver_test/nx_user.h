@@ -0,0 +1,14 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef NX_USER_H
+#define NX_USER_H
+
+// The driver only needs packets from the stack, the IP instance itself is never started
+
+// Packet data aligned as on the board, which is what keeps the transmit frames aligned
+#define NX_PACKET_ALIGNMENT 32
+
+// IPv6 stays enabled, so NX_UDP_PACKET leaves room for headers an IPv4 frame does not fill
+
+#endif // NX_USER_H
@@ -0,0 +1,9 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _PIN_MUX_H
+#define _PIN_MUX_H
+
+// Included by the driver, the pin and clock setup it needs is stubbed in MIMXRT1062.h
+
+#endif // _PIN_MUX_H
@@ -0,0 +1,210 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include "sim_enet.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "fsl_enet.h"
+
+// Bytes in front of the frame in the first buffer, when the driver turns on SHIFT16 in either direction
+#define SIM_ENET_SHIFT16 2
+
+ENET_Type sim_enet_registers;
+
+static SIM_ENET_STATS sim_stats;
+static UINT transmit_index;
+static UINT receive_index;
+
+// Events raised and not yet handled, the handler clears them by writing ones to EIR which plain memory can't do
+static ULONG events;
+
+// Not in the driver's header, on the board it is only called from the ENET vector
+VOID nx_driver_imx_ethernet_isr(VOID);
+
+static enet_tx_bd_struct_t* transmit_descriptor(UINT index)
+{
+    return (enet_tx_bd_struct_t*)(uintptr_t)ENET->TDSR + index;
+}
+
+static enet_rx_bd_struct_t* receive_descriptor(UINT index)
+{
+    return (enet_rx_bd_struct_t*)(uintptr_t)ENET->RDSR + index;
+}
+
+static UINT receive_next(UINT index)
+{
+    return (receive_descriptor(index)->control & ENET_BUFFDESCRIPTOR_RX_WRAP_MASK) ? 0 : index + 1;
+}
+
+VOID sim_enet_reset(VOID)
+{
+    memset(&sim_enet_registers, 0, sizeof(sim_enet_registers));
+    memset(&sim_stats, 0, sizeof(sim_stats));
+
+    transmit_index = 0;
+    receive_index  = 0;
+    events         = 0;
+}
+
+VOID sim_enet_stats_get(SIM_ENET_STATS* stats)
+{
+    *stats = sim_stats;
+}
+
+ULONG sim_enet_transmit(UCHAR* buffer, ULONG length)
+{
+    enet_tx_bd_struct_t* descriptor;
+    ULONG frame_length = 0;
+    ULONG skip;
+    ULONG copy;
+
+    // The DMA stops when it runs out of ready descriptors, until the driver writes TDAR again
+    if ((ENET->ECR & ENET_ECR_ETHEREN_MASK) == 0 || ENET->TDAR == 0)
+    {
+        return 0;
+    }
+
+    descriptor = transmit_descriptor(transmit_index);
+    if ((descriptor->control & ENET_BUFFDESCRIPTOR_TX_READY_MASK) == 0)
+    {
+        ENET->TDAR = 0;
+        return 0;
+    }
+
+    if ((uintptr_t)descriptor->buffer & (SIM_ENET_TX_ALIGNMENT - 1))
+    {
+        sim_stats.transmit_misaligned++;
+    }
+
+    // SHIFT16 drops the first two bytes of the frame
+    skip = (ENET->TACC & ENET_TACC_SHIFT16_MASK) ? SIM_ENET_SHIFT16 : 0;
+
+    for (;;)
+    {
+        descriptor = transmit_descriptor(transmit_index);
+        if ((descriptor->control & ENET_BUFFDESCRIPTOR_TX_READY_MASK) == 0)
+        {
+            printf("ERROR: simulated ENET found a frame without its last descriptor\n");
+            return 0;
+        }
+
+        copy = descriptor->length - skip;
+        if (copy > length - frame_length)
+        {
+            printf("ERROR: simulated ENET got a frame longer than %lu bytes\n", length);
+            return 0;
+        }
+
+        memcpy(buffer + frame_length, descriptor->buffer + skip, copy);
+        frame_length += copy;
+        skip = 0;
+
+        descriptor->control &= ~ENET_BUFFDESCRIPTOR_TX_READY_MASK;
+        sim_stats.transmit_descriptors++;
+
+        transmit_index = (descriptor->control & ENET_BUFFDESCRIPTOR_TX_WRAP_MASK) ? 0 : transmit_index + 1;
+
+        if (descriptor->control & ENET_BUFFDESCRIPTOR_TX_LAST_MASK)
+        {
+            break;
+        }
+    }
+
+    if ((transmit_descriptor(transmit_index)->control & ENET_BUFFDESCRIPTOR_TX_READY_MASK) == 0)
+    {
+        ENET->TDAR = 0;
+    }
+
+    sim_stats.transmitted++;
+    events |= ENET_EIR_TXF_MASK;
+
+    return frame_length;
+}
+
+UINT sim_enet_receive(const UCHAR* frame, ULONG length)
+{
+    enet_rx_bd_struct_t* descriptor;
+    ULONG buffer_size = ENET->MRBR;
+    ULONG pad         = (ENET->RACC & ENET_RACC_SHIFT16_MASK) ? SIM_ENET_SHIFT16 : 0;
+    ULONG total       = length + pad;
+    ULONG position;
+    ULONG chunk;
+    UINT index;
+
+    if ((ENET->ECR & ENET_ECR_ETHEREN_MASK) == 0 || buffer_size == 0)
+    {
+        return NX_NOT_ENABLED;
+    }
+
+    // The DMA stops when it runs out of empty descriptors and drops what comes in, until the driver writes RDAR again
+    for (index = receive_index, position = 0; position < total; index = receive_next(index), position += buffer_size)
+    {
+        if (ENET->RDAR == 0 || (receive_descriptor(index)->control & ENET_BUFFDESCRIPTOR_RX_EMPTY_MASK) == 0)
+        {
+            ENET->RDAR = 0;
+            sim_stats.receive_overruns++;
+            return NX_OVERFLOW;
+        }
+    }
+
+    for (position = 0; position < total; position += chunk)
+    {
+        descriptor = receive_descriptor(receive_index);
+        chunk      = (total - position < buffer_size) ? total - position : buffer_size;
+
+        if (position == 0)
+        {
+            memset(descriptor->buffer, 0, pad);
+            memcpy(descriptor->buffer + pad, frame, chunk - pad);
+        }
+        else
+        {
+            memcpy(descriptor->buffer, frame + position - pad, chunk);
+        }
+
+        // Each descriptor holds a full buffer, the last one the length of the whole frame
+        descriptor->control &= ~(ENET_BUFFDESCRIPTOR_RX_EMPTY_MASK | ENET_BUFFDESCRIPTOR_RX_LAST_MASK);
+        if (position + chunk == total)
+        {
+            descriptor->control |= ENET_BUFFDESCRIPTOR_RX_LAST_MASK;
+            descriptor->length = (uint16_t)total;
+        }
+        else
+        {
+            descriptor->length = (uint16_t)buffer_size;
+        }
+
+        receive_index = receive_next(receive_index);
+    }
+
+    if ((receive_descriptor(receive_index)->control & ENET_BUFFDESCRIPTOR_RX_EMPTY_MASK) == 0)
+    {
+        ENET->RDAR = 0;
+    }
+
+    sim_stats.received++;
+    events |= ENET_EIR_RXF_MASK;
+
+    return NX_SUCCESS;
+}
+
+VOID sim_enet_interrupt(VOID)
+{
+    ULONG handled = events & ENET->EIMR;
+
+    if (handled == 0)
+    {
+        return;
+    }
+
+    ENET->EIR = events;
+    nx_driver_imx_ethernet_isr();
+
+    events &= ~handled;
+    ENET->EIR = events;
+
+    sim_stats.interrupts++;
+}
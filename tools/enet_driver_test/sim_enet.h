@@ -0,0 +1,42 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _SIM_ENET_H
+#define _SIM_ENET_H
+
+#include "nx_api.h"
+
+// Transmit buffers the DMA reads without a penalty start on this boundary
+#define SIM_ENET_TX_ALIGNMENT 8
+
+// What the simulated controller saw since the last sim_enet_reset
+typedef struct SIM_ENET_STATS_STRUCT
+{
+    // Frames sent, the descriptors they took, and the frames whose first buffer was off the alignment
+    ULONG transmitted;
+    ULONG transmit_descriptors;
+    ULONG transmit_misaligned;
+
+    // Frames written to the receive ring, and frames lost because it had no empty descriptor for them
+    ULONG received;
+    ULONG receive_overruns;
+
+    // Times the interrupt handler ran
+    ULONG interrupts;
+} SIM_ENET_STATS;
+
+// Simulated ENET DMA working the descriptor rings the driver sets up through the registers in MIMXRT1062.h. Reset it
+// before the driver initializes, so it starts at the first descriptor of the rings.
+VOID sim_enet_reset(VOID);
+VOID sim_enet_stats_get(SIM_ENET_STATS* stats);
+
+// Send the next frame the driver made ready and raise its transmit event, returns its length or 0 when there is none
+ULONG sim_enet_transmit(UCHAR* buffer, ULONG length);
+
+// Receive a frame into the next empty descriptors and raise the receive event, NX_OVERFLOW when the ring is full
+UINT sim_enet_receive(const UCHAR* frame, ULONG length);
+
+// Run the driver's interrupt handler if one of the events raised so far is unmasked
+VOID sim_enet_interrupt(VOID);
+
+#endif // _SIM_ENET_H
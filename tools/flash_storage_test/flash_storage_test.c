@@ -0,0 +1,702 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tx_api.h"
+
+#include "nx_api.h"
+
+#include "dhcp_lease.h"
+#include "dps_cache.h"
+#include "flash_emulator.h"
+#include "flash_segment_log.h"
+#include "store_forward.h"
+
+#define TEST_STACK_SIZE (16 * 1024)
+#define TEST_PRIORITY   4
+
+// Four small sectors so the log wraps after a few dozen records, see CMakeLists.txt
+#define TEST_SECTOR_SIZE  FLASH_EMULATOR_SECTOR_SIZE
+#define TEST_SECTOR_COUNT FLASH_EMULATOR_SECTOR_COUNT
+
+// Each record is a 24 byte header plus the payload rounded up to the write alignment
+#define TEST_PAYLOAD_SIZE 100
+#define TEST_HEADER_SIZE  24
+#define TEST_RECORD_SIZE  (TEST_HEADER_SIZE + 104)
+
+// A DPS cache record is a 24 byte header followed by the host name and device id, a DHCP lease record is 48 bytes
+#define TEST_DPS_RECORD_SIZE   (24 + DPS_CACHE_HOST_NAME_SIZE + DPS_CACHE_DEVICE_ID_SIZE)
+#define TEST_LEASE_RECORD_SIZE 48
+
+// The DPS cache and the DHCP lease share the flash the way a board keeps them, half the sectors each
+#define TEST_DPS_FIRST_SECTOR   0
+#define TEST_DPS_SECTOR_COUNT   (TEST_SECTOR_COUNT / 2)
+#define TEST_LEASE_FIRST_SECTOR TEST_DPS_SECTOR_COUNT
+#define TEST_LEASE_SECTOR_COUNT (TEST_SECTOR_COUNT - TEST_DPS_SECTOR_COUNT)
+
+#define TEST_ID_SCOPE        "0ne00000000"
+#define TEST_REGISTRATION_ID "mydevice"
+
+#define TEST_ASSERT(condition)                                                                                         \
+    if (!(condition))                                                                                                  \
+    {                                                                                                                  \
+        printf("  FAIL: %s:%d: %s\n", __FILE__, __LINE__, #condition);                                                 \
+        return NX_NOT_SUCCESSFUL;                                                                                      \
+    }
+
+typedef UINT (*func_ptr_test)(VOID);
+
+static TX_THREAD test_thread;
+static ULONG test_stack[TEST_STACK_SIZE / sizeof(ULONG)];
+
+// The emulator the boards without a flash driver use, its storage outlives a reboot
+static const FLASH_DRIVER* flash = &flash_emulator;
+
+// Payloads carry their sequence number so a record replayed out of place is caught
+static UINT payload_build(UCHAR* payload, UINT size, ULONG sequence)
+{
+    memset(payload, (UCHAR)sequence, size);
+    snprintf((CHAR*)payload, size, "record %lu", sequence);
+
+    return size;
+}
+
+static UINT payload_check(const UCHAR* payload, UINT length, ULONG sequence)
+{
+    UCHAR expected[TEST_PAYLOAD_SIZE];
+
+    return length == payload_build(expected, sizeof(expected), sequence) && memcmp(payload, expected, length) == 0;
+}
+
+// Power cycle the board, only the flash contents survive
+static UINT reboot(FLASH_SEGMENT_LOG* log)
+{
+    flash_emulator_power_restore();
+
+    return flash_segment_log_open(log, flash);
+}
+
+static UINT blank_log(FLASH_SEGMENT_LOG* log)
+{
+    flash_emulator_format();
+
+    return reboot(log);
+}
+
+static UINT log_append(FLASH_SEGMENT_LOG* log, ULONG sequence, ULONG* dropped)
+{
+    UCHAR payload[TEST_PAYLOAD_SIZE];
+
+    payload_build(payload, sizeof(payload), sequence);
+
+    return flash_segment_log_append(log, sequence, payload, sizeof(payload), dropped);
+}
+
+// Consume records first to last, checking they come back oldest first with nothing skipped
+static UINT log_consume(FLASH_SEGMENT_LOG* log, ULONG first, ULONG last)
+{
+    UCHAR payload[TEST_PAYLOAD_SIZE];
+    ULONG expected;
+    ULONG sequence;
+    UINT length;
+
+    for (expected = first; expected <= last; expected++)
+    {
+        TEST_ASSERT(flash_segment_log_peek(log, payload, sizeof(payload), &length, &sequence) == NX_SUCCESS);
+        TEST_ASSERT(sequence == expected);
+        TEST_ASSERT(payload_check(payload, length, sequence));
+        TEST_ASSERT(flash_segment_log_consume(log) == NX_SUCCESS);
+    }
+
+    return NX_SUCCESS;
+}
+
+static UINT log_drain(FLASH_SEGMENT_LOG* log, ULONG first, ULONG last)
+{
+    UCHAR payload[TEST_PAYLOAD_SIZE];
+    ULONG sequence;
+    UINT length;
+
+    TEST_ASSERT(log_consume(log, first, last) == NX_SUCCESS);
+    TEST_ASSERT(log->records == 0);
+    TEST_ASSERT(flash_segment_log_peek(log, payload, sizeof(payload), &length, &sequence) == NX_NOT_FOUND);
+
+    return NX_SUCCESS;
+}
+
+// The emulator refuses what a NOR part would, so the flash users are tested against the real rules
+static UINT test_emulator_rules(VOID)
+{
+    UCHAR data[2 * FLASH_DRIVER_WRITE_ALIGN];
+    UCHAR readback[sizeof(data)];
+
+    flash_emulator_format();
+    flash_emulator_power_restore();
+
+    memset(data, 0x0F, sizeof(data));
+    TEST_ASSERT(flash->write(0, data, sizeof(data)) == NX_SUCCESS);
+
+    // Bits can only be cleared, a refused write leaves even the bytes it could have programmed alone
+    data[0] = 0x03;
+    data[1] = 0xF0;
+    TEST_ASSERT(flash->write(0, data, sizeof(data)) == NX_NOT_SUCCESSFUL);
+    TEST_ASSERT(flash->read(0, readback, sizeof(readback)) == NX_SUCCESS);
+    TEST_ASSERT(readback[0] == 0x0F && readback[1] == 0x0F);
+
+    // Writes must be aligned and stay inside the region
+    TEST_ASSERT(flash->write(1, data, FLASH_DRIVER_WRITE_ALIGN) == NX_INVALID_PARAMETERS);
+    TEST_ASSERT(flash->write(0, data, FLASH_DRIVER_WRITE_ALIGN - 1) == NX_INVALID_PARAMETERS);
+    TEST_ASSERT(flash->write(TEST_SECTOR_SIZE * TEST_SECTOR_COUNT - FLASH_DRIVER_WRITE_ALIGN, data, sizeof(data)) ==
+                NX_INVALID_PARAMETERS);
+    TEST_ASSERT(flash->erase(1) == NX_INVALID_PARAMETERS);
+
+    // A power failure stops programming part way through a word
+    flash_emulator_power_fail_after(3);
+    memset(data, 0, sizeof(data));
+    TEST_ASSERT(flash->write(TEST_SECTOR_SIZE, data, sizeof(data)) == NX_NOT_SUCCESSFUL);
+    TEST_ASSERT(flash->erase(0) == NX_NOT_SUCCESSFUL);
+    flash_emulator_power_restore();
+    TEST_ASSERT(flash->read(TEST_SECTOR_SIZE, readback, sizeof(readback)) == NX_SUCCESS);
+    TEST_ASSERT(readback[2] == 0x00 && readback[3] == 0xFF);
+
+    // Erasing gives a sector back as a blank part reads
+    TEST_ASSERT(flash->erase(0) == NX_SUCCESS);
+    TEST_ASSERT(flash->read(0, readback, sizeof(readback)) == NX_SUCCESS);
+    TEST_ASSERT(readback[0] == 0xFF && readback[1] == 0xFF);
+
+    return NX_SUCCESS;
+}
+
+static UINT test_segment_wrap(VOID)
+{
+    FLASH_SEGMENT_LOG log;
+    ULONG per_sector    = TEST_SECTOR_SIZE / TEST_RECORD_SIZE;
+    ULONG appended      = 3 * per_sector * TEST_SECTOR_COUNT;
+    ULONG dropped_total = 0;
+    ULONG dropped;
+    ULONG sequence;
+
+    TEST_ASSERT(blank_log(&log) == NX_SUCCESS);
+
+    for (sequence = 1; sequence <= appended; sequence++)
+    {
+        TEST_ASSERT(log_append(&log, sequence, &dropped) == NX_SUCCESS);
+        dropped_total += dropped;
+    }
+
+    // Recycling a sector costs exactly that sector's records, everything else is still there
+    TEST_ASSERT(dropped_total > 0 && dropped_total % per_sector == 0);
+    TEST_ASSERT(log.records + dropped_total == appended);
+    TEST_ASSERT(log.records >= per_sector * (TEST_SECTOR_COUNT - 1));
+    TEST_ASSERT(log.bytes == log.records * TEST_PAYLOAD_SIZE);
+
+    // The same backlog comes back after a reboot and appending resumes where it left off
+    TEST_ASSERT(reboot(&log) == NX_SUCCESS);
+    TEST_ASSERT(log.records + dropped_total == appended);
+    TEST_ASSERT(log.next_sequence == appended + 1);
+
+    // Consume part of it, the consumed marks persist too
+    TEST_ASSERT(log_consume(&log, dropped_total + 1, dropped_total + per_sector + 1) == NX_SUCCESS);
+    TEST_ASSERT(reboot(&log) == NX_SUCCESS);
+    TEST_ASSERT(log.records == appended - dropped_total - per_sector - 1);
+
+    return log_drain(&log, dropped_total + per_sector + 2, appended);
+}
+
+// A reset while a record is being programmed, payload_bytes is how far the write got
+static UINT torn_append(ULONG payload_bytes)
+{
+    FLASH_SEGMENT_LOG log;
+    UCHAR zeros[TEST_PAYLOAD_SIZE];
+    ULONG dropped;
+    ULONG sequence;
+
+    TEST_ASSERT(blank_log(&log) == NX_SUCCESS);
+
+    for (sequence = 1; sequence <= 5; sequence++)
+    {
+        TEST_ASSERT(log_append(&log, sequence, &dropped) == NX_SUCCESS);
+    }
+
+    // Zeros, so programming the retried record over the torn one would be refused
+    memset(zeros, 0, sizeof(zeros));
+    flash_emulator_power_fail_after(payload_bytes);
+    TEST_ASSERT(flash_segment_log_append(&log, 6, zeros, sizeof(zeros), &dropped) != NX_SUCCESS);
+
+    // The torn record is not recovered and its space is never programmed over
+    TEST_ASSERT(reboot(&log) == NX_SUCCESS);
+    TEST_ASSERT(log.records == 5);
+    TEST_ASSERT(log.next_sequence == 6);
+
+    for (sequence = 6; sequence <= 8; sequence++)
+    {
+        TEST_ASSERT(log_append(&log, sequence, &dropped) == NX_SUCCESS);
+        TEST_ASSERT(dropped == 0);
+    }
+
+    TEST_ASSERT(reboot(&log) == NX_SUCCESS);
+    TEST_ASSERT(log.records == 8);
+
+    return log_drain(&log, 1, 8);
+}
+
+static UINT test_torn_write(VOID)
+{
+    // Part way through the payload, then with the payload done but the header only partly programmed
+    TEST_ASSERT(torn_append(3) == NX_SUCCESS);
+    TEST_ASSERT(torn_append(TEST_PAYLOAD_SIZE / 2) == NX_SUCCESS);
+    TEST_ASSERT(torn_append(TEST_RECORD_SIZE - TEST_HEADER_SIZE + 4) == NX_SUCCESS);
+    TEST_ASSERT(torn_append(TEST_RECORD_SIZE - TEST_HEADER_SIZE + 12) == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+static UINT test_torn_erase(VOID)
+{
+    FLASH_SEGMENT_LOG log;
+    ULONG per_sector = TEST_SECTOR_SIZE / TEST_RECORD_SIZE;
+    ULONG appended   = per_sector * TEST_SECTOR_COUNT;
+    ULONG dropped;
+    ULONG sequence;
+
+    TEST_ASSERT(blank_log(&log) == NX_SUCCESS);
+
+    for (sequence = 1; sequence <= appended; sequence++)
+    {
+        TEST_ASSERT(log_append(&log, sequence, &dropped) == NX_SUCCESS);
+    }
+
+    // The ring is full, the next append has to recycle the oldest sector and the reset hits during the erase
+    flash_emulator_power_fail_after(0);
+    TEST_ASSERT(log_append(&log, appended + 1, &dropped) != NX_SUCCESS);
+
+    TEST_ASSERT(reboot(&log) == NX_SUCCESS);
+    TEST_ASSERT(log.next_sequence == appended + 1);
+    TEST_ASSERT(log_append(&log, appended + 1, &dropped) == NX_SUCCESS);
+    TEST_ASSERT(dropped == per_sector);
+
+    return log_drain(&log, per_sector + 1, appended + 1);
+}
+
+// Replay everything in the store, checking the order and that a failed send is retried rather than skipped
+static UINT replay(STORE_FORWARD* sf, ULONG first, ULONG last, ULONG fail_at)
+{
+    UCHAR payload[TEST_PAYLOAD_SIZE];
+    ULONG expected = first;
+    UINT failed    = NX_FALSE;
+    ULONG sequence;
+    UINT length;
+
+    while (store_forward_peek(sf, payload, sizeof(payload), &length, &sequence) == NX_SUCCESS)
+    {
+        TEST_ASSERT(sequence == expected);
+        TEST_ASSERT(payload_check(payload, length, sequence));
+
+        if (!failed && sequence == fail_at)
+        {
+            TEST_ASSERT(store_forward_replay_complete(sf, sequence, length, NX_NOT_SUCCESSFUL) == NX_SUCCESS);
+            failed = NX_TRUE;
+            continue;
+        }
+
+        TEST_ASSERT(store_forward_replay_complete(sf, sequence, length, NX_SUCCESS) == NX_SUCCESS);
+        expected++;
+    }
+
+    TEST_ASSERT(expected == last + 1);
+    TEST_ASSERT(store_forward_backlog_get(sf) == 0);
+
+    return NX_SUCCESS;
+}
+
+static UINT test_replay_order(VOID)
+{
+    FLASH_SEGMENT_LOG log;
+    STORE_FORWARD sf;
+    STORE_FORWARD_STATS stats;
+    UCHAR payload[TEST_PAYLOAD_SIZE];
+    ULONG sequence;
+    ULONG first;
+    ULONG first_ram;
+
+    TEST_ASSERT(blank_log(&log) == NX_SUCCESS);
+    TEST_ASSERT(store_forward_create(&sf) == NX_SUCCESS);
+    TEST_ASSERT(store_forward_flash_attach(&sf, &log) == NX_SUCCESS);
+
+    // More than the RAM ring holds, the oldest records spill to flash but replay must still be oldest first
+    for (sequence = 0; sequence < 10; sequence++)
+    {
+        TEST_ASSERT(store_forward_append(&sf, payload, payload_build(payload, sizeof(payload), sequence)) == 0);
+    }
+
+    TEST_ASSERT(store_forward_stats_get(&sf, &stats) == NX_SUCCESS);
+    TEST_ASSERT(stats.spilled > 0 && stats.dropped == 0);
+    TEST_ASSERT(stats.backlog_records == 10);
+    first_ram = stats.spilled;
+
+    // A send that fails part way through the flash backlog is retried, not skipped
+    TEST_ASSERT(replay(&sf, 0, 9, first_ram / 2) == NX_SUCCESS);
+    TEST_ASSERT(store_forward_stats_get(&sf, &stats) == NX_SUCCESS);
+    TEST_ASSERT(stats.replayed == 10 && stats.replay_failed == 1);
+    store_forward_delete(&sf);
+
+    // Reboot with a backlog: what reached flash is replayed first and numbering resumes after it, what was only in
+    // RAM is lost
+    TEST_ASSERT(store_forward_create(&sf) == NX_SUCCESS);
+    TEST_ASSERT(store_forward_flash_attach(&sf, &log) == NX_SUCCESS);
+    first = log.next_sequence;
+
+    for (sequence = first; sequence < first + 10; sequence++)
+    {
+        TEST_ASSERT(store_forward_append(&sf, payload, payload_build(payload, sizeof(payload), sequence)) == 0);
+    }
+
+    TEST_ASSERT(store_forward_stats_get(&sf, &stats) == NX_SUCCESS);
+    first_ram = first + stats.spilled;
+    store_forward_delete(&sf);
+
+    TEST_ASSERT(reboot(&log) == NX_SUCCESS);
+    TEST_ASSERT(log.records == first_ram - first);
+    TEST_ASSERT(log.next_sequence == first_ram);
+    TEST_ASSERT(store_forward_create(&sf) == NX_SUCCESS);
+    TEST_ASSERT(store_forward_flash_attach(&sf, &log) == NX_SUCCESS);
+
+    // The failure this time is on the first record back in RAM, right after the flash backlog
+    TEST_ASSERT(store_forward_append(&sf, payload, payload_build(payload, sizeof(payload), first_ram)) == 0);
+    TEST_ASSERT(replay(&sf, first, first_ram, first_ram) == NX_SUCCESS);
+    store_forward_delete(&sf);
+
+    return NX_SUCCESS;
+}
+
+// Power cycle the board and open the DPS cache over whatever the last boot left in flash
+static UINT dps_reboot(DPS_CACHE* cache)
+{
+    flash_emulator_power_restore();
+
+    return dps_cache_open(cache, flash, TEST_DPS_FIRST_SECTOR, TEST_DPS_SECTOR_COUNT);
+}
+
+static UINT blank_dps_cache(DPS_CACHE* cache)
+{
+    flash_emulator_format();
+
+    return dps_reboot(cache);
+}
+
+static UINT dps_cache_lookup(DPS_CACHE* cache, const CHAR* id_scope, const CHAR* registration_id)
+{
+    CHAR hostname[DPS_CACHE_HOST_NAME_SIZE];
+    CHAR device_id[DPS_CACHE_DEVICE_ID_SIZE];
+
+    return dps_cache_load(cache, id_scope, registration_id, hostname, sizeof(hostname), device_id, sizeof(device_id));
+}
+
+// Check what a connect would use, a NX_NULL hostname when it has to go to DPS
+static UINT dps_cache_expect(DPS_CACHE* cache, const CHAR* hostname, const CHAR* device_id)
+{
+    CHAR cached_hostname[DPS_CACHE_HOST_NAME_SIZE];
+    CHAR cached_device_id[DPS_CACHE_DEVICE_ID_SIZE];
+    UINT status;
+
+    status = dps_cache_load(cache,
+        TEST_ID_SCOPE,
+        TEST_REGISTRATION_ID,
+        cached_hostname,
+        sizeof(cached_hostname),
+        cached_device_id,
+        sizeof(cached_device_id));
+
+    if (hostname == NX_NULL)
+    {
+        TEST_ASSERT(status == NX_NOT_FOUND);
+        return NX_SUCCESS;
+    }
+
+    TEST_ASSERT(status == NX_SUCCESS);
+    TEST_ASSERT(strcmp(cached_hostname, hostname) == 0);
+    TEST_ASSERT(strcmp(cached_device_id, device_id) == 0);
+
+    return NX_SUCCESS;
+}
+
+static UINT test_dps_cache_hit(VOID)
+{
+    DPS_CACHE cache;
+
+    TEST_ASSERT(blank_dps_cache(&cache) == NX_SUCCESS);
+    TEST_ASSERT(dps_cache_expect(&cache, NX_NULL, NX_NULL) == NX_SUCCESS);
+
+    TEST_ASSERT(dps_cache_save(&cache, TEST_ID_SCOPE, TEST_REGISTRATION_ID, "hub-a.azure-devices.net", "device-a") ==
+                NX_SUCCESS);
+    TEST_ASSERT(dps_cache_expect(&cache, "hub-a.azure-devices.net", "device-a") == NX_SUCCESS);
+
+    // The next boot skips DPS
+    TEST_ASSERT(dps_reboot(&cache) == NX_SUCCESS);
+    TEST_ASSERT(dps_cache_expect(&cache, "hub-a.azure-devices.net", "device-a") == NX_SUCCESS);
+
+    // Unless the device was configured with another provisioning identity since
+    TEST_ASSERT(dps_cache_lookup(&cache, TEST_ID_SCOPE, "otherdevice") == NX_NOT_FOUND);
+    TEST_ASSERT(dps_cache_lookup(&cache, "0ne00000001", TEST_REGISTRATION_ID) == NX_NOT_FOUND);
+
+    return NX_SUCCESS;
+}
+
+static UINT test_dps_cache_rejected(VOID)
+{
+    DPS_CACHE cache;
+
+    TEST_ASSERT(blank_dps_cache(&cache) == NX_SUCCESS);
+    TEST_ASSERT(dps_cache_save(&cache, TEST_ID_SCOPE, TEST_REGISTRATION_ID, "hub-a.azure-devices.net", "device-a") ==
+                NX_SUCCESS);
+
+    // The hub refused the cached assignment, it must not be tried again after a reboot
+    TEST_ASSERT(dps_cache_invalidate(&cache) == NX_SUCCESS);
+    TEST_ASSERT(dps_cache_expect(&cache, NX_NULL, NX_NULL) == NX_SUCCESS);
+
+    TEST_ASSERT(dps_reboot(&cache) == NX_SUCCESS);
+    TEST_ASSERT(dps_cache_expect(&cache, NX_NULL, NX_NULL) == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+static UINT test_dps_cache_reprovision(VOID)
+{
+    DPS_CACHE cache;
+    CHAR hostname[DPS_CACHE_HOST_NAME_SIZE];
+    UINT i;
+
+    TEST_ASSERT(blank_dps_cache(&cache) == NX_SUCCESS);
+    TEST_ASSERT(dps_cache_save(&cache, TEST_ID_SCOPE, TEST_REGISTRATION_ID, "hub-0.azure-devices.net", "device-a") ==
+                NX_SUCCESS);
+
+    // Each round the hub rejects the assignment and DPS moves the device, enough rounds to fill and erase the region
+    for (i = 1; i <= 3 * TEST_DPS_SECTOR_COUNT * (TEST_SECTOR_SIZE / TEST_DPS_RECORD_SIZE); i++)
+    {
+        snprintf(hostname, sizeof(hostname), "hub-%u.azure-devices.net", i);
+
+        TEST_ASSERT(dps_cache_invalidate(&cache) == NX_SUCCESS);
+        TEST_ASSERT(dps_cache_save(&cache, TEST_ID_SCOPE, TEST_REGISTRATION_ID, hostname, "device-a") == NX_SUCCESS);
+        TEST_ASSERT(dps_cache_expect(&cache, hostname, "device-a") == NX_SUCCESS);
+
+        TEST_ASSERT(dps_reboot(&cache) == NX_SUCCESS);
+        TEST_ASSERT(dps_cache_expect(&cache, hostname, "device-a") == NX_SUCCESS);
+    }
+
+    return NX_SUCCESS;
+}
+
+// Power cycle the board and open the DHCP lease store over whatever the last boot left in flash
+static UINT lease_reboot(DHCP_LEASE_STORE* store)
+{
+    flash_emulator_power_restore();
+
+    return dhcp_lease_store_open(store, flash, TEST_LEASE_FIRST_SECTOR, TEST_LEASE_SECTOR_COUNT);
+}
+
+static UINT blank_lease_store(DHCP_LEASE_STORE* store)
+{
+    flash_emulator_format();
+
+    return lease_reboot(store);
+}
+
+static VOID lease_build(DHCP_LEASE* lease, ULONG host)
+{
+    memset(lease, 0, sizeof(DHCP_LEASE));
+    lease->ip_address            = IP_ADDRESS(192, 168, 1, host);
+    lease->network_mask          = IP_ADDRESS(255, 255, 255, 0);
+    lease->gateway_address       = IP_ADDRESS(192, 168, 1, 1);
+    lease->server_address        = IP_ADDRESS(192, 168, 1, 1);
+    lease->dns_server_address[0] = IP_ADDRESS(192, 168, 1, 1);
+    lease->dns_server_address[1] = IP_ADDRESS(8, 8, 8, 8);
+    lease->lease_time            = 86400;
+}
+
+// Check what the next DHCP start would ask for, a zero host when it has to run discovery
+static UINT lease_expect(DHCP_LEASE_STORE* store, ULONG host)
+{
+    DHCP_LEASE expected;
+    DHCP_LEASE lease;
+    UINT status;
+
+    status = dhcp_lease_load(store, &lease);
+
+    if (host == 0)
+    {
+        TEST_ASSERT(status == NX_NOT_FOUND);
+        return NX_SUCCESS;
+    }
+
+    lease_build(&expected, host);
+
+    TEST_ASSERT(status == NX_SUCCESS);
+    TEST_ASSERT(memcmp(&lease, &expected, sizeof(lease)) == 0);
+
+    return NX_SUCCESS;
+}
+
+static UINT test_lease_reboot(VOID)
+{
+    DHCP_LEASE_STORE store;
+    DHCP_LEASE lease;
+
+    TEST_ASSERT(blank_lease_store(&store) == NX_SUCCESS);
+    TEST_ASSERT(lease_expect(&store, 0) == NX_SUCCESS);
+
+    lease_build(&lease, 10);
+    TEST_ASSERT(dhcp_lease_save(&store, &lease) == NX_SUCCESS);
+    TEST_ASSERT(lease_expect(&store, 10) == NX_SUCCESS);
+
+    // The next boot asks for the same address
+    TEST_ASSERT(lease_reboot(&store) == NX_SUCCESS);
+    TEST_ASSERT(lease_expect(&store, 10) == NX_SUCCESS);
+
+    // The server confirming the same binding writes nothing, flash that refuses every write shows it
+    flash_emulator_power_fail_after(0);
+    TEST_ASSERT(dhcp_lease_save(&store, &lease) == NX_SUCCESS);
+    TEST_ASSERT(lease_reboot(&store) == NX_SUCCESS);
+    TEST_ASSERT(lease_expect(&store, 10) == NX_SUCCESS);
+
+    // A lease the network no longer honours is gone for good
+    TEST_ASSERT(dhcp_lease_invalidate(&store) == NX_SUCCESS);
+    TEST_ASSERT(lease_expect(&store, 0) == NX_SUCCESS);
+    TEST_ASSERT(lease_reboot(&store) == NX_SUCCESS);
+    TEST_ASSERT(lease_expect(&store, 0) == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+// Lose power at every byte of saving a new lease over an old one. Once the old lease has been touched neither it nor
+// the torn record may be used after the reboot.
+static UINT test_lease_torn_save(VOID)
+{
+    DHCP_LEASE_STORE store;
+    DHCP_LEASE lease;
+    ULONG budget;
+
+    for (budget = 0; budget < 8 + TEST_LEASE_RECORD_SIZE; budget++)
+    {
+        TEST_ASSERT(blank_lease_store(&store) == NX_SUCCESS);
+
+        lease_build(&lease, 10);
+        TEST_ASSERT(dhcp_lease_save(&store, &lease) == NX_SUCCESS);
+
+        lease_build(&lease, 20);
+        flash_emulator_power_fail_after(budget);
+        TEST_ASSERT(dhcp_lease_save(&store, &lease) != NX_SUCCESS);
+
+        TEST_ASSERT(lease_reboot(&store) == NX_SUCCESS);
+        TEST_ASSERT(lease_expect(&store, budget == 0 ? 10 : 0) == NX_SUCCESS);
+
+        // And the next lease lands normally
+        TEST_ASSERT(dhcp_lease_save(&store, &lease) == NX_SUCCESS);
+        TEST_ASSERT(lease_reboot(&store) == NX_SUCCESS);
+        TEST_ASSERT(lease_expect(&store, 20) == NX_SUCCESS);
+    }
+
+    return NX_SUCCESS;
+}
+
+// The lease churning through its sectors, erases included, leaves the DPS assignment next to it alone
+static UINT test_stores_apart(VOID)
+{
+    DHCP_LEASE_STORE store;
+    DHCP_LEASE lease;
+    DPS_CACHE cache;
+    ULONG host = 0;
+    UINT i;
+
+    TEST_ASSERT(blank_dps_cache(&cache) == NX_SUCCESS);
+    TEST_ASSERT(lease_reboot(&store) == NX_SUCCESS);
+    TEST_ASSERT(dps_cache_save(&cache, TEST_ID_SCOPE, TEST_REGISTRATION_ID, "hub-a.azure-devices.net", "device-a") ==
+                NX_SUCCESS);
+
+    for (i = 1; i <= 3 * TEST_LEASE_SECTOR_COUNT * (TEST_SECTOR_SIZE / TEST_LEASE_RECORD_SIZE); i++)
+    {
+        host = 10 + i % 200;
+        lease_build(&lease, host);
+        TEST_ASSERT(dhcp_lease_save(&store, &lease) == NX_SUCCESS);
+    }
+
+    TEST_ASSERT(dps_reboot(&cache) == NX_SUCCESS);
+    TEST_ASSERT(dps_cache_expect(&cache, "hub-a.azure-devices.net", "device-a") == NX_SUCCESS);
+
+    // And the other way round
+    for (i = 1; i <= 3 * TEST_DPS_SECTOR_COUNT * (TEST_SECTOR_SIZE / TEST_DPS_RECORD_SIZE); i++)
+    {
+        const CHAR* device_id = i % 2 ? "device-b" : "device-c";
+
+        TEST_ASSERT(dps_cache_save(&cache, TEST_ID_SCOPE, TEST_REGISTRATION_ID, "hub-b.azure-devices.net", device_id) ==
+                    NX_SUCCESS);
+    }
+
+    TEST_ASSERT(lease_reboot(&store) == NX_SUCCESS);
+    TEST_ASSERT(lease_expect(&store, host) == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+static const struct
+{
+    const CHAR* name;
+    func_ptr_test run;
+} tests[] = {
+    {"emulator_rules", test_emulator_rules},
+    {"segment_wrap", test_segment_wrap},
+    {"torn_write", test_torn_write},
+    {"torn_erase", test_torn_erase},
+    {"replay_order", test_replay_order},
+    {"dps_cache_hit", test_dps_cache_hit},
+    {"dps_cache_rejected", test_dps_cache_rejected},
+    {"dps_cache_reprovision", test_dps_cache_reprovision},
+    {"lease_reboot", test_lease_reboot},
+    {"lease_torn_save", test_lease_torn_save},
+    {"stores_apart", test_stores_apart},
+};
+
+static VOID test_entry(ULONG parameter)
+{
+    UINT failures = 0;
+    UINT i;
+
+    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    {
+        printf("%s\n", tests[i].name);
+
+        if (tests[i].run() != NX_SUCCESS)
+        {
+            failures++;
+        }
+    }
+
+    printf("%u of %u tests passed\n",
+        (UINT)(sizeof(tests) / sizeof(tests[0])) - failures,
+        (UINT)(sizeof(tests) / sizeof(tests[0])));
+
+    exit(failures ? 1 : 0);
+}
+
+VOID tx_application_define(VOID* first_unused_memory)
+{
+    tx_thread_create(&test_thread,
+        "flash storage test",
+        test_entry,
+        0,
+        test_stack,
+        sizeof(test_stack),
+        TEST_PRIORITY,
+        TEST_PRIORITY,
+        TX_NO_TIME_SLICE,
+        TX_AUTO_START);
+}
+
+int main(int argc, char* argv[])
+{
+    tx_kernel_enter();
+
+    return 0;
+}
@@ -0,0 +1,9 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef NX_USER_H
+#define NX_USER_H
+
+// Only the status codes and types are used, the stack itself is never started
+
+#endif // NX_USER_H
@@ -12,4 +12,4 @@ CODENAME=$(lsb_release -c | cut -f2 -d':' | sed 's/\t//')
 sudo apt-add-repository "deb https://apt.kitware.com/ubuntu/ $CODENAME main"
 
 sudo apt-get update
-sudo apt-get install  gcc-arm-none-eabi ninja-build cmake 
+sudo apt-get install  gcc-arm-none-eabi ninja-build cmake python3
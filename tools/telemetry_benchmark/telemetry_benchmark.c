@@ -0,0 +1,245 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCHMARK_HAS_CYCLES 1
+#endif
+
+#include "pnp_model.h"
+#include "telemetry_writer.h"
+
+#define SAMPLE_COUNT    256
+#define ITERATION_COUNT 2000
+#define MESSAGE_SIZE    512
+
+typedef struct SENSOR_SAMPLE_STRUCT
+{
+    double temperature;
+    double humidity;
+    double pressure;
+    double magnetic[3];
+    double acceleration[3];
+    double angular_rate[3];
+} SENSOR_SAMPLE;
+
+typedef struct MESSAGE_KIND_STRUCT
+{
+    const CHAR* name;
+    func_ptr_telemetry_append append;
+} MESSAGE_KIND;
+
+typedef struct RESULT_STRUCT
+{
+    ULONG bytes;
+    double nanoseconds;
+    double cycles;
+} RESULT;
+
+static SENSOR_SAMPLE samples[SAMPLE_COUNT];
+static UCHAR message[MESSAGE_SIZE];
+
+// Deterministic readings in the ranges the MXChip sensors report, rounded like the float sensor drivers produce
+static double sample_value(ULONG* seed, double low, double high)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return (double)(float)(low + (high - low) * ((*seed >> 8) & 0xFFFF) / 65535.0);
+}
+
+static VOID samples_init(VOID)
+{
+    ULONG seed = 1;
+    UINT i;
+    UINT axis;
+
+    for (i = 0; i < SAMPLE_COUNT; i++)
+    {
+        samples[i].temperature = sample_value(&seed, 18, 32);
+        samples[i].humidity    = sample_value(&seed, 25, 70);
+        samples[i].pressure    = sample_value(&seed, 980, 1030);
+
+        for (axis = 0; axis < 3; axis++)
+        {
+            samples[i].magnetic[axis]     = sample_value(&seed, -600, 600);
+            samples[i].acceleration[axis] = sample_value(&seed, -1100, 1100);
+            samples[i].angular_rate[axis] = sample_value(&seed, -2000, 2000);
+        }
+    }
+}
+
+static UINT append_environment(TELEMETRY_WRITER* writer, VOID* context)
+{
+    SENSOR_SAMPLE* sample = (SENSOR_SAMPLE*)context;
+
+    return pnp_telemetry_humidity_append(writer, sample->humidity) ||
+           pnp_telemetry_temperature_append(writer, sample->temperature) ||
+           pnp_telemetry_pressure_append(writer, sample->pressure);
+}
+
+static UINT append_magnetometer(TELEMETRY_WRITER* writer, VOID* context)
+{
+    SENSOR_SAMPLE* sample = (SENSOR_SAMPLE*)context;
+
+    return pnp_telemetry_magnetometer_x_append(writer, sample->magnetic[0]) ||
+           pnp_telemetry_magnetometer_y_append(writer, sample->magnetic[1]) ||
+           pnp_telemetry_magnetometer_z_append(writer, sample->magnetic[2]);
+}
+
+static UINT append_accelerometer(TELEMETRY_WRITER* writer, VOID* context)
+{
+    SENSOR_SAMPLE* sample = (SENSOR_SAMPLE*)context;
+
+    return pnp_telemetry_accelerometer_x_append(writer, sample->acceleration[0]) ||
+           pnp_telemetry_accelerometer_y_append(writer, sample->acceleration[1]) ||
+           pnp_telemetry_accelerometer_z_append(writer, sample->acceleration[2]);
+}
+
+static UINT append_gyroscope(TELEMETRY_WRITER* writer, VOID* context)
+{
+    SENSOR_SAMPLE* sample = (SENSOR_SAMPLE*)context;
+
+    return pnp_telemetry_gyroscope_x_append(writer, sample->angular_rate[0]) ||
+           pnp_telemetry_gyroscope_y_append(writer, sample->angular_rate[1]) ||
+           pnp_telemetry_gyroscope_z_append(writer, sample->angular_rate[2]);
+}
+
+static UINT append_all_channels(TELEMETRY_WRITER* writer, VOID* context)
+{
+    return append_environment(writer, context) || append_magnetometer(writer, context) ||
+           append_accelerometer(writer, context) || append_gyroscope(writer, context);
+}
+
+static const MESSAGE_KIND message_kinds[] = {
+    {"environment", append_environment},
+    {"magnetometer", append_magnetometer},
+    {"accelerometer", append_accelerometer},
+    {"gyroscope", append_gyroscope},
+    {"all 12 channels", append_all_channels},
+};
+
+static double now_nanoseconds(VOID)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)now.tv_sec * 1e9 + (double)now.tv_nsec;
+}
+
+static double now_cycles(VOID)
+{
+#ifdef BENCHMARK_HAS_CYCLES
+    return (double)__rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static UINT encode(TELEMETRY_ENCODING encoding, func_ptr_telemetry_append append, SENSOR_SAMPLE* sample, UINT* length)
+{
+    UINT status;
+    TELEMETRY_WRITER writer;
+
+    if ((status = telemetry_writer_with_buffer_init(&writer, encoding, message, sizeof(message))) ||
+        (status = telemetry_writer_build(&writer, append, sample)))
+    {
+        return status;
+    }
+
+    *length = telemetry_writer_get_bytes_used(&writer);
+    telemetry_writer_deinit(&writer);
+
+    return NX_SUCCESS;
+}
+
+static UINT measure(TELEMETRY_ENCODING encoding, func_ptr_telemetry_append append, RESULT* result)
+{
+    UINT status;
+    UINT length;
+    UINT i;
+    double start_nanoseconds;
+    double start_cycles;
+
+    result->bytes = 0;
+
+    for (i = 0; i < SAMPLE_COUNT; i++)
+    {
+        if ((status = encode(encoding, append, &samples[i], &length)))
+        {
+            return status;
+        }
+
+        result->bytes += length;
+    }
+
+    start_nanoseconds = now_nanoseconds();
+    start_cycles      = now_cycles();
+
+    for (i = 0; i < ITERATION_COUNT * SAMPLE_COUNT; i++)
+    {
+        encode(encoding, append, &samples[i % SAMPLE_COUNT], &length);
+    }
+
+    result->cycles      = (now_cycles() - start_cycles) / (ITERATION_COUNT * SAMPLE_COUNT);
+    result->nanoseconds = (now_nanoseconds() - start_nanoseconds) / (ITERATION_COUNT * SAMPLE_COUNT);
+    result->bytes /= SAMPLE_COUNT;
+
+    return NX_SUCCESS;
+}
+
+// Topic suffix the client adds to tag the payload, part of the bytes each message costs on the wire
+static UINT content_properties_length(TELEMETRY_ENCODING encoding)
+{
+    return (UINT)(strlen("$.ct=&$.ce=&") + strlen(telemetry_encoding_content_type(encoding)) +
+                  strlen(telemetry_encoding_content_encoding(encoding)));
+}
+
+int main(VOID)
+{
+    RESULT json;
+    RESULT cbor;
+    UINT i;
+
+    samples_init();
+
+    printf("%u samples, %u iterations, payload bytes are per message, wire adds the $.ct/$.ce topic properties\n\n",
+        SAMPLE_COUNT,
+        ITERATION_COUNT);
+    printf("%-16s %9s %9s %9s %9s %9s %9s %9s %9s\n",
+        "message",
+        "json B",
+        "cbor B",
+        "json wire",
+        "cbor wire",
+        "json ns",
+        "cbor ns",
+        "json cyc",
+        "cbor cyc");
+
+    for (i = 0; i < sizeof(message_kinds) / sizeof(message_kinds[0]); i++)
+    {
+        if (measure(TELEMETRY_ENCODING_JSON, message_kinds[i].append, &json) ||
+            measure(TELEMETRY_ENCODING_CBOR, message_kinds[i].append, &cbor))
+        {
+            printf("ERROR: failed to encode %s\n", message_kinds[i].name);
+            return 1;
+        }
+
+        printf("%-16s %9lu %9lu %9lu %9lu %9.0f %9.0f %9.0f %9.0f\n",
+            message_kinds[i].name,
+            json.bytes,
+            cbor.bytes,
+            json.bytes + content_properties_length(TELEMETRY_ENCODING_JSON),
+            cbor.bytes + content_properties_length(TELEMETRY_ENCODING_CBOR),
+            json.nanoseconds,
+            cbor.nanoseconds,
+            json.cycles,
+            cbor.cycles);
+    }
+
+    return 0;
+}
@@ -0,0 +1,13 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef NX_USER_H
+#define NX_USER_H
+
+// Minimal configuration needed to build the Azure IoT addon on the host
+#define NX_SECURE_ENABLE
+#define NX_ENABLE_EXTENDED_NOTIFY_SUPPORT
+#define NX_DNS_CLIENT_USER_CREATE_PACKET_POOL
+#define NXD_MQTT_CLOUD_ENABLE
+
+#endif // NX_USER_H
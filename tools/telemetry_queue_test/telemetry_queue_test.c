@@ -0,0 +1,323 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "tx_api.h"
+
+#include "nx_api.h"
+
+#include "telemetry_batch.h"
+#include "telemetry_deadband.h"
+#include "telemetry_queue.h"
+
+#define TEST_STACK_SIZE (16 * 1024)
+#define TEST_PRIORITY   4
+
+#define TEST_BATCH_EVENT 0x01
+
+// Small packets, so a message larger than one has to be chained
+#define TEST_PACKET_PAYLOAD 128
+#define TEST_PACKET_COUNT   16
+
+#define TEST_ASSERT(condition)                                                                                         \
+    if (!(condition))                                                                                                  \
+    {                                                                                                                  \
+        printf("  FAIL: %s:%d: %s\n", __FILE__, __LINE__, #condition);                                                 \
+        return NX_NOT_SUCCESSFUL;                                                                                      \
+    }
+
+typedef UINT (*func_ptr_test)(VOID);
+
+static TX_THREAD test_thread;
+static ULONG test_stack[TEST_STACK_SIZE / sizeof(ULONG)];
+
+static NX_PACKET_POOL pool;
+static UCHAR pool_memory[TEST_PACKET_COUNT * (TEST_PACKET_PAYLOAD + sizeof(NX_PACKET))];
+
+static TELEMETRY_QUEUE queue;
+static TELEMETRY_QUEUE_ENTRY entry;
+
+// Any change is reported and there is no heartbeat, so only a released deadband lets a repeated value through
+static TELEMETRY_DEADBAND temperature = TELEMETRY_DEADBAND_INIT(0, 0, 0);
+static TELEMETRY_DEADBAND humidity    = TELEMETRY_DEADBAND_INIT(0, 0, 0);
+
+// The sample the append callback writes next
+static TELEMETRY_DEADBAND* sample_deadband;
+static double sample_value;
+
+static UINT append_sample(TELEMETRY_WRITER* writer, VOID* context)
+{
+    if (!telemetry_writer_deadband_check(writer, sample_deadband, sample_value))
+    {
+        return NX_AZURE_IOT_SUCCESS;
+    }
+
+    return telemetry_writer_append_property_with_double_value(writer, (UCHAR*)"value", 5, sample_value, 2);
+}
+
+// Longer than the old fixed message size, and than several packets
+static UCHAR long_value[600];
+
+static UINT append_long(TELEMETRY_WRITER* writer, VOID* context)
+{
+    return telemetry_writer_append_property_with_string_value(
+        writer, (UCHAR*)"value", 5, long_value, sizeof(long_value));
+}
+
+static UINT sample_push(TELEMETRY_DEADBAND* deadband, double value)
+{
+    sample_deadband = deadband;
+    sample_value    = value;
+
+    return telemetry_queue_push(&queue, TELEMETRY_ENCODING_CBOR, append_sample, NX_NULL, NX_NULL);
+}
+
+static UINT sample_batch(TELEMETRY_BATCH* batch, TELEMETRY_DEADBAND* deadband, double value)
+{
+    sample_deadband = deadband;
+    sample_value    = value;
+
+    return telemetry_batch_append(batch, 0, append_sample);
+}
+
+// Start every test from an empty queue and deadbands that have never reported
+static UINT queue_open(TELEMETRY_QUEUE_POLICY policy)
+{
+    telemetry_deadband_set(&temperature, 0, 0, 0);
+    telemetry_deadband_set(&humidity, 0, 0, 0);
+
+    return telemetry_queue_create(&queue, &pool, policy);
+}
+
+// Every test gives back the packets it queued
+static UINT queue_close(VOID)
+{
+    telemetry_queue_delete(&queue);
+
+    return (pool.nx_packet_pool_available == pool.nx_packet_pool_total) ? NX_SUCCESS : NX_NOT_SUCCESSFUL;
+}
+
+// Send every queued message with the same outcome
+static VOID queue_drain(UINT status)
+{
+    while (telemetry_queue_pop(&queue, &entry) == NX_SUCCESS)
+    {
+        telemetry_queue_complete(&queue, &entry, status);
+    }
+}
+
+static UINT test_delivered(VOID)
+{
+    TEST_ASSERT(queue_open(TELEMETRY_QUEUE_DROP_OLDEST) == NX_SUCCESS);
+
+    TEST_ASSERT(sample_push(&temperature, 21) == NX_SUCCESS);
+    queue_drain(NX_SUCCESS);
+
+    // The hub has the value, repeating it is filtered
+    TEST_ASSERT(sample_push(&temperature, 21) == NX_NOT_FOUND);
+
+    // Handed to store and forward, the value is still on its way
+    TEST_ASSERT(sample_push(&temperature, 22) == NX_SUCCESS);
+    queue_drain(NX_IN_PROGRESS);
+    TEST_ASSERT(sample_push(&temperature, 22) == NX_NOT_FOUND);
+
+    TEST_ASSERT(queue_close() == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+static UINT test_send_failed(VOID)
+{
+    TEST_ASSERT(queue_open(TELEMETRY_QUEUE_DROP_OLDEST) == NX_SUCCESS);
+
+    TEST_ASSERT(sample_push(&temperature, 21) == NX_SUCCESS);
+    queue_drain(NX_NOT_CONNECTED);
+
+    // The hub never saw 21, so it goes out again
+    TEST_ASSERT(sample_push(&temperature, 21) == NX_SUCCESS);
+    queue_drain(NX_SUCCESS);
+    TEST_ASSERT(sample_push(&temperature, 21) == NX_NOT_FOUND);
+
+    TEST_ASSERT(queue_close() == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+static UINT test_evicted(VOID)
+{
+    TEST_ASSERT(queue_open(TELEMETRY_QUEUE_DROP_OLDEST) == NX_SUCCESS);
+
+    TEST_ASSERT(sample_push(&humidity, 40) == NX_SUCCESS);
+    TEST_ASSERT(sample_push(&temperature, 21) == NX_SUCCESS);
+
+    // Evicting 40 leaves humidity alone, the message pushing it out carries the newer 41
+    TEST_ASSERT(sample_push(&humidity, 41) == NX_SUCCESS);
+    TEST_ASSERT(sample_push(&humidity, 41) == NX_NOT_FOUND);
+
+    // Evicting 21 lets the temperature through again
+    TEST_ASSERT(sample_push(&humidity, 42) == NX_SUCCESS);
+    TEST_ASSERT(sample_push(&temperature, 21) == NX_SUCCESS);
+
+    // Deleting the queue gives back the packets of the messages still in it
+    TEST_ASSERT(queue_close() == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+static UINT test_batch_refused(VOID)
+{
+    TELEMETRY_BATCH batch;
+    TX_EVENT_FLAGS_GROUP events;
+    TELEMETRY_QUEUE_STATS stats;
+
+    TEST_ASSERT(queue_open(TELEMETRY_QUEUE_DROP_NEWEST) == NX_SUCCESS);
+    TEST_ASSERT(tx_event_flags_create(&events, "telemetry queue test") == TX_SUCCESS);
+    TEST_ASSERT(telemetry_batch_create(&batch, &queue, &events, TEST_BATCH_EVENT) == NX_SUCCESS);
+    TEST_ASSERT(telemetry_batch_config_set(&batch, 2, TX_TIMER_TICKS_PER_SECOND) == NX_SUCCESS);
+
+    TEST_ASSERT(sample_push(&humidity, 40) == NX_SUCCESS);
+    TEST_ASSERT(sample_push(&humidity, 41) == NX_SUCCESS);
+
+    // The second sample closes the batch, which the full queue turns away
+    TEST_ASSERT(sample_batch(&batch, &temperature, 21) == NX_SUCCESS);
+    TEST_ASSERT(sample_batch(&batch, &temperature, 22) == NX_OVERFLOW);
+
+    // Once there is room again 22 is sent rather than filtered against the lost batch
+    queue_drain(NX_SUCCESS);
+    TEST_ASSERT(sample_batch(&batch, &temperature, 22) == NX_SUCCESS);
+    TEST_ASSERT(sample_batch(&batch, &temperature, 22) == NX_NOT_FOUND);
+    TEST_ASSERT(telemetry_batch_flush(&batch) == NX_SUCCESS);
+
+    TEST_ASSERT(telemetry_queue_stats_get(&queue, &stats) == NX_SUCCESS);
+    TEST_ASSERT(stats.depth == 1);
+
+    telemetry_batch_delete(&batch);
+    tx_event_flags_delete(&events);
+    queue_drain(NX_SUCCESS);
+    TEST_ASSERT(queue_close() == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+static UINT test_pool_empty(VOID)
+{
+    NX_PACKET* packets[TEST_PACKET_COUNT];
+    TELEMETRY_QUEUE_STATS stats;
+    UINT count = 0;
+
+    TEST_ASSERT(queue_open(TELEMETRY_QUEUE_DROP_OLDEST) == NX_SUCCESS);
+
+    while (count < TEST_PACKET_COUNT &&
+           nx_packet_allocate(&pool, &packets[count], NX_RECEIVE_PACKET, NX_NO_WAIT) == NX_SUCCESS)
+    {
+        count++;
+    }
+
+    // Refused before the message is built, so the deadband never sees 21
+    TEST_ASSERT(sample_push(&temperature, 21) == NX_NO_PACKET);
+    TEST_ASSERT(telemetry_queue_stats_get(&queue, &stats) == NX_SUCCESS);
+    TEST_ASSERT(stats.no_packet == 1 && stats.depth == 0);
+
+    while (count > 0)
+    {
+        nx_packet_release(packets[--count]);
+    }
+
+    TEST_ASSERT(sample_push(&temperature, 21) == NX_SUCCESS);
+    queue_drain(NX_SUCCESS);
+    TEST_ASSERT(queue_close() == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+static UINT test_large_payload(VOID)
+{
+    UINT i;
+
+    TEST_ASSERT(queue_open(TELEMETRY_QUEUE_DROP_OLDEST) == NX_SUCCESS);
+
+    for (i = 0; i < sizeof(long_value); i++)
+    {
+        long_value[i] = (UCHAR)('a' + i % 26);
+    }
+
+    // Built straight into a chain of packets, nothing caps the message at a fixed buffer size
+    TEST_ASSERT(telemetry_queue_push(&queue, TELEMETRY_ENCODING_CBOR, append_long, NX_NULL, NX_NULL) == NX_SUCCESS);
+    TEST_ASSERT(telemetry_queue_pop(&queue, &entry) == NX_SUCCESS);
+    TEST_ASSERT(entry.encoding == TELEMETRY_ENCODING_CBOR);
+    TEST_ASSERT(entry.payload != NX_NULL && entry.payload->nx_packet_length > sizeof(long_value));
+    TEST_ASSERT(entry.payload->nx_packet_next != NX_NULL);
+
+    // A completed message gives its packets back
+    telemetry_queue_complete(&queue, &entry, NX_NOT_CONNECTED);
+    TEST_ASSERT(entry.payload == NX_NULL);
+    TEST_ASSERT(queue_close() == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+static const struct
+{
+    const CHAR* name;
+    func_ptr_test run;
+} tests[] = {
+    {"delivered", test_delivered},
+    {"send_failed", test_send_failed},
+    {"evicted", test_evicted},
+    {"batch_refused", test_batch_refused},
+    {"pool_empty", test_pool_empty},
+    {"large_payload", test_large_payload},
+};
+
+static VOID test_entry(ULONG parameter)
+{
+    UINT failures = 0;
+    UINT i;
+
+    nx_system_initialize();
+
+    if (nx_packet_pool_create(&pool, "telemetry queue test", TEST_PACKET_PAYLOAD, pool_memory, sizeof(pool_memory)))
+    {
+        printf("ERROR: failed to create the packet pool\n");
+        exit(1);
+    }
+
+    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    {
+        printf("%s\n", tests[i].name);
+
+        if (tests[i].run() != NX_SUCCESS)
+        {
+            failures++;
+        }
+    }
+
+    printf("%u of %u tests passed\n",
+        (UINT)(sizeof(tests) / sizeof(tests[0])) - failures,
+        (UINT)(sizeof(tests) / sizeof(tests[0])));
+
+    exit(failures ? 1 : 0);
+}
+
+VOID tx_application_define(VOID* first_unused_memory)
+{
+    tx_thread_create(&test_thread,
+        "telemetry queue test",
+        test_entry,
+        0,
+        test_stack,
+        sizeof(test_stack),
+        TEST_PRIORITY,
+        TEST_PRIORITY,
+        TX_NO_TIME_SLICE,
+        TX_AUTO_START);
+}
+
+int main(int argc, char* argv[])
+{
+    tx_kernel_enter();
+
+    return 0;
+}
@@ -0,0 +1,12 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef NX_USER_H
+#define NX_USER_H
+
+// Build both ciphersuite profiles so they can be compared
+#define NX_SECURE_ENABLE
+#define NX_SECURE_ENABLE_ECC_CIPHERSUITE
+#define NX_SECURE_ENABLE_AEAD_CIPHER
+
+#endif // NX_USER_H
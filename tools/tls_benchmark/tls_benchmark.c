@@ -0,0 +1,529 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tx_api.h"
+
+#include "nx_api.h"
+#include "nx_crypto.h"
+#include "nx_secure_tls_api.h"
+
+#include "azure_iot_ciphersuites.h"
+
+#define HANDSHAKE_ITERATIONS 20
+#define RECORD_ITERATIONS    2000
+#define RECORD_SIZE_MAX      1024
+
+#define CRYPTO_METADATA_SIZE   (16 * 1024)
+#define SESSION_METADATA_LIMIT (32 * 1024)
+#define METADATA_PROBE_STEP    16
+
+#define BENCHMARK_STACK_SIZE (32 * 1024)
+#define BENCHMARK_PRIORITY   4
+
+// Certificates a client checks while connecting to the hub: the server certificate and one intermediate
+#define CHAIN_SIGNATURES 2
+
+#define AES_KEY_BITS  128
+#define HMAC_KEY_BITS 256
+#define HMAC_SIZE     32
+#define GCM_TAG_SIZE  16
+#define GCM_AAD_SIZE  13
+
+// Room for the payload, its MAC and a block of padding
+#define RECORD_BUFFER_SIZE (RECORD_SIZE_MAX + HMAC_SIZE + AES_KEY_BITS / 8)
+
+extern NX_CRYPTO_METHOD crypto_method_rsa;
+extern NX_CRYPTO_METHOD crypto_method_ecdhe;
+extern NX_CRYPTO_METHOD crypto_method_ecdsa;
+extern NX_CRYPTO_METHOD crypto_method_ec_secp256;
+extern NX_CRYPTO_METHOD crypto_method_aes_cbc_128;
+extern NX_CRYPTO_METHOD crypto_method_aes_128_gcm_16;
+extern NX_CRYPTO_METHOD crypto_method_hmac_sha256;
+
+// Fixed keys so runs are comparable, the EC signature is over ecdsa_digest with the key behind ec_public_key
+static const UCHAR rsa_exponent[] = {0x01, 0x00, 0x01};
+
+static const UCHAR rsa_modulus[] = {
+    0xe9, 0xae, 0xf7, 0xfd, 0xbd, 0x24, 0xba, 0x3a, 0xe7, 0xc9, 0xad, 0x4d,
+    0xe3, 0xbf, 0x81, 0x17, 0x92, 0x5c, 0xf9, 0x92, 0xac, 0x2e, 0x88, 0x4c,
+    0xe6, 0x5d, 0x23, 0x2a, 0xff, 0xe7, 0x5a, 0x48, 0x43, 0x6a, 0xd6, 0x5f,
+    0x8b, 0x51, 0xb0, 0xfc, 0x4e, 0x63, 0x14, 0x2d, 0xcf, 0x20, 0xd6, 0x3b,
+    0x07, 0x08, 0x53, 0x0a, 0xb1, 0x61, 0xec, 0xce, 0x34, 0xf9, 0x51, 0xf1,
+    0x61, 0x7c, 0xbf, 0x1a, 0x29, 0x57, 0xbc, 0x9b, 0x82, 0x0a, 0x9b, 0x79,
+    0xc7, 0x8d, 0x5c, 0xa5, 0x6e, 0x57, 0xc4, 0x71, 0x31, 0xe0, 0xd8, 0xf7,
+    0xe8, 0x8e, 0xc3, 0x26, 0x05, 0x51, 0x9e, 0xf7, 0xea, 0x75, 0x2e, 0x12,
+    0x1c, 0xc3, 0xc6, 0x93, 0x1a, 0xf1, 0x3c, 0x86, 0x4b, 0xac, 0xbd, 0xb0,
+    0x5e, 0x26, 0x78, 0x9d, 0xa9, 0xff, 0x0c, 0x97, 0x35, 0x28, 0xa4, 0x6f,
+    0x64, 0xf3, 0x7f, 0x23, 0x66, 0x11, 0x4d, 0xb7, 0x8e, 0x4a, 0xd4, 0x08,
+    0xf7, 0x33, 0x03, 0x9f, 0x8f, 0xd1, 0xc6, 0x60, 0x75, 0xab, 0x2b, 0xb6,
+    0xd8, 0x32, 0xac, 0xc3, 0x4c, 0x58, 0x4e, 0x75, 0xdc, 0x2e, 0xd4, 0xe2,
+    0xc6, 0xc3, 0x5d, 0xb6, 0xfb, 0xcf, 0xcd, 0xeb, 0xcd, 0x8c, 0xde, 0x30,
+    0x3e, 0x95, 0xe7, 0x27, 0xc4, 0x22, 0x27, 0xa9, 0xee, 0x17, 0x86, 0x51,
+    0xc0, 0x28, 0xbf, 0xbf, 0xdd, 0xa2, 0x68, 0xa3, 0xe5, 0x18, 0x64, 0x49,
+    0xe4, 0xf9, 0x11, 0xa4, 0x48, 0x1c, 0x1d, 0xbe, 0xc6, 0x40, 0x01, 0x40,
+    0x5a, 0xab, 0xd2, 0x9c, 0x92, 0xbe, 0x20, 0x09, 0x2a, 0x94, 0x5b, 0x84,
+    0x27, 0xdf, 0xa9, 0x9b, 0x8a, 0x2b, 0x96, 0x50, 0x38, 0xac, 0x81, 0x60,
+    0xc9, 0x7a, 0xf2, 0xe1, 0x8e, 0x23, 0x50, 0x22, 0xc4, 0x21, 0xe7, 0x6c,
+    0x0d, 0x30, 0xbd, 0x10, 0x5f, 0x17, 0x6c, 0x7a, 0xe4, 0x31, 0x72, 0xf2,
+    0x95, 0x07, 0x3c, 0x4d,
+};
+static const UCHAR ec_public_key[] = {
+    0x04, 0x9f, 0x3d, 0x82, 0x21, 0xc9, 0x79, 0x55, 0x69, 0x5d, 0xfe, 0x81,
+    0x1e, 0x79, 0xb7, 0x9f, 0x1a, 0x91, 0xa8, 0x04, 0x66, 0xdf, 0x53, 0xec,
+    0x3d, 0x97, 0xcd, 0xde, 0xd5, 0xd6, 0x92, 0xa8, 0x43, 0x6f, 0x03, 0xc7,
+    0xa5, 0x7c, 0x3c, 0xc2, 0xf8, 0x10, 0x0a, 0x4b, 0xe5, 0x7d, 0xd6, 0xb1,
+    0x8b, 0xf3, 0x4b, 0x9f, 0x02, 0x0f, 0xdf, 0xdc, 0xd1, 0xc3, 0xc2, 0x02,
+    0x00, 0xf9, 0x6e, 0x42, 0x8c,
+};
+static const UCHAR ecdsa_digest[] = {
+    0x79, 0xed, 0xf2, 0x69, 0x55, 0x53, 0x3d, 0x1e, 0x5a, 0x42, 0xd5, 0x6c,
+    0x7c, 0x14, 0xaa, 0x8a, 0x85, 0x49, 0x41, 0xc2, 0xbb, 0xe4, 0x74, 0x83,
+    0x62, 0x51, 0x8b, 0xc7, 0x15, 0x00, 0x2c, 0x14,
+};
+static const UCHAR ecdsa_signature[] = {
+    0x30, 0x45, 0x02, 0x20, 0x27, 0x31, 0x2f, 0x34, 0xcb, 0x24, 0x5d, 0x9c,
+    0x3b, 0xf0, 0x1b, 0x70, 0x6a, 0xb0, 0x85, 0x45, 0xc0, 0x6c, 0x45, 0x6b,
+    0xa3, 0x4f, 0xfe, 0xba, 0x16, 0xa1, 0xb0, 0x41, 0xdf, 0x54, 0xf9, 0xf2,
+    0x02, 0x21, 0x00, 0xe0, 0x43, 0x4b, 0x56, 0x10, 0xa1, 0x01, 0xc8, 0x85,
+    0xe7, 0x81, 0x45, 0x54, 0x72, 0xb1, 0x25, 0x1f, 0x0c, 0x6c, 0x6d, 0x43,
+    0x4d, 0xcd, 0x04, 0xcf, 0xc7, 0x2a, 0x39, 0xcb, 0x56, 0x4f, 0x44,
+};
+
+static const UINT record_sizes[] = {64, 256, 1024};
+
+static ULONG crypto_metadata[CRYPTO_METADATA_SIZE / sizeof(ULONG)];
+static ULONG session_metadata[SESSION_METADATA_LIMIT / sizeof(ULONG)];
+static NX_SECURE_TLS_SESSION tls_session;
+
+static UCHAR record_input[RECORD_BUFFER_SIZE];
+static UCHAR record_output[RECORD_BUFFER_SIZE];
+
+static TX_THREAD benchmark_thread;
+static ULONG benchmark_stack[BENCHMARK_STACK_SIZE / sizeof(ULONG)];
+
+static double now_nanoseconds(VOID)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)now.tv_sec * 1e9 + (double)now.tv_nsec;
+}
+
+static UINT crypto_init(NX_CRYPTO_METHOD* method, UCHAR* key, NX_CRYPTO_KEY_SIZE key_bits, VOID** handle)
+{
+    *handle = NX_NULL;
+
+    if (method->nx_crypto_metadata_area_size > sizeof(crypto_metadata))
+    {
+        return NX_SIZE_ERROR;
+    }
+
+    if (method->nx_crypto_init == NX_NULL)
+    {
+        return NX_SUCCESS;
+    }
+
+    return method->nx_crypto_init(
+        method, key, key_bits, handle, crypto_metadata, method->nx_crypto_metadata_area_size);
+}
+
+static VOID crypto_cleanup(NX_CRYPTO_METHOD* method)
+{
+    if (method->nx_crypto_cleanup)
+    {
+        method->nx_crypto_cleanup(crypto_metadata);
+    }
+}
+
+static UINT crypto_operation(NX_CRYPTO_METHOD* method,
+    UINT op,
+    VOID* handle,
+    UCHAR* key,
+    NX_CRYPTO_KEY_SIZE key_bits,
+    UCHAR* input,
+    ULONG input_length,
+    UCHAR* iv,
+    UCHAR* output,
+    ULONG output_length)
+{
+    return method->nx_crypto_operation(op,
+        handle,
+        method,
+        key,
+        key_bits,
+        input,
+        input_length,
+        iv,
+        output,
+        output_length,
+        crypto_metadata,
+        method->nx_crypto_metadata_area_size,
+        NX_NULL,
+        NX_NULL);
+}
+
+// RSA public key operation, what the client does to send the premaster secret and to check each RSA signature
+static UINT rsa_public(VOID)
+{
+    UCHAR block[sizeof(rsa_modulus)];
+    UCHAR output[sizeof(rsa_modulus)];
+    VOID* handle;
+    UINT status;
+
+    memset(block, 0x5A, sizeof(block));
+    block[0] = 0x00;
+    block[1] = 0x02;
+
+    status = crypto_init(&crypto_method_rsa, (UCHAR*)rsa_modulus, sizeof(rsa_modulus) << 3, &handle);
+    if (status == NX_SUCCESS)
+    {
+        status = crypto_operation(&crypto_method_rsa,
+            NX_CRYPTO_ENCRYPT,
+            handle,
+            (UCHAR*)rsa_exponent,
+            sizeof(rsa_exponent) << 3,
+            block,
+            sizeof(block),
+            NX_NULL,
+            output,
+            sizeof(output));
+    }
+
+    crypto_cleanup(&crypto_method_rsa);
+
+    return status;
+}
+
+// Ephemeral P-256 key pair and the shared secret with the server's ephemeral key
+static UINT ecdhe_exchange(VOID)
+{
+    UCHAR public_key[1 + 2 * 32];
+    UCHAR shared_secret[32];
+    NX_CRYPTO_EXTENDED_OUTPUT output;
+    VOID* handle;
+    UINT status;
+
+    if ((status = crypto_init(&crypto_method_ecdhe, NX_NULL, 0, &handle)) == NX_SUCCESS &&
+        (status = crypto_operation(&crypto_method_ecdhe,
+             NX_CRYPTO_EC_CURVE_SET,
+             handle,
+             NX_NULL,
+             0,
+             (UCHAR*)&crypto_method_ec_secp256,
+             sizeof(NX_CRYPTO_METHOD*),
+             NX_NULL,
+             NX_NULL,
+             0)) == NX_SUCCESS)
+    {
+        output.nx_crypto_extended_output_data           = public_key;
+        output.nx_crypto_extended_output_length_in_byte = sizeof(public_key);
+
+        if ((status = crypto_operation(&crypto_method_ecdhe,
+                 NX_CRYPTO_DH_SETUP,
+                 handle,
+                 NX_NULL,
+                 0,
+                 NX_NULL,
+                 0,
+                 NX_NULL,
+                 (UCHAR*)&output,
+                 sizeof(output))) == NX_SUCCESS)
+        {
+            output.nx_crypto_extended_output_data           = shared_secret;
+            output.nx_crypto_extended_output_length_in_byte = sizeof(shared_secret);
+
+            status = crypto_operation(&crypto_method_ecdhe,
+                NX_CRYPTO_DH_CALCULATE,
+                handle,
+                NX_NULL,
+                0,
+                (UCHAR*)ec_public_key,
+                sizeof(ec_public_key),
+                NX_NULL,
+                (UCHAR*)&output,
+                sizeof(output));
+        }
+    }
+
+    crypto_cleanup(&crypto_method_ecdhe);
+
+    return status;
+}
+
+static UINT ecdsa_verify(VOID)
+{
+    VOID* handle;
+    UINT status;
+
+    if ((status = crypto_init(&crypto_method_ecdsa, NX_NULL, 0, &handle)) == NX_SUCCESS &&
+        (status = crypto_operation(&crypto_method_ecdsa,
+             NX_CRYPTO_EC_CURVE_SET,
+             handle,
+             NX_NULL,
+             0,
+             (UCHAR*)&crypto_method_ec_secp256,
+             sizeof(NX_CRYPTO_METHOD*),
+             NX_NULL,
+             NX_NULL,
+             0)) == NX_SUCCESS)
+    {
+        status = crypto_operation(&crypto_method_ecdsa,
+            NX_CRYPTO_VERIFY,
+            handle,
+            (UCHAR*)ec_public_key,
+            sizeof(ec_public_key) << 3,
+            (UCHAR*)ecdsa_digest,
+            sizeof(ecdsa_digest),
+            NX_NULL,
+            (UCHAR*)ecdsa_signature,
+            sizeof(ecdsa_signature));
+    }
+
+    crypto_cleanup(&crypto_method_ecdsa);
+
+    return status;
+}
+
+static UINT time_operation(UINT (*operation)(VOID), double* nanoseconds)
+{
+    double start;
+    UINT status;
+    UINT i;
+
+    start = now_nanoseconds();
+
+    for (i = 0; i < HANDSHAKE_ITERATIONS; i++)
+    {
+        if ((status = operation()))
+        {
+            return status;
+        }
+    }
+
+    *nanoseconds = (now_nanoseconds() - start) / HANDSHAKE_ITERATIONS;
+
+    return NX_SUCCESS;
+}
+
+// AES-128-CBC plus a separate HMAC-SHA256 over the record, as TLS_RSA_WITH_AES_128_CBC_SHA256 does
+static UINT record_cbc(UINT size)
+{
+    UCHAR key[AES_KEY_BITS / 8] = {1};
+    UCHAR mac_key[HMAC_KEY_BITS / 8] = {2};
+    UCHAR iv[AES_KEY_BITS / 8] = {3};
+    UCHAR mac[HMAC_SIZE];
+    VOID* handle;
+    UINT status;
+
+    if ((status = crypto_init(&crypto_method_hmac_sha256, mac_key, HMAC_KEY_BITS, &handle)) == NX_SUCCESS)
+    {
+        status = crypto_operation(&crypto_method_hmac_sha256,
+            NX_CRYPTO_AUTHENTICATE,
+            handle,
+            mac_key,
+            HMAC_KEY_BITS,
+            record_input,
+            size,
+            NX_NULL,
+            mac,
+            sizeof(mac));
+    }
+
+    crypto_cleanup(&crypto_method_hmac_sha256);
+
+    if (status == NX_SUCCESS &&
+        (status = crypto_init(&crypto_method_aes_cbc_128, key, AES_KEY_BITS, &handle)) == NX_SUCCESS)
+    {
+        // Payload, MAC and padding rounded up to the block size
+        status = crypto_operation(&crypto_method_aes_cbc_128,
+            NX_CRYPTO_ENCRYPT,
+            handle,
+            key,
+            AES_KEY_BITS,
+            record_input,
+            (size + HMAC_SIZE + AES_KEY_BITS / 8) & ~(AES_KEY_BITS / 8 - 1),
+            iv,
+            record_output,
+            sizeof(record_output));
+    }
+
+    crypto_cleanup(&crypto_method_aes_cbc_128);
+
+    return status;
+}
+
+// AES-128-GCM, the tag comes out of the same pass as the ciphertext
+static UINT record_gcm(UINT size)
+{
+    UCHAR key[AES_KEY_BITS / 8] = {1};
+    UCHAR additional_data[GCM_AAD_SIZE] = {4};
+    UCHAR nonce[1 + 12] = {12, 5};
+    VOID* handle;
+    UINT status;
+
+    if ((status = crypto_init(&crypto_method_aes_128_gcm_16, key, AES_KEY_BITS, &handle)) == NX_SUCCESS &&
+        (status = crypto_operation(&crypto_method_aes_128_gcm_16,
+             NX_CRYPTO_SET_ADDITIONAL_DATA,
+             handle,
+             key,
+             AES_KEY_BITS,
+             additional_data,
+             sizeof(additional_data),
+             NX_NULL,
+             NX_NULL,
+             0)) == NX_SUCCESS)
+    {
+        status = crypto_operation(&crypto_method_aes_128_gcm_16,
+            NX_CRYPTO_ENCRYPT,
+            handle,
+            key,
+            AES_KEY_BITS,
+            record_input,
+            size,
+            nonce,
+            record_output,
+            size + GCM_TAG_SIZE);
+    }
+
+    crypto_cleanup(&crypto_method_aes_128_gcm_16);
+
+    return status;
+}
+
+static UINT time_record(UINT (*record)(UINT), UINT size, double* nanoseconds)
+{
+    double start;
+    UINT status;
+    UINT i;
+
+    start = now_nanoseconds();
+
+    for (i = 0; i < RECORD_ITERATIONS; i++)
+    {
+        if ((status = record(size)))
+        {
+            return status;
+        }
+    }
+
+    *nanoseconds = (now_nanoseconds() - start) / RECORD_ITERATIONS;
+
+    return NX_SUCCESS;
+}
+
+// Smallest metadata buffer the TLS session accepts for a crypto table, what NX_AZURE_IOT_TLS_METADATA_BUFFER_SIZE
+// has to cover
+static ULONG session_metadata_size(const NX_CRYPTO_METHOD** crypto,
+    UINT crypto_size,
+    const NX_CRYPTO_CIPHERSUITE** ciphersuites,
+    UINT ciphersuites_size)
+{
+    ULONG size;
+
+    for (size = METADATA_PROBE_STEP; size <= sizeof(session_metadata); size += METADATA_PROBE_STEP)
+    {
+        if (_nx_secure_tls_session_create_ext(
+                &tls_session, crypto, crypto_size, ciphersuites, ciphersuites_size, session_metadata, size) ==
+            NX_SUCCESS)
+        {
+            nx_secure_tls_session_delete(&tls_session);
+            return size;
+        }
+    }
+
+    return 0;
+}
+
+static VOID benchmark_entry(ULONG parameter)
+{
+    double rsa_ns;
+    double ecdhe_ns;
+    double ecdsa_ns;
+    double cbc_ns;
+    double gcm_ns;
+    ULONG rsa_metadata;
+    ULONG ecc_metadata;
+    UINT i;
+
+    nx_secure_tls_initialize();
+
+    if (time_operation(rsa_public, &rsa_ns) || time_operation(ecdhe_exchange, &ecdhe_ns) ||
+        time_operation(ecdsa_verify, &ecdsa_ns))
+    {
+        printf("ERROR: public key operation failed\n");
+        exit(1);
+    }
+
+    // Client side public key work for one handshake with server authentication
+    printf("Handshake public key cost, %u iterations\n", HANDSHAKE_ITERATIONS);
+    printf("  %-40s %10.0f us  (RSA encrypt + %u RSA verify)\n",
+        "RSA / AES-128-CBC-SHA256",
+        (1 + CHAIN_SIGNATURES) * rsa_ns / 1000,
+        CHAIN_SIGNATURES);
+    printf("  %-40s %10.0f us  (ECDHE + %u RSA verify + key exchange signature)\n",
+        "ECDHE-RSA / AES-128-GCM-SHA256",
+        (ecdhe_ns + (CHAIN_SIGNATURES + 1) * rsa_ns) / 1000,
+        CHAIN_SIGNATURES);
+    printf("  %-40s %10.0f us  (ECDHE + %u ECDSA verify + key exchange signature)\n\n",
+        "ECDHE-ECDSA / AES-128-GCM-SHA256",
+        (ecdhe_ns + (CHAIN_SIGNATURES + 1) * ecdsa_ns) / 1000,
+        CHAIN_SIGNATURES);
+
+    printf("Per record cost, %u iterations\n", RECORD_ITERATIONS);
+    printf("  %10s %14s %14s\n", "bytes", "CBC+HMAC ns", "GCM ns");
+
+    for (i = 0; i < sizeof(record_sizes) / sizeof(record_sizes[0]); i++)
+    {
+        if (time_record(record_cbc, record_sizes[i], &cbc_ns) || time_record(record_gcm, record_sizes[i], &gcm_ns))
+        {
+            printf("ERROR: record encryption failed\n");
+            exit(1);
+        }
+
+        printf("  %10u %14.0f %14.0f\n", record_sizes[i], cbc_ns, gcm_ns);
+    }
+
+    rsa_metadata = session_metadata_size(_nx_azure_iot_tls_rsa_crypto,
+        _nx_azure_iot_tls_rsa_crypto_size,
+        _nx_azure_iot_tls_rsa_ciphersuite_map,
+        _nx_azure_iot_tls_rsa_ciphersuite_map_size);
+    ecc_metadata = session_metadata_size(_nx_azure_iot_tls_ecc_crypto,
+        _nx_azure_iot_tls_ecc_crypto_size,
+        _nx_azure_iot_tls_ecc_ciphersuite_map,
+        _nx_azure_iot_tls_ecc_ciphersuite_map_size);
+
+    printf("\nTLS session RAM, metadata buffer plus the session itself\n");
+    printf("  %-40s %10lu bytes\n", "RSA profile", rsa_metadata + sizeof(NX_SECURE_TLS_SESSION));
+    printf("  %-40s %10lu bytes\n", "ECC profile", ecc_metadata + sizeof(NX_SECURE_TLS_SESSION));
+
+    exit(0);
+}
+
+VOID tx_application_define(VOID* first_unused_memory)
+{
+    tx_thread_create(&benchmark_thread,
+        "TLS benchmark",
+        benchmark_entry,
+        0,
+        benchmark_stack,
+        sizeof(benchmark_stack),
+        BENCHMARK_PRIORITY,
+        BENCHMARK_PRIORITY,
+        TX_NO_TIME_SLICE,
+        TX_AUTO_START);
+}
+
+int main(VOID)
+{
+    memset(record_input, 0xA5, sizeof(record_input));
+
+    tx_kernel_enter();
+
+    return 0;
+}
@@ -0,0 +1,9 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef NX_USER_H
+#define NX_USER_H
+
+// The driver only needs packets and the IP mutex from the stack, the IP instance itself is never started
+
+#endif // NX_USER_H
@@ -0,0 +1,406 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include "sim_wifi.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "es_wifi.h"
+#include "es_wifi_io.h"
+
+#define SIM_WIFI_BUFFER_SIZE 8192
+#define SIM_WIFI_COMMAND_MAX 32
+
+#define SIM_WIFI_INFO   "ISM43362-M3G-L44-SPI,C3.5.2.5.STM,v3.5.2,v1.4.0.rc1,v8.2.1,120000000,Inventek eS-WiFi"
+#define SIM_WIFI_OK     "\r\nOK\r\n> "
+#define SIM_WIFI_ERROR  "\r\nERROR\r\n> "
+#define SIM_WIFI_CRLF   "\r\n"
+
+#define SIM_WIFI_MS_TO_TICKS(ms) ((((ULONG)(ms)) * TX_TIMER_TICKS_PER_SECOND + 999) / 1000)
+
+typedef struct SIM_WIFI_BUFFER_STRUCT
+{
+    UCHAR data[SIM_WIFI_BUFFER_SIZE];
+    ULONG length;
+} SIM_WIFI_BUFFER;
+
+typedef struct SIM_WIFI_SOCKET_STRUCT
+{
+    UINT open;
+    SIM_WIFI_BUFFER received;
+    SIM_WIFI_BUFFER sent;
+    SIM_WIFI_BUFFER reply;
+} SIM_WIFI_SOCKET;
+
+// Commands that only set a parameter of the next connection or send
+static const CHAR* settings[] = {"P1=", "P2=", "P3=", "P4=", "S2="};
+
+static NX_IP* sim_ip;
+static SIM_WIFI_STATS sim_stats;
+static SIM_WIFI_SOCKET sim_sockets[SIM_WIFI_SOCKETS];
+
+// Socket selected by P0, R1 read length, R2 read timeout in ms, and the S3 payload length expected next
+static UINT selected_socket;
+static ULONG read_length;
+static ULONG read_timeout;
+static UINT read_pending;
+static ULONG payload_length;
+static UINT send_fail_count;
+
+// Thread of the transaction the last P0 started, and of the command waiting for its response
+static TX_THREAD* transaction_thread;
+static TX_THREAD* command_thread;
+
+static UCHAR response[ES_WIFI_PAYLOAD_SIZE + 64];
+static ULONG response_length;
+
+static UINT buffer_append(SIM_WIFI_BUFFER* buffer, const UCHAR* data, ULONG length)
+{
+    if (length > sizeof(buffer->data) - buffer->length)
+    {
+        printf("ERROR: simulated module buffer full\n");
+        return NX_OVERFLOW;
+    }
+
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+
+    return NX_SUCCESS;
+}
+
+static ULONG buffer_take(SIM_WIFI_BUFFER* buffer, UCHAR* data, ULONG length)
+{
+    if (length > buffer->length)
+    {
+        length = buffer->length;
+    }
+
+    memcpy(data, buffer->data, length);
+    memmove(buffer->data, buffer->data + length, buffer->length - length);
+    buffer->length -= length;
+
+    return length;
+}
+
+static VOID response_set(const CHAR* text)
+{
+    response_length = strlen(text);
+    memcpy(response, text, response_length);
+}
+
+static VOID payload_receive(const UCHAR* data, ULONG length)
+{
+    TX_INTERRUPT_SAVE_AREA
+    SIM_WIFI_SOCKET* socket = &sim_sockets[selected_socket];
+    CHAR text[SIM_WIFI_COMMAND_MAX];
+    UINT status;
+
+    if (length != payload_length)
+    {
+        printf("ERROR: S3 announced %lu bytes, %lu followed\n", payload_length, length);
+        payload_length = 0;
+        response_set(SIM_WIFI_ERROR);
+        return;
+    }
+
+    payload_length = 0;
+
+    // A refused send answers -1 in place of the length
+    if (send_fail_count)
+    {
+        send_fail_count--;
+        response_set(SIM_WIFI_CRLF "-1" SIM_WIFI_OK);
+        return;
+    }
+
+    TX_DISABLE
+    status = buffer_append(&socket->sent, data, length);
+
+    // The peer answers whatever is sent
+    if (status == NX_SUCCESS && socket->reply.length)
+    {
+        status = buffer_append(&socket->received, socket->reply.data, socket->reply.length);
+    }
+    TX_RESTORE
+
+    if (status)
+    {
+        response_set(SIM_WIFI_ERROR);
+        return;
+    }
+
+    if (sim_stats.transfers < SIM_WIFI_TRANSFER_LOG)
+    {
+        sim_stats.transfer_length[sim_stats.transfers] = (USHORT)length;
+    }
+    sim_stats.transfers++;
+
+    snprintf(text, sizeof(text), SIM_WIFI_CRLF "%lu" SIM_WIFI_OK, length);
+    response_set(text);
+}
+
+static VOID read_respond(VOID)
+{
+    TX_INTERRUPT_SAVE_AREA
+    SIM_WIFI_SOCKET* socket = &sim_sockets[selected_socket];
+    ULONG deadline          = tx_time_get() + SIM_WIFI_MS_TO_TICKS(read_timeout);
+    ULONG length;
+
+    // Like the module, hold the response until data arrives or the R2 timeout runs out
+    while (socket->received.length == 0 && (LONG)(deadline - tx_time_get()) > 0)
+    {
+        tx_thread_sleep(1);
+    }
+
+    TX_DISABLE
+    length = buffer_take(&socket->received, response + 2, read_length);
+    TX_RESTORE
+
+    memcpy(response, SIM_WIFI_CRLF, 2);
+    memcpy(response + 2 + length, SIM_WIFI_OK, sizeof(SIM_WIFI_OK) - 1);
+    response_length = 2 + length + sizeof(SIM_WIFI_OK) - 1;
+
+    sim_stats.reads++;
+}
+
+static VOID command_run(CHAR* command, TX_THREAD* thread)
+{
+    ULONG value = strtoul(command + 3, NX_NULL, 10);
+    UINT i;
+
+    // Every socket transaction starts by selecting the socket, the rest of it must come from the same thread
+    if (strncmp(command, "P0=", 3) == 0 || strcmp(command, "I?") == 0)
+    {
+        transaction_thread = thread;
+    }
+    else if (transaction_thread != thread)
+    {
+        sim_stats.interleaved++;
+    }
+
+    response_set(SIM_WIFI_OK);
+
+    if (strcmp(command, "I?") == 0)
+    {
+        response_set(SIM_WIFI_CRLF SIM_WIFI_INFO SIM_WIFI_OK);
+    }
+    else if (strncmp(command, "P0=", 3) == 0)
+    {
+        if (value >= SIM_WIFI_SOCKETS)
+        {
+            response_set(SIM_WIFI_ERROR);
+            return;
+        }
+
+        selected_socket = value;
+    }
+    else if (strncmp(command, "P6=", 3) == 0)
+    {
+        sim_sockets[selected_socket].open = (value != 0);
+    }
+    else if (strncmp(command, "R1=", 3) == 0)
+    {
+        read_length = (value < ES_WIFI_PAYLOAD_SIZE) ? value : ES_WIFI_PAYLOAD_SIZE;
+    }
+    else if (strncmp(command, "R2=", 3) == 0)
+    {
+        read_timeout = value;
+    }
+    else if (strncmp(command, "S3=", 3) == 0 || strcmp(command, "R0") == 0)
+    {
+        if (!sim_sockets[selected_socket].open)
+        {
+            response_set(SIM_WIFI_ERROR);
+            return;
+        }
+
+        // The payload follows the S3 command, the R0 response waits for data
+        if (command[0] == 'S')
+        {
+            payload_length = value;
+        }
+        else
+        {
+            read_pending = NX_TRUE;
+        }
+    }
+    else
+    {
+        for (i = 0; i < sizeof(settings) / sizeof(settings[0]); i++)
+        {
+            if (strncmp(command, settings[i], 3) == 0)
+            {
+                return;
+            }
+        }
+
+        printf("ERROR: simulated module got unknown command %s\n", command);
+        response_set(SIM_WIFI_ERROR);
+    }
+}
+
+VOID sim_wifi_reset(NX_IP* ip_ptr)
+{
+    sim_ip = ip_ptr;
+
+    memset(&sim_stats, 0, sizeof(sim_stats));
+    memset(sim_sockets, 0, sizeof(sim_sockets));
+
+    selected_socket    = 0;
+    read_length        = 0;
+    read_timeout       = 0;
+    read_pending       = NX_FALSE;
+    payload_length     = 0;
+    send_fail_count    = 0;
+    transaction_thread = NX_NULL;
+    command_thread     = NX_NULL;
+    response_length    = 0;
+}
+
+VOID sim_wifi_stats_get(SIM_WIFI_STATS* stats)
+{
+    *stats = sim_stats;
+}
+
+UINT sim_wifi_receive_push(UINT socket, const UCHAR* data, ULONG length)
+{
+    TX_INTERRUPT_SAVE_AREA
+    UINT status;
+
+    if (socket >= SIM_WIFI_SOCKETS)
+    {
+        return NX_INVALID_PARAMETERS;
+    }
+
+    TX_DISABLE
+    status = buffer_append(&sim_sockets[socket].received, data, length);
+    TX_RESTORE
+
+    return status;
+}
+
+UINT sim_wifi_reply_set(UINT socket, const UCHAR* data, ULONG length)
+{
+    TX_INTERRUPT_SAVE_AREA
+    UINT status;
+
+    if (socket >= SIM_WIFI_SOCKETS)
+    {
+        return NX_INVALID_PARAMETERS;
+    }
+
+    TX_DISABLE
+    sim_sockets[socket].reply.length = 0;
+    status                           = buffer_append(&sim_sockets[socket].reply, data, length);
+    TX_RESTORE
+
+    return status;
+}
+
+ULONG sim_wifi_sent_get(UINT socket, UCHAR* buffer, ULONG length)
+{
+    TX_INTERRUPT_SAVE_AREA
+
+    if (socket >= SIM_WIFI_SOCKETS)
+    {
+        return 0;
+    }
+
+    TX_DISABLE
+    length = buffer_take(&sim_sockets[socket].sent, buffer, length);
+    TX_RESTORE
+
+    return length;
+}
+
+VOID sim_wifi_send_fail(UINT count)
+{
+    send_fail_count = count;
+}
+
+int8_t SPI_WIFI_Init(uint16_t mode)
+{
+    return 0;
+}
+
+int8_t SPI_WIFI_DeInit(void)
+{
+    return 0;
+}
+
+void SPI_WIFI_Delay(uint32_t delay)
+{
+    tx_thread_sleep(SIM_WIFI_MS_TO_TICKS(delay));
+}
+
+int16_t SPI_WIFI_SendData(uint8_t* pdata, uint16_t len, uint32_t timeout)
+{
+    TX_THREAD* thread = tx_thread_identify();
+    CHAR command[SIM_WIFI_COMMAND_MAX];
+
+    // Waiting on the module with the IP mutex held would stall every other socket and the stack
+    if (sim_ip != NX_NULL && sim_ip->nx_ip_protection.tx_mutex_owner == thread)
+    {
+        sim_stats.ip_mutex_held++;
+    }
+
+    // Nothing may come in between a command and its response
+    if (command_thread != NX_NULL && command_thread != thread)
+    {
+        sim_stats.interleaved++;
+    }
+    command_thread = thread;
+
+    if (payload_length)
+    {
+        payload_receive(pdata, len);
+        return (int16_t)len;
+    }
+
+    if (len >= sizeof(command))
+    {
+        printf("ERROR: simulated module got a %u byte command\n", len);
+        response_set(SIM_WIFI_ERROR);
+        return (int16_t)len;
+    }
+
+    // Commands end in \r, padded with \n to a whole SPI word
+    memcpy(command, pdata, len);
+    command[len] = '\0';
+    command[strcspn(command, "\r\n")] = '\0';
+
+    command_run(command, thread);
+
+    return (int16_t)len;
+}
+
+int16_t SPI_WIFI_ReceiveData(uint8_t* pdata, uint16_t len, uint32_t timeout)
+{
+    ULONG length;
+
+    if (read_pending)
+    {
+        read_pending = NX_FALSE;
+        read_respond();
+    }
+
+    // A length of 0 takes the whole response
+    length = response_length;
+    if (len && length > len)
+    {
+        length = len;
+    }
+
+    memcpy(pdata, response, length);
+    response_length = 0;
+    command_thread  = NX_NULL;
+
+    return (int16_t)length;
+}
+
+uint32_t HAL_GetTick(void)
+{
+    return tx_time_get() * (1000 / TX_TIMER_TICKS_PER_SECOND);
+}
@@ -0,0 +1,42 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _SIM_WIFI_H
+#define _SIM_WIFI_H
+
+#include "nx_api.h"
+
+#define SIM_WIFI_SOCKETS      8
+#define SIM_WIFI_TRANSFER_LOG 16
+
+// What the simulated module saw since the last sim_wifi_reset
+typedef struct SIM_WIFI_STATS_STRUCT
+{
+    // S3 sends, the length of the first SIM_WIFI_TRANSFER_LOG of them, and R0 reads
+    ULONG transfers;
+    USHORT transfer_length[SIM_WIFI_TRANSFER_LOG];
+    ULONG reads;
+
+    // Commands sent by a thread holding the IP mutex, and commands cutting into another thread's transaction
+    ULONG ip_mutex_held;
+    ULONG interleaved;
+} SIM_WIFI_STATS;
+
+// Simulated Inventek ES-WiFi module behind the SPI_WIFI_* bus functions es_wifi.c calls. It answers the AT commands
+// the socket calls use, and checks every command against the IP mutex of ip_ptr.
+VOID sim_wifi_reset(NX_IP* ip_ptr);
+VOID sim_wifi_stats_get(SIM_WIFI_STATS* stats);
+
+// Data arriving on a module socket, handed out by the next R0 reads
+UINT sim_wifi_receive_push(UINT socket, const UCHAR* data, ULONG length);
+
+// Data the peer answers with each time the socket sends
+UINT sim_wifi_reply_set(UINT socket, const UCHAR* data, ULONG length);
+
+// Take the data the socket sent so far, returns its length
+ULONG sim_wifi_sent_get(UINT socket, UCHAR* buffer, ULONG length);
+
+// Refuse the next count sends, the way the module reports a send it could not make
+VOID sim_wifi_send_fail(UINT count);
+
+#endif // _SIM_WIFI_H
@@ -0,0 +1,13 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#ifndef _STM32L4XX_HAL_H
+#define _STM32L4XX_HAL_H
+
+// Just enough of the HAL for es_wifi_io.h, the SPI bus itself is simulated by sim_wifi.c
+typedef struct
+{
+    int unused;
+} SPI_HandleTypeDef;
+
+#endif // _STM32L4XX_HAL_H
@@ -0,0 +1,655 @@
+/* Copyright (c) Microsoft Corporation.
+   Licensed under the MIT License. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tx_api.h"
+
+#include "nx_api.h"
+#include "nx_wifi.h"
+#include "wifi.h"
+
+#include "sim_wifi.h"
+
+#define TEST_STACK_SIZE (16 * 1024)
+#define TEST_PRIORITY   4
+
+// Small packets, so a send of a few hundred bytes is already a chain
+#define TEST_PACKET_PAYLOAD 256
+#define TEST_PACKET_COUNT   48
+
+#define TEST_SOCKETS        3
+#define TEST_LOCAL_PORT     49152
+#define TEST_SERVER_PORT    8883
+#define TEST_SERVER_ADDRESS IP_ADDRESS(10, 0, 0, 1)
+
+// Worker threads running socket calls next to the test thread and the wifi thread
+#define TEST_WORKER_STACK_SIZE (8 * 1024)
+
+// Each lock order worker sends its stream in rounds and waits for the reply to each one
+#define TEST_ROUNDS       16
+#define TEST_ROUND_LENGTH 200
+#define TEST_REPLY_LENGTH 64
+#define TEST_REPLY_OFFSET 3800
+
+#define TEST_ASSERT(condition)                                                                                         \
+    if (!(condition))                                                                                                  \
+    {                                                                                                                  \
+        printf("  FAIL: %s:%d: %s\n", __FILE__, __LINE__, #condition);                                                 \
+        return NX_NOT_SUCCESSFUL;                                                                                      \
+    }
+
+typedef UINT (*func_ptr_test)(VOID);
+
+static TX_THREAD test_thread;
+static ULONG test_stack[TEST_STACK_SIZE / sizeof(ULONG)];
+
+// The driver only takes the IP mutex, the rest of the IP instance is never used
+static NX_IP ip;
+static NX_PACKET_POOL pool;
+static UCHAR pool_memory[TEST_PACKET_COUNT * (TEST_PACKET_PAYLOAD + sizeof(NX_PACKET))];
+
+static NX_TCP_SOCKET sockets[TEST_SOCKETS];
+static TX_SEMAPHORE received_semaphore;
+
+static TX_THREAD workers[TEST_SOCKETS];
+static ULONG worker_stacks[TEST_SOCKETS][TEST_WORKER_STACK_SIZE / sizeof(ULONG)];
+static UINT worker_started[TEST_SOCKETS];
+static UINT worker_status[TEST_SOCKETS];
+static TX_SEMAPHORE worker_semaphore;
+
+static UCHAR pattern[4096];
+static UCHAR buffer[4096];
+
+// Called by the wifi thread when data is queued on a socket that had none
+static VOID socket_received(NX_TCP_SOCKET* socket_ptr)
+{
+    tx_semaphore_ceiling_put(&received_semaphore, 1);
+}
+
+static UINT packet_build(NX_PACKET** packet_ptr, const UCHAR* data, ULONG length)
+{
+    UINT status;
+
+    if ((status = nx_packet_allocate(&pool, packet_ptr, NX_TCP_PACKET, NX_NO_WAIT)))
+    {
+        return status;
+    }
+
+    if ((status = nx_packet_data_append(*packet_ptr, (VOID*)data, length, &pool, NX_NO_WAIT)))
+    {
+        nx_packet_release(*packet_ptr);
+    }
+
+    return status;
+}
+
+static VOID workers_stop(VOID)
+{
+    UINT i;
+
+    for (i = 0; i < TEST_SOCKETS; i++)
+    {
+        if (worker_started[i])
+        {
+            tx_thread_terminate(&workers[i]);
+            tx_thread_delete(&workers[i]);
+            worker_started[i] = NX_FALSE;
+        }
+    }
+
+    while (tx_semaphore_get(&worker_semaphore, TX_NO_WAIT) == TX_SUCCESS)
+    {
+    }
+}
+
+// Start count workers, worker i runs entry on socket i
+static UINT workers_start(VOID (*entry)(ULONG), UINT count)
+{
+    UINT status;
+    UINT i;
+
+    for (i = 0; i < count; i++)
+    {
+        worker_status[i] = NX_NOT_SUCCESSFUL;
+
+        if ((status = tx_thread_create(&workers[i],
+                 "wifi driver test worker",
+                 entry,
+                 i,
+                 worker_stacks[i],
+                 sizeof(worker_stacks[i]),
+                 TEST_PRIORITY,
+                 TEST_PRIORITY,
+                 TX_NO_TIME_SLICE,
+                 TX_AUTO_START)))
+        {
+            return status;
+        }
+
+        worker_started[i] = NX_TRUE;
+    }
+
+    return NX_SUCCESS;
+}
+
+// Wait for count workers to finish, the ones that do not are stuck
+static UINT workers_wait(UINT count, ULONG wait_option)
+{
+    UINT status;
+    UINT i;
+
+    for (i = 0; i < count; i++)
+    {
+        if ((status = tx_semaphore_get(&worker_semaphore, wait_option)))
+        {
+            return status;
+        }
+    }
+
+    return NX_SUCCESS;
+}
+
+static VOID sockets_close(VOID)
+{
+    UINT i;
+
+    // Sockets that are not connected are refused, which is fine here
+    for (i = 0; i < TEST_SOCKETS; i++)
+    {
+        nx_wifi_tcp_socket_disconnect(&sockets[i], NX_WAIT_FOREVER);
+    }
+}
+
+// Start a test on a fresh module with count sockets, connected in order so socket i is module socket i
+static UINT test_open(UINT count)
+{
+    NXD_ADDRESS server;
+    UINT status;
+    UINT i;
+
+    // Whatever a failed test left behind
+    workers_stop();
+    sockets_close();
+    while (tx_semaphore_get(&received_semaphore, TX_NO_WAIT) == TX_SUCCESS)
+    {
+    }
+
+    sim_wifi_reset(&ip);
+
+    for (i = 0; i < count; i++)
+    {
+        memset(&sockets[i], 0, sizeof(NX_TCP_SOCKET));
+        sockets[i].nx_tcp_socket_port = TEST_LOCAL_PORT + i;
+
+        server.nxd_ip_version    = NX_IP_VERSION_V4;
+        server.nxd_ip_address.v4 = TEST_SERVER_ADDRESS;
+
+        if ((status = nx_wifi_tcp_client_socket_connect(&sockets[i], &server, TEST_SERVER_PORT, NX_WAIT_FOREVER)))
+        {
+            return status;
+        }
+    }
+
+    return NX_SUCCESS;
+}
+
+// Close the sockets, after which every packet must be back in the pool
+static UINT test_close(VOID)
+{
+    sockets_close();
+
+    return (pool.nx_packet_pool_available == pool.nx_packet_pool_total) ? NX_SUCCESS : NX_NOT_SUCCESSFUL;
+}
+
+// Wait for the wifi thread to finish a poll of the module
+static UINT poll_wait(VOID)
+{
+    SIM_WIFI_STATS stats;
+    ULONG reads;
+    ULONG ticks;
+
+    sim_wifi_stats_get(&stats);
+    reads = stats.reads;
+
+    for (ticks = 0; ticks < WIFI_THREAD_PERIOD * 2; ticks++)
+    {
+        tx_thread_sleep(1);
+
+        sim_wifi_stats_get(&stats);
+        if (stats.reads != reads)
+        {
+            return NX_SUCCESS;
+        }
+    }
+
+    return NX_NOT_SUCCESSFUL;
+}
+
+// Let the wifi thread back off to its full period and return just after one of its polls
+static UINT poll_idle(VOID)
+{
+    UINT status;
+
+    tx_thread_sleep(WIFI_THREAD_PERIOD * 3);
+    if ((status = poll_wait()))
+    {
+        return status;
+    }
+
+    tx_thread_sleep(2);
+
+    return NX_SUCCESS;
+}
+
+// Wait for the module to have seen count sends
+static UINT transfers_wait(ULONG count, ULONG wait_option)
+{
+    SIM_WIFI_STATS stats;
+    ULONG ticks;
+
+    for (ticks = 0; ticks <= wait_option; ticks++)
+    {
+        sim_wifi_stats_get(&stats);
+        if (stats.transfers >= count)
+        {
+            return NX_SUCCESS;
+        }
+
+        tx_thread_sleep(1);
+    }
+
+    return NX_NOT_SUCCESSFUL;
+}
+
+static UINT test_receive(VOID)
+{
+    NX_PACKET* packet_ptr;
+    ULONG length = 0;
+
+    TEST_ASSERT(test_open(1) == NX_SUCCESS);
+    sockets[0].nx_tcp_receive_callback = socket_received;
+
+    // More than a packet holds, it arrives over several reads straight into the packets
+    TEST_ASSERT(sim_wifi_receive_push(0, pattern, 1000) == NX_SUCCESS);
+    TEST_ASSERT(tx_semaphore_get(&received_semaphore, WIFI_THREAD_PERIOD * 2) == TX_SUCCESS);
+
+    while (length < 1000)
+    {
+        TEST_ASSERT(nx_wifi_tcp_socket_receive(&sockets[0], &packet_ptr, NX_IP_PERIODIC_RATE) == NX_SUCCESS);
+        TEST_ASSERT(packet_ptr->nx_packet_length <= TEST_PACKET_PAYLOAD - ES_WIFI_RECEIVE_OVERHEAD);
+        TEST_ASSERT(memcmp(packet_ptr->nx_packet_prepend_ptr, pattern + length, packet_ptr->nx_packet_length) == 0);
+
+        length += packet_ptr->nx_packet_length;
+        nx_packet_release(packet_ptr);
+    }
+
+    TEST_ASSERT(length == 1000);
+    TEST_ASSERT(nx_wifi_tcp_socket_receive(&sockets[0], &packet_ptr, NX_NO_WAIT) == NX_NO_PACKET);
+
+    TEST_ASSERT(test_close() == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+static UINT test_send_polls(VOID)
+{
+    NX_PACKET* packet_ptr;
+
+    TEST_ASSERT(test_open(1) == NX_SUCCESS);
+    sockets[0].nx_tcp_receive_callback = socket_received;
+    TEST_ASSERT(sim_wifi_reply_set(0, pattern + 100, 16) == NX_SUCCESS);
+
+    // Send just after a poll, with the next one a whole period away
+    TEST_ASSERT(poll_idle() == NX_SUCCESS);
+
+    TEST_ASSERT(packet_build(&packet_ptr, pattern, 16) == NX_SUCCESS);
+    TEST_ASSERT(nx_wifi_tcp_socket_send(&sockets[0], packet_ptr, NX_WAIT_FOREVER) == NX_SUCCESS);
+
+    // The send wakes the wifi thread, the reply is in long before the next poll was due
+    TEST_ASSERT(tx_semaphore_get(&received_semaphore, WIFI_THREAD_PERIOD / 4) == TX_SUCCESS);
+
+    TEST_ASSERT(nx_wifi_tcp_socket_receive(&sockets[0], &packet_ptr, NX_NO_WAIT) == NX_SUCCESS);
+    TEST_ASSERT(packet_ptr->nx_packet_length == 16);
+    TEST_ASSERT(memcmp(packet_ptr->nx_packet_prepend_ptr, pattern + 100, 16) == 0);
+    nx_packet_release(packet_ptr);
+
+    TEST_ASSERT(sim_wifi_sent_get(0, buffer, sizeof(buffer)) == 16);
+    TEST_ASSERT(memcmp(buffer, pattern, 16) == 0);
+
+    TEST_ASSERT(test_close() == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+// Block in a receive that nothing arrives for, holding the socket the whole time
+static VOID busy_entry(ULONG index)
+{
+    NX_PACKET* packet_ptr;
+
+    worker_status[index] = nx_wifi_tcp_socket_receive(&sockets[index], &packet_ptr, 3 * NX_IP_PERIODIC_RATE);
+    if (worker_status[index] == NX_SUCCESS)
+    {
+        nx_packet_release(packet_ptr);
+    }
+
+    tx_semaphore_put(&worker_semaphore);
+}
+
+static UINT test_busy_socket(VOID)
+{
+    SIM_WIFI_STATS stats;
+    NX_PACKET* packet_ptr;
+
+    TEST_ASSERT(test_open(2) == NX_SUCCESS);
+    sockets[1].nx_tcp_receive_callback = socket_received;
+
+    TEST_ASSERT(workers_start(busy_entry, 1) == NX_SUCCESS);
+    tx_thread_sleep(10);
+
+    // The wifi thread skips the socket the worker holds, and the other one keeps moving
+    TEST_ASSERT(sim_wifi_receive_push(1, pattern, 100) == NX_SUCCESS);
+    TEST_ASSERT(tx_semaphore_get(&received_semaphore, NX_IP_PERIODIC_RATE) == TX_SUCCESS);
+
+    TEST_ASSERT(nx_wifi_tcp_socket_receive(&sockets[1], &packet_ptr, NX_NO_WAIT) == NX_SUCCESS);
+    TEST_ASSERT(packet_ptr->nx_packet_length == 100);
+    TEST_ASSERT(memcmp(packet_ptr->nx_packet_prepend_ptr, pattern, 100) == 0);
+    nx_packet_release(packet_ptr);
+
+    TEST_ASSERT(packet_build(&packet_ptr, pattern + 100, 100) == NX_SUCCESS);
+    TEST_ASSERT(nx_wifi_tcp_socket_send(&sockets[1], packet_ptr, NX_IP_PERIODIC_RATE) == NX_SUCCESS);
+    TEST_ASSERT(sim_wifi_sent_get(1, buffer, sizeof(buffer)) == 100);
+    TEST_ASSERT(memcmp(buffer, pattern + 100, 100) == 0);
+
+    // All of that happened while the worker was still waiting
+    TEST_ASSERT(tx_semaphore_get(&worker_semaphore, TX_NO_WAIT) != TX_SUCCESS);
+    TEST_ASSERT(workers_wait(1, 5 * NX_IP_PERIODIC_RATE) == NX_SUCCESS);
+    TEST_ASSERT(worker_status[0] == NX_NO_PACKET);
+    workers_stop();
+
+    sim_wifi_stats_get(&stats);
+    TEST_ASSERT(stats.ip_mutex_held == 0);
+    TEST_ASSERT(stats.interleaved == 0);
+
+    TEST_ASSERT(test_close() == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+// Send rounds on a socket and collect the reply to each, racing the other workers and the wifi thread
+static VOID round_trip_entry(ULONG index)
+{
+    const UCHAR* reply = pattern + TEST_REPLY_OFFSET + index * TEST_REPLY_LENGTH;
+    NX_PACKET* packet_ptr;
+    ULONG length;
+    UINT round;
+    UINT status = NX_SUCCESS;
+
+    for (round = 0; round < TEST_ROUNDS && status == NX_SUCCESS; round++)
+    {
+        if ((status = packet_build(&packet_ptr, pattern + index * 200 + round * TEST_ROUND_LENGTH, TEST_ROUND_LENGTH)))
+        {
+            break;
+        }
+
+        if ((status = nx_wifi_tcp_socket_send(&sockets[index], packet_ptr, NX_IP_PERIODIC_RATE)))
+        {
+            nx_packet_release(packet_ptr);
+            break;
+        }
+
+        // The reply comes either from the queue the wifi thread filled or straight from the module
+        for (length = 0; length < TEST_REPLY_LENGTH && status == NX_SUCCESS; length += packet_ptr->nx_packet_length)
+        {
+            if ((status = nx_wifi_tcp_socket_receive(&sockets[index], &packet_ptr, 5 * NX_IP_PERIODIC_RATE)))
+            {
+                break;
+            }
+
+            if (length + packet_ptr->nx_packet_length > TEST_REPLY_LENGTH ||
+                memcmp(packet_ptr->nx_packet_prepend_ptr, reply + length, packet_ptr->nx_packet_length))
+            {
+                status = NX_NOT_SUCCESSFUL;
+            }
+
+            nx_packet_release(packet_ptr);
+        }
+    }
+
+    worker_status[index] = status;
+    tx_semaphore_put(&worker_semaphore);
+}
+
+static UINT test_lock_order(VOID)
+{
+    SIM_WIFI_STATS stats;
+    UINT i;
+
+    TEST_ASSERT(test_open(TEST_SOCKETS) == NX_SUCCESS);
+
+    for (i = 0; i < TEST_SOCKETS; i++)
+    {
+        TEST_ASSERT(sim_wifi_reply_set(i, pattern + TEST_REPLY_OFFSET + i * TEST_REPLY_LENGTH, TEST_REPLY_LENGTH) ==
+                    NX_SUCCESS);
+    }
+
+    // A lock order inversion between the socket, IP and module mutexes leaves workers stuck here
+    TEST_ASSERT(workers_start(round_trip_entry, TEST_SOCKETS) == NX_SUCCESS);
+    TEST_ASSERT(workers_wait(TEST_SOCKETS, 30 * NX_IP_PERIODIC_RATE) == NX_SUCCESS);
+    workers_stop();
+
+    for (i = 0; i < TEST_SOCKETS; i++)
+    {
+        TEST_ASSERT(worker_status[i] == NX_SUCCESS);
+        TEST_ASSERT(sim_wifi_sent_get(i, buffer, sizeof(buffer)) == TEST_ROUNDS * TEST_ROUND_LENGTH);
+        TEST_ASSERT(memcmp(buffer, pattern + i * 200, TEST_ROUNDS * TEST_ROUND_LENGTH) == 0);
+    }
+
+    // No module transaction ran under the IP mutex, and none was cut into by another thread
+    sim_wifi_stats_get(&stats);
+    TEST_ASSERT(stats.reads > 0);
+    TEST_ASSERT(stats.ip_mutex_held == 0);
+    TEST_ASSERT(stats.interleaved == 0);
+
+    TEST_ASSERT(test_close() == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+static UINT test_chain_coalesced(VOID)
+{
+    SIM_WIFI_STATS stats;
+    NX_PACKET* packet_ptr;
+
+    TEST_ASSERT(test_open(1) == NX_SUCCESS);
+
+    // A chain of three packets goes out in one transfer
+    TEST_ASSERT(packet_build(&packet_ptr, pattern, 700) == NX_SUCCESS);
+    TEST_ASSERT(packet_ptr->nx_packet_next != NX_NULL);
+    TEST_ASSERT(nx_wifi_tcp_socket_send(&sockets[0], packet_ptr, NX_WAIT_FOREVER) == NX_SUCCESS);
+
+    sim_wifi_stats_get(&stats);
+    TEST_ASSERT(stats.transfers == 1);
+    TEST_ASSERT(stats.transfer_length[0] == 700);
+
+    // A longer one in full transfers, whatever the packet boundaries
+    TEST_ASSERT(packet_build(&packet_ptr, pattern + 700, 3000) == NX_SUCCESS);
+    TEST_ASSERT(nx_wifi_tcp_socket_send(&sockets[0], packet_ptr, NX_WAIT_FOREVER) == NX_SUCCESS);
+
+    sim_wifi_stats_get(&stats);
+    TEST_ASSERT(stats.transfers == 4);
+    TEST_ASSERT(stats.transfer_length[1] == ES_WIFI_PAYLOAD_SIZE);
+    TEST_ASSERT(stats.transfer_length[2] == ES_WIFI_PAYLOAD_SIZE);
+    TEST_ASSERT(stats.transfer_length[3] == 3000 - 2 * ES_WIFI_PAYLOAD_SIZE);
+
+    TEST_ASSERT(sim_wifi_sent_get(0, buffer, sizeof(buffer)) == 3700);
+    TEST_ASSERT(memcmp(buffer, pattern, 3700) == 0);
+
+    TEST_ASSERT(test_close() == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+static UINT test_corked(VOID)
+{
+    SIM_WIFI_STATS stats;
+    NX_PACKET* packet_ptr;
+    UINT i;
+
+    TEST_ASSERT(test_open(1) == NX_SUCCESS);
+    TEST_ASSERT(nx_wifi_tcp_socket_cork(&sockets[0], NX_TRUE) == NX_SUCCESS);
+
+    // Keep the wifi thread from sending on the cork timeout in between
+    TEST_ASSERT(poll_idle() == NX_SUCCESS);
+
+    // Corked writes are held back until they fill a transfer
+    for (i = 0; i < 3; i++)
+    {
+        sim_wifi_stats_get(&stats);
+        TEST_ASSERT(stats.transfers == 0);
+
+        TEST_ASSERT(packet_build(&packet_ptr, pattern + i * 500, 500) == NX_SUCCESS);
+        TEST_ASSERT(nx_wifi_tcp_socket_send(&sockets[0], packet_ptr, NX_WAIT_FOREVER) == NX_SUCCESS);
+    }
+
+    sim_wifi_stats_get(&stats);
+    TEST_ASSERT(stats.transfers == 1);
+    TEST_ASSERT(stats.transfer_length[0] == ES_WIFI_PAYLOAD_SIZE);
+
+    // The flush sends the rest
+    TEST_ASSERT(nx_wifi_tcp_socket_flush(&sockets[0]) == NX_SUCCESS);
+
+    sim_wifi_stats_get(&stats);
+    TEST_ASSERT(stats.transfers == 2);
+    TEST_ASSERT(stats.transfer_length[1] == 1500 - ES_WIFI_PAYLOAD_SIZE);
+
+    // A short write that is never flushed goes out on the wifi thread's next poll after the cork timeout
+    TEST_ASSERT(packet_build(&packet_ptr, pattern + 1500, 100) == NX_SUCCESS);
+    TEST_ASSERT(nx_wifi_tcp_socket_send(&sockets[0], packet_ptr, NX_WAIT_FOREVER) == NX_SUCCESS);
+
+    sim_wifi_stats_get(&stats);
+    TEST_ASSERT(stats.transfers == 2);
+    TEST_ASSERT(transfers_wait(3, WIFI_THREAD_PERIOD * 2) == NX_SUCCESS);
+
+    sim_wifi_stats_get(&stats);
+    TEST_ASSERT(stats.transfer_length[2] == 100);
+
+    TEST_ASSERT(sim_wifi_sent_get(0, buffer, sizeof(buffer)) == 1600);
+    TEST_ASSERT(memcmp(buffer, pattern, 1600) == 0);
+
+    TEST_ASSERT(test_close() == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+static UINT test_send_failed(VOID)
+{
+    NX_PACKET* packet_ptr;
+
+    TEST_ASSERT(test_open(1) == NX_SUCCESS);
+    TEST_ASSERT(nx_wifi_tcp_socket_cork(&sockets[0], NX_TRUE) == NX_SUCCESS);
+
+    TEST_ASSERT(packet_build(&packet_ptr, pattern, 500) == NX_SUCCESS);
+    TEST_ASSERT(nx_wifi_tcp_socket_send(&sockets[0], packet_ptr, NX_WAIT_FOREVER) == NX_SUCCESS);
+
+    // The send that fills a transfer fails, the corked data goes and the caller keeps its packet
+    sim_wifi_send_fail(1);
+    TEST_ASSERT(packet_build(&packet_ptr, pattern + 500, 1000) == NX_SUCCESS);
+    TEST_ASSERT(nx_wifi_tcp_socket_send(&sockets[0], packet_ptr, NX_WAIT_FOREVER) == NX_NOT_SUCCESSFUL);
+
+    TEST_ASSERT(packet_ptr->nx_packet_length == 1000);
+    TEST_ASSERT(memcmp(packet_ptr->nx_packet_prepend_ptr, pattern + 500, 100) == 0);
+    TEST_ASSERT(nx_packet_release(packet_ptr) == NX_SUCCESS);
+
+    // The socket carries on with the next write
+    TEST_ASSERT(nx_wifi_tcp_socket_cork(&sockets[0], NX_FALSE) == NX_SUCCESS);
+    TEST_ASSERT(packet_build(&packet_ptr, pattern + 1500, 100) == NX_SUCCESS);
+    TEST_ASSERT(nx_wifi_tcp_socket_send(&sockets[0], packet_ptr, NX_WAIT_FOREVER) == NX_SUCCESS);
+
+    TEST_ASSERT(sim_wifi_sent_get(0, buffer, sizeof(buffer)) == 100);
+    TEST_ASSERT(memcmp(buffer, pattern + 1500, 100) == 0);
+
+    TEST_ASSERT(test_close() == NX_SUCCESS);
+
+    return NX_SUCCESS;
+}
+
+static const struct
+{
+    const CHAR* name;
+    func_ptr_test run;
+} tests[] = {
+    {"receive", test_receive},
+    {"send_polls", test_send_polls},
+    {"busy_socket", test_busy_socket},
+    {"lock_order", test_lock_order},
+    {"chain_coalesced", test_chain_coalesced},
+    {"corked", test_corked},
+    {"send_failed", test_send_failed},
+};
+
+static VOID test_entry(ULONG parameter)
+{
+    UINT failures = 0;
+    UINT i;
+
+    // A deadlocked test never gets to exit, show how far it got
+    setvbuf(stdout, NX_NULL, _IONBF, 0);
+
+    for (i = 0; i < sizeof(pattern); i++)
+    {
+        pattern[i] = (UCHAR)(i * 7 + i / 251);
+    }
+
+    nx_system_initialize();
+    sim_wifi_reset(&ip);
+
+    if (nx_packet_pool_create(&pool, "wifi driver test", TEST_PACKET_PAYLOAD, pool_memory, sizeof(pool_memory)) ||
+        tx_mutex_create(&ip.nx_ip_protection, "wifi driver test ip", TX_INHERIT) ||
+        tx_semaphore_create(&received_semaphore, "wifi driver test received", 0) ||
+        tx_semaphore_create(&worker_semaphore, "wifi driver test worker", 0) || WIFI_Init() != WIFI_STATUS_OK ||
+        nx_wifi_initialize(&ip, &pool))
+    {
+        printf("ERROR: failed to start the wifi driver\n");
+        exit(1);
+    }
+
+    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    {
+        printf("%s\n", tests[i].name);
+
+        if (tests[i].run() != NX_SUCCESS)
+        {
+            failures++;
+        }
+    }
+
+    printf("%u of %u tests passed\n",
+        (UINT)(sizeof(tests) / sizeof(tests[0])) - failures,
+        (UINT)(sizeof(tests) / sizeof(tests[0])));
+
+    exit(failures ? 1 : 0);
+}
+
+VOID tx_application_define(VOID* first_unused_memory)
+{
+    tx_thread_create(&test_thread,
+        "wifi driver test",
+        test_entry,
+        0,
+        test_stack,
+        sizeof(test_stack),
+        TEST_PRIORITY,
+        TEST_PRIORITY,
+        TX_NO_TIME_SLICE,
+        TX_AUTO_START);
+}
+
+int main(int argc, char* argv[])
+{
+    tx_kernel_enter();
+
+    return 0;
+}